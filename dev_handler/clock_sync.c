@@ -0,0 +1,65 @@
+#include <clock_sync.h>
+
+#include <math.h>  // for llround
+
+void clock_sync_init(clock_sync_t* sync) {
+    memset(sync, 0, sizeof(clock_sync_t));
+}
+
+void clock_sync_add_exchange(clock_sync_t* sync, uint32_t t1, uint32_t t2, uint32_t t3, uint64_t t4) {
+    // Time on the wire, excluding the time the device took to reply
+    int32_t delay = (int32_t) ((uint32_t) t4 - t1) - (int32_t) (t3 - t2);
+    if (delay < 0) {
+        delay = 0;  // Possible if the clocks drifted a lot within one exchange; treat as instantaneous
+    }
+    // ((t2 - t1) + (t3 - t4)) / 2 == (t3 - t4) + delay / 2, which doesn't overflow modulo 2^32
+    uint32_t offset = (t3 - (uint32_t) t4) + (uint32_t) (delay / 2);
+
+    // Put the exchange into the window, overwriting the oldest one
+    sync->offsets[sync->next] = offset;
+    sync->delays[sync->next] = (uint32_t) delay;
+    sync->times[sync->next] = t4;
+    sync->next = (sync->next + 1) % CLOCK_SYNC_WINDOW;
+    if (sync->num_samples < CLOCK_SYNC_WINDOW) {
+        sync->num_samples++;
+    }
+
+    // The exchange with the smallest delay has the smallest error bound on its offset
+    int best = 0;
+    for (int i = 1; i < sync->num_samples; i++) {
+        if (sync->delays[i] < sync->delays[best]) {
+            best = i;
+        }
+    }
+    if (sync->synced && sync->times[best] == sync->offset_time) {
+        return;  // Best estimate didn't change
+    }
+    sync->offset = sync->offsets[best];
+    sync->offset_time = sync->times[best];
+    sync->delay = sync->delays[best];
+
+    // Update the drift once the best offset has moved far enough in time from the reference
+    if (!sync->synced) {
+        sync->drift_ref_offset = sync->offset;
+        sync->drift_ref_time = sync->offset_time;
+    } else if (sync->offset_time - sync->drift_ref_time >= CLOCK_SYNC_DRIFT_INTERVAL) {
+        double sample = (double) (int32_t) (sync->offset - sync->drift_ref_offset) / (double) (sync->offset_time - sync->drift_ref_time);
+        sync->drift = (sync->drift == 0.0) ? sample : 0.75 * sync->drift + 0.25 * sample;
+        sync->drift_ref_offset = sync->offset;
+        sync->drift_ref_time = sync->offset_time;
+    }
+    sync->synced = true;
+}
+
+int clock_sync_to_host(clock_sync_t* sync, uint32_t device_time, uint64_t now, uint64_t* host_time) {
+    if (!sync->synced) {
+        return -1;
+    }
+    // Extrapolate the offset to the present using the drift
+    uint32_t offset = sync->offset + (uint32_t) llround(sync->drift * (double) (int64_t) (now - sync->offset_time));
+    uint32_t host_time_low = device_time - offset;
+    // Recover the upper bits of the host time from NOW
+    int32_t age = (int32_t) ((uint32_t) now - host_time_low);
+    *host_time = now - age;
+    return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * Per-device clock synchronization for DEV_HANDLER
+ * Estimates the offset and drift between dev handler's clock (micros()) and a
+ * lowcar device's clock (Arduino micros()) from DEVICE_PING exchanges, NTP style:
+ *
+ *    t1: dev handler sends DEVICE_PING            (host clock)
+ *    t2: device receives it                       (device clock)
+ *    t3: device sends its DEVICE_PING reply       (device clock)
+ *    t4: dev handler receives the reply           (host clock)
+ *
+ *    offset = ((t2 - t1) + (t3 - t4)) / 2    (device clock - host clock)
+ *    delay  = (t4 - t1) - (t3 - t2)          (round trip time spent on the wire)
+ *
+ * Of the last CLOCK_SYNC_WINDOW exchanges, the one with the smallest delay is
+ * trusted the most (its offset error is bounded by delay / 2). Drift is estimated
+ * from how that best offset moves over time.
+ *
+ * All device timestamps are 32-bit and wrap around every ~71 minutes; all
+ * arithmetic here is done modulo 2^32 so wrap-around is handled transparently.
+ */
+
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <runtime_util.h>
+
+// The number of most recent DEVICE_PING exchanges to pick the best offset from
+#define CLOCK_SYNC_WINDOW 8
+
+// Minimum number of microseconds between two offsets used to compute a drift sample
+#define CLOCK_SYNC_DRIFT_INTERVAL 2000000
+
+// State of the clock synchronization with a single device
+typedef struct {
+    uint32_t offsets[CLOCK_SYNC_WINDOW];  // offset (device - host, mod 2^32) of each exchange in the window
+    uint32_t delays[CLOCK_SYNC_WINDOW];   // round trip delay of each exchange in the window
+    uint64_t times[CLOCK_SYNC_WINDOW];    // host time (micros()) at which each exchange completed
+    int num_samples;                      // number of valid exchanges in the window
+    int next;                             // index in the window to put the next exchange in
+    bool synced;                          // true iff there is at least one exchange to estimate the offset from
+    uint32_t offset;                      // current best offset estimate (device - host, mod 2^32)
+    uint64_t offset_time;                 // host time at which OFFSET was measured
+    uint32_t delay;                       // round trip delay of the exchange OFFSET was taken from
+    uint32_t drift_ref_offset;            // offset used as the reference for the next drift sample
+    uint64_t drift_ref_time;              // host time at which DRIFT_REF_OFFSET was measured
+    double drift;                         // smoothed drift of the device clock relative to the host clock (us per us)
+} clock_sync_t;
+
+/**
+ * Resets the clock synchronization state for a newly connected device
+ * Arguments:
+ *    sync: the state to reset
+ */
+void clock_sync_init(clock_sync_t* sync);
+
+/**
+ * Adds a completed DEVICE_PING exchange to the estimator
+ * Arguments:
+ *    sync: the state of the device the exchange was with
+ *    t1: lower 32 bits of the host time at which dev handler sent the DEVICE_PING
+ *    t2: device time at which the device received it
+ *    t3: device time at which the device sent its reply
+ *    t4: host time (micros()) at which dev handler received the reply
+ */
+void clock_sync_add_exchange(clock_sync_t* sync, uint32_t t1, uint32_t t2, uint32_t t3, uint64_t t4);
+
+/**
+ * Converts a device timestamp to host time
+ * Arguments:
+ *    sync: the state of the device the timestamp came from
+ *    device_time: the device timestamp to convert
+ *    now: the current host time (micros()); DEVICE_TIME must not be more than ~35 minutes away from it
+ *    host_time: populated with DEVICE_TIME expressed as host time (microseconds since the Unix Epoch)
+ * Returns:
+ *    0 on success
+ *    -1 if the device's clock has not been synchronized yet
+ */
+int clock_sync_to_host(clock_sync_t* sync, uint32_t device_time, uint64_t now, uint64_t* host_time);
+
+#endif
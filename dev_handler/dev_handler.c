@@ -5,10 +5,12 @@
 
 #include <termios.h>  // for POSIX terminal control definitions in serialport_open()
 
+#include <clock_sync.h>
 #include <dev_handler_message.h>
 #include <logger.h>
 #include <runtime_util.h>
 #include <shm_wrapper.h>
+#include <write_acks.h>
 
 /**
  * Each device will have a unique port number.
@@ -29,26 +31,41 @@
 
 // **************************** PRIVATE STRUCT ****************************** //
 
+/* A logical lowcar device on a port.
+ * A port normally carries a single device. A multiplexed link (a microcontroller or hub board
+ * presenting several devices over one port) carries up to MAX_LINK_DEVICES, each with its own
+ * shared memory slot. The device's address on the link is its index in relay_t.devs
+ */
+typedef struct {
+    int shm_dev_idx;                  // The unique index assigned to the device by shm_wrapper on device_connect(); -1 if not connected (protected by relay_lock)
+    dev_id_t dev_id;                  // set by relayer once ACKNOWLEDGEMENT is received
+    uint64_t last_received_msg_time;  // set by receiver: Timestamp of the most recent message from the device (protected by relay_lock)
+    write_acks_t acks;                // unacknowledged DEVICE_WRITEs, updated by sender and receiver (protected by relay_lock)
+    clock_sync_t clock;               // used only by receiver: estimate of the device's clock relative to ours
+    dev_timing_t timing;              // used only by receiver: latest timing measurements, published to shared memory
+    uint32_t last_write_time;         // used only by receiver: device time of the last applied DEVICE_WRITE seen in a DEVICE_DATA
+} link_dev_t;
+
 /* A struct shared between SENDER, RECEIVER, and RELAYER threads communicating
- * with the same device.
- * Contains information about each thread, how to communicate with the device,
- * and information about the device itself
+ * with the same port.
+ * Contains information about each thread, how to communicate with the port,
+ * and information about the device(s) on it
  * The RELAYER thread is responsible for using this struct to properly clean up
  * when the device disconnects or times out
  */
 typedef struct {
-    pthread_t sender;                 // Thread to build and send outgoing messages
-    pthread_t receiver;               // Thread to receive and process all incoming messages
-    pthread_t relayer;                // Thread to get ACKNOWLEDGEMENT and monitor disconnect/timeout
-    bool is_virtual;                  // True iff the device is a virtual device. Otherwise, an actual Arduino.
-    bool is_usb;                      // True iff the device is an actual Arduino recognized as ttyacm
-    uint8_t port_num;                 // The device is a file with path "<port_prefix><port_num>/"
-    int file_descriptor;              // Obtained from opening port. Used to close port.
-    int shm_dev_idx;                  // The unique index assigned to the device by shm_wrapper for shared memory operations on device_connect()
-    dev_id_t dev_id;                  // set by relayer once ACKNOWLEDGEMENT is received
-    uint64_t last_received_msg_time;  // set by receiver: Timestamp of the most recent message from the device
-    pthread_mutex_t relay_lock;       // Mutex on relay->last_received_msg_time
-    pthread_cond_t start_cond;        // Conditional variable for relayer to broadcast to sender and receiver to start work
+    pthread_t sender;                   // Thread to build and send outgoing messages
+    pthread_t receiver;                 // Thread to receive and process all incoming messages
+    pthread_t relayer;                  // Thread to get ACKNOWLEDGEMENT and monitor disconnect/timeout
+    bool is_virtual;                    // True iff the device is a virtual device. Otherwise, an actual Arduino.
+    bool is_usb;                        // True iff the device is an actual Arduino recognized as ttyacm
+    uint8_t port_num;                   // The device is a file with path "<port_prefix><port_num>/"
+    int file_descriptor;                // Obtained from opening port. Used to close port.
+    bool is_mux;                        // True iff the port is a multiplexed link; every message after the MUX_ACKNOWLEDGEMENT carries an address
+    int num_devs;                       // Number of logical devices on the port; 0 until verified, 1 unless IS_MUX
+    link_dev_t devs[MAX_LINK_DEVICES];  // The logical devices on the port, indexed by address
+    pthread_mutex_t relay_lock;         // Mutex on the fields of DEVS marked as protected
+    pthread_cond_t start_cond;          // Conditional variable for relayer to broadcast to sender and receiver to start work
 } relay_t;
 
 // ************************** FUNCTION DECLARATIONS ************************* //
@@ -65,12 +82,14 @@ int get_new_devices(uint32_t* lowcar_bitmap, uint32_t* virtual_bitmap, uint32_t*
 void communicate(bool is_virtual, bool is_usb, uint8_t port_num);
 void* relayer(void* relay_cast);
 void relay_clean_up(relay_t* relay);
+void disconnect_link_dev(relay_t* relay, int address);
 void* sender(void* relay_cast);
 void* receiver(void* relay_cast);
+void update_timing(relay_t* relay, link_dev_t* dev, int shm_dev_idx, message_t* dev_data);
 
 // Device communication
-int send_message(relay_t* relay, message_t* msg);
-int receive_message(relay_t* relay, message_t* msg);
+int send_message(relay_t* relay, uint8_t address, message_t* msg);
+int receive_message(relay_t* relay, message_t* msg, uint8_t* address);
 int verify_device(relay_t* relay);
 
 // Serial port or socket opening and closing
@@ -103,6 +122,11 @@ const char* home_dir;
 void init() {
     // Init logger
     logger_init(DEV_HANDLER);
+    // Lock memory and tighten timers if the real-time profile is on (before any threads are spawned)
+    int err = rt_profile_process_init();
+    if (err != 0) {
+        log_printf(WARN, "init: Couldn't fully apply real-time profile, continuing without it: %s", strerror(err));
+    }
     // Init shared memory
     shm_init();
     // Initialize lock on global variable USED_PORTS
@@ -259,11 +283,20 @@ void communicate(bool is_virtual, bool is_usb, uint8_t port_num) {
     }
 
     // Initialize the other relay values
-    relay->shm_dev_idx = -1;
-    relay->dev_id.type = -1;
-    relay->dev_id.year = -1;
-    relay->dev_id.uid = -1;
-    relay->last_received_msg_time = 0;
+    relay->is_mux = false;
+    relay->num_devs = 0;
+    for (int i = 0; i < MAX_LINK_DEVICES; i++) {
+        link_dev_t* dev = &relay->devs[i];
+        dev->shm_dev_idx = -1;
+        dev->dev_id.type = -1;
+        dev->dev_id.year = -1;
+        dev->dev_id.uid = -1;
+        dev->last_received_msg_time = 0;
+        write_acks_init(&dev->acks);
+        clock_sync_init(&dev->clock);
+        dev->timing = (const dev_timing_t){0};
+        dev->last_write_time = 0;
+    }
     pthread_mutex_init(&relay->relay_lock, NULL);
     pthread_cond_init(&relay->start_cond, NULL);
 
@@ -301,11 +334,19 @@ void* relayer(void* relay_cast) {
         return NULL;
     }
 
-    // At this point, the device is confirmed to be a lowcar device!
+    // At this point, the device is confirmed to be a lowcar device (or a link of them)!
 
-    // Connect the lowcar device to shared memory
-    device_connect(&relay->dev_id, &relay->shm_dev_idx);
-    if (relay->shm_dev_idx == -1) {
+    // Connect the lowcar device(s) to shared memory
+    int num_connected = 0;
+    for (int i = 0; i < relay->num_devs; i++) {
+        int shm_dev_idx;
+        device_connect(&relay->devs[i].dev_id, &shm_dev_idx);
+        pthread_mutex_lock(&relay->relay_lock);
+        relay->devs[i].shm_dev_idx = shm_dev_idx;
+        pthread_mutex_unlock(&relay->relay_lock);
+        num_connected += (shm_dev_idx != -1);
+    }
+    if (num_connected == 0) {
         relay_clean_up(relay);
         return NULL;
     }
@@ -314,25 +355,38 @@ void* relayer(void* relay_cast) {
     pthread_cond_broadcast(&relay->start_cond);
 
     // If the device disconnects or times out, clean up
-    log_printf(DEBUG, "Monitoring %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
     char port_name[MAX_PORT_NAME_SIZE];
     construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
+    log_printf(DEBUG, "Monitoring %s", port_name);
     while (1) {
         // If Arduino port file doesn't exist, it disconnected
         if (access(port_name, F_OK) == -1) {
-            log_printf(INFO, "%s (0x%016llX) disconnected!", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+            for (int i = 0; i < relay->num_devs; i++) {
+                log_printf(INFO, "%s (0x%016llX) disconnected!", get_device_name(relay->devs[i].dev_id.type), relay->devs[i].dev_id.uid);
+            }
             relay_clean_up(relay);
             return NULL;
         }
         // If it took too long to receive a message, the device timed out
-        pthread_mutex_lock(&relay->relay_lock);
-        if ((millis() - relay->last_received_msg_time) >= TIMEOUT) {
+        // Devices on a multiplexed link are dropped individually; the link is cleaned up once none are left
+        num_connected = 0;
+        for (int i = 0; i < relay->num_devs; i++) {
+            link_dev_t* dev = &relay->devs[i];
+            pthread_mutex_lock(&relay->relay_lock);
+            bool connected = dev->shm_dev_idx != -1;
+            bool timed_out = connected && (millis() - dev->last_received_msg_time) >= TIMEOUT;
             pthread_mutex_unlock(&relay->relay_lock);
-            log_printf(WARN, "%s (0x%016llX) timed out!", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+            if (timed_out) {
+                log_printf(WARN, "%s (0x%016llX) timed out!", get_device_name(dev->dev_id.type), dev->dev_id.uid);
+                disconnect_link_dev(relay, i);
+            } else if (connected) {
+                num_connected++;
+            }
+        }
+        if (num_connected == 0) {
             relay_clean_up(relay);
             return NULL;
         }
-        pthread_mutex_unlock(&relay->relay_lock);
         usleep(POLL_INTERVAL);
     }
 }
@@ -367,16 +421,20 @@ void relay_clean_up(relay_t* relay) {
         log_printf(ERROR, "relay_clean_up: pthread_join on receiver failed -- error: %d", ret);
     }
 
-    // Disconnect the device from shared memory if it's connected
-    if (relay->shm_dev_idx != -1) {
-        device_disconnect(relay->shm_dev_idx);
+    // Disconnect the device(s) from shared memory if connected
+    for (int i = 0; i < relay->num_devs; i++) {
+        if (relay->devs[i].shm_dev_idx != -1) {
+            device_disconnect(relay->devs[i].shm_dev_idx);
+        }
     }
 
-    // Send a RST message to the device to signal that we are closing the connection
+    // Send a RST message to the device(s) to signal that we are closing the connection
     message_t* rst = make_rst();
-    ret = send_message(relay, rst);
-    if (ret != 0) {
-        log_printf(WARN, "Couldn't send RST to %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+    for (int i = 0; i < relay->num_devs; i++) {
+        ret = send_message(relay, i, rst);
+        if (ret != 0) {
+            log_printf(WARN, "Couldn't send RST to %s (0x%016llX)", get_device_name(relay->devs[i].dev_id.type), relay->devs[i].dev_id.uid);
+        }
     }
     destroy_message(rst);
 
@@ -395,18 +453,39 @@ void relay_clean_up(relay_t* relay) {
     pthread_mutex_unlock(&used_ports_lock);
     pthread_mutex_destroy(&relay->relay_lock);
     pthread_cond_destroy(&relay->start_cond);
-    if (relay->dev_id.uid == (uint64_t) -1) {
+    if (relay->num_devs == 0) {
         char port_name[MAX_PORT_NAME_SIZE];
         construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
         log_printf(DEBUG, "Cleaned up bad device %s\n", port_name);
     } else {
-        log_printf(DEBUG, "Cleaned up %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        for (int i = 0; i < relay->num_devs; i++) {
+            log_printf(DEBUG, "Cleaned up %s (0x%016llX)", get_device_name(relay->devs[i].dev_id.type), relay->devs[i].dev_id.uid);
+        }
     }
     free(relay);
 }
 
+/**
+ * Called by relayer to drop a single logical device that timed out, leaving the rest of its link running
+ * Disconnects the device from shared memory; the sender and receiver ignore it from then on
+ * Arguments:
+ *    relay: Struct containing the link the device is on
+ *    address: The address of the device on the link
+ */
+void disconnect_link_dev(relay_t* relay, int address) {
+    pthread_mutex_lock(&relay->relay_lock);
+    int shm_dev_idx = relay->devs[address].shm_dev_idx;
+    relay->devs[address].shm_dev_idx = -1;
+    pthread_mutex_unlock(&relay->relay_lock);
+    if (shm_dev_idx != -1) {
+        device_disconnect(shm_dev_idx);
+    }
+}
+
 /**
  * Continuously sends DEVICE_PING and reads from shared memory to send DEVICE_WRITE
+ * DEVICE_WRITEs that the device didn't acknowledge in time are resent (see write_acks.h)
+ * On a multiplexed link, does so for each logical device on the link
  * Arguments:
  *    relay_cast: Uncasted relay_t struct containing device info
  */
@@ -422,6 +501,11 @@ void* sender(void* relay_cast) {
     // Cancel this thread only where pthread_testcancel()
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
 
+    int err = rt_profile_thread_init(RT_PRIO_DEV_HANDLER);
+    if (err != 0) {
+        log_printf(DEBUG, "sender: Running without real-time priority: %s", strerror(err));
+    }
+
     // Start doing work
     uint32_t pmap[MAX_DEVICES + 1];
     param_val_t* params = malloc(MAX_PARAMS * sizeof(param_val_t));  // Array of params to be filled on device_read()
@@ -431,32 +515,59 @@ void* sender(void* relay_cast) {
     }
     message_t* msg;  // Message to build
     int ret;         // Hold the value from send_message()
+    int shm_dev_idx;
+    uint32_t to_write;  // Params to write to a device
+    uint32_t lost;      // Params of DEVICE_WRITEs to retransmit to a device
+    int seq;            // Sequence number of a DEVICE_WRITE
     uint64_t last_sent_ping_time = millis();
     while (1) {
-        // Write to device if needed via a DEVICE_WRITE message
+        // Write to each device if needed via a DEVICE_WRITE message
         get_cmd_map(pmap);
-        if (pmap[0] & (1 << relay->shm_dev_idx)) {  // If bit i in pmap[0] != 0, there are values to write to device i
+        for (int i = 0; i < relay->num_devs; i++) {
+            link_dev_t* dev = &relay->devs[i];
+            pthread_mutex_lock(&relay->relay_lock);
+            shm_dev_idx = dev->shm_dev_idx;
+            lost = write_acks_lost(&dev->acks, micros());
+            pthread_mutex_unlock(&relay->relay_lock);
+            if (shm_dev_idx == -1) {
+                continue;
+            }
+            // If bit i in pmap[0] != 0, there are values to write to device i
+            to_write = (pmap[0] & (1 << shm_dev_idx)) ? pmap[1 + shm_dev_idx] : 0;
+            if (to_write == 0 && lost == 0) {
+                continue;
+            }
             // Read the new parameter values to write from shared memory as DEV_HANDLER from the COMMAND stream
-            device_read(relay->shm_dev_idx, DEV_HANDLER, COMMAND, pmap[1 + relay->shm_dev_idx], params);
+            // Lost params are read again too, so that a retransmission carries their latest values
+            device_read(shm_dev_idx, DEV_HANDLER, COMMAND, to_write | lost, params);
             // Serialize and bulk transfer a DeviceWrite packet with PARAMS to the device
-            msg = make_device_write(relay->dev_id.type, pmap[1 + relay->shm_dev_idx], params);
-            ret = send_message(relay, msg);
+            msg = make_device_write(dev->dev_id.type, to_write | lost, params);
+            pthread_mutex_lock(&relay->relay_lock);
+            seq = write_acks_sent(&dev->acks, to_write | lost, micros(), lost != 0);
+            pthread_mutex_unlock(&relay->relay_lock);
+            if (seq != -1) {
+                append_write_seq(msg, (uint16_t) seq);
+            }
+            ret = send_message(relay, i, msg);
             if (ret != 0) {
-                log_printf(WARN, "Couldn't send DEVICE_WRITE to %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+                log_printf(WARN, "Couldn't send DEVICE_WRITE to %s (0x%016llX)", get_device_name(dev->dev_id.type), dev->dev_id.uid);
             }
             destroy_message(msg);
         }
 
-        // Send another DEVICE_PING every PING_FREQ milliseconds
+        // Send another DEVICE_PING to each device every PING_FREQ milliseconds
+        // It carries our send time so that devices that support it can reply for clock synchronization
         if ((millis() - last_sent_ping_time) >= PING_FREQ) {
-            msg = make_ping();
-            ret = send_message(relay, msg);
-            if (ret != 0) {
-                log_printf(WARN, "Couldn't send DEVICE_PING to %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+            for (int i = 0; i < relay->num_devs; i++) {
+                msg = make_sync_ping((uint32_t) micros());
+                ret = send_message(relay, i, msg);
+                if (ret != 0) {
+                    log_printf(WARN, "Couldn't send DEVICE_PING to %s (0x%016llX)", get_device_name(relay->devs[i].dev_id.type), relay->devs[i].dev_id.uid);
+                }
+                destroy_message(msg);
             }
             // Update the timestamp at which we sent a DEVICE_PING
             last_sent_ping_time = millis();
-            destroy_message(msg);
         }
 
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
@@ -470,7 +581,7 @@ void* sender(void* relay_cast) {
 
 /**
  * Continuously attempts to parse incoming data over serial and send to shared memory
- * Sets relay->last_received_msg_time upon receiving a message
+ * Sets last_received_msg_time of the sending device upon receiving a message
  * Arguments:
  *    relay_cast: uncasted relay_t struct containing device info
  */
@@ -486,6 +597,11 @@ void* receiver(void* relay_cast) {
     // Cancel this thread only where pthread_testcancel()
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
 
+    int err = rt_profile_thread_init(RT_PRIO_DEV_HANDLER);
+    if (err != 0) {
+        log_printf(DEBUG, "receiver: Running without real-time priority: %s", strerror(err));
+    }
+
     // Start doing work!
     // An empty message to parse the received data into
     message_t* msg = make_empty(MAX_PAYLOAD_SIZE);
@@ -495,33 +611,58 @@ void* receiver(void* relay_cast) {
         log_printf(FATAL, "receiver: Failed to malloc");
         exit(1);
     }
+    uint8_t address;  // The device on the link that sent the message
+    int shm_dev_idx;
     while (1) {
         // Try to read a message
         // Since this function blocks the thread until a message is received, we don't need to sleep in this loop
-        if (receive_message(relay, msg) != 0) {
+        if (receive_message(relay, msg, &address) != 0) {
             // Message was broken... try to read the next message
             continue;
         }
+        if (address >= relay->num_devs) {
+            log_printf(WARN, "Dropped message (type %d) to unknown address %d on multiplexed link", msg->message_id, address);
+            continue;
+        }
+        link_dev_t* dev = &relay->devs[address];
+        pthread_mutex_lock(&relay->relay_lock);
+        shm_dev_idx = dev->shm_dev_idx;
+        pthread_mutex_unlock(&relay->relay_lock);
+        if (shm_dev_idx == -1) {
+            continue;  // Device timed out and was disconnected; ignore it from now on
+        }
         if (msg->message_id == DEVICE_DATA || msg->message_id == LOG || msg->message_id == DEVICE_PING) {
             // Update last received message time
             pthread_mutex_lock(&relay->relay_lock);
-            relay->last_received_msg_time = millis();
+            dev->last_received_msg_time = millis();
             pthread_mutex_unlock(&relay->relay_lock);
             // Handle message
             if (msg->message_id == DEVICE_DATA) {
                 // If received DEVICE_DATA, write to shared memory
-                parse_device_data(relay->dev_id.type, msg, vals);  // Get param values from payload
-                device_write(relay->shm_dev_idx, DEV_HANDLER, DATA, *((uint32_t*) msg->payload), vals);
+                parse_device_data(dev->dev_id.type, msg, vals);  // Get param values from payload
+                device_write(shm_dev_idx, DEV_HANDLER, DATA, *((uint32_t*) msg->payload), vals);
+                update_timing(relay, dev, shm_dev_idx, msg);
+            } else if (msg->message_id == DEVICE_PING) {
+                // If the DEVICE_PING is a reply to one of ours, use it to synchronize with the device's clock
+                uint32_t t1, t2, t3;
+                if (parse_ping_reply(msg, &t1, &t2, &t3) == 0) {
+                    clock_sync_add_exchange(&dev->clock, t1, t2, t3, micros());
+                }
             } else if (msg->message_id == LOG) {
                 // If received LOG, send it to the logger
-                log_printf(DEBUG, "[%s (0x%016llX)]: %s", get_device_name(relay->dev_id.type), relay->dev_id.uid, msg->payload);
+                log_printf(DEBUG, "[%s (0x%016llX)]: %s", get_device_name(dev->dev_id.type), dev->dev_id.uid, msg->payload);
             }
             // Device is going to disconnect, so we clean up on our end
         } else if (msg->message_id == RST) {
-            relay_clean_up(relay);
-            return NULL;
+            if (!relay->is_mux) {
+                relay_clean_up(relay);
+                return NULL;
+            }
+            // Only this device is leaving the link
+            log_printf(INFO, "%s (0x%016llX) disconnected!", get_device_name(dev->dev_id.type), dev->dev_id.uid);
+            disconnect_link_dev(relay, address);
         } else {  // Invalid message type
-            log_printf(WARN, "Dropped bad message (type %d) from %s (0x%016llX)", msg->message_id, get_device_name(relay->dev_id.type), relay->dev_id.uid);
+            log_printf(WARN, "Dropped bad message (type %d) from %s (0x%016llX)", msg->message_id, get_device_name(dev->dev_id.type), dev->dev_id.uid);
         }
         // Now that the message is taken care of, clear the message
         msg->message_id = 0x0;
@@ -535,6 +676,64 @@ void* receiver(void* relay_cast) {
     return NULL;
 }
 
+/**
+ * Helper function for receiver()
+ * Uses the timestamps in a DEVICE_DATA (if any) to measure the latency between the device sampling its
+ * params and them landing in shared memory, and between sending a DEVICE_WRITE and the device applying it.
+ * Also processes the write acknowledgement in the DEVICE_DATA (if any).
+ * The results are published to shared memory.
+ * Arguments:
+ *    relay: Struct containing the link the device is on
+ *    dev: The device that sent DEV_DATA, containing its clock synchronization state
+ *    shm_dev_idx: The index of the device in shared memory
+ *    dev_data: The DEVICE_DATA message that was just written to shared memory
+ */
+void update_timing(relay_t* relay, link_dev_t* dev, int shm_dev_idx, message_t* dev_data) {
+    uint64_t now = micros();
+    uint32_t sample_time, write_time;
+    uint64_t host_sample_time, host_write_time;
+    uint16_t ack;
+    bool acked = false;
+    uint64_t ack_sent_time = 0;  // time at which the DEVICE_WRITE the device just acknowledged was sent, if any
+
+    // Stop tracking the DEVICE_WRITEs the device acknowledged
+    if (parse_device_data_write_ack(dev->dev_id.type, dev_data, &ack) == 0) {
+        pthread_mutex_lock(&relay->relay_lock);
+        ack_sent_time = write_acks_received(&dev->acks, ack, now);
+        dev->timing.write_rtt_us = dev->acks.srtt;
+        dev->timing.writes_acked = dev->acks.num_acked;
+        dev->timing.writes_retransmitted = dev->acks.num_retransmitted;
+        pthread_mutex_unlock(&relay->relay_lock);
+        acked = true;
+    }
+
+    if (parse_device_data_timestamps(dev->dev_id.type, dev_data, &sample_time, &write_time) != 0
+        || clock_sync_to_host(&dev->clock, sample_time, now, &host_sample_time) != 0) {
+        // Device doesn't support clock synchronization, or we haven't synchronized yet
+        if (acked) {
+            device_timing_write(shm_dev_idx, &dev->timing);
+        }
+        return;
+    }
+    dev->timing.synced = true;
+    dev->timing.clock_rtt_us = dev->clock.delay;
+    dev->timing.clock_drift_ppm = (float) (dev->clock.drift * 1000000.0);
+    dev->timing.last_sample_time = host_sample_time;
+    dev->timing.sample_to_shm_us = (now > host_sample_time) ? now - host_sample_time : 0;
+
+    // A new DEVICE_WRITE was applied since the last DEVICE_DATA. It is the one the device just acknowledged
+    // only if the acknowledgement advanced to it; otherwise (an earlier DEVICE_WRITE was lost, or the device
+    // doesn't acknowledge writes) we can't tell which one it was, so it isn't measured.
+    if (write_time != 0 && write_time != dev->last_write_time) {
+        dev->last_write_time = write_time;
+        clock_sync_to_host(&dev->clock, write_time, now, &host_write_time);
+        if (ack_sent_time != 0 && host_write_time > ack_sent_time) {
+            dev->timing.cmd_to_actuation_us = host_write_time - ack_sent_time;
+        }
+    }
+    device_timing_write(shm_dev_idx, &dev->timing);
+}
+
 // ************************** DEVICE COMMUNICATION ************************** //
 
 /**
@@ -542,22 +741,29 @@ void* receiver(void* relay_cast) {
  * Serializes, encodes, and sends a message
  * Arguments:
  *    relay: Contains the file descriptor
+ *    address: The device on the link to send to; ignored unless the port is a multiplexed link
  *    msg: The message to be sent
  * Returns:
  *    0 if successful
  *    -1 if couldn't write all the bytes
  */
-int send_message(relay_t* relay, message_t* msg) {
+int send_message(relay_t* relay, uint8_t address, message_t* msg) {
     int len = calc_max_cobs_msg_length(msg);
     uint8_t* data = malloc(len);
     if (data == NULL) {
         log_printf(FATAL, "send_message: Failed to malloc");
         exit(1);
     }
-    len = message_to_bytes(msg, data, len);
+    if (relay->is_mux) {
+        len = addressed_message_to_bytes(msg, address, data, len);
+    } else {
+        len = message_to_bytes(msg, data, len);
+    }
     int transferred = writen(relay->file_descriptor, data, len);
     if (transferred != len) {
-        log_printf(WARN, "Sent only %d out of %d bytes to %d (0x%016llX)\n", transferred, len, get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        char port_name[MAX_PORT_NAME_SIZE];
+        construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
+        log_printf(WARN, "Sent only %d out of %d bytes to %s\n", transferred, len, port_name);
     }
     free(data);
     return (transferred == len) ? 0 : -1;
@@ -570,19 +776,21 @@ int send_message(relay_t* relay, message_t* msg) {
  * Arguments:
  *    relay: Contains the file descriptor and port number of the device
  *    msg: The message_t *to be populated with the parsed data (if successful)
+ *    address: Populated with the device on the link that sent the message; always 0 unless the port is a multiplexed link
  * Returns:
  *    0 on successful parse
  *    1 on broken message
  *    2 on incorrect checksum
  *    3 on timeout
  */
-int receive_message(relay_t* relay, message_t* msg) {
+int receive_message(relay_t* relay, message_t* msg, uint8_t* address) {
     uint8_t last_byte_read = 0;  // Variable to temporarily hold a read byte
     int num_bytes_read = 0;
     char port_name[MAX_PORT_NAME_SIZE];
     construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
+    int address_size = relay->is_mux ? ADDRESS_SIZE : 0;
 
-    if (relay->dev_id.uid == (uint64_t) -1) {
+    if (relay->num_devs == 0) {
         /* Haven't verified device is lowcar yet
          * read() is set to timeout while waiting for an ACK (see serialport_open())*/
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
@@ -627,11 +835,11 @@ int receive_message(relay_t* relay, message_t* msg) {
     num_bytes_read = readn(relay->file_descriptor, &cobs_len, 1);
     if (num_bytes_read != 1) {
         return 1;
-    } else if (cobs_len > (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + CHECKSUM_SIZE + 1)) {  // + 1 for cobs encoding overhead
+    } else if (cobs_len > (address_size + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + CHECKSUM_SIZE + 1)) {  // + 1 for cobs encoding overhead
         // Got some weird message that is unusually long (longer than a valid message with the longest payload)
         log_printf(WARN, "Received a cobs length that is too large");
         return 1;
-    } else if (cobs_len < (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + CHECKSUM_SIZE + 1)) {  // + 1 for cobs encoding overhead
+    } else if (cobs_len < (address_size + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + CHECKSUM_SIZE + 1)) {  // + 1 for cobs encoding overhead
         // Got some weird message that is unusually short (shorter than a DEVICE_PING with no payload)
         log_printf(WARN, "Received a cobs length that is too small");
         return 1;
@@ -649,13 +857,19 @@ int receive_message(relay_t* relay, message_t* msg) {
     // Read the message
     num_bytes_read = readn(relay->file_descriptor, &data[2], cobs_len);
     if (num_bytes_read != cobs_len) {
-        log_printf(WARN, "Read only %d out of %d bytes from %s (0x%016llX)\n", num_bytes_read, cobs_len, get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        log_printf(WARN, "Read only %d out of %d bytes from %s\n", num_bytes_read, cobs_len, port_name);
         free(data);
         return 1;
     }
 
     // Parse the message
-    int ret = parse_message(data, msg);
+    int ret;
+    if (relay->is_mux) {
+        ret = parse_addressed_message(data, msg, address);
+    } else {
+        ret = parse_message(data, msg);
+        *address = 0;
+    }
     free(data);
     if (ret != 0) {
         log_printf(WARN, "Couldn't parse message from %s\n", port_name);
@@ -666,19 +880,20 @@ int receive_message(relay_t* relay, message_t* msg) {
 
 /**
  * Sends a DEVICE_PING to the device and waits for an ACKNOWLEDGEMENT
- * The first message received must be a perfectly constructed ACKNOWLEDGEMENT
+ * The first message received must be a perfectly constructed ACKNOWLEDGEMENT, or a
+ * MUX_ACKNOWLEDGEMENT if the port is a multiplexed link
  * Arguments:
  *    relay: Struct containing all relevant port information.
- *           dev_id field will be populated on successful ACKNOWLEDGEMENT
+ *           devs and num_devs fields will be populated on successful ACKNOWLEDGEMENT
  * Returns:
- *    0 if received ACKNOWLEDGEMENT. Sets relay->dev_id
+ *    0 if received ACKNOWLEDGEMENT. Sets relay->devs, relay->num_devs, and relay->is_mux
  *    1 if Ping message couldn't be sent
  *    2 if ACKNOWLEDGEMENT wasn't received
  */
 int verify_device(relay_t* relay) {
     // Send a DEVICE_PING
     message_t* ping = make_ping();
-    int ret = send_message(relay, ping);
+    int ret = send_message(relay, 0, ping);
     destroy_message(ping);
     if (ret != 0) {
         return 1;
@@ -686,17 +901,34 @@ int verify_device(relay_t* relay) {
 
     // Try to read an ACKNOWLEDGEMENT, which we expect from a lowcar device that receives a DEVICE_PING
     message_t* ack = make_empty(MAX_PAYLOAD_SIZE);
-    ret = receive_message(relay, ack);
+    uint8_t address;
+    ret = receive_message(relay, ack, &address);
     if (ret != 0) {
         log_printf(DEBUG, "Didn't receive ACK");
         destroy_message(ack);
         return 2;
-    } else if (ack->message_id != ACKNOWLEDGEMENT) {
+    } else if (ack->message_id != ACKNOWLEDGEMENT && ack->message_id != MUX_ACKNOWLEDGEMENT) {
         log_printf(DEBUG, "Message is not an ACK, but of type %d", ack->message_id);
         destroy_message(ack);
         return 2;
     }
 
+    // Parse the identities of the device(s) on the port
+    dev_id_t dev_ids[MAX_LINK_DEVICES];
+    int num_devs = 1;
+    if (ack->message_id == MUX_ACKNOWLEDGEMENT) {
+        if (parse_mux_acknowledgement(ack, dev_ids, &num_devs) != 0) {
+            log_printf(DEBUG, "Received an invalid MUX_ACKNOWLEDGEMENT");
+            destroy_message(ack);
+            return 2;
+        }
+    } else {
+        // Parse ACKNOWLEDGEMENT payload into dev_id_t
+        memcpy(&dev_ids[0].type, &ack->payload[0], 1);
+        memcpy(&dev_ids[0].year, &ack->payload[1], 1);
+        memcpy(&dev_ids[0].uid, &ack->payload[2], 8);
+    }
+
     // We have a lowcar device!
 
     /* Set serial port options to allow read() to block indefinitely
@@ -705,24 +937,27 @@ int verify_device(relay_t* relay) {
     if (!relay->is_virtual) {
         struct termios toptions;
         if (tcgetattr(relay->file_descriptor, &toptions) < 0) {  // Get current options
-            log_printf(ERROR, "verify_lowcar: Couldn't get term attributes for %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+            log_printf(ERROR, "verify_lowcar: Couldn't get term attributes for %s (0x%016llX)", get_device_name(dev_ids[0].type), dev_ids[0].uid);
+            destroy_message(ack);
             return -1;
         }
         toptions.c_cc[VMIN] = 1;  // read() must read at least a byte before returning
         // Save changes to TOPTIONS immediately using flag TCSANOW
         tcsetattr(relay->file_descriptor, TCSANOW, &toptions);
         if (tcsetattr(relay->file_descriptor, TCSAFLUSH, &toptions) < 0) {
-            log_printf(ERROR, "verify_lowcar: Couldn't set term attributes for %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+            log_printf(ERROR, "verify_lowcar: Couldn't set term attributes for %s (0x%016llX)", get_device_name(dev_ids[0].type), dev_ids[0].uid);
+            destroy_message(ack);
             return -1;
         }
     }
 
-    // Parse ACKNOWLEDGEMENT payload into relay->dev_id_t
-    memcpy(&relay->dev_id.type, &ack->payload[0], 1);
-    memcpy(&relay->dev_id.year, &ack->payload[1], 1);
-    memcpy(&relay->dev_id.uid, &ack->payload[2], 8);
-    log_printf(INFO, "Connected %s (0x%016llX) from year %d!", get_device_name(relay->dev_id.type), relay->dev_id.uid, relay->dev_id.year);
-    relay->last_received_msg_time = millis();
+    relay->is_mux = (ack->message_id == MUX_ACKNOWLEDGEMENT);
+    for (int i = 0; i < num_devs; i++) {
+        relay->devs[i].dev_id = dev_ids[i];
+        relay->devs[i].last_received_msg_time = millis();
+        log_printf(INFO, "Connected %s (0x%016llX) from year %d!", get_device_name(dev_ids[i].type), dev_ids[i].uid, dev_ids[i].year);
+    }
+    relay->num_devs = num_devs;
     destroy_message(ack);
     return 0;
 }
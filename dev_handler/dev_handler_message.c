@@ -14,7 +14,7 @@ void print_bytes(uint8_t* data, size_t len) {
 
 /**
  * Private utility function to calculate the size of the payload needed
- * for a DEVICE_WRITE message.
+ * for a DEVICE_WRITE message (or the parameter portion of a DEVICE_DATA message, which has the same layout).
  * Arguments:
  *    device_type: The type of device (refer to runtime_util)
  *    param_bitmap: A bitmap, the i-th bit indicates whether param i will be transmitted in the message
@@ -153,13 +153,13 @@ static ssize_t cobs_decode(uint8_t* dst, const uint8_t* src, size_t src_len) {
         int num_bytes_to_copy = *src;
         src++;
         for (int i = 1; i < num_bytes_to_copy; i++) {
+            if (src >= end) {  // Bad packet
+                return 0;
+            }
             *dst = *src;
             dst++;
             src++;
             out_len++;
-            if (src > end) {  // Bad packet
-                return 0;
-            }
         }
         if (src != end) {
             // Start decoding a new block, putting back the zero
@@ -202,6 +202,13 @@ message_t* make_ping() {
     return ping;
 }
 
+message_t* make_sync_ping(uint32_t host_time) {
+    message_t* ping = make_empty(PING_REQUEST_SIZE);
+    ping->message_id = DEVICE_PING;
+    append_payload(ping, (uint8_t*) &host_time, TIMESTAMP_SIZE);
+    return ping;
+}
+
 message_t* make_device_write(uint8_t dev_type, uint32_t pmap, param_val_t param_values[]) {
     device_t* dev = get_device(dev_type);
     // Don't write to non-existent params
@@ -220,7 +227,7 @@ message_t* make_device_write(uint8_t dev_type, uint32_t pmap, param_val_t param_
     }
     dev_write->message_id = DEVICE_WRITE;
     dev_write->payload_length = 0;
-    dev_write->max_payload_length = device_write_payload_size(dev_type, pmap);
+    dev_write->max_payload_length = device_write_payload_size(dev_type, pmap) + WRITE_SEQ_SIZE;
     dev_write->payload = malloc(dev_write->max_payload_length);
     if (dev_write->payload == NULL) {
         log_printf(FATAL, "make_device_write: Failed to malloc");
@@ -249,6 +256,10 @@ message_t* make_device_write(uint8_t dev_type, uint32_t pmap, param_val_t param_
     return (status == 0) ? dev_write : NULL;
 }
 
+int append_write_seq(message_t* dev_write, uint16_t seq) {
+    return append_payload(dev_write, (uint8_t*) &seq, WRITE_SEQ_SIZE);
+}
+
 message_t* make_rst() {
     message_t* rst = malloc(sizeof(message_t));
     if (rst == NULL) {
@@ -270,7 +281,8 @@ void destroy_message(message_t* message) {
 // ********************* SERIALIZE AND PARSE MESSAGES *********************** //
 
 size_t calc_max_cobs_msg_length(message_t* msg) {
-    size_t required_packet_length = MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length + CHECKSUM_SIZE;
+    // Leave room for an address in case the message is sent over a multiplexed link
+    size_t required_packet_length = ADDRESS_SIZE + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length + CHECKSUM_SIZE;
     // Cobs encoding a length N message adds overhead of at most ceil(N/254)
     size_t cobs_length = required_packet_length + (required_packet_length / 254) + 1;
     /* Add 2 additional bytes to the buffer for use in message_to_bytes()
@@ -279,33 +291,60 @@ size_t calc_max_cobs_msg_length(message_t* msg) {
     return DELIMITER_SIZE + COBS_LENGTH_SIZE + cobs_length;
 }
 
-ssize_t message_to_bytes(message_t* msg, uint8_t cobs_encoded[], size_t len) {
+/**
+ * Serializes then cobs encodes a message, optionally preceded by an address
+ * Arguments:
+ *    msg: The message to serialize
+ *    header_size: ADDRESS_SIZE to prepend ADDRESS to the message; 0 otherwise
+ *    address: The address of the logical device the message is for (ignored if HEADER_SIZE is 0)
+ *    cobs_encoded: The buffer to write the encoded message into
+ *    len: the length of COBS_ENCODED
+ * Returns:
+ *    The size of COBS_ENCODED that was actually populated, or -1 if LEN is too small
+ */
+static ssize_t encode_message(message_t* msg, size_t header_size, uint8_t address, uint8_t cobs_encoded[], size_t len) {
     size_t required_length = calc_max_cobs_msg_length(msg);
     if (len < required_length) {
         return -1;
     }
     // Build an intermediate byte array to hold the serialized message to be encoded
-    uint8_t* data = malloc(MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length + CHECKSUM_SIZE);
+    size_t data_len = header_size + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length + CHECKSUM_SIZE;
+    uint8_t* data = malloc(data_len);
     if (data == NULL) {
         log_printf(FATAL, "message_to_bytes: Failed to malloc");
         exit(1);
     }
-    data[0] = msg->message_id;
-    data[1] = msg->payload_length;
+    uint8_t* packet = &data[header_size];
+    if (header_size != 0) {
+        data[0] = address;
+    }
+    packet[0] = msg->message_id;
+    packet[1] = msg->payload_length;
     for (size_t i = 0; i < msg->payload_length; i++) {
-        data[i + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE] = msg->payload[i];
+        packet[i + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE] = msg->payload[i];
     }
-    data[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length] = checksum(data, MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length);
+    // The checksum covers the address too, so a corrupted address isn't delivered to the wrong device
+    data[data_len - CHECKSUM_SIZE] = checksum(data, data_len - CHECKSUM_SIZE);
 
     // Encode the intermediate byte array into output buffer
     cobs_encoded[0] = 0x00;
-    int cobs_len = cobs_encode(&cobs_encoded[2], data, MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length + CHECKSUM_SIZE);
+    int cobs_len = cobs_encode(&cobs_encoded[2], data, data_len);
     free(data);
     cobs_encoded[1] = cobs_len;
     return DELIMITER_SIZE + COBS_LENGTH_SIZE + cobs_len;
 }
 
-int parse_message(uint8_t data[], message_t* msg_to_fill) {
+/**
+ * Cobs decodes a byte array and populates the fields of input message, optionally reading an address first
+ * Arguments:
+ *    data: A byte array containing a cobs encoded message, starting with the delimiter
+ *    msg_to_fill: A message to be populated
+ *    header_size: ADDRESS_SIZE if the message is preceded by an address; 0 otherwise
+ *    address: Populated with the address of the message (untouched if HEADER_SIZE is 0)
+ * Returns:
+ *    The same as parse_message()
+ */
+static int decode_message(uint8_t data[], message_t* msg_to_fill, size_t header_size, uint8_t* address) {
     uint8_t cobs_len = data[1];
     uint8_t* decoded = malloc(cobs_len);  // Actual number of bytes populated will be a couple less due to overhead
     if (decoded == NULL) {
@@ -313,32 +352,57 @@ int parse_message(uint8_t data[], message_t* msg_to_fill) {
         exit(1);
     }
     int ret = cobs_decode(decoded, &data[2], cobs_len);
-    if (ret < (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + CHECKSUM_SIZE)) {
+    uint8_t* packet = &decoded[header_size];
+    if (ret < (int) (header_size + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + CHECKSUM_SIZE)) {
         // Smaller than valid message
         free(decoded);
         return 3;
-    } else if (ret > (int) (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + CHECKSUM_SIZE)) {
+    } else if (ret > (int) (header_size + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + CHECKSUM_SIZE)) {
         // Larger than the largest valid message
         free(decoded);
         return 3;
+    } else if (ret < (int) (header_size + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + packet[MESSAGE_ID_SIZE] + CHECKSUM_SIZE)) {
+        // Payload length is longer than the message (corrupted in transit)
+        free(decoded);
+        return 3;
     }
-    msg_to_fill->message_id = decoded[0];
+    msg_to_fill->message_id = packet[0];
     msg_to_fill->payload_length = 0;
-    msg_to_fill->max_payload_length = decoded[MESSAGE_ID_SIZE];
-    ret = append_payload(msg_to_fill, &decoded[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE], msg_to_fill->max_payload_length);
+    msg_to_fill->max_payload_length = packet[MESSAGE_ID_SIZE];
+    ret = append_payload(msg_to_fill, &packet[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE], msg_to_fill->max_payload_length);
     if (ret != 0) {
         log_printf(ERROR, "parse_message: Overwrote to payload\n");
+        free(decoded);
         return 2;
     }
-    uint8_t expected_checksum = checksum(decoded, MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg_to_fill->payload_length);
-    uint8_t received_checksum = decoded[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg_to_fill->payload_length];
+    size_t checked_len = header_size + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg_to_fill->payload_length;
+    uint8_t expected_checksum = checksum(decoded, checked_len);
+    uint8_t received_checksum = decoded[checked_len];
     if (expected_checksum != received_checksum) {
         log_printf(ERROR, "parse_message: Expected checksum 0x%02X. Received 0x%02X\n", expected_checksum, received_checksum);
+    } else if (header_size != 0) {
+        *address = decoded[0];
     }
     free(decoded);
     return (expected_checksum != received_checksum) ? 1 : 0;
 }
 
+ssize_t message_to_bytes(message_t* msg, uint8_t cobs_encoded[], size_t len) {
+    return encode_message(msg, 0, 0, cobs_encoded, len);
+}
+
+ssize_t addressed_message_to_bytes(message_t* msg, uint8_t address, uint8_t cobs_encoded[], size_t len) {
+    return encode_message(msg, ADDRESS_SIZE, address, cobs_encoded, len);
+}
+
+int parse_message(uint8_t data[], message_t* msg_to_fill) {
+    return decode_message(data, msg_to_fill, 0, NULL);
+}
+
+int parse_addressed_message(uint8_t data[], message_t* msg_to_fill, uint8_t* address) {
+    return decode_message(data, msg_to_fill, ADDRESS_SIZE, address);
+}
+
 void parse_device_data(uint8_t dev_type, message_t* dev_data, param_val_t vals[]) {
     device_t* dev = get_device(dev_type);
     // Bitmap is stored in the first 32 bits of the payload
@@ -366,3 +430,66 @@ void parse_device_data(uint8_t dev_type, message_t* dev_data, param_val_t vals[]
         }
     }
 }
+
+int parse_device_data_timestamps(uint8_t dev_type, message_t* dev_data, uint32_t* sample_time, uint32_t* write_time) {
+    uint32_t bitmap = *((uint32_t*) dev_data->payload);
+    // The timestamps, if any, immediately follow the last parameter value
+    size_t values_size = device_write_payload_size(dev_type, bitmap);
+    if (dev_data->payload_length != values_size + DEVICE_DATA_TIMESTAMPS_SIZE
+        && dev_data->payload_length != values_size + DEVICE_DATA_TIMESTAMPS_SIZE + WRITE_SEQ_SIZE) {
+        return -1;
+    }
+    memcpy(sample_time, &dev_data->payload[values_size], TIMESTAMP_SIZE);
+    memcpy(write_time, &dev_data->payload[values_size + TIMESTAMP_SIZE], TIMESTAMP_SIZE);
+    return 0;
+}
+
+int parse_ping_reply(message_t* ping, uint32_t* host_send_time, uint32_t* device_recv_time, uint32_t* device_send_time) {
+    if (ping->message_id != DEVICE_PING || ping->payload_length != PING_REPLY_SIZE) {
+        return -1;
+    }
+    memcpy(host_send_time, &ping->payload[0], TIMESTAMP_SIZE);
+    memcpy(device_recv_time, &ping->payload[TIMESTAMP_SIZE], TIMESTAMP_SIZE);
+    memcpy(device_send_time, &ping->payload[2 * TIMESTAMP_SIZE], TIMESTAMP_SIZE);
+    return 0;
+}
+
+int parse_mux_acknowledgement(message_t* ack, dev_id_t dev_ids[], int* num_devices) {
+    if (ack->message_id != MUX_ACKNOWLEDGEMENT || ack->payload_length < 1) {
+        return -1;
+    }
+    int n = ack->payload[0];
+    if (n < 1 || n > MAX_LINK_DEVICES || ack->payload_length != 1 + n * DEVICE_ID_SIZE) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        uint8_t* id = &ack->payload[1 + i * DEVICE_ID_SIZE];
+        dev_ids[i].type = id[0];
+        dev_ids[i].year = id[1];
+        memcpy(&dev_ids[i].uid, &id[2], sizeof(uint64_t));
+    }
+    *num_devices = n;
+    return 0;
+}
+
+int parse_device_data_write_ack(uint8_t dev_type, message_t* dev_data, uint16_t* ack) {
+    uint32_t bitmap = *((uint32_t*) dev_data->payload);
+    // The acknowledgement, if any, is the last thing in the payload
+    size_t values_size = device_write_payload_size(dev_type, bitmap);
+    if (dev_data->payload_length != values_size + WRITE_SEQ_SIZE
+        && dev_data->payload_length != values_size + DEVICE_DATA_TIMESTAMPS_SIZE + WRITE_SEQ_SIZE) {
+        return -1;
+    }
+    memcpy(ack, &dev_data->payload[dev_data->payload_length - WRITE_SEQ_SIZE], WRITE_SEQ_SIZE);
+    return 0;
+}
+
+int parse_write_seq(uint8_t dev_type, message_t* dev_write, uint16_t* seq) {
+    uint32_t bitmap = *((uint32_t*) dev_write->payload);
+    size_t values_size = device_write_payload_size(dev_type, bitmap);
+    if (dev_write->payload_length != values_size + WRITE_SEQ_SIZE) {
+        return -1;
+    }
+    memcpy(seq, &dev_write->payload[values_size], WRITE_SEQ_SIZE);
+    return 0;
+}
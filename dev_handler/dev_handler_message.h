@@ -24,6 +24,8 @@
 
 // The size in bytes of the message delimiter
 #define DELIMITER_SIZE 1
+// The size in bytes of the logical device address that precedes the message id on a multiplexed link
+#define ADDRESS_SIZE 1
 // The size in bytes of the section specifying the length of the cobs encoded message
 #define COBS_LENGTH_SIZE 1
 // The size in bytes of the section specifying the type of message being encoded
@@ -36,18 +38,35 @@
 #define DEVICE_ID_SIZE 10
 // The size in bytes of the section specifying the checksum of the message id, the payload length, and the payload itself
 #define CHECKSUM_SIZE 1
+// The size in bytes of a timestamp (the lower 32 bits of a microsecond clock) used for clock synchronization
+#define TIMESTAMP_SIZE 4
+// The size in bytes of a DEVICE_PING payload sent by dev handler to request a clock sync reply: [host send time]
+#define PING_REQUEST_SIZE TIMESTAMP_SIZE
+// The size in bytes of a DEVICE_PING payload sent by a device in reply: [host send time][device receive time][device send time]
+#define PING_REPLY_SIZE (3 * TIMESTAMP_SIZE)
+// The size in bytes of the optional trailer at the end of a DEVICE_DATA payload: [device sample time][device time of last applied DEVICE_WRITE]
+#define DEVICE_DATA_TIMESTAMPS_SIZE (2 * TIMESTAMP_SIZE)
+// The size in bytes of the optional sequence number at the end of a DEVICE_WRITE payload, echoed by the device at the end of DEVICE_DATA
+#define WRITE_SEQ_SIZE 2
+// Bits of a DEVICE_WRITE sequence number holding the actual number; it wraps around at WRITE_SEQ_MASK
+#define WRITE_SEQ_MASK 0x7FFF
+// Bit set in the sequence number of a DEVICE_WRITE that supersedes all previous ones (see write_acks.h)
+#define WRITE_SEQ_RESYNC 0x8000
+// The maximum number of logical devices that can share one multiplexed link
+#define MAX_LINK_DEVICES 8
 // The length of the largest payload in bytes, which may be reached for DEVICE_WRITE and DEVICE_DATA message types.
-#define MAX_PAYLOAD_SIZE (BITMAP_SIZE + (MAX_PARAMS * sizeof(float)))  // Bitmap + Each param (may be floats)
+#define MAX_PAYLOAD_SIZE (BITMAP_SIZE + (MAX_PARAMS * sizeof(float)) + DEVICE_DATA_TIMESTAMPS_SIZE + WRITE_SEQ_SIZE)  // Bitmap + Each param (may be floats) + timestamps + sequence number
 
 // The types of messages
 typedef enum {
-    NOP = 0x00,              // Dummy message
-    DEVICE_PING = 0x01,      // To lowcar
-    ACKNOWLEDGEMENT = 0x02,  // To dev handler
-    DEVICE_WRITE = 0x03,     // To lowcar
-    DEVICE_DATA = 0x04,      // To dev handler
-    LOG = 0x05,              // To dev handler
-    RST = 0x06               // Between dev handler and lowcar
+    NOP = 0x00,                 // Dummy message
+    DEVICE_PING = 0x01,         // To lowcar
+    ACKNOWLEDGEMENT = 0x02,     // To dev handler
+    DEVICE_WRITE = 0x03,        // To lowcar
+    DEVICE_DATA = 0x04,         // To dev handler
+    LOG = 0x05,                 // To dev handler
+    RST = 0x06,                 // Between dev handler and lowcar
+    MUX_ACKNOWLEDGEMENT = 0x07  // To dev handler; sent instead of ACKNOWLEDGEMENT by a multiplexed link
 } message_id_t;
 
 // A struct defining a message to be sent over serial
@@ -90,6 +109,19 @@ message_t* make_empty(ssize_t payload_size);
  */
 message_t* make_ping();
 
+/**
+ * Builds a DEVICE_PING carrying dev handler's send time
+ * A device that supports clock synchronization replies immediately with a DEVICE_PING
+ * of payload length PING_REPLY_SIZE (see parse_ping_reply()). Older devices ignore the payload.
+ * Arguments:
+ *    host_time: The lower 32 bits of micros() at the time of sending
+ * Returns:
+ *    A message of type DEVICE_PING
+ *      payload_length PING_REQUEST_SIZE
+ *      max_payload_length PING_REQUEST_SIZE
+ */
+message_t* make_sync_ping(uint32_t host_time);
+
 /**
  * Builds a DEVICE_WRITE
  * Arguments:
@@ -101,10 +133,22 @@ message_t* make_ping();
  *    A message of type DEVICE_WRITE
  *      Payload: pmap followed by, each of the param_values specified
  *      payload_length: sizeof(pmap) + sizeof(all the values in PARAM_VALUES)
- *      max_payload_length: same as above
+ *      max_payload_length: same as above + WRITE_SEQ_SIZE, leaving room for append_write_seq()
  */
 message_t* make_device_write(uint8_t dev_type, uint32_t pmap, param_val_t param_values[]);
 
+/**
+ * Appends a sequence number to a DEVICE_WRITE built by make_device_write()
+ * Devices that support it echo the sequence number back in DEVICE_DATA; others ignore it
+ * Arguments:
+ *    dev_write: The DEVICE_WRITE to append to
+ *    seq: The sequence number, possibly with WRITE_SEQ_RESYNC set
+ * Returns:
+ *    0 on success
+ *    -1 if DEV_WRITE has no room left for the sequence number
+ */
+int append_write_seq(message_t* dev_write, uint16_t seq);
+
 /**
  * Builds a RST message
  * Returns:
@@ -145,6 +189,20 @@ size_t calc_max_cobs_msg_length(message_t* msg);
  */
 ssize_t message_to_bytes(message_t* msg, uint8_t cobs_encoded[], size_t len);
 
+/**
+ * Same as message_to_bytes(), but for a multiplexed link: the message is preceded by
+ * the address of the logical device it is for
+ * Arguments:
+ *    msg: The message to be serialized
+ *    address: The address of the logical device on the link (its index in the MUX_ACKNOWLEDGEMENT)
+ *    cobs_encoded: A byte array populated with the encoded message
+ *    len: the length of COBS_ENCODED. Should be at least calc_max_cobs_msg_length(msg)
+ * Returns:
+ *    The size of COBS_ENCODED that was actually populated
+ *    -1 if len is too small (less than calc_max_cobs_msg_length)
+ */
+ssize_t addressed_message_to_bytes(message_t* msg, uint8_t address, uint8_t cobs_encoded[], size_t len);
+
 /**
  * Cobs decodes a byte array and populates the fields of input message
  * Arguments:
@@ -160,6 +218,20 @@ ssize_t message_to_bytes(message_t* msg, uint8_t cobs_encoded[], size_t len);
  */
 int parse_message(uint8_t data[], message_t* empty_msg);
 
+/**
+ * Same as parse_message(), but for a multiplexed link, where every message is preceded
+ * by the address of the logical device it is from
+ * Arguments:
+ *    data: A byte array containing a cobs encoded message.
+ *      data[0] should be the delimiter. data[1] should be cobs_len
+ *    empty_msg: A message to be populated.
+ *      Payload must be properly allocated memory. Use make_empty()
+ *    address: Populated with the address of the logical device that sent the message
+ * Returns:
+ *    The same as parse_message()
+ */
+int parse_addressed_message(uint8_t data[], message_t* empty_msg, uint8_t* address);
+
 /**
  * Reads the parameter values from a DEVICE_DATA message into param_val_t[]
  * Arguments:
@@ -171,4 +243,69 @@ int parse_message(uint8_t data[], message_t* empty_msg);
  */
 void parse_device_data(uint8_t dev_type, message_t* dev_data, param_val_t vals[]);
 
+/**
+ * Reads the optional timestamp trailer that follows the parameter values of a DEVICE_DATA message
+ * Arguments:
+ *    dev_type: The type of the device that the message was sent from
+ *    dev_data: The DEVICE_DATA message to unpack
+ *    sample_time: Populated with the device time (microseconds) at which the params were read
+ *    write_time: Populated with the device time (microseconds) at which the last DEVICE_WRITE was applied,
+ *      or 0 if the device hasn't applied one yet
+ * Returns:
+ *    0 if the message carried timestamps
+ *    -1 if it didn't (device doesn't support clock synchronization or hasn't been asked yet)
+ */
+int parse_device_data_timestamps(uint8_t dev_type, message_t* dev_data, uint32_t* sample_time, uint32_t* write_time);
+
+/**
+ * Reads the optional write acknowledgement at the very end of a DEVICE_DATA message (after the timestamps, if any)
+ * Arguments:
+ *    dev_type: The type of the device that the message was sent from
+ *    dev_data: The DEVICE_DATA message to unpack
+ *    ack: Populated with the sequence number of the last DEVICE_WRITE the device applied in order
+ * Returns:
+ *    0 if the message carried a write acknowledgement
+ *    -1 if it didn't (device doesn't support sequence numbers or hasn't received one yet)
+ */
+int parse_device_data_write_ack(uint8_t dev_type, message_t* dev_data, uint16_t* ack);
+
+/**
+ * Reads the optional sequence number at the end of a DEVICE_WRITE message
+ * Used by (virtual) devices to acknowledge DEVICE_WRITEs
+ * Arguments:
+ *    dev_type: The type of the device that the message was sent to
+ *    dev_write: The DEVICE_WRITE message to unpack
+ *    seq: Populated with the sequence number, possibly with WRITE_SEQ_RESYNC set
+ * Returns:
+ *    0 if the message carried a sequence number
+ *    -1 if it didn't
+ */
+int parse_write_seq(uint8_t dev_type, message_t* dev_write, uint16_t* seq);
+
+/**
+ * Reads the timestamps out of a DEVICE_PING sent by a device in reply to make_sync_ping()
+ * Arguments:
+ *    ping: The DEVICE_PING received from the device
+ *    host_send_time: Populated with the echoed host time of the original DEVICE_PING
+ *    device_recv_time: Populated with the device time at which the original DEVICE_PING was received
+ *    device_send_time: Populated with the device time at which this reply was sent
+ * Returns:
+ *    0 if the message is a clock sync reply
+ *    -1 otherwise (e.g. a plain keep-alive DEVICE_PING)
+ */
+int parse_ping_reply(message_t* ping, uint32_t* host_send_time, uint32_t* device_recv_time, uint32_t* device_send_time);
+
+/**
+ * Reads the identities of the logical devices on a multiplexed link from its MUX_ACKNOWLEDGEMENT
+ * Payload: [number of devices N][type][year][uid] ... N times; device i has address i on the link
+ * Arguments:
+ *    ack: The MUX_ACKNOWLEDGEMENT received from the link
+ *    dev_ids: Array of at least MAX_LINK_DEVICES ids, populated with the id of the device at each address
+ *    num_devices: Populated with the number of logical devices on the link
+ * Returns:
+ *    0 on success
+ *    -1 if the message isn't a valid MUX_ACKNOWLEDGEMENT
+ */
+int parse_mux_acknowledgement(message_t* ack, dev_id_t dev_ids[], int* num_devices);
+
 #endif
@@ -0,0 +1,91 @@
+#include <write_acks.h>
+
+// Returns true iff sequence number A is B or was sent before B
+static bool seq_not_after(uint16_t a, uint16_t b) {
+    return ((b - a) & WRITE_SEQ_MASK) <= (WRITE_SEQ_MASK / 2);
+}
+
+// Updates the smoothed round trip time and the retransmission timeout with a new sample (RFC 6298)
+static void add_rtt_sample(write_acks_t* acks, uint32_t rtt) {
+    if (acks->srtt == 0) {
+        acks->srtt = rtt;
+        acks->rttvar = rtt / 2;
+    } else {
+        uint32_t err = (rtt > acks->srtt) ? rtt - acks->srtt : acks->srtt - rtt;
+        acks->rttvar = (3 * acks->rttvar + err) / 4;
+        acks->srtt = (7 * acks->srtt + rtt) / 8;
+    }
+    acks->rto = acks->srtt + 4 * acks->rttvar;
+    if (acks->rto < WRITE_ACKS_MIN_RTO) {
+        acks->rto = WRITE_ACKS_MIN_RTO;
+    } else if (acks->rto > WRITE_ACKS_MAX_RTO) {
+        acks->rto = WRITE_ACKS_MAX_RTO;
+    }
+}
+
+void write_acks_init(write_acks_t* acks) {
+    memset(acks, 0, sizeof(write_acks_t));
+    acks->next_seq = 1;  // The device starts with an ACK of 0
+    acks->rto = WRITE_ACKS_INITIAL_RTO;
+}
+
+int write_acks_sent(write_acks_t* acks, uint32_t pmap, uint64_t now, bool resync) {
+    if (!acks->supported) {
+        return -1;
+    }
+    // If the window is full, supersede everything in it
+    if (!resync && acks->num_pending == WRITE_ACKS_WINDOW) {
+        for (int i = 0; i < acks->num_pending; i++) {
+            pmap |= acks->pending[(acks->first + i) % WRITE_ACKS_WINDOW].pmap;
+        }
+        resync = true;
+    }
+    if (resync) {
+        acks->num_pending = 0;
+    }
+    uint16_t seq = acks->next_seq;
+    acks->next_seq = (acks->next_seq + 1) & WRITE_SEQ_MASK;
+    pending_write_t* write = &acks->pending[(acks->first + acks->num_pending) % WRITE_ACKS_WINDOW];
+    write->seq = seq;
+    write->pmap = pmap;
+    write->sent_time = now;
+    acks->num_pending++;
+    return resync ? (seq | WRITE_SEQ_RESYNC) : seq;
+}
+
+uint32_t write_acks_lost(write_acks_t* acks, uint64_t now) {
+    if (acks->num_pending == 0 || now - acks->pending[acks->first].sent_time < acks->rto) {
+        return 0;
+    }
+    uint32_t pmap = 0;
+    for (int i = 0; i < acks->num_pending; i++) {
+        pmap |= acks->pending[(acks->first + i) % WRITE_ACKS_WINDOW].pmap;
+    }
+    acks->retries++;
+    acks->num_retransmitted++;
+    // Back off in case the device (or the link) is just slow
+    acks->rto = (2 * acks->rto > WRITE_ACKS_MAX_RTO) ? WRITE_ACKS_MAX_RTO : 2 * acks->rto;
+    return pmap;
+}
+
+uint64_t write_acks_received(write_acks_t* acks, uint16_t ack, uint64_t now) {
+    uint64_t ack_sent_time = 0;
+    bool retransmitted = acks->retries > 0;
+    acks->supported = true;
+    ack &= WRITE_SEQ_MASK;
+    while (acks->num_pending > 0 && seq_not_after(acks->pending[acks->first].seq, ack)) {
+        // Only the DEVICE_WRITE that ACK names is timed; the older ones it retires may have waited for a lost
+        // acknowledgement, and nothing is timed after a retransmission (Karn's rule, RFC 6298)
+        if (acks->pending[acks->first].seq == ack) {
+            ack_sent_time = acks->pending[acks->first].sent_time;
+            if (!retransmitted) {
+                add_rtt_sample(acks, (uint32_t) (now - ack_sent_time));
+            }
+        }
+        acks->first = (acks->first + 1) % WRITE_ACKS_WINDOW;
+        acks->num_pending--;
+        acks->num_acked++;
+        acks->retries = 0;
+    }
+    return ack_sent_time;
+}
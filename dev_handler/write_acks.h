@@ -0,0 +1,108 @@
+/**
+ * Per-device DEVICE_WRITE acknowledgements for DEV_HANDLER
+ * A device that supports them keeps a cumulative acknowledgement ACK, starting at 0, which it
+ * echoes at the end of every DEVICE_DATA. Once it has echoed one, every DEVICE_WRITE carries
+ * a sequence number (see append_write_seq()), and the device updates ACK on every DEVICE_WRITE it receives:
+ *
+ *    if the sequence number has WRITE_SEQ_RESYNC set:   ACK = sequence number
+ *    else if the sequence number is ACK + 1:            ACK = sequence number
+ *    else:                                              ACK is unchanged (a DEVICE_WRITE was lost)
+ *
+ * The device always applies the values it receives, so only the sequence numbers need to be in order.
+ *
+ * Since messages over a serial port arrive in order, a DEVICE_WRITE that is still unacknowledged
+ * after a retransmission timeout (RTO) was lost along with everything sent after it. Instead of
+ * resending each of them, dev handler sends a single DEVICE_WRITE with the current values of all
+ * their params and WRITE_SEQ_RESYNC set, which supersedes them all and resynchronizes the device's ACK.
+ * Values are always read fresh from shared memory, so a retransmission never overwrites a newer command.
+ *
+ * The RTO is computed from the measured round trip times as in RFC 6298 (SRTT + 4 * RTTVAR),
+ * doubling on each consecutive retransmission. Until the device echoes an ACK, DEVICE_WRITEs are sent
+ * without a sequence number and aren't tracked, so that they still fit the MAX_PAYLOAD_SIZE of older
+ * firmware, which never echoes one.
+ *
+ * All sequence numbers are modulo WRITE_SEQ_MASK + 1.
+ */
+
+#ifndef WRITE_ACKS_H
+#define WRITE_ACKS_H
+
+#include <dev_handler_message.h>
+
+// The maximum number of unacknowledged DEVICE_WRITEs tracked per device; beyond that, the next one is sent as a resync
+#define WRITE_ACKS_WINDOW 32
+
+// Bounds and initial value of the retransmission timeout, in microseconds
+#define WRITE_ACKS_MIN_RTO 5000
+#define WRITE_ACKS_MAX_RTO 500000
+#define WRITE_ACKS_INITIAL_RTO 50000
+
+// A DEVICE_WRITE that hasn't been acknowledged yet
+typedef struct {
+    uint16_t seq;        // sequence number it was sent with (without WRITE_SEQ_RESYNC)
+    uint32_t pmap;       // params it wrote
+    uint64_t sent_time;  // micros() at which it was sent
+} pending_write_t;
+
+// State of the DEVICE_WRITE acknowledgements of a single device
+typedef struct {
+    pending_write_t pending[WRITE_ACKS_WINDOW];  // unacknowledged DEVICE_WRITEs, oldest first, as a ring buffer
+    int first;                                   // index in PENDING of the oldest unacknowledged DEVICE_WRITE
+    int num_pending;                             // number of unacknowledged DEVICE_WRITEs
+    uint16_t next_seq;                           // sequence number of the next DEVICE_WRITE
+    bool supported;                              // true iff the device has echoed an ACK, so DEVICE_WRITEs are numbered
+    int retries;                                 // number of retransmissions since the last acknowledgement
+    uint32_t srtt;                               // smoothed round trip time (microseconds)
+    uint32_t rttvar;                             // round trip time variation (microseconds)
+    uint32_t rto;                                // current retransmission timeout (microseconds)
+    uint32_t num_acked;                          // number of DEVICE_WRITEs acknowledged
+    uint32_t num_retransmitted;                  // number of retransmissions sent
+} write_acks_t;
+
+/**
+ * Resets the acknowledgement state for a newly connected device
+ * Arguments:
+ *    acks: the state to reset
+ */
+void write_acks_init(write_acks_t* acks);
+
+/**
+ * Records a DEVICE_WRITE that is about to be sent and assigns it a sequence number
+ * Arguments:
+ *    acks: the state of the device the DEVICE_WRITE is for
+ *    pmap: the params written by the DEVICE_WRITE
+ *    now: the current time (micros())
+ *    resync: true if the DEVICE_WRITE retransmits all pending ones (PMAP must include write_acks_lost())
+ * Returns:
+ *    the sequence number to send with append_write_seq(), or
+ *    -1 if the device hasn't shown it supports acknowledgements (send the DEVICE_WRITE without a sequence number)
+ */
+int write_acks_sent(write_acks_t* acks, uint32_t pmap, uint64_t now, bool resync);
+
+/**
+ * Checks whether the oldest unacknowledged DEVICE_WRITE timed out
+ * If so, the caller must send a resync DEVICE_WRITE including the returned params
+ * Arguments:
+ *    acks: the state of the device
+ *    now: the current time (micros())
+ * Returns:
+ *    the bitmap of the params of all unacknowledged DEVICE_WRITEs if they need to be retransmitted, or
+ *    0 if nothing needs to be retransmitted
+ */
+uint32_t write_acks_lost(write_acks_t* acks, uint64_t now);
+
+/**
+ * Processes a write acknowledgement received in a DEVICE_DATA
+ * Acknowledged DEVICE_WRITEs stop being tracked, and the round trip time of the one with sequence number ACK
+ * is measured, unless a retransmission was sent since the last acknowledgement
+ * Arguments:
+ *    acks: the state of the device the acknowledgement came from
+ *    ack: the acknowledgement (see parse_device_data_write_ack())
+ *    now: the current time (micros())
+ * Returns:
+ *    the time (micros()) at which the DEVICE_WRITE with sequence number ACK was sent, if this acknowledges it, or
+ *    0 if ACK doesn't acknowledge any new DEVICE_WRITE
+ */
+uint64_t write_acks_received(write_acks_t* acks, uint16_t ack, uint64_t now);
+
+#endif
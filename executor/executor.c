@@ -1,5 +1,6 @@
 #define PY_SSIZE_T_CLEAN
 #include <arpa/inet.h>          //for networking
+#include <limits.h>             // for PATH_MAX
 #include <pthread.h>            //for POSIX threads
 #include <python3.12/Python.h>  // For Python's C API
 #include <signal.h>             // Used to handle SIGTERM, SIGINT, SIGKILL
@@ -25,12 +26,22 @@ PyObject *pModule, *pAPI, *pRobot, *pGamepad, *pKeyboard;
 robot_desc_val_t mode = IDLE;  // current robot mode
 pid_t pid;                     // pid for mode process
 
+// The zygote: a child that has already imported the student code and waits to be sent the mode to run (see arm_zygote())
+pid_t zygote_pid = -1;        // pid of the zygote, or -1 if there is none
+int zygote_fd = -1;           // write end of the pipe on which the zygote is sent the mode
+struct timespec zygote_time;  // when the zygote was forked; student code modified since then is stale in it
+bool zygote_failed = false;   // whether the last zygote exited before being used (e.g. the student code doesn't import)
+
 // Timings for all modes
 struct timespec setup_time = {2, 0};  // Max time allowed for setup functions
 #define MIN_FREQ 10.0                 // Minimum number of times per second the main loop should run
 struct timespec main_interval = {0, (long) ((1.0 / MIN_FREQ) * 1e9)};
 #define MAX_FREQ 10000.0                     // Maximum number of times per second the Python function should run
 uint64_t min_time = (1.0 / MAX_FREQ) * 1e9;  // Minimum time in nanoseconds that the Python function should take
+#define ACTION_CANCEL_TIMEOUT 50000          // Microseconds that async actions are given to finish once cancelled when the mode ends
+
+#define MODE_POLL_INTERVAL 5000   // Microseconds between checks of the run mode in shared memory
+#define ZYGOTE_CHECK_INTERVAL 20  // Number of run mode checks between checks of whether the zygote is still usable
 
 
 /**
@@ -87,7 +98,7 @@ static void reset_params() {
 
 
 /**
- *  Initializes the executor process. Must be the first thing called in each child subprocess
+ *  Initializes the executor process and imports the student code. Must be the first thing called in each child subprocess
  *
  *  Input:
  *      student_code: string representing the name of the student's Python file, without the .py
@@ -107,15 +118,22 @@ static void executor_init(char* student_code) {
         exit(1);
     }
 
-    // imports the student code
+    // imports the student code from its cached compiled code, logging how long that took
     module_name = student_code;
-    pModule = PyImport_ImportModule(module_name);
+    pModule = PyObject_CallMethod(pAPI, "_import_student_code", "s", module_name);
     if (pModule == NULL) {
         PyErr_Print();
         log_printf(ERROR, "Could not import student code file: %s", module_name);
         exit(1);
     }
+}
 
+
+/**
+ *  Instantiates the student API and inserts it into the student code. Must be called after executor_init(), once the
+ *  mode to run is in shared memory: Robot, Gamepad and Keyboard read the run mode and start position when instantiated.
+ */
+static void executor_init_api() {
     // checks to make sure there is a Robot class, then instantiates it
     PyObject* robot_class = PyObject_GetAttrString(pAPI, "Robot");
     if (robot_class == NULL) {
@@ -131,6 +149,15 @@ static void executor_init(char* student_code) {
     }
     Py_DECREF(robot_class);
 
+    // has Python cancel the async actions on SIGTERM; the caller puts python_exit_handler() back in front of it
+    PyObject* ret = PyObject_CallMethod(pAPI, "_cancel_actions_on_exit", "O", pRobot);
+    if (ret == NULL) {
+        PyErr_Print();
+        log_printf(ERROR, "Could not set the handler that cancels the async actions");
+        exit(1);
+    }
+    Py_DECREF(ret);
+
     // checks to make sure there is a Gamepad class, then instantiates it
     PyObject* gamepad_class = PyObject_GetAttrString(pAPI, "Gamepad");
     if (gamepad_class == NULL) {
@@ -258,24 +285,182 @@ static uint8_t run_py_function(const char* func_name, struct timespec* timeout,
 
 
 /**
- *  Handler for killing the child mode subprocess
+ *  Cancels the student's async actions, giving them ACTION_CANCEL_TIMEOUT to finish (e.g. to stop their motors in a
+ *  `finally`), then exits. Must be called on the main Python thread.
  */
-static void python_exit_handler(int signum) {
+static void cancel_actions() {
+    PyObject* ret = PyObject_CallMethod(pRobot, "_cancel_actions", "d", ACTION_CANCEL_TIMEOUT / 1e6);
+    if (ret == NULL) {
+        PyErr_Print();
+        log_printf(ERROR, "Could not cancel the async actions");
+    }
+    Py_XDECREF(ret);
+    exit(0);
+}
+
+
+/**
+ *  Handler for when cancelling the async actions takes too long
+ */
+static void cancel_timeout_handler(int signum) {
     exit(0);
-    // Cancel the Python thread by sending a TimeoutError
-    // log_printf(DEBUG, "cancelling Python function");
-    // PyGILState_STATE gstate = PyGILState_Ensure();
-    //     PyObject* ret = PyObject_CallMethod(event, "set", NULL);
-    //     Py_DECREF(event);
-    //     if (ret == NULL) {
-    //         PyErr_Print();
-    //         log_printf(ERROR, "Could not set sleep_event to True");
-    //         exit(2);
-    //     }
-    //     Py_DECREF(ret);
-    // }
-    // PyThreadState_SetAsyncExc((unsigned long) pthread_self(), PyExc_TimeoutError);
-    // PyGILState_Release(gstate);
+}
+
+
+/**
+ *  Handler for killing the child mode subprocess. Only trips the SIGTERM handler that executor_init_api() has
+ *  studentapi install, which cancels the async actions once the main Python thread gets to it; if it doesn't exit within
+ *  twice ACTION_CANCEL_TIMEOUT (e.g. it is in a blocking call), the subprocess exits anyway.
+ */
+static void python_exit_handler(int signum) {
+    if (pRobot == NULL) {
+        exit(0);  // the zygote was never given a mode, so no action has run
+    }
+    signal(SIGALRM, cancel_timeout_handler);
+    ualarm(2 * ACTION_CANCEL_TIMEOUT, 0);
+    PyErr_SetInterruptEx(SIGTERM);  // async-signal-safe, unlike calling into Python here
+}
+
+
+/**
+ *  Finds the file of the student code the way the import in executor_init() does: in the executor directory first,
+ *  then in each directory of PYTHONPATH.
+ *
+ *  Input:
+ *      student_code: string representing the name of the student's Python file, without the .py
+ *      path: filled in with the path of the file, of size PATH_MAX
+ *  Returns: 0 if the file was found, -1 otherwise
+ */
+static int find_student_code(char* student_code, char* path) {
+    snprintf(path, PATH_MAX, "./%s.py", student_code);
+    if (access(path, F_OK) == 0) {
+        return 0;
+    }
+    char* python_path = getenv("PYTHONPATH");
+    if (python_path == NULL) {
+        return -1;
+    }
+    char dirs[PATH_MAX];
+    snprintf(dirs, PATH_MAX, "%s", python_path);
+    char* save_ptr;
+    for (char* dir = strtok_r(dirs, ":", &save_ptr); dir != NULL; dir = strtok_r(NULL, ":", &save_ptr)) {
+        snprintf(path, PATH_MAX, "%s/%s.py", dir, student_code);
+        if (access(path, F_OK) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ *  Runs the mode in a child subprocess, and exits when it returns.
+ */
+static void run_mode() {
+    char* mode_str = get_mode_str(mode);
+    int err = run_py_function(mode_str, &main_interval, NULL, NULL);  // Run main function
+    if (err) {
+        log_printf(WARN, "NEED TO EDIT STATEMENT");  // "Problem Child"
+    }
+    cancel_actions();
+}
+
+
+/**
+ *  Forks the zygote: a child subprocess that initializes Python and imports the studentapi and the student code
+ *  right away, then waits for the mode to run to be written to its pipe. Starting a mode then only has to instantiate
+ *  the API and call the mode's function, instead of waiting for all of that (which takes hundreds of milliseconds with
+ *  heavy imports). The zygote is forked again whenever the robot goes back to IDLE, and also as soon as AUTO starts,
+ *  since Shepherd switches from AUTO straight to TELEOP; that zygote imports while AUTO runs. Switching straight from
+ *  TELEOP to another mode starts without a zygote.
+ *
+ *  Input:
+ *      student_code: string representing the name of the student's Python file, without the .py
+ */
+static void arm_zygote(char* student_code) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        log_printf(ERROR, "arm_zygote: Failed to create pipe: %s", strerror(errno));
+        return;
+    }
+    clock_gettime(CLOCK_REALTIME_COARSE, &zygote_time);  // the clock that file modification times come from
+    zygote_pid = fork();
+    if (zygote_pid < 0) {
+        log_printf(ERROR, "arm_zygote: Failed to create zygote: %s", strerror(errno));
+        close(fds[0]);
+        close(fds[1]);
+        zygote_pid = -1;
+        return;
+    } else if (zygote_pid == 0) {
+        // Now in child process
+        close(fds[1]);
+        signal(SIGINT, SIG_IGN);  // Disable Ctrl+C for child process
+        executor_init(student_code);
+        signal(SIGTERM, python_exit_handler);  // Set handler for killing subprocess
+
+        // wait for the mode; the pipe is closed without one if the zygote isn't needed anymore
+        uint8_t new_mode;
+        ssize_t n_read;
+        while ((n_read = read(fds[0], &new_mode, 1)) == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n_read != 1) {
+            exit(0);
+        }
+        mode = new_mode;
+        executor_init_api();
+        signal(SIGTERM, python_exit_handler);  // in front of the handler that executor_init_api() had Python install
+        run_mode();
+    }
+    // Now in parent process
+    close(fds[0]);
+    zygote_fd = fds[1];
+    zygote_failed = false;
+}
+
+
+/**
+ *  Kills the zygote, if there is one.
+ */
+static void disarm_zygote() {
+    if (zygote_pid == -1) {
+        return;
+    }
+    close(zygote_fd);  // the zygote exits once it is done initializing, if it isn't yet
+    if (kill(zygote_pid, SIGTERM) != 0) {
+        log_printf(ERROR, "Kill signal not sent to zygote: %s", strerror(errno));
+    }
+    if (waitpid(zygote_pid, NULL, 0) == -1) {
+        log_printf(ERROR, "Wait failed for zygote pid %d: %s", zygote_pid, strerror(errno));
+    }
+    zygote_pid = -1;
+}
+
+
+/**
+ *  Returns whether the zygote can't be used to run the student code as it is now: it exited (e.g. the student code
+ *  doesn't import), or the student code was modified since it was forked.
+ *
+ *  Input:
+ *      student_code: string representing the name of the student's Python file, without the .py
+ */
+static bool zygote_stale(char* student_code) {
+    if (zygote_pid != -1 && waitpid(zygote_pid, NULL, WNOHANG) == zygote_pid) {
+        log_printf(DEBUG, "Zygote exited before being used");
+        close(zygote_fd);
+        zygote_pid = -1;
+        zygote_failed = true;
+    }
+    char path[PATH_MAX];
+    struct stat code_stat;
+    if (find_student_code(student_code, path) != 0 || stat(path, &code_stat) != 0) {
+        return zygote_pid == -1;
+    }
+    bool modified = code_stat.st_mtim.tv_sec > zygote_time.tv_sec || (code_stat.st_mtim.tv_sec == zygote_time.tv_sec && code_stat.st_mtim.tv_nsec >= zygote_time.tv_nsec);
+    if (modified) {
+        zygote_failed = false;  // the new code may import
+    }
+    return zygote_pid == -1 || modified;
 }
 
 
@@ -302,30 +487,33 @@ static void kill_subprocess() {
 
 
 /**
- *  Creates a new subprocess with fork that will run the given mode using `run_mode`
+ *  Starts a subprocess that runs the current mode, by handing the mode to the zygote. If there is no usable zygote,
+ *  a new one is forked first, which then starts as slowly as without one.
  */
 static pid_t start_mode_subprocess(char* student_code) {
-    pid_t pid = fork();
-    if (pid < 0) {
-        log_printf(ERROR, "Failed to create child subprocess for mode %d: %s", mode, strerror(errno));
-        return -1;
-    } else if (pid == 0) {
-        // Now in child process
-        signal(SIGINT, SIG_IGN);  // Disable Ctrl+C for child process
-        executor_init(student_code);
-        signal(SIGTERM, python_exit_handler);  // Set handler for killing subprocess
-
-        char* mode_str = get_mode_str(mode);
-        int err = run_py_function(mode_str, &main_interval, NULL, NULL);  // Run main function
-        if (err) {
-            log_printf(WARN, "NEED TO EDIT STATEMENT");  // "Problem Child"
+    if (zygote_stale(student_code)) {
+        disarm_zygote();
+        arm_zygote(student_code);
+    }
+    uint8_t mode_byte = mode;
+    if (zygote_pid != -1 && write(zygote_fd, &mode_byte, 1) != 1) {
+        // The zygote exited since it was checked; SIGPIPE is ignored so that this fails instead
+        disarm_zygote();
+        arm_zygote(student_code);
+        if (zygote_pid != -1 && write(zygote_fd, &mode_byte, 1) != 1) {
+            log_printf(ERROR, "Failed to start mode %d: %s", mode, strerror(errno));
+            disarm_zygote();
         }
-        exit(0);
-        return pid;  // Never reach this statement due to exit, needed to fix compiler warning
-    } else {
-        // Now in parent process
-        return pid;
     }
+    if (zygote_pid == -1) {
+        log_printf(ERROR, "Failed to create child subprocess for mode %d", mode);
+        return -1;
+    }
+    // The zygote is now the mode's subprocess
+    pid_t pid = zygote_pid;
+    close(zygote_fd);
+    zygote_pid = -1;
+    return pid;
 }
 
 
@@ -337,6 +525,7 @@ static void exit_handler(int signum) {
     if (mode != IDLE) {
         kill_subprocess();
     }
+    disarm_zygote();
     exit(0);
 }
 
@@ -353,6 +542,7 @@ static void exit_handler(int signum) {
  */
 int main(int argc, char* argv[]) {
     signal(SIGINT, exit_handler);
+    signal(SIGPIPE, SIG_IGN);  // So that handing a mode to a zygote that exited fails instead of killing the executor
     logger_init(EXECUTOR);
     shm_init();
     chdir("../executor");
@@ -362,8 +552,14 @@ int main(int argc, char* argv[]) {
         student_code = argv[1];
     }
     robot_desc_val_t new_mode = IDLE;
+    arm_zygote(student_code);
     // Main loop that checks for new run mode in shared memory from the network handler
-    while (1) {
+    for (uint32_t i = 1;; i++) {
+        // While idle, keep a zygote that is ready with the current student code
+        if (mode == IDLE && i % ZYGOTE_CHECK_INTERVAL == 0 && zygote_stale(student_code) && !zygote_failed) {
+            disarm_zygote();
+            arm_zygote(student_code);
+        }
         new_mode = robot_desc_read(RUN_MODE);
         // If we receive a new mode, cancel the previous mode and start the new one
         if (new_mode != mode) {
@@ -375,9 +571,11 @@ int main(int argc, char* argv[]) {
                 pid = start_mode_subprocess(student_code);
                 if (pid == -1) {
                     mode = IDLE;
+                } else if (mode == AUTO) {
+                    arm_zygote(student_code);  // for TELEOP, which usually follows AUTO without going back to IDLE
                 }
             }
         }
-        usleep(100000);  // throttle this thread to ~10 Hz
+        usleep(MODE_POLL_INTERVAL);  // throttle this thread to ~200 Hz, which adds at most 5 ms to starting a mode
     }
 }
@@ -99,23 +99,59 @@ static void bound_velocity(param_val_t* params) {
     }
 }
 
-int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params) {
+// The game states that affect writes to devices, read from shared memory the first time a write needs them
+typedef struct {
+    bool read;  // whether the fields below have been read
+    bool hypothermia;
+    bool poison_ivy;
+    bool dehydration;
+} gamestates_t;
+
+// Modifies the params to be written to a device based on the current active game states
+static void apply_gamestates(uint8_t dev_type, param_val_t* params, gamestates_t* states) {
     // Spring 2021: Only KoalaBear is affected by game states
     if (dev_type == KOALABEAR) {
+        if (!states->read) {
+            states->hypothermia = robot_desc_read(HYPOTHERMIA) == ACTIVE;
+            states->poison_ivy = robot_desc_read(POISON_IVY) == ACTIVE;
+            states->dehydration = robot_desc_read(DEHYDRATION) == ACTIVE;
+            states->read = true;
+        }
+
         // Bound velocity to [-1.0, 1.0]
         bound_velocity(params);
 
         // Implement each gamestate, modifying params as necessary
-        if (robot_desc_read(HYPOTHERMIA) == ACTIVE) {
+        if (states->hypothermia) {
             scale_velocity(params, SLOW_SCALAR);
         }
-        if (robot_desc_read(POISON_IVY) == ACTIVE) {
+        if (states->poison_ivy) {
             scale_velocity(params, -1.0);
         }
-        if (robot_desc_read(DEHYDRATION) == ACTIVE) {
+        if (states->dehydration) {
             scale_velocity(params, 0);
         }
     }
+}
+
+int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params) {
+    gamestates_t states = {.read = false};
+    apply_gamestates(dev_type, params, &states);
     // Call the actual shared memory wrapper function with the (possibly modified) values
     return device_write_uid(dev_uid, process, stream, params_to_write, params);
 }
+
+int filter_device_write(uint8_t dev_type, int dev_ix, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params) {
+    gamestates_t states = {.read = false};
+    apply_gamestates(dev_type, params, &states);
+    return device_write(dev_ix, process, stream, params_to_write, params);
+}
+
+int filter_device_write_batch(int num_devices, uint8_t* dev_types, int* dev_ixs, process_t process, stream_t stream, uint32_t* params_to_write, param_val_t (*params)[MAX_PARAMS]) {
+    // the game states are read at most once for the whole batch
+    gamestates_t states = {.read = false};
+    for (int i = 0; i < num_devices; i++) {
+        apply_gamestates(dev_types[i], params[i], &states);
+    }
+    return device_write_batch(num_devices, dev_ixs, process, stream, params_to_write, params);
+}
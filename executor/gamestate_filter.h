@@ -41,4 +41,17 @@ void start_gamestate_handler_thread();
  */
 int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params);
 
+/**
+ * The same as filter_device_write_uid(), but wraps device_write() for a device
+ * whose index in shared memory is already known.
+ */
+int filter_device_write(uint8_t dev_type, int dev_ix, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params);
+
+/**
+ * A wrapper function to device_write_batch that modifies the input params of each device
+ * based on the current active game states, which are only read once for the whole batch.
+ * Returns the same as device_write_batch().
+ */
+int filter_device_write_batch(int num_devices, uint8_t* dev_types, int* dev_ixs, process_t process, stream_t stream, uint32_t* params_to_write, param_val_t (*params)[MAX_PARAMS]);
+
 #endif
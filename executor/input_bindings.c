@@ -0,0 +1,201 @@
+#include <input_bindings.h>
+#include <time.h>  // for clock_nanosleep
+
+// A binding, with what the binding thread remembers about each of its targets
+typedef struct {
+    binding_t binding;
+    int num_targets;
+    int dev_ix[2];       // index of the target's device in shared memory when it was last found, or -1
+    float written[2];    // value last written to the target
+    bool is_written[2];  // whether the target's device has been written since it was found
+} binding_state_t;
+
+static binding_state_t bindings[MAX_BINDINGS];
+static int num_bindings = 0;
+static bool bindings_running = false;                               // whether the binding thread has been started
+static pthread_mutex_t bindings_mutex = PTHREAD_MUTEX_INITIALIZER;  // guards bindings, num_bindings and bindings_running
+
+// Returns the position of a joystick of the gamepad, after the binding's deadband and scale
+static float read_axis(binding_t* binding, float* joysticks, gp_joystick_t axis) {
+    float value = joysticks[axis];
+    if (value < binding->deadband && value > -binding->deadband) {
+        return 0;
+    }
+    return value * binding->scale;
+}
+
+// Bounds a mixed value to [-1.0, 1.0]
+static float bound(float value) {
+    if (value > 1.0) {
+        return 1.0;
+    } else if (value < -1.0) {
+        return -1.0;
+    }
+    return value;
+}
+
+// Computes the values of the binding's targets from the gamepad's joysticks
+static void mix(binding_t* binding, float* joysticks, float* values) {
+    float first = read_axis(binding, joysticks, binding->axes[0]);
+    switch (binding->mixer) {
+        case AXIS_MIXER:
+            values[0] = first;
+            break;
+        case ARCADE_MIXER: {
+            float turn = read_axis(binding, joysticks, binding->axes[1]);
+            values[0] = bound(first + turn);
+            values[1] = bound(first - turn);
+            break;
+        }
+        case TANK_MIXER:
+            values[0] = first;
+            values[1] = read_axis(binding, joysticks, binding->axes[1]);
+            break;
+    }
+}
+
+/**
+ * Evaluates every binding once, writing the targets whose values changed
+ * to shared memory in a single batch.
+ */
+static void evaluate_bindings() {
+    uint64_t buttons;
+    float joysticks[4] = {0};  // left at 0 while the gamepad is disconnected
+    input_read(&buttons, joysticks, GAMEPAD);
+
+    // The targets to write, grouped by device
+    uint8_t dev_types[MAX_DEVICES];
+    int dev_ixs[MAX_DEVICES];
+    uint32_t params_to_write[MAX_DEVICES];
+    param_val_t params[MAX_DEVICES][MAX_PARAMS];
+    int num_devices = 0;
+
+    pthread_mutex_lock(&bindings_mutex);
+    for (int i = 0; i < num_bindings; i++) {
+        binding_state_t* state = &bindings[i];
+        float values[2];
+        mix(&state->binding, joysticks, values);
+        for (int t = 0; t < state->num_targets; t++) {
+            binding_target_t* target = &state->binding.targets[t];
+            int dev_ix = get_dev_ix_from_uid_cached(target->dev_uid, state->dev_ix[t]);
+            if (dev_ix != state->dev_ix[t]) {
+                state->dev_ix[t] = dev_ix;
+                state->is_written[t] = false;
+            }
+            if (dev_ix == -1 || (state->is_written[t] && state->written[t] == values[t])) {
+                continue;
+            }
+            int d = 0;
+            while (d < num_devices && dev_ixs[d] != dev_ix) {
+                d++;
+            }
+            if (d == num_devices) {
+                dev_types[d] = target->dev_type;
+                dev_ixs[d] = dev_ix;
+                params_to_write[d] = 0;
+                num_devices++;
+            }
+            params[d][target->param_idx].p_f = values[t];
+            params_to_write[d] |= 1 << target->param_idx;
+            state->written[t] = values[t];
+            state->is_written[t] = true;
+        }
+    }
+    int err = (num_devices > 0) ? filter_device_write_batch(num_devices, dev_types, dev_ixs, EXECUTOR, COMMAND, params_to_write, params) : 0;
+    if (err < 0) {
+        // a device disconnected since it was found; look for it again
+        int lost = dev_ixs[-err - 1];
+        for (int i = 0; i < num_bindings; i++) {
+            for (int t = 0; t < bindings[i].num_targets; t++) {
+                if (bindings[i].dev_ix[t] == lost) {
+                    bindings[i].dev_ix[t] = -1;
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&bindings_mutex);
+}
+
+/**
+ * A thread function that evaluates the bindings every BINDING_INTERVAL microseconds, and blocks forever.
+ * Deadlines missed because an evaluation took too long are skipped.
+ * Arguments:
+ *    Unused
+ * Returns:
+ *    NULL
+ */
+static void* bindings_loop(void* args) {
+    // leave signals (e.g. SIGTERM at the end of the mode) to the Python threads
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    struct timespec deadline, now;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    while (1) {
+        evaluate_bindings();
+
+        deadline.tv_nsec += BINDING_INTERVAL * 1000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec > deadline.tv_nsec)) {
+            deadline = now;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+            continue;
+        }
+    }
+    return NULL;
+}
+
+// Returns whether two bindings write one of the same parameters
+static bool share_target(binding_state_t* a, binding_state_t* b) {
+    for (int i = 0; i < a->num_targets; i++) {
+        for (int j = 0; j < b->num_targets; j++) {
+            if (a->binding.targets[i].dev_uid == b->binding.targets[j].dev_uid && a->binding.targets[i].param_idx == b->binding.targets[j].param_idx) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int add_binding(binding_t* binding) {
+    pthread_t bindings_tid;
+    binding_state_t state = {.binding = *binding, .num_targets = (binding->mixer == AXIS_MIXER) ? 1 : 2, .dev_ix = {-1, -1}, .is_written = {false, false}};
+
+    pthread_mutex_lock(&bindings_mutex);
+    // remove the bindings that write one of the same parameters
+    int kept = 0;
+    for (int i = 0; i < num_bindings; i++) {
+        if (!share_target(&bindings[i], &state)) {
+            bindings[kept++] = bindings[i];
+        }
+    }
+    num_bindings = kept;
+    if (num_bindings == MAX_BINDINGS) {
+        pthread_mutex_unlock(&bindings_mutex);
+        return -1;
+    }
+    if (!bindings_running) {  // There should be only one thread evaluating bindings.
+        if (pthread_create(&bindings_tid, NULL, bindings_loop, NULL) != 0) {
+            log_printf(ERROR, "add_binding: Couldn't spawn thread for bindings");
+            pthread_mutex_unlock(&bindings_mutex);
+            return -2;
+        }
+        pthread_detach(bindings_tid);
+        bindings_running = true;
+    }
+    bindings[num_bindings++] = state;
+    pthread_mutex_unlock(&bindings_mutex);
+    return 0;
+}
+
+void clear_bindings() {
+    pthread_mutex_lock(&bindings_mutex);
+    num_bindings = 0;
+    pthread_mutex_unlock(&bindings_mutex);
+}
@@ -0,0 +1,66 @@
+#ifndef INPUT_BINDINGS_H
+#define INPUT_BINDINGS_H
+
+/**
+ * Bindings from the gamepad's joysticks to device parameters, which are
+ * evaluated in C by a thread of the mode's process, without Python.
+ * This interface is to be used only by the Student API's Robot.bind_axis(),
+ * Robot.bind_arcade_drive(), Robot.bind_tank_drive() and Robot.clear_bindings().
+ *
+ * Every BINDING_INTERVAL microseconds, the thread reads the gamepad from shared memory,
+ * mixes the joysticks into the value of each bound parameter, and writes the parameters
+ * whose values changed through filter_device_write_batch(), so game states apply
+ * to them like to Robot.set_value(). While the gamepad is disconnected, every bound
+ * parameter is held at 0.
+ */
+
+#include <gamestate_filter.h>
+#include <logger.h>
+#include <runtime_util.h>
+#include <shm_wrapper.h>
+
+// Maximum number of bindings at once
+#define MAX_BINDINGS 16
+// Microseconds between each evaluation of the bindings (1 kHz)
+#define BINDING_INTERVAL 1000
+
+// How a binding mixes its joysticks into the values of its parameters
+typedef enum {
+    AXIS_MIXER,    // targets[0] = axes[0]
+    ARCADE_MIXER,  // targets[0] (left) = axes[0] + axes[1], targets[1] (right) = axes[0] - axes[1]; axes[0] is the throttle, axes[1] the turn
+    TANK_MIXER     // targets[0] (left) = axes[0], targets[1] (right) = axes[1]
+} mixer_t;
+
+// A parameter of a device that a binding writes
+typedef struct {
+    uint8_t dev_type;
+    uint64_t dev_uid;
+    uint8_t param_idx;  // must be a FLOAT parameter
+} binding_target_t;
+
+typedef struct {
+    mixer_t mixer;
+    gp_joystick_t axes[2];        // AXIS_MIXER only uses axes[0]
+    float scale;                  // each joystick is multiplied by this, after its deadband is applied
+    float deadband;               // joystick positions closer to 0 than this are read as 0
+    binding_target_t targets[2];  // AXIS_MIXER only uses targets[0]
+} binding_t;
+
+/**
+ * Adds a binding, replacing any binding that writes one of the same parameters.
+ * Starts the binding thread the first time it is called.
+ * Arguments:
+ *    binding: the binding to add, which is copied
+ * Returns:
+ *    0 on success
+ *    -1 if there are already MAX_BINDINGS bindings
+ *    -2 if the binding thread couldn't be started (the binding isn't added)
+ */
+int add_binding(binding_t* binding);
+
+/**
+ * Removes every binding. The parameters they wrote keep their last values.
+ */
+void clear_bindings();
+
+#endif
@@ -1,8 +1,8 @@
 from libc.stdint cimport *
 
 cdef extern from "../runtime_util/runtime_util.h":
-    int MAX_DEVICES
-    int MAX_PARAMS
+    enum: MAX_DEVICES
+    enum: MAX_PARAMS
     int NUM_GAMEPAD_BUTTONS
     int NUM_KEYBOARD_BUTTONS
     int LOG_KEY_LENGTH
@@ -28,6 +28,8 @@ cdef extern from "../runtime_util/runtime_util.h":
         GAMEPAD, KEYBOARD, START_POS, RUN_MODE
     ctypedef enum robot_desc_val_t:
         CONNECTED, DISCONNECTED, LEFT, RIGHT, AUTO, TELEOP
+    ctypedef enum gp_joystick_t:
+        pass
     uint8_t is_param_to_kill(uint8_t dev_type, char* param_name) nogil
     char** get_button_names() nogil
     char** get_joystick_names() nogil
@@ -47,11 +49,33 @@ cdef extern from "../shm_wrapper/shm_wrapper.h" nogil:
     ctypedef enum stream_t:
         DATA, COMMAND
     void shm_init()
+    int get_dev_ix_from_uid_cached(uint64_t dev_uid, int dev_ix)
+    int device_read(int dev_ix, process_t process, stream_t stream, uint32_t params_to_read, param_val_t *params)
     int device_read_uid(uint64_t device_uid, process_t process, stream_t stream, uint32_t params_to_read, param_val_t *params)
+    int device_read_gen(int dev_ix, uint32_t params_to_read, param_val_t *params, uint32_t *gen)
     int device_write_uid(uint64_t device_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t *params)
     int input_read (uint64_t *pressed_buttons, float *joystick_vals, robot_desc_field_t source)
     robot_desc_val_t robot_desc_read (robot_desc_field_t field)
     int log_data_write(char* key, param_type_t type, param_val_t value)
 
-cdef extern from "gamestate_filter.h":
+cdef extern from "gamestate_filter.h" nogil:
     int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params)
+    int filter_device_write(uint8_t dev_type, int dev_ix, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params)
+    int filter_device_write_batch(int num_devices, uint8_t* dev_types, int* dev_ixs, process_t process, stream_t stream, uint32_t* params_to_write, param_val_t (*params)[MAX_PARAMS])
+
+cdef extern from "input_bindings.h" nogil:
+    ctypedef enum mixer_t:
+        AXIS_MIXER, ARCADE_MIXER, TANK_MIXER
+    ctypedef struct binding_target_t:
+        uint8_t dev_type
+        uint64_t dev_uid
+        uint8_t param_idx
+    ctypedef struct binding_t:
+        mixer_t mixer
+        gp_joystick_t axes[2]
+        float scale
+        float deadband
+        binding_target_t targets[2]
+    int MAX_BINDINGS
+    int add_binding(binding_t* binding)
+    void clear_bindings()
@@ -2,24 +2,48 @@
 
 # from libc.stdint cimport *
 from studentapi cimport *
+from libc.string cimport strcmp, memcpy
+from libc.stdlib cimport exit
+from libc.math cimport NAN
 from cpython.mem cimport PyMem_Malloc, PyMem_Free
-from libc.string cimport strcmp
+from cpython.buffer cimport PyBUF_WRITABLE
+from posix.time cimport clock_gettime, clock_nanosleep, timespec, CLOCK_MONOTONIC, TIMER_ABSTIME
 
 import threading
+import asyncio
+import inspect
+import queue
 import sys
 import builtins
 import traceback
 import time
 import re
 import importlib
-from collections import defaultdict
+import importlib.machinery
+import importlib.util
+import marshal
+import os
+import signal
+from collections import defaultdict, OrderedDict
+from concurrent.futures import Future
 from typing import Dict, List
 
 
 """Student API written in Cython. """
 
-# Maximum number of concurrent student actions
+# Maximum number of concurrent student actions that aren't `async def`
 MAX_THREADS = 8
+# Seconds that `async def` actions are given to finish once they are cancelled at the end of a mode (the same as ACTION_CANCEL_TIMEOUT in executor.c)
+ACTION_CANCEL_TIMEOUT = 0.05
+# Maximum number of parameter handles that Robot.get_value() and Robot.set_value() keep resolved
+HANDLE_CACHE_SIZE = 64
+# Bounds of the rate of Robot.run_periodic(), in calls per second (the same as MIN_FREQ and MAX_FREQ in executor.c)
+MIN_FREQ = 10.0
+MAX_FREQ = 10000.0
+# Seconds between each time Robot.run_periodic() logs the timing of its loop
+PERIODIC_STATS_INTERVAL = 1.0
+# Maximum number of samples that the history of a Robot.device_view() keeps
+MAX_VIEW_HISTORY = 10000
 
 ######################### Logging #########################
 
@@ -59,12 +83,212 @@ def _init():
     logger_init(EXECUTOR)
     shm_init()
 
+###################### Student Code Loading ######################
+
+# Number of imports that took the longest (not including their own imports) that are logged along with the total
+IMPORT_TIME_LOG_SLOWEST = 5
+# Imports that took at least this many seconds (including their own imports) are logged at the DEBUG level
+IMPORT_TIME_LOG_MIN = 0.001
+
+def _compile_student_code(str module_name):
+    """Compiles the student code to a cached .pyc file if the cached one wasn't compiled from the same source.
+
+    The .pyc is hash-based (PEP 552): it holds a hash of the source it was compiled from, which is checked
+    instead of the file's modification time. Uploaded code is compiled once, however often it is imported, and a new
+    upload is never mistaken for the old one even if it has the same size and modification time.
+    The source is read and hashed only once: the code returned is the one that was checked against it (or just
+    compiled from it), so that _import_student_code() doesn't have the import check the hash again.
+
+    Args:
+        module_name: name of the student code module
+    Returns:
+        (code, path, compiled): the student code's code object, or None if the source can't be found or doesn't compile
+        (importing it then raises the SyntaxError); the path of the source; and whether it was compiled, instead of
+        loaded from the cache
+    """
+    spec = importlib.util.find_spec(module_name)
+    if spec is None or spec.origin is None or not spec.origin.endswith('.py'):
+        return None, None, False
+    cfile = importlib.util.cache_from_source(spec.origin)
+    with open(spec.origin, 'rb') as f:
+        source = f.read()
+    source_hash = importlib.util.source_hash(source)
+    # magic number, flags (0b11: hash-based, checked against the source), then the source hash
+    header = importlib.util.MAGIC_NUMBER + b'\x03\x00\x00\x00' + source_hash
+    try:
+        with open(cfile, 'rb') as f:
+            data = f.read()
+        if data[:16] == header:
+            return marshal.loads(data[16:]), spec.origin, False
+    except (OSError, EOFError, ValueError, TypeError):
+        pass  # not cached yet, or the cache is corrupt
+    try:
+        code = compile(source, spec.origin, 'exec', dont_inherit=True)
+    except SyntaxError:
+        return None, spec.origin, False
+    try:
+        os.makedirs(os.path.dirname(cfile), exist_ok=True)
+        with open(cfile + '.tmp', 'wb') as f:
+            f.write(header + marshal.dumps(code))
+        os.replace(cfile + '.tmp', cfile)  # so that the cache is never seen half-written
+    except OSError as e:
+        _print(f"Couldn't cache compiled student code, so it is compiled on every import: {e}", level=WARN)
+    return code, spec.origin, True
+
+
+class _CompiledCodeFinder:
+    """A meta path finder that has the student code module loaded from a code object that was already checked against
+    its source, instead of having the import read and hash the source again. Everything else about the module
+    (__file__, __cached__, tracebacks) is the same as with a regular import.
+    """
+
+    class Loader(importlib.machinery.SourceFileLoader):
+        def __init__(self, fullname, path, code):
+            super().__init__(fullname, path)
+            self.code = code
+
+        def get_code(self, fullname):
+            return self.code
+
+    def __init__(self, module_name, path, code):
+        self.module_name = module_name
+        self.path = path
+        self.code = code
+
+    def find_spec(self, fullname, path=None, target=None):
+        if fullname != self.module_name:
+            return None
+        return importlib.util.spec_from_file_location(fullname, self.path, loader=self.Loader(fullname, self.path, self.code))
+
+
+class _ImportTimer:
+    """Wraps the builtin __import__ to time every module imported, like `python -X importtime`.
+
+    The time of an import includes the imports it makes (cumulative); its self time doesn't.
+    Modules that were already imported aren't timed, since importing them again does nothing.
+    """
+
+    def __init__(self):
+        self.times = []  # (module name, depth, self time, cumulative time) of each import, in the order they finished
+        self.children = []  # for each import in progress, the cumulative time of the imports it made so far
+        self.real_import = builtins.__import__
+
+    def __call__(self, name, globals=None, locals=None, fromlist=(), level=0):
+        if level == 0 and name in sys.modules:
+            return self.real_import(name, globals, locals, fromlist, level)
+        start = time.perf_counter()
+        self.children.append(0.0)
+        try:
+            return self.real_import(name, globals, locals, fromlist, level)
+        finally:
+            cumulative = time.perf_counter() - start
+            children = self.children.pop()
+            self.times.append(('.' * level + name, len(self.children), cumulative - children, cumulative))
+            if self.children:
+                self.children[-1] += cumulative
+
+
+def _import_student_code(str module_name):
+    """Imports the student code from its cached compiled code (see _compile_student_code()), and logs how long
+    importing it took along with the IMPORT_TIME_LOG_SLOWEST slowest imports. Every import that took at least
+    IMPORT_TIME_LOG_MIN seconds is also logged at the DEBUG level, nested by what imported it.
+
+    Args:
+        module_name: name of the student code module
+    Returns:
+        the student code module
+    """
+    start = time.perf_counter()
+    code, path, compiled = _compile_student_code(module_name)
+    compile_time = time.perf_counter() - start
+
+    timer = _ImportTimer()
+    finder = _CompiledCodeFinder(module_name, path, code)
+    if code is not None:
+        sys.meta_path.insert(0, finder)
+    builtins.__import__ = timer
+    try:
+        timer(module_name)  # Without a code object, this raises the SyntaxError, which is printed like any other import error
+    finally:
+        builtins.__import__ = timer.real_import
+        if code is not None:
+            sys.meta_path.remove(finder)
+    module = sys.modules[module_name]
+
+    total = time.perf_counter() - start
+    _print(f"Imported {module_name} in {total * 1000:.1f} ms" + (f" (compiling it took {compile_time * 1000:.1f} ms)" if compiled else ""), level=INFO)
+    for name, depth, self_time, cumulative in sorted(timer.times, key=lambda t: t[2], reverse=True)[:IMPORT_TIME_LOG_SLOWEST]:
+        _print(f"slowest import: {self_time * 1000:8.1f} ms self | {cumulative * 1000:8.1f} ms cumulative | {name}", level=INFO)
+    for name, depth, self_time, cumulative in timer.times:
+        if cumulative >= IMPORT_TIME_LOG_MIN:
+            _print(f"import time: {self_time * 1000:8.1f} ms self | {cumulative * 1000:8.1f} ms cumulative | {'  ' * depth}{name}", level=DEBUG)
+    return module
+
 ########################### API Objects ###########################
 
 class DeviceError(Exception):
     """An exception caused by using an invalid device. """
 
 
+cdef dict _name_indices(char** names, int num_names):
+    """Returns a dict from each name to its index in the array NAMES. """
+    return {names[i].decode('utf-8'): i for i in range(num_names)}
+
+# Bit of each gamepad button and keyboard key in input_t.buttons, and index of each joystick in input_t.joysticks
+cdef dict GAMEPAD_BUTTONS = _name_indices(get_button_names(), NUM_GAMEPAD_BUTTONS)
+cdef dict GAMEPAD_JOYSTICKS = _name_indices(get_joystick_names(), 4)
+cdef dict KEYBOARD_KEYS = _name_indices(get_key_names(), NUM_KEYBOARD_BUTTONS)
+
+
+cdef class InputSnapshot:
+    """
+    The state of the gamepad or keyboard at one moment, from Gamepad.snapshot() or Keyboard.snapshot().
+    It doesn't change, so the inputs read from it are consistent with each other.
+
+    Attributes:
+        connected: Whether the gamepad or keyboard was connected. If it wasn't, no buttons are pressed and the joysticks are at 0.
+    """
+    cdef uint64_t buttons
+    cdef float joysticks[4]
+    cdef readonly bint connected
+    cdef dict button_bits
+    cdef dict joystick_indices
+    cdef str source
+
+    @staticmethod
+    cdef InputSnapshot read(robot_desc_field_t source):
+        """Returns a snapshot of the gamepad or keyboard, read from shared memory with a single input_read(). """
+        cdef InputSnapshot snapshot = InputSnapshot.__new__(InputSnapshot)
+        cdef int err
+        with nogil:
+            err = input_read(&snapshot.buttons, snapshot.joysticks, source)
+        snapshot.connected = (err != -1)
+        if source == GAMEPAD:
+            snapshot.button_bits = GAMEPAD_BUTTONS
+            snapshot.joystick_indices = GAMEPAD_JOYSTICKS
+            snapshot.source = 'gamepad'
+        else:
+            snapshot.button_bits = KEYBOARD_KEYS
+            snapshot.joystick_indices = {}
+            snapshot.source = 'keyboard'
+        return snapshot
+
+    cpdef get_value(self, str param_name):
+        """
+        Get whether a button or key was pressed, or the position of a joystick.
+
+        Args:
+            param_name: The name of the button, key, or joystick. Possible values are at https://pioneers.berkeley.edu/software/robot_api.html
+        """
+        bit = self.button_bits.get(param_name)
+        if bit is not None:
+            return self.connected and (self.buttons >> <int> bit) & 1 == 1
+        idx = self.joystick_indices.get(param_name)
+        if idx is not None:
+            return self.joysticks[<int> idx] if self.connected else 0.0
+        raise KeyError(f"Invalid {self.source} parameter {param_name}")
+
+
 cdef class Gamepad:
     """
     The API for accessing gamepads.
@@ -76,7 +300,17 @@ cdef class Gamepad:
 
     def __cinit__(self):
         """Initializes the mode of the robot. """
-        self.available = (robot_desc_read(RUN_MODE) == TELEOP)
+        with nogil:
+            self.available = (robot_desc_read(RUN_MODE) == TELEOP)
+
+
+    cpdef InputSnapshot snapshot(self):
+        """
+        Get the state of the gamepad if the robot is in teleop, to read several inputs that were pressed at the same time.
+        """
+        if not self.available:
+            raise NotImplementedError(f'Can only use Gamepad during teleop mode')
+        return InputSnapshot.read(GAMEPAD)
 
 
     cpdef get_value(self, str param_name):
@@ -86,25 +320,7 @@ cdef class Gamepad:
         Args:
             param: The name of the parameter to read. Possible values are at https://pioneers.berkeley.edu/software/robot_api.html 
         """
-        if not self.available:
-            raise NotImplementedError(f'Can only use Gamepad during teleop mode')
-        # Convert Python string to C string
-        cdef bytes param = param_name.encode('utf-8')
-        cdef uint64_t buttons
-        cdef float joysticks[4]
-        cdef int err = input_read(&buttons, joysticks, GAMEPAD)
-        gamepad_connected = (err != -1)
-        cdef char** button_names = get_button_names()
-        cdef char** joystick_names = get_joystick_names()
-        # Check if param is button
-        for i in range(NUM_GAMEPAD_BUTTONS):
-            if param == button_names[i]:
-                return bool(buttons & (1 << i)) if gamepad_connected else False
-        # Check if param is joystick
-        for i in range(4):
-            if param == joystick_names[i]:
-                return joysticks[i] if gamepad_connected else 0.0
-        raise KeyError(f"Invalid gamepad parameter {param_name}")
+        return self.snapshot().get_value(param_name)
 
 
 cdef class Keyboard:
@@ -115,7 +331,16 @@ cdef class Keyboard:
 
     def __cinit__(self):
         """Initializes the mode of the robot. """
-        self.available = (robot_desc_read(RUN_MODE) == TELEOP)
+        with nogil:
+            self.available = (robot_desc_read(RUN_MODE) == TELEOP)
+
+    cpdef InputSnapshot snapshot(self):
+        """
+        Get the state of the keyboard if the robot is in teleop, to read several keys that were pressed at the same time.
+        """
+        if not self.available:
+            raise NotImplementedError(f'Can only use Keyboard during teleop mode')
+        return InputSnapshot.read(KEYBOARD)
 
     cpdef get_value(self, str param_name):
         """
@@ -124,38 +349,436 @@ cdef class Keyboard:
         Args:
             param: the name of the parameter to read. TODO: Add link to possible params
         """
-        if not self.available:
-            raise NotImplementedError(f'Can only use Keyboard during teleop mode')
-        # Convert Python string to C string
+        cdef InputSnapshot snapshot = self.snapshot()
+        if not snapshot.connected:
+            return False
+        return snapshot.get_value(param_name)
+
+
+########################### Periodic Loops ###########################
+
+cdef int64_t _monotonic_ns() noexcept nogil:
+    """Returns the time of the monotonic clock in nanoseconds. """
+    cdef timespec now
+    clock_gettime(CLOCK_MONOTONIC, &now)
+    return <int64_t> now.tv_sec * 1000000000 + now.tv_nsec
+
+
+cdef void _sleep_until(int64_t deadline) noexcept nogil:
+    """Sleeps until the monotonic clock reaches DEADLINE (in nanoseconds), which doesn't drift like sleeping for a duration. """
+    cdef timespec until
+    until.tv_sec = deadline // 1000000000
+    until.tv_nsec = deadline % 1000000000
+    while clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) != 0:
+        pass  # interrupted by a signal
+
+
+def _percentile(list values, int percent):
+    """Returns a percentile of a non-empty sorted list (nearest rank). """
+    return values[max(0, (len(values) * percent + 99) // 100 - 1)]
+
+
+########################### Action Threads ###########################
+
+class _ActionPool:
+    """
+    The threads that plain (not `async def`) actions run on. A thread is kept once started and waits for the next
+    action, so starting an action doesn't start a thread unless every thread is busy, up to MAX_THREADS of them.
+    """
+
+    def __init__(self, error_event):
+        self.error_event = error_event
+        self.queue = queue.SimpleQueue()
+        self.lock = threading.Lock()
+        self.num_threads = 0
+        self.num_idle = 0
+
+    def submit(self, action, args, kwargs):
+        """Runs `action` on an idle thread. Returns a Future that is done when it returns, or None if all MAX_THREADS are busy. """
+        with self.lock:
+            if self.num_idle == 0:
+                if self.num_threads >= MAX_THREADS:
+                    return None
+                threading.Thread(target=self._work, daemon=True).start()
+                self.num_threads += 1
+            else:
+                self.num_idle -= 1
+        future = Future()
+        self.queue.put((future, action, args, kwargs))
+        return future
+
+    def _work(self):
+        while True:
+            future, action, args, kwargs = self.queue.get()
+            try:
+                action(*args, **kwargs)
+            except Exception as e:
+                traceback.print_exc(file=sys.stderr)
+                self.error_event.set()
+            except BaseException as e:
+                # e.g. sys.exit() in the action, which ends this thread
+                with self.lock:
+                    self.num_threads -= 1
+                future.set_exception(e)
+                raise
+            # idle before the action is done, so an action started as soon as it is done can reuse this thread
+            with self.lock:
+                self.num_idle += 1
+            future.set_result(None)
+
+
+class _Sleep:
+    """The awaitable that `Robot.sleep()` returns in an `async def` action. It logs an error if it is dropped without being awaited, since it then doesn't sleep. """
+
+    def __init__(self, timeout):
+        self.timeout = timeout
+        self.awaited = False
+
+    def __await__(self):
+        self.awaited = True
+        return asyncio.sleep(self.timeout).__await__()
+
+    def __del__(self):
+        if not self.awaited:
+            _print(f"Robot.sleep({self.timeout}) was called without await in an async def action, so it didn't sleep. Use `await Robot.sleep({self.timeout})` instead.", level=ERROR)
+
+
+async def _run_action(action, error_event, args, kwargs):
+    """Runs an `async def` action on the event loop, setting `error_event` if it fails. """
+    try:
+        await action(*args, **kwargs)
+    except asyncio.CancelledError:
+        raise
+    except Exception as e:
+        traceback.print_exc(file=sys.stderr)
+        error_event.set()
+
+
+async def _cancel_tasks(double timeout):
+    """Cancels every other task on the event loop, and waits up to `timeout` seconds for them to finish. """
+    tasks = [task for task in asyncio.all_tasks() if task is not asyncio.current_task()]
+    for task in tasks:
+        task.cancel()
+    if tasks:
+        await asyncio.wait(tasks, timeout=timeout)
+
+
+def _cancel_actions_on_exit(robot):
+    """
+    Makes SIGTERM cancel the `async def` actions of `robot`, giving them ACTION_CANCEL_TIMEOUT seconds to finish, then
+    exit. Python runs the handler on the main thread between bytecodes, so it is free to call into the interpreter.
+    Must be called on the main thread.
+    """
+    def handler(signum, frame):
+        robot._cancel_actions(ACTION_CANCEL_TIMEOUT)
+        exit(0)
+    signal.signal(signal.SIGTERM, handler)
+
+
+cdef class Device:
+    """
+    A handle to a device, from Robot.device(). Parses the device id once, and
+    remembers where the device is in shared memory between calls.
+    """
+    cdef readonly str device_id
+    cdef int device_type
+    cdef uint64_t device_uid
+    cdef device_t* desc
+    cdef int dev_ix  # index of the device in shared memory when it was last found, or -1
+    cdef dict params
+
+    def __cinit__(self, str device_id):
+        splits = device_id.split('_')
+        if len(splits) != 2:
+            raise ValueError(f"First argument device_id must be of the form <device_type>_<device_uid>")
+        self.device_id = device_id
+        self.device_type = int(splits[0])
+        self.device_uid = int(splits[1])
+        self.desc = get_device(self.device_type)
+        if not self.desc:
+            raise DeviceError(f"Device with uid {self.device_uid} has invalid type {self.device_type}")
+        self.dev_ix = -1
+        self.params = {}
+
+    cpdef Param param(self, str param_name):
+        """
+        Get a handle to a parameter of this device, which can be read and written without looking it up again.
+
+        Args:
+            param_name: Name of the param. List of possible values are at https://pioneers.berkeley.edu/software/robot_api.html
+        """
+        handle = self.params.get(param_name)
+        if handle is None:
+            handle = Param(self, param_name)
+            self.params[param_name] = handle
+        return handle
+
+    cdef int find(self) except -1:
+        """Returns the index of the device in shared memory, raising a DeviceError if it isn't connected. """
+        self.dev_ix = get_dev_ix_from_uid_cached(self.device_uid, self.dev_ix)
+        if self.dev_ix == -1:
+            raise self.disconnected()
+        return self.dev_ix
+
+    cdef disconnected(self):
+        """Returns the DeviceError for using the device while it isn't connected, forgetting where it was. """
+        self.dev_ix = -1
+        return DeviceError(f"Device with type {self.desc.name.decode('utf-8')}({self.device_type}) and uid {self.device_uid} isn't connected to the robot")
+
+
+cdef class Param:
+    """
+    A handle to a parameter of a device, from Device.param(). Reads and writes
+    go straight to the parameter's slot in shared memory.
+    """
+    cdef readonly Device device
+    cdef readonly str name
+    cdef int8_t idx
+    cdef param_type_t type
+    cdef bint kill  # whether the param is held at 0 while the robot is emergency stopped
+
+    def __cinit__(self, Device device, str param_name):
         cdef bytes param = param_name.encode('utf-8')
-        cdef uint64_t buttons
-        cdef float joysticks[4]
-        cdef int err = input_read(&buttons, joysticks, KEYBOARD)
+        self.device = device
+        self.name = param_name
+        self.idx = -1
+        for i in range(device.desc.num_params):
+            if device.desc.params[i].name == param:
+                self.idx = i
+                self.type = device.desc.params[i].type
+                break
+        if self.idx == -1:
+            raise DeviceError(f"Invalid device parameter {param_name} for device type {device.desc.name.decode('utf-8')}({device.device_type})")
+        self.kill = is_param_to_kill(device.device_type, param)
+
+    cpdef get(self):
+        """Get the value of the parameter. """
+        cdef param_val_t param_value[MAX_PARAMS]
+        cdef int dev_ix = self.device.find()
+        cdef int err
+        with nogil:
+            err = device_read(dev_ix, EXECUTOR, DATA, 1 << self.idx, param_value)
+        if err == -1:
+            raise self.device.disconnected()
+        return self.load(param_value)
+
+    cpdef void set(self, value) except *:
+        """
+        Set the value of the parameter.
+
+        Args:
+            value: Value to set for the param. The type of the value can be seen at https://pioneers.berkeley.edu/software/robot_api.html
+        """
+        if self.kill and _emergency_stopped():
+            value = 0
+        cdef param_val_t param_value[MAX_PARAMS]
+        self.store(param_value, value)
+        cdef uint8_t dev_type = self.device.device_type
+        cdef int dev_ix = self.device.find()
+        cdef int err
+        with nogil:
+            err = filter_device_write(dev_type, dev_ix, EXECUTOR, COMMAND, 1 << self.idx, param_value)
+        if err == -1:
+            raise self.device.disconnected()
+
+    cdef load(self, param_val_t* param_value):
+        """Returns the value of the parameter in a buffer read from its device. """
+        if self.type == INT:
+            return param_value[self.idx].p_i
+        elif self.type == FLOAT:
+            return param_value[self.idx].p_f
+        return bool(param_value[self.idx].p_b)
+
+    cdef int store(self, param_val_t* param_value, value) except -1:
+        """Puts a value of the parameter in a buffer to write to its device. """
+        if self.type == INT:
+            param_value[self.idx].p_i = value
+        elif self.type == FLOAT:
+            param_value[self.idx].p_f = value
+        elif self.type == BOOL:
+            param_value[self.idx].p_b = int(value)
+        return 0
+
+
+cdef class DeviceView:
+    """
+    The readable params of a device as an array of doubles, from Robot.device_view(), which supports the buffer
+    protocol: `numpy.frombuffer(view)` makes an array that shares the view's memory, so it has the latest values
+    after every refresh() without being made again. Each refresh() reads all the params with a single wait on the
+    device's data semaphore, so the values are always from the same moment. Ints and bools are converted to doubles.
+
+    Attributes:
+        names: The names of the params, in the order of the array
+        history: The ParamHistory of the values, or None if the view was made without one
+    """
+    cdef Device device
+    cdef readonly tuple names
+    cdef readonly ParamHistory history
+    cdef int num_params
+    cdef uint32_t params_to_read
+    cdef int8_t idx[MAX_PARAMS]  # index in the device of each param in the array
+    cdef param_type_t types[MAX_PARAMS]
+    cdef double values[MAX_PARAMS]
+    cdef Py_ssize_t shape[1]
+    cdef Py_ssize_t strides[1]
+    cdef int dev_ix  # index of the device in shared memory when values were last read, or -1
+    cdef uint32_t gen  # generation of the device's DATA values when they were last read
+
+    def __cinit__(self, Device device, int history):
+        self.device = device
+        names = []
+        self.num_params = 0
+        self.params_to_read = 0
+        for i in range(device.desc.num_params):
+            if device.desc.params[i].read:
+                names.append(device.desc.params[i].name.decode('utf-8'))
+                self.idx[self.num_params] = i
+                self.types[self.num_params] = device.desc.params[i].type
+                self.values[self.num_params] = NAN
+                self.params_to_read |= 1 << i
+                self.num_params += 1
+        self.names = tuple(names)
+        self.history = ParamHistory(history, self.num_params) if history > 0 else None
+        self.shape[0] = self.num_params
+        self.strides[0] = sizeof(double)
+        self.dev_ix = -1
+
+    cpdef bint refresh(self) except -1:
+        """
+        Read the latest values of the params into the array. Returns whether they changed since the last refresh,
+        in which case they are also added to the history.
+        """
+        cdef param_val_t param_value[MAX_PARAMS]
+        cdef uint32_t gen
+        cdef int dev_ix = self.device.find()
+        cdef int err
+        with nogil:
+            err = device_read_gen(dev_ix, self.params_to_read, param_value, &gen)
         if err == -1:
+            raise self.device.disconnected()
+        if dev_ix == self.dev_ix and gen == self.gen:
             return False
-        cdef char** key_names = get_key_names()
-        for i in range(NUM_KEYBOARD_BUTTONS):
-            if param == key_names[i]:
-                return bool(buttons & (1 << i))
-        raise KeyError(f"Invalid keyboard parameter {param_name}")
+        self.dev_ix = dev_ix
+        self.gen = gen
+        cdef int i
+        for i in range(self.num_params):
+            if self.types[i] == INT:
+                self.values[i] = param_value[self.idx[i]].p_i
+            elif self.types[i] == FLOAT:
+                self.values[i] = param_value[self.idx[i]].p_f
+            else:
+                self.values[i] = param_value[self.idx[i]].p_b
+        if self.history is not None:
+            self.history.append(self.values)
+        return True
 
+    def __len__(self):
+        return self.num_params
 
-class ThreadWrapper(threading.Thread):
+    def __getbuffer__(self, Py_buffer* buffer, int flags):
+        if flags & PyBUF_WRITABLE:
+            raise BufferError("A DeviceView is read-only; use Robot.set_value() to set params")
+        buffer.buf = self.values
+        buffer.obj = self
+        buffer.len = self.num_params * sizeof(double)
+        buffer.readonly = 1
+        buffer.itemsize = sizeof(double)
+        buffer.format = 'd'
+        buffer.ndim = 1
+        buffer.shape = self.shape
+        buffer.strides = self.strides
+        buffer.suboffsets = NULL
+        buffer.internal = NULL
 
-    def __init__(self, action, error_event, args, kwargs):
-        super().__init__()
-        self.action = action
-        self.error_event = error_event
-        self.args = args
-        self.kwargs = kwargs
 
-    def run(self):
-        try:
-            self.action(*self.args, **self.kwargs)
-        except Exception as e:
-            traceback.print_exc(file=sys.stderr)
-            self.error_event.set()
-            
+cdef class ParamHistory:
+    """
+    The values of a DeviceView's params at its last refreshes that changed them, as a 2D array of doubles that supports
+    the buffer protocol: one row per sample, oldest first, so the latest is the last row.
+    Until the history is full, the rows before the first sample are NaN.
+
+    The samples are kept in a ring, so recording one only writes its row. Unlike the view, the buffer is a copy of
+    the history in order, made when it is requested, so it has to be requested again to see later samples.
+
+    Attributes:
+        samples: The number of samples recorded, up to the number of rows
+    """
+    cdef double* rows
+    cdef readonly int samples
+    cdef int head  # row that the next sample is written to, which holds the oldest sample once the history is full
+    cdef int capacity
+    cdef int num_params
+    cdef Py_ssize_t shape[2]
+    cdef Py_ssize_t strides[2]
+
+    def __cinit__(self, int capacity, int num_params):
+        if capacity > MAX_VIEW_HISTORY:
+            raise ValueError(f"Cannot keep a history of more than {MAX_VIEW_HISTORY} samples")
+        self.capacity = capacity
+        self.num_params = num_params
+        self.samples = 0
+        self.head = 0
+        self.rows = <double*> PyMem_Malloc(max(1, capacity * num_params) * sizeof(double))
+        if self.rows == NULL:
+            raise MemoryError()
+        for i in range(capacity * num_params):
+            self.rows[i] = NAN
+        self.shape[0] = capacity
+        self.shape[1] = num_params
+        self.strides[0] = num_params * sizeof(double)
+        self.strides[1] = sizeof(double)
+
+    def __dealloc__(self):
+        PyMem_Free(self.rows)
+
+    cdef void append(self, double* values) noexcept:
+        """Records a sample over the oldest one. """
+        memcpy(self.rows + self.head * self.num_params, values, self.num_params * sizeof(double))
+        self.head = (self.head + 1) % self.capacity
+        if self.samples < self.capacity:
+            self.samples += 1
+
+    def __len__(self):
+        return self.capacity
+
+    def __getbuffer__(self, Py_buffer* buffer, int flags):
+        if flags & PyBUF_WRITABLE:
+            raise BufferError("A ParamHistory is read-only")
+        # linearize the ring into a copy, oldest first
+        cdef size_t older = (self.capacity - self.head) * self.num_params
+        cdef double* rows = <double*> PyMem_Malloc(max(1, self.capacity * self.num_params) * sizeof(double))
+        if rows == NULL:
+            raise MemoryError()
+        memcpy(rows, self.rows + self.head * self.num_params, older * sizeof(double))
+        memcpy(rows + older, self.rows, self.head * self.num_params * sizeof(double))
+        buffer.buf = rows
+        buffer.obj = self
+        buffer.len = self.capacity * self.num_params * sizeof(double)
+        buffer.readonly = 1
+        buffer.itemsize = sizeof(double)
+        buffer.format = 'd'
+        buffer.ndim = 2
+        buffer.shape = self.shape
+        buffer.strides = self.strides
+        buffer.suboffsets = NULL
+        buffer.internal = rows
+
+    def __releasebuffer__(self, Py_buffer* buffer):
+        PyMem_Free(buffer.internal)
+
+
+cdef bint _emergency_stopped():
+    """
+    EDGE CASE: If it's TELEOP but no UserInput is connected, robot is emergency stopped
+    There are certain parameters that need to remain 0
+    """
+    cdef bint stopped
+    with nogil:
+        stopped = robot_desc_read(RUN_MODE) == TELEOP \
+            and robot_desc_read(GAMEPAD) == DISCONNECTED \
+            and robot_desc_read(KEYBOARD) == DISCONNECTED
+    return stopped
+
 
 cdef class Robot:
     """
@@ -166,19 +789,32 @@ cdef class Robot:
     cdef public error_event
     cdef public sleep_event
     cdef int64_t main_thread
+    cdef object pool  # _ActionPool that plain actions run on
+    cdef object loop  # event loop that `async def` actions run on, or None until one is run
+    cdef int64_t loop_thread
+    cdef object devices  # OrderedDict of the device handles used by get_value() and the like, least recently used first
 
 
     def __cinit__(self):
         """Initializes the dict of running threads. """
         self.running_actions = {}
-        self.start_pos = 'left' if robot_desc_read(START_POS) == LEFT else 'right'
+        cdef robot_desc_val_t start_pos
+        with nogil:
+            start_pos = robot_desc_read(START_POS)
+        self.start_pos = 'left' if start_pos == LEFT else 'right'
         self.error_event = threading.Event() # Is set when error occurs in an action thread
         self.sleep_event = threading.Event() # Is set when the main thread is cancelled during sleeping
         self.main_thread = threading.get_ident()
+        self.pool = _ActionPool(self.error_event)
+        self.loop = None
+        self.loop_thread = 0
+        self.devices = OrderedDict()
 
 
     def run(self, action, *args, **kwargs) -> None:
-        """ Schedule an action for execution in a separate thread. Uses Python threading module.
+        """ Schedule an action for execution. An `async def` action is run as a task on the event loop that all of them share,
+        so it must `await` (e.g. `await Robot.sleep()`) to let the others run. Any other action is run on a thread of its own,
+        which is reused for later actions once it returns.
         
         Args:
             action: Python function to run
@@ -188,30 +824,117 @@ cdef class Robot:
         if self.is_running(action):
             _print(f"Calling action {action.__name__} when it is still running won't do anything. Use Robot.is_running to check if action is over.", level=ERROR)
             return
-        if threading.active_count() > MAX_THREADS:
-            _print(f"Number of Python threads {threading.active_count()} exceeds the limit {MAX_THREADS} so action won't be scheduled. Make sure your actions are returning properly.", level=ERROR)
-            return
-        thread = ThreadWrapper(action, self.error_event, args, kwargs)
-        thread.daemon = True
-        self.running_actions[action.__name__] = thread
-        thread.start()
+        if inspect.iscoroutinefunction(action):
+            coro = _run_action(action, self.error_event, args, kwargs)
+            if self.loop_thread != 0 and threading.get_ident() == self.loop_thread:
+                future = self.loop.create_task(coro)  # run from another async action, so the loop doesn't need waking up
+            else:
+                future = asyncio.run_coroutine_threadsafe(coro, self.event_loop())
+        else:
+            future = self.pool.submit(action, args, kwargs)
+            if future is None:
+                _print(f"{MAX_THREADS} actions are already running so action {action.__name__} won't be scheduled. Make sure your actions are returning properly, or make them async def.", level=ERROR)
+                return
+        self.running_actions[action.__name__] = future
         
 
     def is_running(self, action) -> bool:
-        """Returns whether the given function `action` is running in a different thread.
+        """Returns whether the given function `action` is running as an action.
         
         Args:
             action: Python function to check
         """
-        thread = self.running_actions.get(action.__name__, None)
-        if thread:
-            return thread.is_alive()
+        future = self.running_actions.get(action.__name__, None)
+        if future:
+            return not future.done()
         return False
 
 
-    cpdef void sleep(self, float timeout) except *:
-        """Make the current thread inactive for `timeout` seconds."""
-        if threading.current_thread().ident == self.main_thread:
+    cdef event_loop(self):
+        """Returns the event loop that `async def` actions run on, starting it the first time. """
+        if self.loop is None:
+            self.loop = asyncio.new_event_loop()
+            started = threading.Event()
+            def run_loop():
+                asyncio.set_event_loop(self.loop)
+                self.loop_thread = threading.get_ident()
+                started.set()
+                self.loop.run_forever()
+            threading.Thread(target=run_loop, daemon=True).start()
+            started.wait()
+        return self.loop
+
+
+    def _cancel_actions(self, double timeout) -> None:
+        """Cancels the `async def` actions, and waits up to `timeout` seconds for them to finish. Called when the mode ends. """
+        if self.loop is None:
+            return
+        try:
+            asyncio.run_coroutine_threadsafe(_cancel_tasks(timeout), self.loop).result(2 * timeout)
+        except Exception as e:
+            pass
+
+
+    def run_periodic(self, action, double hz, *args, **kwargs) -> None:
+        """
+        Call `action` `hz` times per second, until it returns False or an action fails. Each call starts at a fixed
+        deadline, so the rate doesn't drift like calling `Robot.sleep` in a loop, and the time between calls is left to
+        the rest of the robot. A call that takes longer than the period is an overrun: the deadlines it missed are skipped.
+
+        Every PERIODIC_STATS_INTERVAL seconds, the timing of the loop is logged with `Robot.log`, under keys that start with
+        the name of `action`: `_overruns` (the number of calls that overran so far), `_jitter_p99_us` (how late calls started
+        after their deadlines), and `_exec_p50_us` and `_exec_p99_us` (how long the calls took), in microseconds.
+
+        Args:
+            action: Python function to call
+            hz: number of times per second to call it, from MIN_FREQ to MAX_FREQ
+            args: arguments for the Python function
+            kwargs: keyword arguments for the Python function
+        """
+        if hz < MIN_FREQ or hz > MAX_FREQ:
+            raise ValueError(f"Cannot run {action.__name__} {hz} times per second; the rate must be from {MIN_FREQ} to {MAX_FREQ}")
+        cdef int64_t period = <int64_t> (1e9 / hz)
+        cdef int64_t stats_interval = <int64_t> (PERIODIC_STATS_INTERVAL * 1e9)
+        cdef int64_t deadline = _monotonic_ns()
+        cdef int64_t next_stats = deadline + stats_interval
+        cdef int64_t start, end
+        cdef int overruns = 0
+        cdef list jitters = []
+        cdef list exec_times = []
+        name = action.__name__[:LOG_KEY_LENGTH - 1 - len("_jitter_p99_us")]
+        while not self.error_event.is_set():
+            with nogil:
+                _sleep_until(deadline)
+            start = _monotonic_ns()
+            if action(*args, **kwargs) is False:
+                break
+            end = _monotonic_ns()
+            jitters.append((start - deadline) // 1000)
+            exec_times.append((end - start) // 1000)
+
+            deadline += period
+            if end > deadline:
+                overruns += 1
+                deadline += ((end - deadline) // period + 1) * period
+
+            if end >= next_stats:
+                jitters.sort()
+                exec_times.sort()
+                self.log(f"{name}_overruns", overruns)
+                self.log(f"{name}_jitter_p99_us", _percentile(jitters, 99))
+                self.log(f"{name}_exec_p50_us", _percentile(exec_times, 50))
+                self.log(f"{name}_exec_p99_us", _percentile(exec_times, 99))
+                jitters = []
+                exec_times = []
+                next_stats = end + stats_interval
+
+
+    def sleep(self, float timeout):
+        """Make the current thread inactive for `timeout` seconds. In an `async def` action, returns an awaitable
+        instead, which has to be awaited: `await Robot.sleep(timeout)`. An error is logged if it isn't."""
+        if self.loop_thread != 0 and threading.get_ident() == self.loop_thread:
+            return _Sleep(timeout)
+        if threading.get_ident() == self.main_thread:
             self.sleep_event.wait(timeout)
         else: # For action threads
             time.sleep(timeout)
@@ -243,7 +966,10 @@ cdef class Robot:
         else:
             raise ValueError(f"Cannot log parameter {key} with type {type(value).__name__} since it's not an int, float, or bool.")
 
-        cdef int err = log_data_write(key_bytes, param_type, param)
+        cdef char* key_str = key_bytes
+        cdef int err
+        with nogil:
+            err = log_data_write(key_str, param_type, param)
         if err == -1:
             raise IndexError(f"Maximum number of 255 log data keys reached. can't add key {key}")
         elif err == -2:
@@ -251,6 +977,45 @@ cdef class Robot:
         
 
 
+    cpdef Device device(self, str device_id):
+        """
+        Get a handle to a device, whose params can be read and written without parsing device_id and looking them up every time.
+        For example, `motor = Robot.device("6_1234").param("velocity_a")` then `motor.set(0.5)` and `motor.get()`.
+
+        Args:
+            device_id: string of the format '{device_type}_{device_uid}' where device_type is LowCar device ID and device_uid is 64-bit UID assigned by LowCar.
+        """
+        return Device(device_id)
+
+
+    def device_view(self, str device_id, int history=0) -> DeviceView:
+        """
+        Get the readable params of a device as an array, for reading many of them at once with NumPy: `view = Robot.device_view(device_id)`
+        and `values = numpy.frombuffer(view)` once, then `view.refresh()` whenever `values` should be updated. `view.names` has the
+        names of the params in the array.
+
+        Args:
+            device_id: string of the format '{device_type}_{device_uid}' where device_type is LowCar device ID and device_uid is 64-bit UID assigned by LowCar.
+            history: Number of samples to also keep in `view.history`, a 2D array with a row for each refresh that changed the values.
+        """
+        if history < 0:
+            raise ValueError(f"Cannot keep a history of {history} samples")
+        return DeviceView(Device(device_id), history)
+
+
+    cdef Device cached_device(self, str device_id):
+        """Returns the handle to a device, resolving it only if it isn't one of the HANDLE_CACHE_SIZE most recently used. """
+        device = self.devices.get(device_id)
+        if device is None:
+            device = Device(device_id)
+            self.devices[device_id] = device
+            if len(self.devices) > HANDLE_CACHE_SIZE:
+                self.devices.popitem(last=False)
+        else:
+            self.devices.move_to_end(device_id)
+        return device
+
+
     cpdef get_value(self, str device_id, str param_name):
         """ 
         Get a device value. 
@@ -259,49 +1024,7 @@ cdef class Robot:
             device_id: string of the format '{device_type}_{device_uid}' where device_type is LowCar device ID and device_uid is 64-bit UID assigned by LowCar.
             param_name: Name of param to get. List of possible values are at https://pioneers.berkeley.edu/software/robot_api.html
         """
-        # Convert Python string to C string
-        cdef bytes param = param_name.encode('utf-8')
-
-        # Getting device identification info
-        splits = device_id.split('_')
-        if len(splits) != 2:
-            raise ValueError(f"First argument device_id must be of the form <device_type>_<device_uid>")
-        cdef int device_type = int(splits[0])
-        cdef uint64_t device_uid = int(splits[1])
-        
-        # Getting parameter info from the name
-        cdef device_t* device = get_device(device_type)
-        if not device:
-            raise DeviceError(f"Device with uid {device_uid} has invalid type {device_type}")
-        cdef param_type_t param_type
-        cdef int8_t param_idx = -1
-        for i in range(device.num_params):
-            if device.params[i].name == param:
-                param_idx = i
-                param_type = device.params[i].type
-                break
-        if param_idx == -1:
-            raise DeviceError(f"Invalid device parameter {param_name} for device type {device.name.decode('utf-8')}({device_type})")
-
-        # Allocate memory for parameter
-        cdef param_val_t* param_value = <param_val_t*> PyMem_Malloc(sizeof(param_val_t) * MAX_PARAMS)
-        if not param_value:
-            raise MemoryError("Could not allocate memory to get device value.")
-
-        # Read and return parameter
-        cdef int err = device_read_uid(device_uid, EXECUTOR, DATA, 1 << param_idx, param_value)
-        if err == -1:
-            PyMem_Free(param_value)
-            raise DeviceError(f"Device with type {device.name.decode('utf-8')}({device_type}) and uid {device_uid} isn't connected to the robot")
-
-        if param_type == INT:
-            ret = param_value[param_idx].p_i
-        elif param_type == FLOAT:
-            ret = param_value[param_idx].p_f
-        elif param_type == BOOL:
-            ret = bool(param_value[param_idx].p_b)
-        PyMem_Free(param_value)
-        return ret
+        return self.cached_device(device_id).param(param_name).get()
 
 
     cpdef void set_value(self, str device_id, str param_name, value) except *:
@@ -313,51 +1036,180 @@ cdef class Robot:
             param_name: Name of param to get. List of possible values are at https://pioneers.berkeley.edu/software/robot_api.html
             value: Value to set for the param. The type of the value can be seen at https://pioneers.berkeley.edu/software/robot_api.html
         """
-        # Convert Python string to C string
-        cdef bytes param = param_name.encode('utf-8')
+        self.cached_device(device_id).param(param_name).set(value)
 
-        # Get device identification info
-        splits = device_id.split('_')
-        if len(splits) != 2:
-            raise ValueError(f"First argument device_id must be of the form <device_type>_<device_uid>")
-        cdef int device_type = int(splits[0])
-        cdef uint64_t device_uid = int(splits[1])
 
-        # Getting parameter info from the name
-        cdef device_t* device = get_device(device_type)
-        if not device:
-            raise DeviceError(f"Device with uid {device_uid} has invalid type {device_type}")
-        cdef param_type_t param_type
-        cdef int8_t param_idx = -1
-        for i in range(device.num_params):
-            if device.params[i].name == param:
-                param_idx = i
-                param_type = device.params[i].type
-                break
-        if param_idx == -1:
-            raise DeviceError(f"Invalid device parameter {param_name} for device type {device.name.decode('utf-8')}({device_type})")
+    cpdef list get_values(self, str device_id, param_names):
+        """
+        Get several values of a device at once, reading the device only once.
 
-        # EDGE CASE: If it's TELEOP but no UserInput is connected, robot is emergency stopped
-        # There are certain parameters that need to remain 0
-        if (robot_desc_read(RUN_MODE) == TELEOP \
-            and robot_desc_read(GAMEPAD) == DISCONNECTED \
-            and robot_desc_read(KEYBOARD) == DISCONNECTED) \
-            and is_param_to_kill(device_type, param):
-            value = 0
-        
-        # Allocating memory for parameter to write
-        cdef param_val_t* param_value = <param_val_t*> PyMem_Malloc(sizeof(param_val_t) * MAX_PARAMS)
-        if not param_value:
-            raise MemoryError("Could not allocate memory to get device value.")
-
-        if param_type == INT:
-            param_value[param_idx].p_i = value
-        elif param_type == FLOAT:
-            param_value[param_idx].p_f = value
-        elif param_type == BOOL:
-            param_value[param_idx].p_b = int(value)
-        cdef int err = filter_device_write_uid(device_type, device_uid, EXECUTOR, COMMAND, 1 << param_idx, &param_value[0])
-        PyMem_Free(param_value)
+        Args:
+            device_id: string of the format '{device_type}_{device_uid}' where device_type is LowCar device ID and device_uid is 64-bit UID assigned by LowCar.
+            param_names: Names of the params to get. List of possible values are at https://pioneers.berkeley.edu/software/robot_api.html
+        Returns:
+            The values of the params, in the same order
+        """
+        cdef Device device = self.cached_device(device_id)
+        cdef list params = [device.param(param_name) for param_name in param_names]
+        cdef Param param
+        cdef uint32_t params_to_read = 0
+        for param in params:
+            params_to_read |= 1 << param.idx
+        cdef param_val_t param_value[MAX_PARAMS]
+        cdef int dev_ix = device.find()
+        cdef int err
+        with nogil:
+            err = device_read(dev_ix, EXECUTOR, DATA, params_to_read, param_value)
         if err == -1:
-            raise DeviceError(f"Device with type {device.name.decode('utf-8')}({device_type}) and uid {device_uid} isn't connected to the robot")
+            raise device.disconnected()
+        return [param.load(param_value) for param in params]
 
+
+    cpdef void set_values(self, dict values) except *:
+        """
+        Set params of several devices at once. Each device is written once, and
+        the game states and whether the robot is emergency stopped are checked once for all of them.
+
+        Args:
+            values: dict from each device_id (see set_value()) to a dict from the names of the params to set to their values.
+                For example, {LEFT_MOTOR: {"velocity_a": 0.5, "velocity_b": 0.5}, RIGHT_MOTOR: {"velocity_a": -0.5}}
+        """
+        if len(values) > MAX_DEVICES:
+            raise ValueError(f"Cannot set the values of more than {MAX_DEVICES} devices at once")
+        cdef int num_devices = 0
+        cdef uint8_t dev_types[MAX_DEVICES]
+        cdef int dev_ixs[MAX_DEVICES]
+        cdef uint32_t params_to_write[MAX_DEVICES]
+        cdef param_val_t param_values[MAX_DEVICES][MAX_PARAMS]
+        cdef int emergency_stopped = -1  # checked the first time a param that is held at 0 is set
+        cdef Device device
+        cdef Param param
+        cdef list devices = []
+        for device_id, device_values in values.items():
+            device = self.cached_device(device_id)
+            devices.append(device)
+            params_to_write[num_devices] = 0
+            for param_name, value in device_values.items():
+                param = device.param(param_name)
+                if param.kill:
+                    if emergency_stopped == -1:
+                        emergency_stopped = _emergency_stopped()
+                    if emergency_stopped:
+                        value = 0
+                param.store(param_values[num_devices], value)
+                params_to_write[num_devices] |= 1 << param.idx
+            dev_types[num_devices] = device.device_type
+            dev_ixs[num_devices] = device.find()
+            num_devices += 1
+        cdef int err
+        with nogil:
+            err = filter_device_write_batch(num_devices, dev_types, dev_ixs, EXECUTOR, COMMAND, params_to_write, param_values)
+        if err < 0:
+            # a device disconnected while the values were being set; the others were still written
+            raise (<Device> devices[-err - 1]).disconnected()
+
+
+    def bind_axis(self, str axis, str device_id, str param_name, float scale=1.0, float deadband=0.0) -> None:
+        """
+        Set a device parameter to the position of a gamepad joystick, 1000 times per second, until the end of teleop.
+        The executor does it in C, so it keeps going smoothly while the student code is busy.
+        Binding a parameter again replaces its binding.
+
+        Args:
+            axis: Name of the joystick, like "joystick_left_y"
+            device_id: string of the format '{device_type}_{device_uid}' (see set_value())
+            param_name: Name of the param to set, which must be a float, like "velocity_a"
+            scale: The joystick's position is multiplied by this
+            deadband: Joystick positions closer to 0 than this are read as 0
+        """
+        cdef binding_t binding
+        binding.mixer = AXIS_MIXER
+        binding.axes[0] = self.binding_axis(axis)
+        self.binding_target(&binding.targets[0], device_id, param_name)
+        self.bind(&binding, scale, deadband)
+
+
+    def bind_arcade_drive(self, str throttle_axis, str turn_axis, str left_device_id, str left_param, str right_device_id, str right_param, float scale=1.0, float deadband=0.0) -> None:
+        """
+        Drive with one joystick for going forward and one for turning, like bind_axis(). The left motor is set to
+        throttle + turn, and the right motor to throttle - turn, each bounded to [-1.0, 1.0].
+
+        Args:
+            throttle_axis: Name of the joystick for going forward, like "joystick_left_y"
+            turn_axis: Name of the joystick for turning, like "joystick_right_x"
+            left_device_id, left_param: The device and param of the left motor (see bind_axis())
+            right_device_id, right_param: The device and param of the right motor
+            scale: Both joysticks' positions are multiplied by this
+            deadband: Joystick positions closer to 0 than this are read as 0
+        """
+        cdef binding_t binding
+        binding.mixer = ARCADE_MIXER
+        binding.axes[0] = self.binding_axis(throttle_axis)
+        binding.axes[1] = self.binding_axis(turn_axis)
+        self.binding_target(&binding.targets[0], left_device_id, left_param)
+        self.binding_target(&binding.targets[1], right_device_id, right_param)
+        self.bind(&binding, scale, deadband)
+
+
+    def bind_tank_drive(self, str left_axis, str right_axis, str left_device_id, str left_param, str right_device_id, str right_param, float scale=1.0, float deadband=0.0) -> None:
+        """
+        Drive with one joystick for each side of the robot, like bind_axis().
+
+        Args:
+            left_axis: Name of the joystick for the left motor, like "joystick_left_y"
+            right_axis: Name of the joystick for the right motor, like "joystick_right_y"
+            left_device_id, left_param: The device and param of the left motor (see bind_axis())
+            right_device_id, right_param: The device and param of the right motor
+            scale: Both joysticks' positions are multiplied by this
+            deadband: Joystick positions closer to 0 than this are read as 0
+        """
+        cdef binding_t binding
+        binding.mixer = TANK_MIXER
+        binding.axes[0] = self.binding_axis(left_axis)
+        binding.axes[1] = self.binding_axis(right_axis)
+        self.binding_target(&binding.targets[0], left_device_id, left_param)
+        self.binding_target(&binding.targets[1], right_device_id, right_param)
+        self.bind(&binding, scale, deadband)
+
+
+    def clear_bindings(self) -> None:
+        """Stop every binding. The params they set keep their last values. """
+        with nogil:
+            clear_bindings()
+
+
+    cdef gp_joystick_t binding_axis(self, str axis) except *:
+        """Returns the index of a joystick to bind. """
+        idx = GAMEPAD_JOYSTICKS.get(axis)
+        if idx is None:
+            raise KeyError(f"Invalid gamepad joystick {axis}")
+        return <gp_joystick_t> <int> idx
+
+    cdef int binding_target(self, binding_target_t* target, str device_id, str param_name) except -1:
+        """Fills in a parameter to bind, which has to be a float. """
+        cdef Device device = self.cached_device(device_id)
+        cdef Param param = device.param(param_name)
+        if param.type != FLOAT or not device.desc.params[param.idx].write:
+            raise ValueError(f"Cannot bind parameter {param_name} of device {device_id} since it isn't a float that can be written")
+        target.dev_type = device.device_type
+        target.dev_uid = device.device_uid
+        target.param_idx = param.idx
+        return 0
+
+    cdef int bind(self, binding_t* binding, float scale, float deadband) except -1:
+        """Adds a binding with the given scale and deadband. """
+        cdef robot_desc_val_t mode
+        with nogil:
+            mode = robot_desc_read(RUN_MODE)
+        if mode != TELEOP:
+            raise NotImplementedError(f'Can only bind the gamepad during teleop mode')
+        binding.scale = scale
+        binding.deadband = deadband
+        cdef int err
+        with nogil:
+            err = add_binding(binding)
+        if err == -1:
+            _print(f"{MAX_BINDINGS} bindings already exist so this one won't be added. Use Robot.clear_bindings to remove them.", level=ERROR)
+        elif err == -2:
+            raise RuntimeError("Couldn't start the thread that evaluates the bindings")
+        return 0
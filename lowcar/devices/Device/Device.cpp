@@ -14,6 +14,10 @@ Device::Device(DeviceType dev_id, uint8_t dev_year, bool is_hardware_serial, Har
     this->led = new StatusLED();
 
     this->last_sent_data_time = this->last_received_ping_time = this->curr_time = millis();
+    this->send_timestamps = FALSE;
+    this->last_write_time = 0;
+    this->send_write_ack = FALSE;
+    this->write_ack = 0;
 }
 
 void Device::set_uid(uint64_t uid) {
@@ -24,6 +28,7 @@ void Device::loop() {
     Status sts;
     this->curr_time = millis();
     sts = this->msngr->read_message(&(this->curr_msg));  // try to read a new message
+    uint32_t recv_time = micros();
 
     if (sts == Status::SUCCESS) {  // we have a message!
         switch (this->curr_msg.message_id) {
@@ -31,22 +36,31 @@ void Device::loop() {
                 this->last_received_ping_time = this->curr_time;
                 // If this is the first DEVICE_PING received, send an ACKNOWLEDGEMENT
                 if (!this->enabled) {
+                    this->curr_msg.payload_length = 0;  // The ACKNOWLEDGEMENT payload is built from scratch
                     this->msngr->send_message(MessageID::ACKNOWLEDGEMENT, &(this->curr_msg), &(this->dev_id));
                     this->msngr->lowcar_printf("Device type %d, UID 0x...%X sent ACK", (uint8_t) this->dev_id.type, this->dev_id.uid);
                     this->enabled = TRUE;
+                    this->send_write_ack = TRUE;  // tells dev handler that it can number its DEVICE_WRITEs
                     device_enable();
+                } else if (this->curr_msg.payload_length == PING_REQUEST_BYTES) {
+                    reply_sync_ping(&(this->curr_msg), recv_time);
+                    this->send_timestamps = TRUE;
                 }
                 break;
 
             case MessageID::DEVICE_WRITE:
                 this->last_received_ping_time = this->curr_time;
                 device_write_params(&(this->curr_msg));
+                this->last_write_time = micros();
                 break;
 
             // Runtime intends to disconnect this device
             case MessageID::RST:
                 device_reset();
                 this->enabled = FALSE;
+                this->send_timestamps = FALSE;
+                this->send_write_ack = FALSE;
+                this->write_ack = 0;
                 break;
 
             // Receiving some other Message
@@ -63,6 +77,9 @@ void Device::loop() {
     if (this->enabled && (this->timeout > 0) && (this->curr_time - this->last_received_ping_time >= this->timeout)) {
         device_reset();
         this->enabled = FALSE;
+        this->send_timestamps = FALSE;
+        this->send_write_ack = FALSE;
+        this->write_ack = 0;
 
         // Send RST message
         this->curr_msg.message_id = MessageID::RST;
@@ -141,6 +158,20 @@ void Device::device_read_params(message_t* msg) {
     // The first 32 bits of the payload should be set to the param_bitmap we determined
     uint32_t* payload_ptr_uint32 = (uint32_t*) msg->payload;
     *payload_ptr_uint32 = param_bitmap;
+
+    // If dev handler is synchronizing with our clock, tell it when these values were read
+    if (this->send_timestamps) {
+        uint32_t sample_time = micros();
+        memcpy(msg->payload + msg->payload_length, &sample_time, TIMESTAMP_BYTES);
+        memcpy(msg->payload + msg->payload_length + TIMESTAMP_BYTES, &(this->last_write_time), TIMESTAMP_BYTES);
+        msg->payload_length += 2 * TIMESTAMP_BYTES;
+    }
+
+    // Tell dev handler which of its numbered DEVICE_WRITEs we got (0 until it numbers them)
+    if (this->send_write_ack) {
+        memcpy(msg->payload + msg->payload_length, &(this->write_ack), WRITE_SEQ_BYTES);
+        msg->payload_length += WRITE_SEQ_BYTES;
+    }
 }
 
 void Device::device_write_params(message_t* msg) {
@@ -158,4 +189,24 @@ void Device::device_write_params(message_t* msg) {
             payload_ptr += device_write((uint8_t) param_num, payload_ptr);
         }
     }
+
+    // An optional sequence number follows the params
+    // Only advance WRITE_ACK past sequence numbers received in order, unless told to resynchronize
+    if (payload_ptr + WRITE_SEQ_BYTES == msg->payload + msg->payload_length) {
+        uint16_t seq;
+        memcpy(&seq, payload_ptr, WRITE_SEQ_BYTES);
+        if ((seq & WRITE_SEQ_RESYNC) || (seq & WRITE_SEQ_MASK) == ((this->write_ack + 1) & WRITE_SEQ_MASK)) {
+            this->write_ack = seq & WRITE_SEQ_MASK;
+        }
+    }
+}
+
+void Device::reply_sync_ping(message_t* msg, uint32_t recv_time) {
+    // The payload already holds dev handler's send time; append when we received it and when we reply
+    uint32_t send_time;
+    memcpy(msg->payload + TIMESTAMP_BYTES, &recv_time, TIMESTAMP_BYTES);
+    send_time = micros();
+    memcpy(msg->payload + 2 * TIMESTAMP_BYTES, &send_time, TIMESTAMP_BYTES);
+    msg->payload_length = 3 * TIMESTAMP_BYTES;
+    this->msngr->send_message(MessageID::DEVICE_PING, msg);
 }
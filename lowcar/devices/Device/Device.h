@@ -107,6 +107,10 @@ class Device {
     uint64_t last_sent_data_time;      // Timestamp of last time we sent DEVICE_DATA
     uint64_t last_received_ping_time;  // Timestamp of last time we received a PING
     message_t curr_msg;                // current message being processed
+    uint8_t send_timestamps;           // Whether dev handler asked for clock synchronization (append timestamps to DEVICE_DATA)
+    uint32_t last_write_time;          // micros() when the last DEVICE_WRITE was applied (0 if none yet)
+    uint8_t send_write_ack;            // Whether to append WRITE_ACK to DEVICE_DATA; set once enabled, so dev handler numbers its DEVICE_WRITEs
+    uint16_t write_ack;                // Sequence number of the last DEVICE_WRITE received in order
 
     /**
      * Builds a DEVICE_DATA message by reading all readable parameters.
@@ -117,10 +121,20 @@ class Device {
 
     /**
      * Writes to device parameters given a DEVICE_WRITE message.
+     * Updates WRITE_ACK if the DEVICE_WRITE carries a sequence number.
      * Arguments:
      *    msg: A DEVICE_WRITE message containing parameters to write to the device.
      */
     void device_write_params(message_t* msg);
+
+    /**
+     * Replies to a DEVICE_PING from dev handler that asks for clock synchronization
+     * with a DEVICE_PING of payload [host send time][time ping was received][time reply is sent]
+     * Arguments:
+     *    msg: The received DEVICE_PING; it is reused to build the reply
+     *    recv_time: micros() at the time the DEVICE_PING was received
+     */
+    void reply_sync_ping(message_t* msg, uint32_t recv_time);
 };
 
 #endif
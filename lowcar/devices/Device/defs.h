@@ -13,9 +13,26 @@
 // The size of the param bitmap used in various messages (8 bits in a byte)
 #define PARAM_BITMAP_BYTES (MAX_PARAMS / 8)
 
+// The size of a timestamp (lower 32 bits of micros()) used for clock synchronization with dev handler
+#define TIMESTAMP_BYTES 4
+
+// Payload size of a DEVICE_PING from dev handler asking for a clock synchronization reply: [host send time]
+#define PING_REQUEST_BYTES TIMESTAMP_BYTES
+
+// The size of the optional sequence number at the end of a DEVICE_WRITE, acknowledged at the end of DEVICE_DATA
+#define WRITE_SEQ_BYTES 2
+
+// Bits of a DEVICE_WRITE sequence number holding the actual number
+#define WRITE_SEQ_MASK 0x7FFF
+
+// Bit set in the sequence number of a DEVICE_WRITE that supersedes all previous ones
+#define WRITE_SEQ_RESYNC 0x8000
+
 // Maximum size of a message payload
-// achieved with a DEVICE_WRITE/DEVICE_DATA of MAX_PARAMS of all floats
-#define MAX_PAYLOAD_SIZE (PARAM_BITMAP_BYTES + (MAX_PARAMS * sizeof(float)))
+// achieved with a DEVICE_WRITE/DEVICE_DATA of MAX_PARAMS of all floats,
+// followed by the two DEVICE_DATA timestamps (sample time, last DEVICE_WRITE time)
+// and the DEVICE_WRITE acknowledgement
+#define MAX_PAYLOAD_SIZE (PARAM_BITMAP_BYTES + (MAX_PARAMS * sizeof(float)) + 2 * TIMESTAMP_BYTES + WRITE_SEQ_BYTES)
 
 // Use these with uint8_t instead of `bool` with `true` and `false`
 // This makes device_read() and device_write() cleaner when parsing on C
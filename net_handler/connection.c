@@ -1,223 +1,494 @@
 #include <connection.h>
 
-// used for creating and cleaning up TCP connection
+// State of the TCP connection with a client
 typedef struct {
-    int conn_fd;
-    int send_logs;
-    FILE* log_file;
-    robot_desc_field_t client;
-} tcp_conn_args_t;
+    robot_desc_field_t client;                   // DAWN or SHEPHERD; unused for observers
+    net_event_t event;                           // tag of conn_fd in the event loop
+    int conn_fd;                                 // connection socket, or -1 if the client isn't connected
+    bool logs;                                   // whether the client receives logs
+    uint8_t rx_buf[BUFFER_OFFSET + UINT16_MAX];  // received bytes that don't make up a complete message yet
+    size_t rx_len;                               // number of bytes in rx_buf
+    send_queue_t queue;                          // messages waiting to be sent to the client
+    bool writing;                                // whether the event loop is waiting for conn_fd to become writable
+} tcp_conn_t;
 
-// For each client, we have two threads
-// 1) Events thread (Acts on messages we receive from them)
-// 2) Poll thread (On an interval, send info to the client)
-pthread_t dawn_events_tid, dawn_poll_tid, shepherd_events_tid, shepherd_poll_tid;
+// The epoll instance of the event loop
+static int epoll_fd = -1;
+
+// The connections with each client; all accessed only from the event loop
+static tcp_conn_t dawn_conn = {.client = DAWN, .event = NET_EVENT_DAWN, .conn_fd = -1};
+static tcp_conn_t shepherd_conn = {.client = SHEPHERD, .event = NET_EVENT_SHEPHERD, .conn_fd = -1};
+static tcp_conn_t observer_conns[MAX_OBSERVERS];  // set up by tcp_conns_init()
+
+// Whether an observer connected since device data was last sent; it is sent device data right away
+static bool observer_joined = false;
+
+// Log FIFO, open while any connected client receives logs; every line read is sent to all of them
+static FILE* log_file = NULL;
+static int num_log_conns = 0;
 
 // The start time of when the tcp connection was created with Dawn
 uint64_t dawn_start_time = -1;
 
-// Number of ms between sending each DeviceData to Dawn
-#define DEVICE_DATA_INTERVAL 10
+// Address of the connected Dawn, which UDP user inputs must come from
+static struct in_addr dawn_addr;
+
+// Sequence number of the last user inputs applied from UDP, if any were since Dawn connected, and when they arrived
+static uint32_t last_udp_seq;
+static bool udp_seq_valid = false;
+static uint64_t last_udp_time;
 
 /*
- * Clean up memory and file descriptors before exiting from tcp_process
- * Arguments:
- *    - void *args: should be a pointer to tcp_conn_args_t populated with the listed descriptors and pointers
+ * Returns the connection state of a client, or NULL if the client is neither Dawn nor Shepherd
  */
-static void tcp_conn_cleanup(void* args) {
-    tcp_conn_args_t* tcp_args = (tcp_conn_args_t*) args;
-    robot_desc_write(RUN_MODE, IDLE);
+static tcp_conn_t* get_conn(robot_desc_field_t client) {
+    if (client == DAWN) {
+        return &dawn_conn;
+    } else if (client == SHEPHERD) {
+        return &shepherd_conn;
+    }
+    log_printf(ERROR, "get_conn: Invalid TCP client %d, not DAWN(%d) or SHEPHERD(%d)", client, DAWN, SHEPHERD);
+    return NULL;
+}
 
-    if (close(tcp_args->conn_fd) != 0) {
-        log_printf(ERROR, "Failed to close conn_fd: %s", strerror(errno));
+/*
+ * Returns whether Dawn's inputs over UDP are silent: none were applied since Dawn connected, or none for UDP_SILENCE_TIMEOUT ms.
+ * While they are, Dawn's inputs over TCP are applied, and the next datagram is applied whatever its sequence number.
+ */
+static bool udp_silent() {
+    return !udp_seq_valid || millis() - last_udp_time > UDP_SILENCE_TIMEOUT;
+}
+
+/*
+ * Returns a description of a client for logging
+ */
+static const char* conn_name(tcp_conn_t* conn) {
+    if (conn->event == NET_EVENT_OBSERVER) {
+        return "observer";
     }
-    if (tcp_args->log_file != NULL) {
-        if (fclose(tcp_args->log_file) != 0) {
-            log_printf(ERROR, "Failed to close log_file: %s", strerror(errno));
+    return (conn->client == DAWN) ? "Dawn" : "Shepherd";
+}
+
+/*
+ * Returns the connection of the observer on a socket, or NULL if no observer is connected on it
+ */
+static tcp_conn_t* get_observer(int fd) {
+    for (int i = 0; i < MAX_OBSERVERS; i++) {
+        if (observer_conns[i].conn_fd != -1 && observer_conns[i].conn_fd == fd) {
+            return &observer_conns[i];
         }
-        tcp_args->log_file = NULL;
-    }
-    robot_desc_write(tcp_args->client, DISCONNECTED);
-    if (tcp_args->client == DAWN) {
-        // Disconnect inputs if Dawn is no longer connected
-        robot_desc_write(GAMEPAD, DISCONNECTED);
-        robot_desc_write(KEYBOARD, DISCONNECTED);
     }
-    free(args);
+    return NULL;
 }
 
 /*
- * A thread function to handle messages with a specific client.
- * This thread waits until a message can be read, reads it, then responds accordingly.
- * It is one of two main control loops for a TCP connection. Sets up connection by opening up pipe to read log messages from
- * and sets up read_set for select(). Then it runs main control loop, using select() to make actions event-driven.
+ * Registers a descriptor with the event loop for reading
  * Arguments:
- *    - void *tcp_args: arguments containing file descriptors and file pointers that need to be closed on exit (and other settings)
- * Return:
- *    - NULL
+ *    - net_event_t event: what the descriptor is for
+ *    - int fd: the descriptor
+ * Returns:
+ *    - 0 on success, -1 on failure
  */
-static void* tcp_events_thread(void* tcp_args) {
-    tcp_conn_args_t* args = (tcp_conn_args_t*) tcp_args;
-    pthread_cleanup_push(tcp_conn_cleanup, args);
-    int ret;
-
-    // variables used for waiting for something to do using select()
-    fd_set read_set;
-    int log_fd;
-    int maxfd = args->conn_fd;
-    if (args->send_logs) {
-        log_fd = fileno(args->log_file);
-        maxfd = log_fd > maxfd ? log_fd : maxfd;
-    }
-    maxfd = maxfd + 1;
-
-    // main control loop that is responsible for sending and receiving data
-    while (1) {
-        // set up the read_set argument to select()
-        FD_ZERO(&read_set);
-        FD_SET(args->conn_fd, &read_set);
-        if (args->send_logs) {
-            FD_SET(log_fd, &read_set);
-        }
+static int watch_fd(net_event_t event, int fd) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = NET_EVENT_DATA(event, fd)};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        log_printf(ERROR, "watch_fd: Failed to add fd %d to epoll: %s", fd, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
 
-        // prepare to accept cancellation requests over the select
-        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+/*
+ * Handles the result of sending to a client: stops the connection if sending failed, and otherwise
+ * makes the event loop wait for the connection to become writable exactly while messages are waiting to be sent.
+ * Arguments:
+ *    - tcp_conn_t *conn: the connection that was sent on
+ *    - int ret: what the send returned; 0 on success, -1 on failure
+ */
+static void stop_conn(tcp_conn_t* conn);
 
-        // wait for something to happen
-        if (select(maxfd, &read_set, NULL, NULL, NULL) < 0) {
-            log_printf(ERROR, "tcp_process: Failed to wait for select in control loop for client %d: %s", args->client, strerror(errno));
+static void check_send(tcp_conn_t* conn, int ret) {
+    if (ret != 0) {
+        log_printf(ERROR, "check_send: Disconnecting %s, which isn't keeping up with what is sent to it", conn_name(conn));
+        stop_conn(conn);
+        return;
+    }
+    bool writing = send_queue_pending(&conn->queue);
+    if (writing != conn->writing) {
+        struct epoll_event ev = {.events = EPOLLIN | (writing ? EPOLLOUT : 0), .data.u64 = NET_EVENT_DATA(conn->event, conn->conn_fd)};
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->conn_fd, &ev) != 0) {
+            log_printf(ERROR, "check_send: Failed to modify fd %d in epoll: %s", conn->conn_fd, strerror(errno));
+            return;
         }
+        conn->writing = writing;
+    }
+}
 
-        // deny all cancellation requests until the next loop
-        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+/************************ PUBLIC FUNCTIONS *************************/
 
-        // If client wants logs, logs are availble to send, and FIFO doesn't have an EOF, send logs
-        if (args->send_logs && FD_ISSET(log_fd, &read_set)) {
-            send_log_msg(args->conn_fd, args->log_file);
+/*
+ * Makes a client receive logs, opening the log FIFO if it is the first one
+ * Returns:
+ *    - 0 on success, -1 if the log FIFO couldn't be opened
+ */
+static int subscribe_logs() {
+    if (log_file == NULL) {
+        int log_fd;
+        if ((log_fd = open(LOG_FIFO, O_RDONLY | O_NONBLOCK)) == -1) {
+            log_printf(ERROR, "subscribe_logs: could not open log FIFO: %s", strerror(errno));
+            return -1;
         }
+        if ((log_file = fdopen(log_fd, "r")) == NULL) {
+            log_printf(ERROR, "subscribe_logs: could not open log file from fd: %s", strerror(errno));
+            close(log_fd);
+            return -1;
+        }
+        if (watch_fd(NET_EVENT_LOGS, log_fd) != 0) {
+            fclose(log_file);
+            log_file = NULL;
+            return -1;
+        }
+    }
+    num_log_conns++;
+    return 0;
+}
 
-        // receive new message on socket if it is ready
-        if (FD_ISSET(args->conn_fd, &read_set)) {
-            if ((ret = recv_new_msg(args->conn_fd, args->client)) != 0) {
-                if (ret == -1) {
-                    log_printf(DEBUG, "client %d has disconnected", args->client);
-                    break;
-                } else {
-                    log_printf(ERROR, "error parsing message from client %d", args->client);
-                }
-            }
+/*
+ * Stops a client from receiving logs, closing the log FIFO if it was the last one
+ */
+static void unsubscribe_logs() {
+    if (--num_log_conns == 0) {
+        // Closing the FIFO also removes it from the epoll instance
+        if (fclose(log_file) != 0) {
+            log_printf(ERROR, "Failed to close log_file: %s", strerror(errno));
         }
+        log_file = NULL;
     }
+}
 
-    // call the cleanup function
-    pthread_cleanup_pop(1);
-    return NULL;
+/*
+ * Starts handling a connection in the event loop, once the client has identified itself
+ * Arguments:
+ *    - tcp_conn_t *conn: the connection's state, which must not be connected
+ *    - int conn_fd: the connection socket
+ *    - bool logs: whether the client receives logs
+ * Returns:
+ *    - 0 on success, -1 on failure, after which conn_fd is closed
+ */
+static int start_conn(tcp_conn_t* conn, int conn_fd, bool logs) {
+    if (watch_fd(conn->event, conn_fd) != 0 || (logs && subscribe_logs() != 0)) {
+        close(conn_fd);
+        return -1;
+    }
+    conn->conn_fd = conn_fd;
+    conn->logs = logs;
+    conn->rx_len = 0;
+    send_queue_reset(&conn->queue, conn_fd);
+    conn->writing = false;
+    return 0;
 }
 
 /*
- * A thread function to handle messages with a specific client.
- * This thread creates a new message on an interval, and sends it to the client.
- * it is one of the two main control loops for a TCP connection.
+ * Stops handling a connection and closes it
  * Arguments:
- * - tcp_args: arguments containing file descriptors and file pointers that need to be closed on exit (and other settings)
- * Return:
- * - NULL
+ *    - tcp_conn_t *conn: the connection's state
  */
-static void* tcp_poll_thread(void* tcp_args) {
-    tcp_conn_args_t* args = (tcp_conn_args_t*) tcp_args;
-    uint64_t time = millis();
-    uint64_t last_sent_device_data = 0;
-    while (1) {
-        // Update time
-        time = millis();
-        // If enough time has passed, send a new DeviceData to Dawn
-        if (args->client == DAWN) {
-            if (time - last_sent_device_data > DEVICE_DATA_INTERVAL) {
-                // Send a DEVICE_DATA to client
-                send_device_data(args->conn_fd, dawn_start_time);
-                last_sent_device_data = time;
-            }
-        }
-        // If enough time has passed, send a Runtime status message
-        // TODO: @Ben/Daniel
-        pthread_testcancel();  // Make sure we allow cancelling this thread at some point
-        usleep(40000);         // Loop throttling
+static void stop_conn(tcp_conn_t* conn) {
+    if (conn->conn_fd == -1) {
+        return;
+    }
+    if (conn->event != NET_EVENT_OBSERVER) {
+        stop_tcp_conn(conn->client);
+        return;
+    }
+    log_printf(DEBUG, "Stopping observer connection");
+    // Closing the descriptor also removes it from the epoll instance
+    if (close(conn->conn_fd) != 0) {
+        log_printf(ERROR, "Failed to close conn_fd: %s", strerror(errno));
+    }
+    conn->conn_fd = -1;
+    send_queue_clear(&conn->queue);
+    if (conn->logs) {
+        unsubscribe_logs();
     }
-    return NULL;
 }
 
 /************************ PUBLIC FUNCTIONS *************************/
 
+void tcp_conns_init(int epfd) {
+    epoll_fd = epfd;
+    dawn_start_time = millis();  // CustomData of the device data that observers get before any Dawn connects
+    for (int i = 0; i < MAX_OBSERVERS; i++) {
+        observer_conns[i].event = NET_EVENT_OBSERVER;
+        observer_conns[i].conn_fd = -1;
+    }
+}
 
 void start_tcp_conn(robot_desc_field_t client, int conn_fd, int send_logs) {
-    if (client != DAWN && client != SHEPHERD) {
-        log_printf(ERROR, "start_tcp_conn: Invalid TCP client %d, not DAWN(%d) or SHEPHERD(%d)", client, DAWN, SHEPHERD);
+    tcp_conn_t* conn = get_conn(client);
+    if (conn == NULL) {
+        return;
+    }
+    if (conn->conn_fd != -1) {
+        stop_tcp_conn(client);
+    }
+    if (start_conn(conn, conn_fd, send_logs) != 0) {
         return;
     }
+    reset_rtt(client);
 
-    // initialize argument to new connection thread
-    tcp_conn_args_t* args = malloc(sizeof(tcp_conn_args_t));
-    if (args == NULL) {
-        log_printf(FATAL, "start_tcp_conn: Failed to malloc args");
-        exit(1);
+    // Update the start time of the TCP connection with Dawn, and expect UDP inputs from its address
+    if (client == DAWN) {
+        dawn_start_time = millis();
+        reset_device_data();
+        struct sockaddr_in peer_addr = {0};
+        socklen_t peer_addr_len = sizeof(peer_addr);
+        if (getpeername(conn_fd, (struct sockaddr*) &peer_addr, &peer_addr_len) != 0) {
+            log_printf(ERROR, "start_tcp_conn: Failed to get Dawn's address, so UDP inputs will be ignored: %s", strerror(errno));
+        }
+        dawn_addr = peer_addr.sin_addr;
+        udp_seq_valid = false;
     }
-    args->client = client;
-    args->conn_fd = conn_fd;
-    args->send_logs = send_logs;
-    args->log_file = NULL;
+    robot_desc_write(client, CONNECTED);
+}
 
-    // Open FIFO pipe for logs
-    if (send_logs) {
-        int log_fd;
-        if ((log_fd = open(LOG_FIFO, O_RDONLY | O_NONBLOCK)) == -1) {
-            log_printf(ERROR, "start_tcp_conn: could not open log FIFO on %d: %s", args->client, strerror(errno));
+void start_observer_conn(int conn_fd) {
+    for (int i = 0; i < MAX_OBSERVERS; i++) {
+        if (observer_conns[i].conn_fd == -1) {
+            if (start_conn(&observer_conns[i], conn_fd, true) == 0) {
+                observer_joined = true;
+            }
             return;
         }
-        if ((args->log_file = fdopen(log_fd, "r")) == NULL) {
-            log_printf(ERROR, "start_tcp_conn: could not open log file from fd: %s", strerror(errno));
-            close(log_fd);
+    }
+    log_printf(ERROR, "start_observer_conn: %d observers are already connected, refusing another one", MAX_OBSERVERS);
+    close(conn_fd);
+}
+
+void stop_tcp_conn(robot_desc_field_t client) {
+    tcp_conn_t* conn = get_conn(client);
+    if (conn == NULL || conn->conn_fd == -1) {
+        return;
+    }
+    robot_desc_write(RUN_MODE, IDLE);
+
+    // Closing the descriptor also removes it from the epoll instance
+    if (close(conn->conn_fd) != 0) {
+        log_printf(ERROR, "Failed to close conn_fd: %s", strerror(errno));
+    }
+    conn->conn_fd = -1;
+    send_queue_clear(&conn->queue);
+    if (conn->logs) {
+        unsubscribe_logs();
+    }
+    reset_rtt(client);
+    robot_desc_write(client, DISCONNECTED);
+    if (client == DAWN) {
+        // Disconnect inputs if Dawn is no longer connected
+        robot_desc_write(GAMEPAD, DISCONNECTED);
+        robot_desc_write(KEYBOARD, DISCONNECTED);
+    }
+}
+
+/*
+ * Receives whatever has arrived on a connection without blocking, and processes every complete message.
+ * Messages from observers are discarded; they can't send commands.
+ * Arguments:
+ *    - tcp_conn_t *conn: the connection, which is connected
+ */
+static void conn_recv(tcp_conn_t* conn) {
+    while (1) {
+        // receive whatever has arrived, without blocking
+        ssize_t n_read = recv(conn->conn_fd, conn->rx_buf + conn->rx_len, sizeof(conn->rx_buf) - conn->rx_len, MSG_DONTWAIT);
+        if (n_read == 0) {
+            log_printf(DEBUG, "%s has disconnected", conn_name(conn));
+            stop_conn(conn);
             return;
+        } else if (n_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_printf(ERROR, "conn_recv: Failed to receive from %s: %s", conn_name(conn), strerror(errno));
+                stop_conn(conn);
+            }
+            return;
+        }
+        if (conn->event == NET_EVENT_OBSERVER) {
+            continue;
         }
+        conn->rx_len += n_read;
+
+        // process every complete message (see make_buf() for the header)
+        size_t offset = 0;
+        while (conn->rx_len - offset >= BUFFER_OFFSET) {
+            uint8_t* msg = conn->rx_buf + offset;
+            uint16_t len_pb;
+            memcpy(&len_pb, msg + 1, sizeof(uint16_t));
+            if (conn->rx_len - offset < BUFFER_OFFSET + len_pb) {
+                break;
+            }
+            if (msg[0] == INPUTS_MSG && conn->client == DAWN && !udp_silent()) {
+                // Dawn sends its inputs over UDP; one over TCP may be older than the newest datagram, so it is only a fallback
+                offset += BUFFER_OFFSET + len_pb;
+                continue;
+            }
+            int ret = process_new_msg(&conn->queue, conn->client, (net_msg_t) msg[0], msg + BUFFER_OFFSET, len_pb);
+            if (ret == -1) {
+                check_send(conn, ret);  // Couldn't reply; the connection is stopped
+                return;
+            } else if (ret != 0) {
+                log_printf(ERROR, "error parsing message from %s", conn_name(conn));
+            }
+            offset += BUFFER_OFFSET + len_pb;
+        }
+        conn->rx_len -= offset;
+        memmove(conn->rx_buf, conn->rx_buf + offset, conn->rx_len);
+        check_send(conn, 0);  // Replies may be waiting to be sent
     }
+}
 
-    // Update the start time of the TCP connection with Dawn
-    if (client == DAWN) {
-        dawn_start_time = millis();
+void tcp_conn_recv(robot_desc_field_t client, int fd) {
+    tcp_conn_t* conn = get_conn(client);
+    if (conn == NULL || conn->conn_fd != fd) {
+        return;  // The connection was stopped (or replaced) earlier in this batch of events
     }
+    conn_recv(conn);
+}
 
-    // create the main control threads for this client
-    if (pthread_create((client == DAWN) ? &dawn_events_tid : &shepherd_events_tid, NULL, tcp_events_thread, args) != 0) {
-        log_printf(ERROR, "start_tcp_conn: Failed to create main TCP thread tcp_events for %d: %s", client, strerror(errno));
-        return;
+void tcp_conn_flush(robot_desc_field_t client, int fd) {
+    tcp_conn_t* conn = get_conn(client);
+    if (conn == NULL || conn->conn_fd != fd) {
+        return;  // The connection was stopped (or replaced) earlier in this batch of events
     }
-    if (pthread_create((client == DAWN) ? &dawn_poll_tid : &shepherd_poll_tid, NULL, tcp_poll_thread, args) != 0) {
-        log_printf(ERROR, "start_tcp_conn: Failed to create main TCP thread tcp_poll for %d: %s", client, strerror(errno));
-        return;
+    check_send(conn, send_queue_flush(&conn->queue));
+}
+
+void observer_conn_recv(int fd) {
+    tcp_conn_t* conn = get_observer(fd);
+    if (conn != NULL) {
+        conn_recv(conn);
     }
-    robot_desc_write(client, CONNECTED);
 }
 
+void observer_conn_flush(int fd) {
+    tcp_conn_t* conn = get_observer(fd);
+    if (conn != NULL) {
+        check_send(conn, send_queue_flush(&conn->queue));
+    }
+}
 
-void stop_tcp_conn(robot_desc_field_t client) {
-    if (client != DAWN && client != SHEPHERD) {
-        log_printf(ERROR, "stop_tcp_conn: Invalid TCP client %d, not DAWN(%d) or SHEPHERD(%d)", client, DAWN, SHEPHERD);
+void udp_conn_recv(int fd) {
+    static uint8_t bufs[2][BUFFER_OFFSET + UINT16_MAX];  // the newest valid datagram so far, and the one being received
+    int newest = -1;                                     // index in bufs of the newest valid datagram, if any
+    ssize_t newest_len = 0;
+
+    while (1) {
+        uint8_t* buf = bufs[(newest == 0) ? 1 : 0];
+        struct sockaddr_in src_addr;
+        socklen_t src_addr_len = sizeof(src_addr);
+        ssize_t n_read = recvfrom(fd, buf, sizeof(bufs[0]), MSG_DONTWAIT, (struct sockaddr*) &src_addr, &src_addr_len);
+        if (n_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_printf(ERROR, "udp_conn_recv: Failed to receive from UDP socket: %s", strerror(errno));
+            }
+            break;
+        }
+        if (dawn_conn.conn_fd == -1 || src_addr.sin_addr.s_addr != dawn_addr.s_addr) {
+            continue;  // Only the connected Dawn may send inputs
+        }
+
+        // check the header (see make_buf()), then drop anything that isn't newer than what was applied
+        uint16_t len_pb;
+        memcpy(&len_pb, buf + 1, sizeof(uint16_t));
+        if (n_read < BUFFER_OFFSET + UDP_SEQ_SIZE || buf[0] != INPUTS_MSG || len_pb != n_read - BUFFER_OFFSET) {
+            log_printf(ERROR, "udp_conn_recv: Ignoring malformed datagram of %d bytes", n_read);
+            continue;
+        }
+        uint32_t seq;
+        memcpy(&seq, buf + BUFFER_OFFSET, UDP_SEQ_SIZE);
+        int32_t ahead = (int32_t) (seq - last_udp_seq);  // wraps around like TCP sequence numbers
+        if (ahead <= 0 && !udp_silent()) {
+            if (ahead > -UDP_SEQ_RESYNC_GAP) {
+                continue;  // Stale; newer inputs were already applied
+            }
+            log_printf(DEBUG, "udp_conn_recv: Dawn's UDP sequence restarted at %u", seq);
+        }
+        last_udp_seq = seq;
+        last_udp_time = millis();
+        udp_seq_valid = true;
+        newest = (newest == 0) ? 1 : 0;
+        newest_len = n_read;
+    }
+
+    // The latest inputs win; older ones from the same batch would be overwritten right away
+    if (newest != -1) {
+        uint8_t* buf = bufs[newest];
+        if (process_new_msg(&dawn_conn.queue, DAWN, INPUTS_MSG, buf + BUFFER_OFFSET + UDP_SEQ_SIZE, newest_len - BUFFER_OFFSET - UDP_SEQ_SIZE) != 0) {
+            log_printf(ERROR, "udp_conn_recv: error parsing inputs from Dawn");
+        }
+    }
+}
+
+void tcp_conn_send_logs(int fd) {
+    if (log_file == NULL || fileno(log_file) != fd) {
+        return;  // The FIFO was closed earlier in this batch of events
+    }
+    shared_msg_t* msg = pack_log_msg(log_file);
+    if (msg == NULL) {
         return;
     }
 
-    // Cancel and join the poll thread
-    // Note: Since both the poll and events thread use the same connection socket,
-    // The first thread we cancel should *not* clean up the connection, but the second thread we cancel should
-    if (pthread_cancel((client == DAWN) ? dawn_poll_tid : shepherd_poll_tid) != 0) {
-        log_printf(ERROR, "stop_tcp_conn: Failed to cancel TCP client poll thread for %d: %s", client, strerror(errno));
+    // packed once, then queued for every client that receives logs
+    tcp_conn_t* conns[] = {&dawn_conn, &shepherd_conn};
+    for (int i = 0; i < 2; i++) {
+        if (conns[i]->conn_fd != -1 && conns[i]->logs) {
+            check_send(conns[i], send_queue_push_shared(&conns[i]->queue, SEND_COALESCE, msg));
+        }
     }
-    if (pthread_join((client == DAWN) ? dawn_poll_tid : shepherd_poll_tid, NULL) != 0) {
-        log_printf(ERROR, "stop_tcp_conn: Failed to join on TCP client poll thread for %d: %s", client, strerror(errno));
+    for (int i = 0; i < MAX_OBSERVERS; i++) {
+        if (observer_conns[i].conn_fd != -1) {
+            check_send(&observer_conns[i], send_queue_push_shared(&observer_conns[i].queue, SEND_COALESCE, msg));
+        }
     }
-    // Cancel and join the events thread
-    if (pthread_cancel((client == DAWN) ? dawn_events_tid : shepherd_events_tid) != 0) {
-        log_printf(ERROR, "stop_tcp_conn: Failed to cancel TCP client events thread for %d: %s", client, strerror(errno));
+    shared_msg_release(msg);
+}
+
+void tcp_conn_send_device_data() {
+    bool observed = false;
+    for (int i = 0; i < MAX_OBSERVERS; i++) {
+        observed |= observer_conns[i].conn_fd != -1;
     }
-    if (pthread_join((client == DAWN) ? dawn_events_tid : shepherd_events_tid, NULL) != 0) {
-        log_printf(ERROR, "stop_tcp_conn: Failed to join on TCP client events thread for %d: %s", client, strerror(errno));
+    if ((dawn_conn.conn_fd == -1 && !observed) || (!observer_joined && !device_data_due())) {
+        return;
+    }
+    observer_joined = false;
+
+    // each message is packed once, then queued for every client it is for
+    shared_msg_t* dawn_msg;
+    shared_msg_t* observer_msg;
+    pack_device_data((dawn_conn.conn_fd != -1) ? &dawn_conn.queue : NULL, observed, dawn_start_time, &dawn_msg, &observer_msg);
+    if (dawn_msg != NULL) {
+        check_send(&dawn_conn, send_queue_push_shared(&dawn_conn.queue, SEND_NEWEST_WINS, dawn_msg));
+        shared_msg_release(dawn_msg);
+    }
+    if (observer_msg != NULL) {
+        for (int i = 0; i < MAX_OBSERVERS; i++) {
+            if (observer_conns[i].conn_fd != -1) {
+                check_send(&observer_conns[i], send_queue_push_shared(&observer_conns[i].queue, SEND_NEWEST_WINS, observer_msg));
+            }
+        }
+        shared_msg_release(observer_msg);
+    }
+}
+
+void tcp_conn_send_rtt_probes() {
+    tcp_conn_t* conns[] = {&dawn_conn, &shepherd_conn};
+    for (int i = 0; i < 2; i++) {
+        // A client that hasn't read everything sent yet is still measured by the probe waiting for it
+        if (conns[i]->conn_fd != -1 && !send_queue_pending(&conns[i]->queue)) {
+            check_send(conns[i], send_rtt_probe(&conns[i]->queue, conns[i]->client));
+        }
     }
 }
@@ -1,27 +1,140 @@
 #ifndef TCP_CONN_H
 #define TCP_CONN_H
 
+#include <sys/epoll.h>  // for epoll_ctl, epoll_event
+
 #include <net_handler_message.h>
 #include <net_util.h>
 
 /**
- * Start the main TCP connection control thread. Does not block.
- * Should be called when a TCP client has requested a connection to Runtime.
+ * What a descriptor registered with net_handler's epoll instance is for.
+ * The tag and the descriptor are packed into the 64-bit epoll_event.data, so that
+ * events for a descriptor that was closed earlier in the same batch can be recognized.
+ */
+typedef enum {
+    NET_EVENT_LISTEN,     // listening socket: connections to accept
+    NET_EVENT_HANDSHAKE,  // accepted connection that hasn't sent its client ID yet
+    NET_EVENT_TIMER,      // timerfd for checking whether there is device data to send
+    NET_EVENT_SIGNAL,     // signalfd for SIGINT
+    NET_EVENT_SHEPHERD,   // connection with Shepherd
+    NET_EVENT_DAWN,       // connection with Dawn
+    NET_EVENT_OBSERVER,   // connection with a read-only observer
+    NET_EVENT_LOGS,       // log FIFO, whose lines are sent to Dawn and the observers
+    NET_EVENT_UDP         // UDP socket on which Dawn sends user inputs
+} net_event_t;
+
+#define NET_EVENT_DATA(tag, fd) (((uint64_t) (tag) << 32) | (uint32_t) (fd))
+#define NET_EVENT_TAG(data) ((net_event_t) ((data) >> 32))
+#define NET_EVENT_FD(data) ((int) ((data) & 0xFFFFFFFF))
+
+/**
+ * Gives the connections the epoll instance of net_handler's event loop. Must be called before any other function here.
+ *
+ * Args:
+ *  - epoll_fd: the epoll instance to register connection and log descriptors with
+ */
+void tcp_conns_init(int epoll_fd);
+
+/**
+ * Starts handling a TCP connection in the event loop. Does not block.
+ * Should be called when a TCP client has identified itself on a new connection.
  *
  * Args:
  *  - client: client to communicate with, either DAWN or SHEPHERD
- *  - connfd: connection socket descriptor on which there is the established connection with Dawn
+ *  - connfd: connection socket descriptor on which there is the established connection with the client
  *  - send_logs: whether to send logs over TCP to client. DAWN should receive logs and SHEPHERD should not
  */
 void start_tcp_conn(robot_desc_field_t client, int connfd, int send_logs);
 
 /**
- * Stops the TCP connection control thread cleanly. May block briefly to allow
- * main control thread to finish what it's doing. Should be called right before the net_handler main loop terminates.
+ * Starts handling a TCP connection with a read-only observer in the event loop. Does not block.
+ * Observers receive the same device data and logs as Dawn, but anything they send is discarded,
+ * and their connecting or disconnecting doesn't affect the robot. At most MAX_OBSERVERS are connected at once;
+ * the connection is closed if there are already that many.
+ *
+ * Args:
+ *  - connfd: connection socket descriptor on which there is the established connection with the observer
+ */
+void start_observer_conn(int connfd);
+
+/**
+ * Stops handling a TCP connection and closes it. Does not block.
  *
  * Args:
  *  - client: which client to stop communicating with, either DAWN or SHEPHERD
  */
 void stop_tcp_conn(robot_desc_field_t client);
 
+/**
+ * Handles a readiness event for a client connection: receives whatever has arrived without blocking, and processes
+ * every complete message. Partial messages are kept until the rest arrives. Stops the connection if the client disconnected.
+ *
+ * Args:
+ *  - client: which client the event is for, either DAWN or SHEPHERD
+ *  - fd: the descriptor the event is for; ignored unless it is still the client's connection
+ */
+void tcp_conn_recv(robot_desc_field_t client, int fd);
+
+/**
+ * Handles a writability event for a client connection: sends as much of what is waiting in its send queue as the
+ * socket takes without blocking. Stops the connection if sending failed.
+ *
+ * Args:
+ *  - client: which client the event is for, either DAWN or SHEPHERD
+ *  - fd: the descriptor the event is for; ignored unless it is still the client's connection
+ */
+void tcp_conn_flush(robot_desc_field_t client, int fd);
+
+/**
+ * Handles a readiness event for an observer connection: receives and discards whatever has arrived without blocking,
+ * and stops the connection if the observer disconnected.
+ *
+ * Args:
+ *  - fd: the descriptor the event is for; ignored unless it is still an observer's connection
+ */
+void observer_conn_recv(int fd);
+
+/**
+ * Handles a writability event for an observer connection, like tcp_conn_flush().
+ *
+ * Args:
+ *  - fd: the descriptor the event is for; ignored unless it is still an observer's connection
+ */
+void observer_conn_flush(int fd);
+
+/**
+ * Handles a readiness event for the log FIFO by sending the available logs to the clients that receive them.
+ * The logs are packed once, and the same buffer is queued for every client.
+ *
+ * Args:
+ *  - fd: the descriptor the event is for; ignored unless it is still a log FIFO
+ */
+void tcp_conn_send_logs(int fd);
+
+/**
+ * Handles a readiness event for the UDP socket: receives every datagram that has arrived without blocking, and
+ * applies the user inputs of the newest one. Only datagrams from the address of the connected Dawn are accepted,
+ * and ones whose sequence number isn't newer than the last one applied are dropped as stale (or duplicate).
+ * This lets a lost datagram be superseded by the next one, instead of holding up later inputs like a lost TCP segment.
+ *
+ * Args:
+ *  - fd: the UDP socket
+ */
+void udp_conn_recv(int fd);
+
+/**
+ * Sends a Device Data message to Dawn and the observers if any are connected and one is due (see device_data_due()),
+ * or right away when an observer just connected. Each message is packed once, and the same buffer is queued for
+ * every client it is for (see pack_device_data()). Called on every tick of the device data timer. If the previous one is still waiting to be sent
+ * because Dawn is reading slowly, it is replaced.
+ */
+void tcp_conn_send_device_data();
+
+/**
+ * Sends Dawn and Shepherd a round trip time probe if one is due (see send_rtt_probe()). Called on every tick of the
+ * device data timer. A client that still has messages waiting to be sent isn't sent another probe until it catches up,
+ * so probes never pile up in the queue of a client that stopped reading.
+ */
+void tcp_conn_send_rtt_probes();
+
 #endif
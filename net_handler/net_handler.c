@@ -1,3 +1,6 @@
+#include <sys/signalfd.h>  // for signalfd
+#include <sys/timerfd.h>   // for timerfd_create, timerfd_settime
+
 #include <connection.h>
 #include <gamestate_filter.h>
 #include <net_util.h>
@@ -47,116 +50,336 @@ static int socket_setup(int* sockfd) {
     return 0;
 }
 
+/*
+ * Sets up the UDP socket on which Dawn can send user inputs, bound to any interface on RASPI_UDP_PORT.
+ * Return:
+ *    - the non-blocking socket, or -1 if it couldn't be set up (Dawn can still send inputs over TCP)
+ */
+static int udp_setup() {
+    int udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (udp_fd == -1) {
+        log_printf(ERROR, "udp_setup: failed to create UDP socket: %s", strerror(errno));
+        return -1;
+    }
+    struct sockaddr_in serv_addr = {0};
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    serv_addr.sin_port = htons(RASPI_UDP_PORT);
+    if (bind(udp_fd, (struct sockaddr*) &serv_addr, sizeof(struct sockaddr_in)) != 0) {
+        log_printf(ERROR, "udp_setup: failed to bind UDP socket to raspi port: %s", strerror(errno));
+        close(udp_fd);
+        return -1;
+    }
+    return udp_fd;
+}
+
+// Max number of accepted connections waiting to send their client ID
+#define MAX_HANDSHAKES 8
+
+// Max ms a new connection has to send its client ID
+#define HANDSHAKE_TIMEOUT 1000
+
+// Max number of events handled per call to epoll_wait()
+#define MAX_EVENTS 16
+
+// An accepted connection that hasn't sent its client ID yet
+typedef struct {
+    int fd;                       // connection socket, or -1 if this slot is free
+    struct sockaddr_in cli_addr;  // requesting client's address
+    uint64_t accept_time;         // millis() at which the connection was accepted
+} handshake_t;
+
+static handshake_t handshakes[MAX_HANDSHAKES];
 
 /*
- * Handles SIGINT being sent to the process by closing connections and closing shm_aux, shm, and logger.
+ * Registers a descriptor with the event loop for reading
  * Arguments:
- *    - int sig_num: signal that caused this handler to execute (will always be SIGINT in this case)
+ *    - int epoll_fd: the event loop's epoll instance
+ *    - net_event_t event: what the descriptor is for
+ *    - int fd: the descriptor
+ * Return:
+ *    - 0 on success, -1 on failure
  */
-static void sigint_handler(int sig_num) {
-    log_printf(INFO, "Stopping net_handler...");
-    if (robot_desc_read(SHEPHERD) == CONNECTED) {
-        stop_tcp_conn(SHEPHERD);
+static int watch_fd(int epoll_fd, net_event_t event, int fd) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = NET_EVENT_DATA(event, fd)};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        log_printf(ERROR, "watch_fd: Failed to add fd %d to epoll: %s", fd, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Accepts every pending connection on the listening socket without blocking, and waits for each of them
+ * to send its client ID in the event loop.
+ * Arguments:
+ *    - int epoll_fd: the event loop's epoll instance
+ *    - int sockfd: the listening socket (non-blocking)
+ */
+static void accept_connections(int epoll_fd, int sockfd) {
+    while (1) {
+        struct sockaddr_in cli_addr;                          // requesting client's address
+        socklen_t cli_addr_len = sizeof(struct sockaddr_in);  // length of requesting client's address in bytes
+        int connfd = accept(sockfd, (struct sockaddr*) &cli_addr, &cli_addr_len);
+        if (connfd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                log_printf(ERROR, "accept_connections: listen socket failed to accept a connection: %s", strerror(errno));
+            }
+            return;
+        }
+        log_printf(DEBUG, "Received connection request from %s:%d", inet_ntoa(cli_addr.sin_addr), ntohs(cli_addr.sin_port));
+
+        // find a free slot, making room by dropping the oldest handshake if needed
+        int slot = 0;
+        for (int i = 0; i < MAX_HANDSHAKES; i++) {
+            if (handshakes[i].fd == -1) {
+                slot = i;
+                break;
+            } else if (handshakes[i].accept_time < handshakes[slot].accept_time) {
+                slot = i;
+            }
+        }
+        if (handshakes[slot].fd != -1) {
+            log_printf(ERROR, "accept_connections: Too many connections waiting for a client ID, dropping the oldest");
+            close(handshakes[slot].fd);
+            handshakes[slot].fd = -1;
+        }
+        if (watch_fd(epoll_fd, NET_EVENT_HANDSHAKE, connfd) != 0) {
+            close(connfd);
+            continue;
+        }
+        handshakes[slot].fd = connfd;
+        handshakes[slot].cli_addr = cli_addr;
+        handshakes[slot].accept_time = millis();
+    }
+}
+
+/*
+ * Reads the client ID (first byte on the socket from the client) of a new connection that has data,
+ * and hands the connection over to the appropriate client.
+ * Arguments:
+ *    - int epoll_fd: the event loop's epoll instance
+ *    - int fd: the new connection
+ */
+static void finish_handshake(int epoll_fd, int fd) {
+    handshake_t* handshake = NULL;
+    for (int i = 0; i < MAX_HANDSHAKES; i++) {
+        if (handshakes[i].fd == fd) {
+            handshake = &handshakes[i];
+            break;
+        }
     }
-    if (robot_desc_read(DAWN) == CONNECTED) {
-        stop_tcp_conn(DAWN);
+    if (handshake == NULL) {
+        return;  // The connection was dropped earlier in this batch of events
+    }
+
+    uint8_t client_id;  // this is 0 if shepherd, 1 if dawn, 2 if an observer
+    ssize_t num_bytes_read = recv(fd, &client_id, 1, MSG_DONTWAIT);
+    if (num_bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    handshake->fd = -1;
+    if (num_bytes_read <= 0) {
+        log_printf(ERROR, "finish_handshake: Connection closed before sending a client ID: %s", (num_bytes_read == 0) ? "EOF" : strerror(errno));
+        close(fd);
+        return;
+    }
+
+    // The connection is now either the client's, or closed; stop treating it as a handshake
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) != 0) {
+        log_printf(ERROR, "finish_handshake: Failed to remove fd %d from epoll: %s", fd, strerror(errno));
+    }
+
+    // if the incoming request is shepherd or dawn, start the appropriate connection
+    if (client_id == 0 && handshake->cli_addr.sin_family == AF_INET) {
+        if (robot_desc_read(SHEPHERD) == DISCONNECTED) {
+            log_printf(DEBUG, "Starting Shepherd connection");
+        } else {  // Shepherd is already connected, but it's probably dead. This new connection is likely Shepherd trying to reconnect.
+            log_printf(DEBUG, "Restarting Shepherd connection");
+            stop_tcp_conn(SHEPHERD);
+        }
+        start_tcp_conn(SHEPHERD, fd, 0);
+    } else if (client_id == 1 && handshake->cli_addr.sin_family == AF_INET) {
+        if (robot_desc_read(DAWN) == DISCONNECTED) {
+            log_printf(DEBUG, "Starting Dawn connection");
+        } else {  // Dawn is already connected, but it's probably dead. This new connection is likely Dawn trying to reconnect.
+            log_printf(DEBUG, "Restarting Dawn connection");
+            stop_tcp_conn(DAWN);
+        }
+        start_tcp_conn(DAWN, fd, 1);
+    } else if (client_id == 2 && handshake->cli_addr.sin_family == AF_INET) {
+        log_printf(DEBUG, "Starting observer connection from %s", inet_ntoa(handshake->cli_addr.sin_addr));
+        start_observer_conn(fd);
+    } else {
+        log_printf(ERROR, "Client is neither Dawn, Shepherd, nor an observer");
+        close(fd);
     }
-    // sockfd and connfd are automatically closed when process terminates
-    exit(0);
 }
 
-/**
- * Returns the client ID
- * (0 for shepherd, 1 for Dawn, 254 on timeout, 255 on error)
+/*
+ * Closes the new connections that haven't sent their client ID within HANDSHAKE_TIMEOUT
  */
-static uint8_t determine_client(int connfd) {
-    fd_set set;
-    FD_ZERO(&set);        /* clear the set */
-    FD_SET(connfd, &set); /* add our file descriptor to the set */
-
-    // Set the timeout duration
-    struct timeval timeout;
-    timeout.tv_sec = 1;
-    timeout.tv_usec = 0;
-
-    // Wait for client ID to be received, with timeout enabled
-    int ret = select(connfd + 1, &set, NULL, NULL, &timeout);
-    if (ret == -1) {
-        log_printf(ERROR, "determine_client: Error on select"); /* an error accured */
-        return 255;
-    } else if (ret == 0) {
-        log_printf(ERROR, "determine_client: Timeout on waiting for client ID"); /* a timeout occured */
-        return 254;
-    } else { /* there was data to read */
-        int num_bytes_read = 0;
-        uint8_t client_id = 255;
-        num_bytes_read = read(connfd, &client_id, 1);
-        if (num_bytes_read == -1) {
-            log_printf(ERROR, "determine_client(): Error when reading from connfd, %s", strerror(errno));
-            return 253;
+static void expire_handshakes() {
+    uint64_t now = millis();
+    for (int i = 0; i < MAX_HANDSHAKES; i++) {
+        if (handshakes[i].fd != -1 && now - handshakes[i].accept_time > HANDSHAKE_TIMEOUT) {
+            log_printf(ERROR, "expire_handshakes: Timeout on waiting for client ID");
+            close(handshakes[i].fd);
+            handshakes[i].fd = -1;
         }
-        return client_id;
     }
 }
 
+/*
+ * Creates a timerfd that expires every DEVICE_DATA_CHECK_INTERVAL ms
+ * Return:
+ *    - the timerfd, or -1 on failure
+ */
+static int timer_setup() {
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (timer_fd == -1) {
+        log_printf(ERROR, "timer_setup: failed to create timerfd: %s", strerror(errno));
+        return -1;
+    }
+    struct itimerspec interval = {0};
+    interval.it_interval.tv_nsec = DEVICE_DATA_CHECK_INTERVAL * 1000000;
+    interval.it_value = interval.it_interval;
+    if (timerfd_settime(timer_fd, 0, &interval, NULL) != 0) {
+        log_printf(ERROR, "timer_setup: failed to start timerfd: %s", strerror(errno));
+        close(timer_fd);
+        return -1;
+    }
+    return timer_fd;
+}
+
+/*
+ * Stops net_handler by closing connections. Called when SIGINT arrives on the signalfd.
+ */
+static void stop_net_handler() {
+    log_printf(INFO, "Stopping net_handler...");
+    stop_tcp_conn(SHEPHERD);
+    stop_tcp_conn(DAWN);
+    // sockfd, the timerfd, the signalfd, and the epoll instance are automatically closed when process terminates
+    exit(0);
+}
+
 // ******************************************* MAIN ROUTINE ******************************* //
 
 int main() {
-    int sockfd = -1, connfd = -1;
-    struct sockaddr_in cli_addr;                          // requesting client's address
-    socklen_t cli_addr_len = sizeof(struct sockaddr_in);  // length of requesting client's address in bytes
-    uint8_t client_id;                                    // this is 0 if shepherd, 1 if dawn
+    int sockfd = -1;
 
     // setup
     logger_init(NET_HANDLER);
-    signal(SIGINT, sigint_handler);
+    int err = rt_profile_process_init();
+    if (err != 0) {
+        log_printf(WARN, "main: Couldn't fully apply real-time profile, continuing without it: %s", strerror(err));
+    }
     if (socket_setup(&sockfd) != 0) {
         if (sockfd != -1) {
             close(sockfd);
         }
         return 1;
     }
+    if (fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK) != 0) {
+        log_printf(FATAL, "main: failed to make listening socket non-blocking: %s", strerror(errno));
+        exit(1);
+    }
     shm_init();
 
+    // SIGINT is handled in the event loop; block it before any thread is started so that all of them inherit the mask
+    sigset_t sigint_mask;
+    sigemptyset(&sigint_mask);
+    sigaddset(&sigint_mask, SIGINT);
+    if (pthread_sigmask(SIG_BLOCK, &sigint_mask, NULL) != 0) {
+        log_printf(FATAL, "main: failed to block SIGINT");
+        exit(1);
+    }
+
     // TODO: Net Handler is in charge of regulating game states.
     // Net Handler may not have this responsibility in the future.
     start_gamestate_handler_thread();
+
+    // set up the event loop
+    int epoll_fd = epoll_create1(0);
+    int timer_fd = timer_setup();
+    int signal_fd = signalfd(-1, &sigint_mask, SFD_NONBLOCK);
+    if (epoll_fd == -1 || timer_fd == -1 || signal_fd == -1) {
+        log_printf(FATAL, "main: failed to set up event loop: %s", strerror(errno));
+        exit(1);
+    }
+    if (watch_fd(epoll_fd, NET_EVENT_LISTEN, sockfd) != 0 || watch_fd(epoll_fd, NET_EVENT_TIMER, timer_fd) != 0 || watch_fd(epoll_fd, NET_EVENT_SIGNAL, signal_fd) != 0) {
+        exit(1);
+    }
+    int udp_fd = udp_setup();
+    if (udp_fd != -1 && watch_fd(epoll_fd, NET_EVENT_UDP, udp_fd) != 0) {
+        close(udp_fd);
+    }
+    tcp_conns_init(epoll_fd);
+    for (int i = 0; i < MAX_HANDSHAKES; i++) {
+        handshakes[i].fd = -1;
+    }
+    if ((err = rt_profile_thread_init(RT_PRIO_NET_HANDLER)) != 0) {
+        log_printf(DEBUG, "main: Running event loop without real-time priority: %s", strerror(err));
+    }
     log_printf(INFO, "Net handler initialized");
 
     // run net_handler main control loop
+    struct epoll_event events[MAX_EVENTS];
     while (1) {
-        // wait for a client to make a request to the robot, and accept it
-        if ((connfd = accept(sockfd, (struct sockaddr*) &cli_addr, &cli_addr_len)) < 0) {
-            log_printf(ERROR, "main: listen socket failed to accept a connection: %s", strerror(errno));
+        int num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (num_events < 0) {
+            if (errno != EINTR) {
+                log_printf(ERROR, "main: epoll_wait failed: %s", strerror(errno));
+            }
             continue;
         }
-
-        cli_addr_len = sizeof(struct sockaddr_in);
-        log_printf(DEBUG, "Received connection request from %s:%d", inet_ntoa(cli_addr.sin_addr), ntohs(cli_addr.sin_port));
-
-        // get the client ID (first byte on the socket from client)
-        client_id = determine_client(connfd);
-
-        // if the incoming request is shepherd or dawn, start the appropriate threads
-        if (client_id == 0 && cli_addr.sin_family == AF_INET) {
-            if (robot_desc_read(SHEPHERD) == DISCONNECTED) {
-                log_printf(DEBUG, "Starting Shepherd connection");
-            } else {  // Shepherd is already connected, but it's probably dead. This new connection is likely Shepherd trying to reconnect.
-                log_printf(DEBUG, "Restarting Shepherd connection");
-                stop_tcp_conn(SHEPHERD);
+        for (int i = 0; i < num_events; i++) {
+            int fd = NET_EVENT_FD(events[i].data.u64);
+            switch (NET_EVENT_TAG(events[i].data.u64)) {
+                case NET_EVENT_LISTEN:
+                    accept_connections(epoll_fd, fd);
+                    break;
+                case NET_EVENT_HANDSHAKE:
+                    finish_handshake(epoll_fd, fd);
+                    break;
+                case NET_EVENT_TIMER: {
+                    uint64_t expirations;
+                    if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                        tcp_conn_send_device_data();
+                        tcp_conn_send_rtt_probes();
+                        expire_handshakes();
+                    }
+                    break;
+                }
+                case NET_EVENT_SIGNAL:
+                    stop_net_handler();
+                    break;
+                case NET_EVENT_SHEPHERD:
+                case NET_EVENT_DAWN: {
+                    robot_desc_field_t client = (NET_EVENT_TAG(events[i].data.u64) == NET_EVENT_DAWN) ? DAWN : SHEPHERD;
+                    if (events[i].events & EPOLLOUT) {
+                        tcp_conn_flush(client, fd);
+                    }
+                    if (events[i].events & ~EPOLLOUT) {
+                        tcp_conn_recv(client, fd);  // also notices hangups and errors
+                    }
+                    break;
+                }
+                case NET_EVENT_OBSERVER:
+                    if (events[i].events & EPOLLOUT) {
+                        observer_conn_flush(fd);
+                    }
+                    if (events[i].events & ~EPOLLOUT) {
+                        observer_conn_recv(fd);  // also notices hangups and errors
+                    }
+                    break;
+                case NET_EVENT_LOGS:
+                    tcp_conn_send_logs(fd);
+                    break;
+                case NET_EVENT_UDP:
+                    udp_conn_recv(fd);
+                    break;
             }
-            start_tcp_conn(SHEPHERD, connfd, 0);
-        } else if (client_id == 1 && cli_addr.sin_family == AF_INET) {
-            if (robot_desc_read(DAWN) == DISCONNECTED) {
-                log_printf(DEBUG, "Starting Dawn connection");
-            } else {  // Dawn is already connected, but it's probably dead. This new connection is likely Dawn trying to reconnect.
-                log_printf(DEBUG, "Restarting Dawn connection");
-                stop_tcp_conn(DAWN);
-            }
-            start_tcp_conn(DAWN, connfd, 1);
-        } else {
-            log_printf(ERROR, "Client is neither Dawn nor Shepherd");
-            close(connfd);
         }
     }
 
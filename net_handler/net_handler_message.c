@@ -3,18 +3,21 @@
 // ******************************************* SEND MESSAGES ***************************************** //
 
 /*
- * Send a log message on the TCP connection to the client. Reads lines from the pipe until there is no more data
- * or it has read MAX_NUM_LOGS lines from the pipe, packages the message, and sends it.
+ * Packs a log message for the clients that receive logs. Reads lines from the pipe until there is no more data
+ * or it has read MAX_NUM_LOGS lines from the pipe, and packages them in a single message.
  * Arguments:
- *    - int conn_fd: socket connection's file descriptor on which to write to the TCP port
+ *    - FILE *log_file: the log FIFO
+ * Returns:
+ *    - the message, which the caller pushes to every client's send queue (with SEND_COALESCE) and then releases
+ *    - NULL if there were no logs to send
  */
-void send_log_msg(int conn_fd, FILE* log_file) {
+shared_msg_t* pack_log_msg(FILE* log_file) {
     char nextline[MAX_LOG_LEN];  // next log line read from FIFO pipe
     Text log_msg = TEXT__INIT;   // initialize a new Text protobuf message
     log_msg.n_payload = 0;       // The number of logs in this payload
     log_msg.payload = malloc(MAX_NUM_LOGS * sizeof(char*));
     if (log_msg.payload == NULL) {
-        log_printf(FATAL, "send_log_msg: Failed to malloc payload for logs");
+        log_printf(FATAL, "pack_log_msg: Failed to malloc payload for logs");
         exit(1);
     }
 
@@ -23,7 +26,7 @@ void send_log_msg(int conn_fd, FILE* log_file) {
         if (fgets(nextline, MAX_LOG_LEN, log_file) != NULL) {
             log_msg.payload[log_msg.n_payload] = malloc(strlen(nextline) + 1);
             if (log_msg.payload[log_msg.n_payload] == NULL) {
-                log_printf(FATAL, "send_log_msg: Failed to malloc log message of length %d", strlen(nextline) + 1);
+                log_printf(FATAL, "pack_log_msg: Failed to malloc log message of length %d", strlen(nextline) + 1);
                 exit(1);
             }
             strcpy(log_msg.payload[log_msg.n_payload], nextline);
@@ -34,29 +37,28 @@ void send_log_msg(int conn_fd, FILE* log_file) {
                 break;
             } else {  // log_msg.n_payload == 0;  (payload is empty) Return immediately
                 free(log_msg.payload);
-                return;
+                return NULL;
             }
         } else if (errno == EAGAIN || errno == EWOULDBLOCK) {  // No more to read on pipe (would block in a blocking read)
             break;
         } else {  // Error occurred
-            log_printf(ERROR, "send_log_msg: Error reading from log fifo: %s", strerror(errno));
+            log_printf(ERROR, "pack_log_msg: Error reading from log fifo: %s", strerror(errno));
             // Free loaded payload contents and the payload itself
             for (size_t i = 0; i < log_msg.n_payload; i++) {
                 free(log_msg.payload[i]);
             }
             free(log_msg.payload);
-            return;
+            return NULL;
         }
     }
 
-    // prepare the message for sending
-    uint16_t len_pb = text__get_packed_size(&log_msg);
-    uint8_t* send_buf = make_buf(LOG_MSG, len_pb);
-    text__pack(&log_msg, send_buf + BUFFER_OFFSET);  // pack message into the rest of send_buf (starting at send_buf[3] onward)
-
-    // send message on socket
-    if (writen(conn_fd, send_buf, len_pb + BUFFER_OFFSET) == -1) {
-        log_printf(ERROR, "send_log_msg: sending log message over socket failed: %s", strerror(errno));
+    // pack the message once, for every client
+    shared_msg_t* msg = NULL;
+    if (log_msg.n_payload > 0) {
+        uint16_t len_pb = text__get_packed_size(&log_msg);
+        msg = shared_msg_get(len_pb + BUFFER_OFFSET);
+        set_buf_header(msg->buf, LOG_MSG, len_pb);
+        text__pack(&log_msg, msg->buf + BUFFER_OFFSET);  // pack message into the rest of the buffer (starting at buf[3] onward)
     }
 
     // free all allocated memory
@@ -64,206 +66,591 @@ void send_log_msg(int conn_fd, FILE* log_file) {
         free(log_msg.payload[i]);
     }
     free(log_msg.payload);
-    free(send_buf);
+    return msg;
 }
 
 /*
 * Send a timestamp message over TCP with a timestamp attached to the message. The timestamp is when the net_handler on runtime has received the
 * packet and processed it.
+* Timestamps are never dropped from the send queue.
 * Arguments:
-    - int conn_fd: socket connection's file descriptor on which to write to the TCP port
+    - send_queue_t* queue: send queue of the client's connection
     - TimeStamps* dawn_timestamp_msg: Unpacked timestamp_proto from Dawn
+* Returns:
+    - 0 if the message was queued
+    - -1 if the client is too far behind or sending on the socket failed
 */
-void send_timestamp_msg(int conn_fd, TimeStamps* dawn_timestamp_msg) {
+int send_timestamp_msg(send_queue_t* queue, TimeStamps* dawn_timestamp_msg) {
+    static uint8_t send_buf[BUFFER_OFFSET + UINT16_MAX];  // the queue copies it, so replying doesn't allocate
     dawn_timestamp_msg->runtime_timestamp = millis();
     uint16_t len_pb = time_stamps__get_packed_size(dawn_timestamp_msg);
-    uint8_t* send_buf = make_buf(TIME_STAMP_MSG, len_pb);
+    set_buf_header(send_buf, TIME_STAMP_MSG, len_pb);
     time_stamps__pack(dawn_timestamp_msg, send_buf + BUFFER_OFFSET);
-    if (writen(conn_fd, send_buf, len_pb + BUFFER_OFFSET) == -1) {
-        log_printf(ERROR, "send_timestamp_msg: sending log message over socket failed: %s", strerror(errno));
+    return send_queue_push(queue, SEND_RELIABLE, send_buf, len_pb + BUFFER_OFFSET);
+}
+
+// Round trip time monitors of the connections with Dawn and Shepherd, indexed by (client == SHEPHERD)
+static rtt_monitor_t rtt_monitors[2];
+
+// Returns the number of microseconds on a clock that, unlike micros(), never jumps, so that round trips measured on it are never skewed
+static uint64_t monotonic_micros() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+void reset_rtt(robot_desc_field_t client) {
+    rtt_reset(&rtt_monitors[client == SHEPHERD], monotonic_micros());
+}
+
+int send_rtt_probe(send_queue_t* queue, robot_desc_field_t client) {
+    static uint8_t send_buf[BUFFER_OFFSET + UINT16_MAX];  // the queue copies it, so probing doesn't allocate
+    uint64_t id = rtt_start_probe(&rtt_monitors[client == SHEPHERD], monotonic_micros());
+    if (id == 0) {
+        return 0;
     }
-    free(send_buf);
+    TimeStamps probe = TIME_STAMPS__INIT;
+    probe.runtime_timestamp = id;  // dawn_timestamp is left 0, which tells the client it is a probe to answer
+    uint16_t len_pb = time_stamps__get_packed_size(&probe);
+    set_buf_header(send_buf, TIME_STAMP_MSG, len_pb);
+    time_stamps__pack(&probe, send_buf + BUFFER_OFFSET);
+    return send_queue_push(queue, SEND_RELIABLE, send_buf, len_pb + BUFFER_OFFSET);
 }
 
-/**
- * Sends a Device Data message to Dawn.
- * Arguments:
- *    - int dawn_socket_fd: socket fd for Dawn connection
- *    - uint64_t dawn_start_time: time that Dawn connection started, for calculating time in CustomData
- */
-void send_device_data(int dawn_socket_fd, uint64_t dawn_start_time) {
-    int len_pb;
-    uint8_t* buffer;
+// What Dawn asked to receive between full DevData messages
+typedef enum {
+    DEV_DATA_FULL,    // nothing; every message is a full DevData
+    DEV_DATA_DELTAS,  // DevData with only the changed devices and params
+    DEV_DATA_VALUES   // packed values of every device, following the last schema
+} dev_data_mode_t;
 
-    dev_id_t dev_ids[MAX_DEVICES];
-    int valid_dev_idxs[MAX_DEVICES];
-    uint32_t catalog;
+// Readonly params after "time_ms" in CustomData, describing Dawn's send queue (see send_queue_stats_t)
+#define NUM_QUEUE_PARAMS 4
+static char* queue_param_names[NUM_QUEUE_PARAMS] = {"queue_bytes", "queue_max_bytes", "queue_replaced", "queue_dropped"};
 
-    param_val_t custom_params[UCHAR_MAX];
-    param_type_t custom_types[UCHAR_MAX];
-    char custom_names[UCHAR_MAX][LOG_KEY_LENGTH];
-    uint8_t num_params;
+// Readonly params after the send queue params in CustomData, describing the round trips to Dawn and Shepherd (see rtt_monitor.h)
+#define NUM_RTT_PARAMS 5
+static char* rtt_param_names[NUM_RTT_PARAMS] = {"rtt_p50_us", "rtt_p99_us", "clock_offset_ms", "shepherd_rtt_p50_us", "shepherd_rtt_p99_us"};
 
-    DevData dev_data = DEV_DATA__INIT;
+// Max number of params in CustomData: the custom log data, the current time, the send queue params, and the round trip params
+#define MAX_CUSTOM_PARAMS (UCHAR_MAX + 1 + NUM_QUEUE_PARAMS + NUM_RTT_PARAMS)
 
-    // get information
-    get_catalog(&catalog);
-    get_device_identifiers(dev_ids);
+/*
+ * The DevData sent to Dawn is rebuilt on every send, but its shape (which devices are connected,
+ * and the names and types of their params) only changes when a device connects or disconnects.
+ * So the whole protobuf tree lives in this preallocated arena: its skeleton is only rebuilt when the connected
+ * devices change, every send just refreshes the values, and the message is packed into a shared message from
+ * the send queues' pool, whose buffers are reused across sends. In steady state, send_device_data() doesn't allocate at all.
+ *
+ * Observers always get the full DevData, as a DEVICE_DATA_MSG packed once for all of them (and shared with Dawn
+ * whenever Dawn gets the same message), at the times Dawn gets its messages.
+ *
+ * If Dawn asked for deltas (see DEVICE_DATA_DELTA_MSG), a second tree in the arena shares the same Params but
+ * only lists the devices and params whose values changed since the previous send. A full DevData (keyframe)
+ * is still sent whenever the devices or the custom data keys change, and at least every DEVICE_DATA_KEYFRAME_INTERVAL.
+ * Since TCP delivers every message in order, the previous send is always what Dawn has applied last, except
+ * that device data waiting in Dawn's send queue is replaced by the next send (see send_queue.h); so a keyframe
+ * is also sent whenever the message it would replace isn't one that can be skipped.
+ *
+ * If Dawn asked for values only (see DEVICE_SCHEMA_MSG), the full DevData is sent as a schema instead, and
+ * every other send is a DEVICE_VALUES_MSG that packs the values of every device in the order of the schema
+ * without any names or flags (see pack_values()). The schema is sent again whenever a keyframe would be.
+ *
+ * Device data is only sent when something changed (see device_data_due()): the arena remembers the shared memory
+ * data generation its last send read, and the min and max intervals between sends that Dawn asked for.
+ *
+ * Device data is only sent and requested from net handler's event loop, so the arena isn't locked.
+ */
+typedef struct {
+    DevData dev_data;
+    Device devices[MAX_DEVICES + 1];                              // + 1 is for custom data
+    Device* device_ptrs[MAX_DEVICES + 1];                         // dev_data.devices
+    Param params[MAX_DEVICES][MAX_PARAMS];                        // params of devices[i]
+    Param* param_ptrs[MAX_DEVICES][MAX_PARAMS];                   // devices[i].params
+    Param custom_params[MAX_CUSTOM_PARAMS];                       // custom log data, then the current time and send queue
+    Param* custom_param_ptrs[MAX_CUSTOM_PARAMS];                  // devices[n_devices - 1].params
+    char custom_names[UCHAR_MAX][LOG_KEY_LENGTH];                 // names of the custom params
+    uint8_t num_custom;                                           // number of custom params (without the current time)
+    DevData delta_data;                                           // only the changed devices and params of dev_data
+    Device delta_devices[MAX_DEVICES + 1];                        // delta_devices[i] holds the changed params of devices[i]
+    Device* delta_device_ptrs[MAX_DEVICES + 1];                   // delta_data.devices
+    Param* delta_param_ptrs[MAX_DEVICES + 1][MAX_CUSTOM_PARAMS];  // delta_devices[i].params
+    bool built;                                                   // whether the skeleton below has been built at least once
+    uint32_t catalog;                                             // catalog the skeleton was built for
+    dev_id_t dev_ids[MAX_DEVICES];                                // device identifiers the skeleton was built for
+    dev_data_mode_t mode;                                         // what Dawn asked to receive between keyframes
+    bool keyframe_needed;                                         // whether the next send must be a keyframe
+    uint64_t last_keyframe;                                       // millis() at which the last keyframe was sent
+    uint64_t last_send;                                           // millis() at which the last message was sent
+    uint32_t sent_gen;                                            // data generation (see get_data_generation()) the last message was built from
+    uint16_t min_interval;                                        // min ms between two messages
+    uint16_t max_interval;                                        // max ms between two messages, or 0 to only send on changes
+} dev_data_arena_t;
+
+static dev_data_arena_t arena;
 
-    // calculate num_devices, get valid device indices
-    int num_devices = 0;
+/*
+ * Returns whether the devices in shared memory are the ones the arena's skeleton was built for.
+ * Arguments:
+ *    - uint32_t catalog: current catalog from shared memory
+ *    - dev_id_t *dev_ids: current device identifiers from shared memory
+ */
+static bool same_devices(uint32_t catalog, dev_id_t* dev_ids) {
+    if (!arena.built || catalog != arena.catalog) {
+        return false;
+    }
     for (int i = 0; i < MAX_DEVICES; i++) {
-        if (catalog & (1 << i)) {
-            valid_dev_idxs[num_devices] = i;
-            num_devices++;
+        if ((catalog & (1 << i)) && (dev_ids[i].uid != arena.dev_ids[i].uid || dev_ids[i].type != arena.dev_ids[i].type)) {
+            return false;
         }
     }
-    dev_data.devices = malloc((num_devices + 1) * sizeof(Device*));  // + 1 is for custom data
-    if (dev_data.devices == NULL) {
-        log_printf(FATAL, "send_device_data: Failed to malloc");
-        exit(1);
-    }
+    return true;
+}
+
+/*
+ * Initializes a device in the delta tree to hold the changed params of a device in the full tree.
+ * Arguments:
+ *    - int dev_idx: index of the device in both trees
+ */
+static void init_delta_device(int dev_idx) {
+    Device* delta = &arena.delta_devices[dev_idx];
+    device__init(delta);  // Leaves the name empty, which isn't serialized; Dawn already has it from the last keyframe
+    delta->uid = arena.devices[dev_idx].uid;
+    delta->type = arena.devices[dev_idx].type;
+    delta->params = arena.delta_param_ptrs[dev_idx];
+}
+
+/*
+ * Rebuilds the skeleton of the DevData in the arena (devices, param names, types, and readonly flags) for the given devices.
+ * Arguments:
+ *    - uint32_t catalog: current catalog from shared memory
+ *    - dev_id_t *dev_ids: current device identifiers from shared memory
+ */
+static void build_dev_data(uint32_t catalog, dev_id_t* dev_ids) {
+    dev_data__init(&arena.dev_data);
+    arena.dev_data.devices = arena.device_ptrs;
 
-    // populate dev_data.device[i]
     int dev_idx = 0;
-    for (int i = 0; i < num_devices; i++) {
-        int idx = valid_dev_idxs[i];
-        device_t* device_info = get_device(dev_ids[idx].type);
-        if (device_info == NULL) {
-            log_printf(ERROR, "send_device_data: Device %d in SHM with type %d is invalid", idx, dev_ids[idx].type);
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (!(catalog & (1 << i))) {
             continue;
         }
-
-        Device* device = malloc(sizeof(Device));
-        if (device == NULL) {
-            log_printf(FATAL, "send_device_data: Failed to malloc");
-            exit(1);
+        device_t* device_info = get_device(dev_ids[i].type);
+        if (device_info == NULL) {
+            log_printf(ERROR, "send_device_data: Device %d in SHM with type %d is invalid", i, dev_ids[i].type);
+            continue;
         }
+        Device* device = &arena.devices[dev_idx];
         device__init(device);
-        dev_data.devices[dev_idx] = device;
-        device->type = dev_ids[idx].type;
-        device->uid = dev_ids[idx].uid;
+        arena.device_ptrs[dev_idx] = device;
+        device->type = dev_ids[i].type;
+        device->uid = dev_ids[i].uid;
         device->name = device_info->name;
-
-        device->n_params = 0;
-        param_val_t param_data[MAX_PARAMS];
-        device_read_uid(device->uid, NET_HANDLER, DATA, get_readable_param_bitmap(device->type), param_data);
-
-        device->params = malloc(device_info->num_params * sizeof(Param*));
-        if (device->params == NULL) {
-            log_printf(FATAL, "send_device_data: Failed to malloc");
-            exit(1);
-        }
-        // populate device parameters
+        device->n_params = device_info->num_params;
+        device->params = arena.param_ptrs[dev_idx];
         for (int j = 0; j < device_info->num_params; j++) {
-            Param* param = malloc(sizeof(Param));
-            if (param == NULL) {
-                log_printf(FATAL, "send_device_data: Failed to malloc");
-                exit(1);
-            }
+            Param* param = &arena.params[dev_idx][j];
             param__init(param);
+            arena.param_ptrs[dev_idx][j] = param;
             param->name = device_info->params[j].name;
             switch (device_info->params[j].type) {
                 case INT:
                     param->val_case = PARAM__VAL_IVAL;
-                    param->ival = param_data[j].p_i;
                     break;
                 case FLOAT:
                     param->val_case = PARAM__VAL_FVAL;
-                    param->fval = param_data[j].p_f;
                     break;
                 case BOOL:
                     param->val_case = PARAM__VAL_BVAL;
-                    param->bval = param_data[j].p_b;
                     break;
             }
             param->readonly = device_info->params[j].read && !device_info->params[j].write;
-            device->params[device->n_params] = param;
-            device->n_params++;
         }
+        init_delta_device(dev_idx);
         dev_idx++;
     }
 
-    // Add custom log data to protobuf
-    Device* custom = malloc(sizeof(Device));
-    if (custom == NULL) {
-        log_printf(FATAL, "send_device_data: Failed to malloc");
-        exit(1);
-    }
+    // Custom log data goes last; its params are refreshed on every send
+    Device* custom = &arena.devices[dev_idx];
     device__init(custom);
-    dev_data.devices[dev_idx] = custom;
-    log_data_read(&num_params, custom_names, custom_types, custom_params);
-    custom->n_params = num_params + 1;  // + 1 is for the current time
-    custom->params = malloc(sizeof(Param*) * custom->n_params);
-    if (custom->params == NULL) {
-        log_printf(FATAL, "send_device_data: Failed to malloc");
-        exit(1);
-    }
+    arena.device_ptrs[dev_idx] = custom;
     custom->name = "CustomData";
     custom->type = MAX_DEVICES;
     custom->uid = 2020;
-    for (size_t i = 0; i < custom->n_params; i++) {
-        Param* param = malloc(sizeof(Param));
-        if (param == NULL) {
-            log_printf(FATAL, "send_device_data: Failed to malloc");
-            exit(1);
+    custom->params = arena.custom_param_ptrs;
+    for (int i = 0; i < MAX_CUSTOM_PARAMS; i++) {
+        param__init(&arena.custom_params[i]);
+        arena.custom_param_ptrs[i] = &arena.custom_params[i];
+        arena.custom_params[i].readonly = true;  // CustomData is used to display changing values; Not an actual parameter
+    }
+    init_delta_device(dev_idx);
+    arena.dev_data.n_devices = dev_idx + 1;  // + 1 is for custom data
+
+    arena.num_custom = 0;  // Names of custom params are set again on the next send
+    dev_data__init(&arena.delta_data);
+    arena.delta_data.devices = arena.delta_device_ptrs;
+
+    arena.built = true;
+    arena.catalog = catalog;
+    memcpy(arena.dev_ids, dev_ids, sizeof(arena.dev_ids));
+}
+
+/*
+ * Sets the value of a param, and adds it to the changed params of a delta device if the value changed.
+ * Arguments:
+ *    - Param *param: the param to set
+ *    - Param__ValCase val_case: type of the new value
+ *    - param_val_t *val: the new value
+ *    - Device *delta: device in the delta tree that holds the changed params of the param's device
+ */
+static void set_param(Param* param, Param__ValCase val_case, param_val_t* val, Device* delta) {
+    bool changed = param->val_case != val_case;
+    param->val_case = val_case;
+    switch (val_case) {
+        case PARAM__VAL_IVAL:
+            changed = changed || param->ival != val->p_i;
+            param->ival = val->p_i;
+            break;
+        case PARAM__VAL_FVAL:
+            changed = changed || memcmp(&param->fval, &val->p_f, sizeof(float)) != 0;  // Bitwise, so that NaN compares equal to itself
+            param->fval = val->p_f;
+            break;
+        case PARAM__VAL_BVAL:
+            changed = changed || param->bval != val->p_b;
+            param->bval = val->p_b;
+            break;
+        default:
+            break;
+    }
+    if (changed) {
+        delta->params[delta->n_params++] = param;
+    }
+}
+
+/*
+ * Converts a Runtime param type to the matching Param value case.
+ */
+static Param__ValCase param_val_case(param_type_t type) {
+    switch (type) {
+        case INT:
+            return PARAM__VAL_IVAL;
+        case FLOAT:
+            return PARAM__VAL_FVAL;
+        case BOOL:
+            return PARAM__VAL_BVAL;
+    }
+    return PARAM__VAL__NOT_SET;
+}
+
+/*
+ * Returns the size of a param value in a DEVICE_VALUES_MSG.
+ */
+static size_t packed_param_size(Param* param) {
+    return (param->val_case == PARAM__VAL_BVAL) ? 1 : 4;
+}
+
+/*
+ * Packs the current values of every device in the arena into the payload of a DEVICE_VALUES_MSG.
+ * For each device in the order of the last schema, the payload holds its index in the schema (1 byte),
+ * then the values of all of its params in the order of the schema: 4 bytes for an int32 or a float, and
+ * 1 byte for a bool, in host byte order like the message header.
+ * Arguments:
+ *    - uint8_t *buf: buffer with room for values_size() bytes
+ */
+static void pack_values(uint8_t* buf) {
+    for (size_t i = 0; i < arena.dev_data.n_devices; i++) {
+        Device* device = arena.device_ptrs[i];
+        *buf++ = (uint8_t) i;
+        for (size_t j = 0; j < device->n_params; j++) {
+            Param* param = device->params[j];
+            switch (param->val_case) {
+                case PARAM__VAL_IVAL:
+                    memcpy(buf, &param->ival, sizeof(int32_t));
+                    break;
+                case PARAM__VAL_FVAL:
+                    memcpy(buf, &param->fval, sizeof(float));
+                    break;
+                default:
+                    *buf = (uint8_t) param->bval;
+                    break;
+            }
+            buf += packed_param_size(param);
         }
-        param__init(param);
-        custom->params[i] = param;
-        param->name = custom_names[i];
-        switch (custom_types[i]) {
-            case INT:
-                param->val_case = PARAM__VAL_IVAL;
-                param->ival = custom_params[i].p_i;
-                break;
-            case FLOAT:
-                param->val_case = PARAM__VAL_FVAL;
-                param->fval = custom_params[i].p_f;
-                break;
-            case BOOL:
-                param->val_case = PARAM__VAL_BVAL;
-                param->bval = custom_params[i].p_b;
-                break;
+    }
+}
+
+/*
+ * Returns the size of the payload of a DEVICE_VALUES_MSG for the devices in the arena.
+ */
+static size_t values_size() {
+    size_t size = 0;
+    for (size_t i = 0; i < arena.dev_data.n_devices; i++) {
+        Device* device = arena.device_ptrs[i];
+        size++;  // index of the device in the schema
+        for (size_t j = 0; j < device->n_params; j++) {
+            size += packed_param_size(device->params[j]);
         }
-        param->readonly = true;  // CustomData is used to display changing values; Not an actual parameter
     }
-    Param* time = malloc(sizeof(Param));
-    if (time == NULL) {
-        log_printf(FATAL, "send_device_data: Failed to malloc");
-        exit(1);
+    return size;
+}
+
+void reset_device_data() {
+    arena.mode = DEV_DATA_FULL;
+    arena.keyframe_needed = true;
+    arena.min_interval = DEVICE_DATA_INTERVAL;
+    arena.max_interval = DEVICE_DATA_IDLE_INTERVAL;
+}
+
+bool device_data_due() {
+    if (arena.keyframe_needed) {
+        return true;  // Dawn just connected or asked for a different mode
+    }
+    uint64_t since_last = millis() - arena.last_send;
+    if (arena.max_interval != 0 && since_last >= arena.max_interval) {
+        return true;
+    } else if (since_last < arena.min_interval) {
+        return false;
     }
-    param__init(time);
-    custom->params[num_params] = time;
-    time->name = "time_ms";
-    time->val_case = PARAM__VAL_IVAL;
-    time->ival = millis() - dawn_start_time;  // Can only give difference in millisecond since robot start since it is int32, not int64
-    time->readonly = true;                    // Just displays the time; Writing to this parameter doesn't make sense
+    uint32_t gen;
+    get_data_generation(&gen);
+    return gen != arena.sent_gen;
+}
 
-    dev_data.n_devices = dev_idx + 1;  // + 1 is for custom data
+/*
+ * Packs a DevData (or the packed values, if DEV_DATA is NULL) into a shared message
+ * Arguments:
+ *    - net_msg_t msg_type: type of the message
+ *    - DevData *dev_data: the message to pack, or NULL to pack the values of every device (see pack_values())
+ * Returns:
+ *    - the message, with a reference for the caller
+ */
+static shared_msg_t* pack_dev_data_msg(net_msg_t msg_type, DevData* dev_data) {
+    size_t len_pb = (dev_data != NULL) ? dev_data__get_packed_size(dev_data) : values_size();
+    shared_msg_t* msg = shared_msg_get(len_pb + BUFFER_OFFSET);
+    set_buf_header(msg->buf, msg_type, len_pb);
+    if (dev_data != NULL) {
+        dev_data__pack(dev_data, msg->buf + BUFFER_OFFSET);
+    } else {
+        pack_values(msg->buf + BUFFER_OFFSET);
+    }
+    return msg;
+}
 
-    len_pb = dev_data__get_packed_size(&dev_data);
-    buffer = make_buf(DEVICE_DATA_MSG, len_pb);
-    dev_data__pack(&dev_data, buffer + BUFFER_OFFSET);
+void pack_device_data(send_queue_t* queue, bool observed, uint64_t dawn_start_time, shared_msg_t** dawn_msg, shared_msg_t** observer_msg) {
+    dev_id_t dev_ids[MAX_DEVICES];
+    uint32_t catalog;
 
-    // send message on socket
-    if (writen(dawn_socket_fd, buffer, len_pb + BUFFER_OFFSET) == -1) {
-        log_printf(ERROR, "send_device_data: sending log message over socket failed: %s", strerror(errno));
+    param_val_t custom_vals[UCHAR_MAX];
+    param_type_t custom_types[UCHAR_MAX];
+    char custom_names[UCHAR_MAX][LOG_KEY_LENGTH];
+    uint8_t num_custom;
+
+    uint64_t now = millis();
+    arena.last_send = now;
+    get_data_generation(&arena.sent_gen);  // Before reading anything, so that changes made while reading are sent next time
+    dev_data_mode_t mode = arena.mode;
+    bool keyframe = mode == DEV_DATA_FULL || arena.keyframe_needed || (mode == DEV_DATA_DELTAS && now - arena.last_keyframe >= DEVICE_DATA_KEYFRAME_INTERVAL);
+
+    // Only values can replace values that Dawn never got; a delta or schema that Dawn never got needs a keyframe
+    int replaced_type = (queue != NULL) ? send_queue_replaceable_type(queue) : -1;
+    if (replaced_type != -1 && replaced_type != DEVICE_VALUES_MSG) {
+        keyframe = true;
     }
 
-    // free everything
-    for (size_t i = 0; i < dev_data.n_devices; i++) {
-        for (size_t j = 0; j < dev_data.devices[i]->n_params; j++) {
-            free(dev_data.devices[i]->params[j]);
+    // get information, and only rebuild the skeleton if a device connected or disconnected
+    get_catalog(&catalog);
+    get_device_identifiers(dev_ids);
+    if (!same_devices(catalog, dev_ids)) {
+        build_dev_data(catalog, dev_ids);
+        keyframe = true;
+    }
+
+    // Dawn can't remove, rename, or retype params from a delta or values, so custom data keys changing also needs a keyframe
+    log_data_read(&num_custom, custom_names, custom_types, custom_vals);
+    for (int i = 0; i < num_custom; i++) {
+        if (i >= arena.num_custom || strcmp(custom_names[i], arena.custom_names[i]) != 0) {
+            strcpy(arena.custom_names[i], custom_names[i]);
+            arena.custom_params[i].name = arena.custom_names[i];
+            keyframe = true;
+        }
+        if (arena.custom_params[i].val_case != param_val_case(custom_types[i])) {
+            keyframe = true;
+        }
+    }
+    if (num_custom != arena.num_custom) {
+        arena.num_custom = num_custom;
+        keyframe = true;
+    }
+
+    // refresh device parameters, noting which ones changed
+    size_t num_devices = arena.dev_data.n_devices - 1;  // - 1 is for custom data
+    arena.delta_data.n_devices = 0;
+    for (size_t i = 0; i < num_devices; i++) {
+        Device* device = arena.device_ptrs[i];
+        Device* delta = &arena.delta_devices[i];
+        delta->n_params = 0;
+        param_val_t param_data[MAX_PARAMS];
+        if (device_read_uid(device->uid, NET_HANDLER, DATA, get_readable_param_bitmap(device->type), param_data) != 0) {
+            continue;  // Device disconnected since the catalog was read; it'll be gone from the next DevData
+        }
+        for (size_t j = 0; j < device->n_params; j++) {
+            set_param(device->params[j], device->params[j]->val_case, &param_data[j], delta);
+        }
+        if (delta->n_params > 0) {
+            arena.delta_device_ptrs[arena.delta_data.n_devices++] = delta;
         }
-        free(dev_data.devices[i]->params);
-        free(dev_data.devices[i]);
     }
-    free(dev_data.devices);
-    free(buffer);  // Free buffer with device data protobuf
+
+    // refresh custom log data, which always changes because of the current time
+    Device* custom = arena.device_ptrs[num_devices];
+    Device* custom_delta = &arena.delta_devices[num_devices];
+    custom_delta->n_params = 0;
+    custom->n_params = num_custom + 1 + NUM_QUEUE_PARAMS + NUM_RTT_PARAMS;  // + 1 is for the current time
+    for (int i = 0; i < num_custom; i++) {
+        set_param(custom->params[i], param_val_case(custom_types[i]), &custom_vals[i], custom_delta);
+    }
+    param_val_t time = {.p_i = now - dawn_start_time};  // Can only give difference in millisecond since robot start since it is int32, not int64
+    custom->params[num_custom]->name = "time_ms";
+    set_param(custom->params[num_custom], PARAM__VAL_IVAL, &time, custom_delta);
+    int32_t queue_stats[NUM_QUEUE_PARAMS] = {0};
+    if (queue != NULL) {
+        queue_stats[0] = queue->stats.bytes;
+        queue_stats[1] = queue->stats.max_bytes;
+        queue_stats[2] = queue->stats.msgs_replaced;
+        queue_stats[3] = queue->stats.msgs_dropped;
+    }
+    for (int i = 0; i < NUM_QUEUE_PARAMS; i++) {
+        param_val_t stat = {.p_i = queue_stats[i]};
+        custom->params[num_custom + 1 + i]->name = queue_param_names[i];
+        set_param(custom->params[num_custom + 1 + i], PARAM__VAL_IVAL, &stat, custom_delta);
+    }
+    int32_t rtt_stats[NUM_RTT_PARAMS] = {
+        rtt_percentile(&rtt_monitors[0], 50),
+        rtt_percentile(&rtt_monitors[0], 99),
+        rtt_clock_offset(&rtt_monitors[0]),
+        rtt_percentile(&rtt_monitors[1], 50),
+        rtt_percentile(&rtt_monitors[1], 99)};
+    for (int i = 0; i < NUM_RTT_PARAMS; i++) {
+        param_val_t stat = {.p_i = rtt_stats[i]};
+        Param* param = custom->params[num_custom + 1 + NUM_QUEUE_PARAMS + i];
+        param->name = rtt_param_names[i];
+        set_param(param, PARAM__VAL_IVAL, &stat, custom_delta);
+    }
+    if (custom_delta->n_params > 0) {
+        arena.delta_device_ptrs[arena.delta_data.n_devices++] = custom_delta;
+    }
+
+    // pack what Dawn asked for, if it is connected
+    net_msg_t msg_type = DEVICE_DATA_MSG;
+    DevData* dev_data = &arena.dev_data;  // NULL for packed values
+    *dawn_msg = NULL;
+    if (queue != NULL) {
+        if (keyframe) {
+            msg_type = (mode == DEV_DATA_VALUES) ? DEVICE_SCHEMA_MSG : DEVICE_DATA_MSG;
+            arena.keyframe_needed = false;
+            arena.last_keyframe = now;
+        } else if (mode == DEV_DATA_DELTAS) {
+            msg_type = DEVICE_DATA_DELTA_MSG;
+            dev_data = &arena.delta_data;
+        } else {
+            msg_type = DEVICE_VALUES_MSG;
+            dev_data = NULL;
+        }
+        *dawn_msg = pack_dev_data_msg(msg_type, dev_data);
+    }
+
+    // observers get the full DevData, which is only packed again if Dawn got something else
+    *observer_msg = NULL;
+    if (observed && *dawn_msg != NULL && msg_type == DEVICE_DATA_MSG && dev_data == &arena.dev_data) {
+        (*dawn_msg)->refs++;  // a reference for each
+        *observer_msg = *dawn_msg;
+    } else if (observed) {
+        *observer_msg = pack_dev_data_msg(DEVICE_DATA_MSG, &arena.dev_data);
+    }
+}
+
+int send_device_data(send_queue_t* queue, uint64_t dawn_start_time) {
+    shared_msg_t* msg;
+    shared_msg_t* observer_msg;
+    pack_device_data(queue, false, dawn_start_time, &msg, &observer_msg);
+    int ret = send_queue_push_shared(queue, SEND_NEWEST_WINS, msg);
+    shared_msg_release(msg);
+    return ret;
 }
 
 // **************************************** RECEIVE MESSAGES ***************************************** //
 
+#define RX_ARENA_SIZE 4096  // Initial size of the block that received messages are unpacked into
+
+/*
+ * Bump allocator that every received message is unpacked into, so the receive path doesn't allocate.
+ * Allocating just moves past the bytes in use, freeing does nothing, and the whole arena is reset
+ * once the message is processed. A message that doesn't fit spills into separately malloc'ed chunks,
+ * and the block grows on the next reset, so only the first messages of a new size allocate.
+ */
+static struct {
+    uint8_t* block;     // current block, allocated on the first message
+    size_t size;        // size of block
+    size_t used;        // bytes of block in use
+    void* overflow;     // malloc'ed chunks that didn't fit in block, each starting with a pointer to the previous one
+    size_t overflowed;  // bytes requested from chunks since the last reset
+} rx_arena;
+
+// ProtobufCAllocator.alloc for the receive arena; returns NULL if out of memory
+static void* rx_alloc(void* allocator_data, size_t size) {
+    size_t align = _Alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+    if (rx_arena.used + size <= rx_arena.size) {
+        void* ptr = rx_arena.block + rx_arena.used;
+        rx_arena.used += size;
+        return ptr;
+    }
+    uint8_t* chunk = malloc(align + size);  // the pointer to the previous chunk, padded to keep the rest aligned
+    if (chunk == NULL) {
+        log_printf(ERROR, "rx_alloc: Failed to malloc %zu bytes to unpack message", size);
+        return NULL;
+    }
+    memcpy(chunk, &rx_arena.overflow, sizeof(void*));
+    rx_arena.overflow = chunk;
+    rx_arena.overflowed += size;
+    return chunk + align;
+}
+
+// ProtobufCAllocator.free for the receive arena; everything is freed by rx_reset()
+static void rx_free(void* allocator_data, void* ptr) {
+    // nothing to do until the arena is reset
+}
+
+static ProtobufCAllocator rx_allocator = {.alloc = rx_alloc, .free = rx_free, .allocator_data = NULL};
+
+/*
+ * Frees everything unpacked since the last reset, and grows the block if anything didn't fit.
+ */
+static void rx_reset() {
+    while (rx_arena.overflow != NULL) {
+        void* prev;
+        memcpy(&prev, rx_arena.overflow, sizeof(void*));
+        free(rx_arena.overflow);
+        rx_arena.overflow = prev;
+    }
+    if (rx_arena.block == NULL || rx_arena.overflowed > 0) {
+        size_t needed = rx_arena.used + rx_arena.overflowed;
+        size_t new_size = (rx_arena.size == 0) ? RX_ARENA_SIZE : rx_arena.size;
+        while (new_size < needed) {
+            new_size *= 2;
+        }
+        free(rx_arena.block);
+        rx_arena.block = malloc(new_size);
+        if (rx_arena.block == NULL) {
+            log_printf(FATAL, "rx_reset: Failed to malloc receive arena of size %zu", new_size);
+            exit(1);
+        }
+        rx_arena.size = new_size;
+    }
+    rx_arena.used = 0;
+    rx_arena.overflowed = 0;
+}
+
 /*
  * Processes new run mode message from client and reacts appropriately
  * Arguments:
@@ -275,7 +662,7 @@ void send_device_data(int dawn_socket_fd, uint64_t dawn_start_time) {
  *     -1 on error unpacking message
  */
 static int process_run_mode_msg(uint8_t* buf, uint16_t len_pb, robot_desc_field_t client) {
-    RunMode* run_mode_msg = run_mode__unpack(NULL, len_pb, buf);
+    RunMode* run_mode_msg = run_mode__unpack(&rx_allocator, len_pb, buf);
     if (run_mode_msg == NULL) {
         log_printf(ERROR, "recv_new_msg: Cannot unpack run_mode msg");
         return -1;
@@ -306,7 +693,6 @@ static int process_run_mode_msg(uint8_t* buf, uint16_t len_pb, robot_desc_field_
             log_printf(ERROR, "recv_new_msg: requested robot to enter invalid robot mode %s", run_mode_msg->mode);
             break;
     }
-    run_mode__free_unpacked(run_mode_msg, NULL);
 
     return 0;
 }
@@ -321,7 +707,7 @@ static int process_run_mode_msg(uint8_t* buf, uint16_t len_pb, robot_desc_field_
  *     -1 on error unpacking message
  */
 static int process_start_pos_msg(uint8_t* buf, uint16_t len_pb) {
-    StartPos* start_pos_msg = start_pos__unpack(NULL, len_pb, buf);
+    StartPos* start_pos_msg = start_pos__unpack(&rx_allocator, len_pb, buf);
     if (start_pos_msg == NULL) {
         log_printf(ERROR, "recv_new_msg: Cannot unpack start_pos msg");
         return -1;
@@ -341,7 +727,6 @@ static int process_start_pos_msg(uint8_t* buf, uint16_t len_pb) {
             log_printf(ERROR, "recv_new_msg: trying to enter unknown start position %d", start_pos_msg->pos);
             break;
     }
-    start_pos__free_unpacked(start_pos_msg, NULL);
 
     return 0;
 }
@@ -356,7 +741,7 @@ static int process_start_pos_msg(uint8_t* buf, uint16_t len_pb) {
  *     -1 on error unpacking message
  */
 static int process_game_state_msg(uint8_t* buf, uint16_t len_pb) {
-    GameState* game_state_msg = game_state__unpack(NULL, len_pb, buf);
+    GameState* game_state_msg = game_state__unpack(&rx_allocator, len_pb, buf);
     if (game_state_msg == NULL) {
         log_printf(ERROR, "recv_new_msg: Cannot unpack game_state msg");
         return -1;
@@ -381,31 +766,38 @@ static int process_game_state_msg(uint8_t* buf, uint16_t len_pb) {
         default:
             log_printf(ERROR, "requested gamestate to enter invalid state %s", game_state_msg->state);
     }
-    game_state__free_unpacked(game_state_msg, NULL);
 
     return 0;
 }
 
 /*
- * Processes new time stamp message from client and reacts appropriately
+ * Processes new time stamp message from client and reacts appropriately: an answer to a probe (see send_rtt_probe())
+ * is recorded by the client's round trip time monitor, and anything else is sent back with our time
  * Arguments:
- *    - int conn_fd: file descriptor of socket to send timestamp message back to Dawn
+ *    - send_queue_t *queue: send queue of the connection to send timestamp message back on
+ *    - robot_desc_field_t client: DAWN or SHEPHERD
  *    - uint8_t *buf: buffer containing packed protobuf with run mode message
  *    - uint16_t len_pb: length of buf
  * Returns:
  *      0 on success (message was processed correctly)
- *     -1 on error unpacking message
+ *     -1 if sending the reply failed
+ *     -2 on error unpacking message
  */
-static int process_time_stamp_msg(int conn_fd, uint8_t* buf, uint16_t len_pb) {
-    TimeStamps* time_stamp_msg = time_stamps__unpack(NULL, len_pb, buf);
+static int process_time_stamp_msg(send_queue_t* queue, robot_desc_field_t client, uint8_t* buf, uint16_t len_pb) {
+    uint64_t now = monotonic_micros();  // before unpacking, which only adds to the round trip
+    uint64_t wall_now = micros();
+    TimeStamps* time_stamp_msg = time_stamps__unpack(&rx_allocator, len_pb, buf);
     if (time_stamp_msg == NULL) {
         log_printf(ERROR, "recv_new_msg: Cannot unpack time_stamp msg");
-        return -1;
+        return -2;
     }
-    send_timestamp_msg(conn_fd, time_stamp_msg);
-    time_stamps__free_unpacked(time_stamp_msg, NULL);
-
-    return 0;
+    if (time_stamp_msg->runtime_timestamp != 0) {
+        if (rtt_probe_reply(&rtt_monitors[client == SHEPHERD], time_stamp_msg->runtime_timestamp, time_stamp_msg->dawn_timestamp, now, wall_now) != 0) {
+            log_printf(DEBUG, "recv_new_msg: Ignoring time stamp that doesn't answer the latest probes");
+        }
+        return 0;
+    }
+    return send_timestamp_msg(queue, time_stamp_msg);
 }
 
 /*
@@ -418,7 +810,7 @@ static int process_time_stamp_msg(int conn_fd, uint8_t* buf, uint16_t len_pb) {
  *     -1 on error unpacking message
  */
 static int process_inputs_msg(uint8_t* buf, uint16_t len_pb) {
-    UserInputs* inputs = user_inputs__unpack(NULL, len_pb, buf);
+    UserInputs* inputs = user_inputs__unpack(&rx_allocator, len_pb, buf);
     if (inputs == NULL) {
         log_printf(ERROR, "recv_new_msg: Failed to unpack UserInputs");
         return -1;
@@ -438,33 +830,25 @@ static int process_inputs_msg(uint8_t* buf, uint16_t len_pb) {
             log_printf(INFO, "recv_new_msg: Received keyboard disconnected from Dawn!!");
         }
     }
-    user_inputs__free_unpacked(inputs, NULL);
 
     return 0;
 }
 
 /*
- * Receives new message from client on TCP connection and processes the message.
+ * Processes a message received from a client on its TCP connection.
  * Arguments:
- *    - int conn_fd: socket connection's file descriptor from which to read the message
+ *    - send_queue_t *queue: send queue of the connection on which the message was received (and replies are sent)
  *    - robot_desc_field_t client: DAWN or SHEPHERD, depending on which connection is being handled
- * Returns: pointer to integer in which return status will be stored
- *      0 if message received and processed
- *     -1 if message could not be parsed because client disconnected and connection closed
+ *    - net_msg_t msg_type: type of the message, from its header
+ *    - uint8_t *buf: serialized message (without its header); still owned by the caller
+ *    - uint16_t len_pb: length of BUF
+ * Returns:
+ *      0 if message processed
+ *     -1 if sending a reply failed; the connection should be closed
  *     -2 if message could not be unpacked or other error
  */
-int recv_new_msg(int conn_fd, robot_desc_field_t client) {
-    net_msg_t msg_type;  // message type
-    uint16_t len_pb;     // length of incoming serialized protobuf message
-    uint8_t* buf;        // buffer to read raw data into
-    int ret = 0;         // return status OK by default
-
-    int err = parse_msg(conn_fd, &msg_type, &len_pb, &buf);
-    if (err == 0) {  // Means there is EOF while reading which means client disconnected
-        return -1;
-    } else if (err == -1) {  // Means there is some other error while reading
-        return -2;
-    }
+int process_new_msg(send_queue_t* queue, robot_desc_field_t client, net_msg_t msg_type, uint8_t* buf, uint16_t len_pb) {
+    int ret = 0;  // return status OK by default
 
     // unpack according to message
     switch (msg_type) {
@@ -487,9 +871,9 @@ int recv_new_msg(int conn_fd, robot_desc_field_t client) {
             }
             break;
         case TIME_STAMP_MSG:
-            if (process_time_stamp_msg(conn_fd, buf, len_pb) != 0) {
+            ret = process_time_stamp_msg(queue, client, buf, len_pb);
+            if (ret == -2) {
                 log_printf(ERROR, "recv_new_msg: error processing time stamp");
-                ret = -2;
             }
             break;
         case INPUTS_MSG:
@@ -498,10 +882,38 @@ int recv_new_msg(int conn_fd, robot_desc_field_t client) {
                 ret = -2;
             }
             break;
+        case DEVICE_DATA_DELTA_MSG:
+        case DEVICE_SCHEMA_MSG:
+            if (client != DAWN) {
+                log_printf(ERROR, "recv_new_msg: only Dawn receives device data, ignoring request from client %d", client);
+                ret = -2;
+                break;
+            }
+            log_printf(DEBUG, "Dawn requested device data %s", (msg_type == DEVICE_SCHEMA_MSG) ? "values" : "deltas");
+            arena.keyframe_needed = true;
+            arena.mode = (msg_type == DEVICE_SCHEMA_MSG) ? DEV_DATA_VALUES : DEV_DATA_DELTAS;
+            break;
+        case RTT_PROBE_MSG:
+            log_printf(DEBUG, "Client %d requested round trip time probes", client);
+            rtt_request_probes(&rtt_monitors[client == SHEPHERD]);
+            break;
+        case DEVICE_DATA_RATE_MSG: {
+            uint16_t intervals[2];  // min and max ms between two messages
+            if (client != DAWN || len_pb != sizeof(intervals)) {
+                log_printf(ERROR, "recv_new_msg: ignoring invalid device data rate request from client %d", client);
+                ret = -2;
+                break;
+            }
+            memcpy(intervals, buf, sizeof(intervals));
+            arena.min_interval = (intervals[0] < DEVICE_DATA_CHECK_INTERVAL) ? DEVICE_DATA_CHECK_INTERVAL : intervals[0];
+            arena.max_interval = (intervals[1] != 0 && intervals[1] < arena.min_interval) ? arena.min_interval : intervals[1];
+            log_printf(DEBUG, "Dawn requested device data no more than every %d ms, and at least every %d ms (0 is only on changes)", arena.min_interval, arena.max_interval);
+            break;
+        }
         default:
             log_printf(ERROR, "recv_new_msg: unknown message type %d", msg_type);
-            return -2;
+            ret = -2;
     }
-    free(buf);
+    rx_reset();  // nothing that was unpacked is used after this
     return ret;
 }
@@ -1,38 +1,118 @@
 #include <net_util.h>
+#include <rtt_monitor.h>
+#include <send_queue.h>
 
 /*
- * Send a log message on the TCP connection to the client. Reads lines from the pipe until there is no more data
- * or it has read MAX_NUM_LOGS lines from the pipe, packages the message, and sends it.
+ * Packs a log message for the clients that receive logs. Reads lines from the pipe until there is no more data
+ * or it has read MAX_NUM_LOGS lines from the pipe, and packages them in a single message. The message is packed once,
+ * and pushed to every client's send queue with SEND_COALESCE: logs that are still waiting to be sent are coalesced
+ * with it, and dropped oldest first if the client falls too far behind.
  * Arguments:
- *    - int conn_fd: socket connection's file descriptor on which to write to the TCP port
+ *    - FILE *log_file: the log FIFO
+ * Returns:
+ *    - the message, which the caller pushes to the send queues and then releases (see shared_msg_release())
+ *    - NULL if there were no logs to send
  */
-void send_log_msg(int conn_fd, FILE* log_file);
+shared_msg_t* pack_log_msg(FILE* log_file);
 
 /*
 * Send a timestamp message over TCP with a timestamp attached to the message. The timestamp is when the net_handler on runtime has received the
 * packet and processed it.
+* Timestamps are never dropped from the send queue.
 * Arguments:
-    - int conn_fd: socket connection's file descriptor on which to write to the TCP port
+    - send_queue_t* queue: send queue of the client's connection
     - TimeStamps* dawn_timestamp_msg: Unpacked timestamp_proto from Dawn
+* Returns:
+    - 0 if the message was queued
+    - -1 if the client is too far behind or sending on the socket failed
 */
-void send_timestamp_msg(int conn_fd, TimeStamps* dawn_timestamp_msg);
+int send_timestamp_msg(send_queue_t* queue, TimeStamps* dawn_timestamp_msg);
+
+/*
+ * Sends a client a round trip time probe if one is due (see rtt_monitor.h): a TimeStamps whose runtime_timestamp
+ * identifies the probe and whose dawn_timestamp is 0. The client answers by sending it back with dawn_timestamp
+ * set to its own time in ms, and process_new_msg() records the round trip. Probes are never dropped from the send queue.
+ * A client is only sent probes once it asked for them with an RTT_PROBE_MSG on its current connection, since
+ * one that doesn't know about them would take them for replies to its own TimeStamps.
+ * Arguments:
+ *    - send_queue_t* queue: send queue of the client's connection
+ *    - robot_desc_field_t client: DAWN or SHEPHERD
+ * Returns:
+ *    - 0 if the probe was queued or none was due
+ *    - -1 if the client is too far behind or sending on the socket failed
+ */
+int send_rtt_probe(send_queue_t* queue, robot_desc_field_t client);
+
+/*
+ * Forgets the round trips to a client, and ignores answers to the probes sent before.
+ * Should be called whenever the client connects or disconnects.
+ * Arguments:
+ *    - robot_desc_field_t client: DAWN or SHEPHERD
+ */
+void reset_rtt(robot_desc_field_t client);
 
 /**
- * Sends a Device Data message to Dawn.
+ * Packs the Device Data messages that are due: the one for Dawn, in the format it asked for (see reset_device_data()),
+ * and a full DevData for observers. Each is packed once into a shared message that the caller pushes to every send queue
+ * it is for (with SEND_NEWEST_WINS). CustomData ends with the readonly params describing Dawn's send queue (see send_device_data()).
  * Arguments:
- *    - int dawn_socket_fd: socket fd for Dawn connection
+ *    - send_queue_t *queue: send queue of the Dawn connection, or NULL if Dawn isn't connected
+ *    - bool observed: whether any observers are connected
  *    - uint64_t dawn_start_time: time that Dawn connection started, for calculating time in CustomData
+ *    - shared_msg_t **dawn_msg: set to the message for Dawn, or NULL if QUEUE is NULL
+ *    - shared_msg_t **observer_msg: set to the DEVICE_DATA_MSG for observers, or NULL if there are none. This is the same
+ *      message as DAWN_MSG whenever Dawn gets a full DevData too, with a reference for each; the caller releases both.
+ */
+void pack_device_data(send_queue_t* queue, bool observed, uint64_t dawn_start_time, shared_msg_t** dawn_msg, shared_msg_t** observer_msg);
+
+/**
+ * Sends a Device Data message to Dawn, replacing the previous one if it is still waiting in the send queue.
+ * CustomData ends with readonly params describing the send queue: queue_bytes, queue_max_bytes,
+ * queue_replaced, and queue_dropped (see send_queue_stats_t); then the round trips (see send_rtt_probe()):
+ * rtt_p50_us, rtt_p99_us, and clock_offset_ms of Dawn, and shepherd_rtt_p50_us and shepherd_rtt_p99_us
+ * (-1 until a probe has been answered).
+ * Arguments:
+ *    - send_queue_t *queue: send queue of the Dawn connection
+ *    - uint64_t dawn_start_time: time that Dawn connection started, for calculating time in CustomData
+ * Returns:
+ *    - 0 if the message was queued
+ *    - -1 if Dawn is too far behind or sending on the socket failed
+ */
+int send_device_data(send_queue_t* queue, uint64_t dawn_start_time);
+
+/**
+ * Returns whether a Device Data message should be sent to Dawn now. One is due as soon as any device data or
+ * custom log data changed in shared memory (see get_data_generation()), but no sooner than the min interval
+ * after the last one; and regardless of changes once the max interval has passed (unless it is 0).
+ * Dawn negotiates the intervals with a DEVICE_DATA_RATE_MSG whose payload is the min and max in ms
+ * (two uint16_t in host byte order, like the message header); the min is at least DEVICE_DATA_CHECK_INTERVAL.
+ * Until then, they are DEVICE_DATA_INTERVAL and DEVICE_DATA_IDLE_INTERVAL.
+ */
+bool device_data_due();
+
+/**
+ * Goes back to sending full Device Data messages at the default rate, for a new Dawn connection.
+ * A Dawn can ask for smaller messages with an empty DEVICE_DATA_DELTA_MSG or DEVICE_SCHEMA_MSG. After either,
+ * send_device_data() sends a full DevData, then only sends another one whenever the devices change:
+ *    - after DEVICE_DATA_DELTA_MSG, as a DEVICE_DATA_MSG followed by deltas (DEVICE_DATA_DELTA_MSG) that only contain
+ *      the devices and params that changed, with a full DevData at least every DEVICE_DATA_KEYFRAME_INTERVAL ms
+ *    - after DEVICE_SCHEMA_MSG, as a DEVICE_SCHEMA_MSG followed by the packed values of every device (DEVICE_VALUES_MSG)
  */
-void send_device_data(int dawn_socket_fd, uint64_t dawn_start_time);
+void reset_device_data();
 
 /*
- * Receives new message from client on TCP connection and processes the message.
+ * Processes a message received from a client on its TCP connection.
+ * Messages are unpacked into an arena that is reset before returning, so once it has grown to fit
+ * the messages a client sends, processing them doesn't allocate.
  * Arguments:
- *    - int conn_fd: socket connection's file descriptor from which to read the message
+ *    - send_queue_t *queue: send queue of the connection on which the message was received (and replies are sent)
  *    - robot_desc_field_t client: DAWN or SHEPHERD, depending on which connection is being handled
- * Returns: pointer to integer in which return status will be stored
- *      0 if message received and processed
- *     -1 if message could not be parsed because client disconnected and connection closed
+ *    - net_msg_t msg_type: type of the message, from its header
+ *    - uint8_t *buf: serialized message (without its header); still owned by the caller
+ *    - uint16_t len_pb: length of BUF
+ * Returns:
+ *      0 if message processed
+ *     -1 if sending a reply failed; the connection should be closed
  *     -2 if message could not be unpacked or other error
  */
-int recv_new_msg(int conn_fd, robot_desc_field_t client);
+int process_new_msg(send_queue_t* queue, robot_desc_field_t client, net_msg_t msg_type, uint8_t* buf, uint16_t len_pb);
@@ -6,13 +6,17 @@ uint8_t* make_buf(net_msg_t msg_type, uint16_t len_pb) {
         log_printf(FATAL, "make_buf: Failed to malloc");
         exit(1);
     }
-    *send_buf = (uint8_t) msg_type;  // Can cast since we know net_msg_t has < 10 options
-    uint16_t* ptr_16 = (uint16_t*) (send_buf + 1);
-    *ptr_16 = len_pb;
-    // log_printf(DEBUG, "prepped buffer, len %d, ptr16 %d, msg_type %d, send buf %d %d %d", len_pb, *ptr_16, msg_type, *send_buf, *(send_buf+1), *(send_buf+2));
+    set_buf_header(send_buf, msg_type, len_pb);
+    // log_printf(DEBUG, "prepped buffer, len %d, msg_type %d, send buf %d %d %d", len_pb, msg_type, *send_buf, *(send_buf+1), *(send_buf+2));
     return send_buf;
 }
 
+void set_buf_header(uint8_t* buf, net_msg_t msg_type, uint16_t len_pb) {
+    *buf = (uint8_t) msg_type;  // Can cast since we know net_msg_t has < 10 options
+    uint16_t* ptr_16 = (uint16_t*) (buf + 1);
+    *ptr_16 = len_pb;
+}
+
 int parse_msg(int fd, net_msg_t* msg_type, uint16_t* len_pb, uint8_t** buf) {
     int result;
     uint8_t type;
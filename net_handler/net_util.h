@@ -28,10 +28,22 @@
 
 #define RASPI_ADDR "127.0.0.1"  // The IP address of Runtime (Raspberry Pi) that clients can request a connection to
 #define RASPI_TCP_PORT 8101     // Port for Runtime as a TCP socket server
+#define RASPI_UDP_PORT 9000     // Port on which Runtime receives user inputs from Dawn over UDP (see INPUTS_MSG)
 
 #define MAX_NUM_LOGS 16  // Maximum number of logs that can be sent in one msg
 
+#define MAX_OBSERVERS 8  // Maximum number of read-only observer clients (client ID 2) connected at once
+
+#define DEVICE_DATA_CHECK_INTERVAL 5        // Ms between checks of shared memory for device data changes to send to Dawn
+#define DEVICE_DATA_INTERVAL 10             // Default min ms between two device data messages (i.e. max rate) when values keep changing
+#define DEVICE_DATA_IDLE_INTERVAL 1000      // Default max ms between two device data messages when nothing changes (0 is never)
+#define DEVICE_DATA_KEYFRAME_INTERVAL 5000  // Max ms between two full DevData messages to a Dawn that receives deltas
+
 #define BUFFER_OFFSET 3  // Num bytes at the beginning of a buffer for metadata (message type and length) See net_util::make_buf()
+#define UDP_SEQ_SIZE 4   // Num bytes of the sequence number between the header and the UserInputs of an INPUTS_MSG datagram
+
+#define UDP_SILENCE_TIMEOUT 100  // Ms without UDP inputs from Dawn after which its TCP inputs are applied again, and its UDP sequence may restart
+#define UDP_SEQ_RESYNC_GAP 256   // A datagram at least this far behind the last sequence number applied restarts the sequence (Dawn reopened its socket)
 
 // All the different possible messages the network handler works with. The order must be the same between net_handler and clients
 typedef enum net_msg {
@@ -40,8 +52,13 @@ typedef enum net_msg {
     LOG_MSG,
     DEVICE_DATA_MSG,
     GAME_STATE_MSG,
-    INPUTS_MSG,  // used for converter testing; remove after 2021 Spring Comp...maybe
-    TIME_STAMP_MSG
+    INPUTS_MSG,  // from Dawn over TCP, or over UDP as a datagram with a uint32_t sequence number (host byte order) between the header and the UserInputs
+    TIME_STAMP_MSG,
+    DEVICE_DATA_DELTA_MSG,  // from Dawn (empty): requests deltas; to Dawn: DevData with only the changed devices and params
+    DEVICE_SCHEMA_MSG,      // from Dawn (empty): requests values only; to Dawn: full DevData that DEVICE_VALUES_MSGs follow
+    DEVICE_VALUES_MSG,      // to Dawn: packed values of every device in the last DEVICE_SCHEMA_MSG (not a protobuf)
+    DEVICE_DATA_RATE_MSG,   // from Dawn: min and max ms between device data messages (two uint16_t, not a protobuf)
+    RTT_PROBE_MSG           // from Dawn or Shepherd (empty): requests round trip time probes, which are sent as TIME_STAMP_MSGs
 } net_msg_t;
 
 // ******************************************* USEFUL UTIL FUNCTIONS ******************************* //
@@ -58,6 +75,16 @@ typedef enum net_msg {
  */
 uint8_t* make_buf(net_msg_t msg_type, uint16_t len_pb);
 
+/*
+ * Sets the first BUFFER_OFFSET bytes of a caller-owned buffer for a packed protobuf message of the specified type and length.
+ * Use this instead of make_buf() to reuse a buffer across messages.
+ * Arguments:
+ *    - uint8_t *buf: buffer with room for at least len_pb + BUFFER_OFFSET bytes
+ *    - net_msg_t msg_type: one of the message types defined in net_util.h
+ *    - unsigned len_pb: length of the serialized bytes returned by the protobuf function *__get_packed_size()
+ */
+void set_buf_header(uint8_t* buf, net_msg_t msg_type, uint16_t len_pb);
+
 /*
  * Parses a message from the given file descriptor into its separate components and stores them in provided pointers
  * Arguments:
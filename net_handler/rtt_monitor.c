@@ -0,0 +1,87 @@
+#include <rtt_monitor.h>
+
+#include <string.h>  // for memset
+
+// Returns the histogram bucket of a round trip of RTT us, which is less than 2^RTT_MAX_BITS
+static int bucket_of(uint32_t rtt) {
+    if (rtt < 4) {
+        return rtt;
+    }
+    int msb = 31 - __builtin_clz(rtt);
+    return 4 * (msb - 1) + ((rtt >> (msb - 2)) & 3);
+}
+
+// Returns the largest round trip, in us, that falls in a histogram bucket
+static uint32_t bucket_max(int bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    int shift = bucket / 4 - 1;
+    return ((uint32_t) (4 + bucket % 4) << shift) + ((uint32_t) 1 << shift) - 1;
+}
+
+void rtt_reset(rtt_monitor_t* rtt, uint64_t now) {
+    memset(rtt, 0, sizeof(rtt_monitor_t));
+    rtt->last_reply = now;
+}
+
+void rtt_request_probes(rtt_monitor_t* rtt) {
+    rtt->requested = true;
+}
+
+uint64_t rtt_start_probe(rtt_monitor_t* rtt, uint64_t now) {
+    if (!rtt->requested || (rtt->probes_sent > 0 && now - rtt->last_probe < RTT_PROBE_INTERVAL * 1000)) {
+        return 0;
+    }
+    rtt->last_probe = now;
+    rtt->probes_sent++;
+    return now;
+}
+
+int rtt_probe_reply(rtt_monitor_t* rtt, uint64_t id, uint64_t client_time, uint64_t now, uint64_t wall_now) {
+    // Answers arrive in the order the probes were sent, so each one must be newer than the last
+    if (rtt->probes_sent == 0 || id <= rtt->last_reply || id > rtt->last_probe || now < id || now - id >= (1 << RTT_MAX_BITS)) {
+        return -1;
+    }
+    rtt->last_reply = id;
+    rtt->replies++;
+
+    // replace the oldest round trip in the window once it is full
+    uint32_t round_trip = now - id;
+    if (rtt->num_samples == RTT_WINDOW) {
+        rtt->counts[bucket_of(rtt->rtts[rtt->next])]--;
+    } else {
+        rtt->num_samples++;
+    }
+    rtt->rtts[rtt->next] = round_trip;
+    rtt->offsets[rtt->next] = (int64_t) client_time - (int64_t) ((wall_now - round_trip / 2) / 1000);
+    rtt->counts[bucket_of(round_trip)]++;
+    rtt->next = (rtt->next + 1) % RTT_WINDOW;
+    return 0;
+}
+
+int32_t rtt_percentile(rtt_monitor_t* rtt, int percent) {
+    if (rtt->num_samples == 0) {
+        return -1;
+    }
+    // the smallest bucket that the given percent of round trips are in or below (rounding up)
+    int rank = (rtt->num_samples * percent + 99) / 100;
+    int seen = 0;
+    for (int i = 0; i < RTT_NUM_BUCKETS; i++) {
+        seen += rtt->counts[i];
+        if (seen >= rank && seen > 0) {
+            return bucket_max(i);
+        }
+    }
+    return bucket_max(RTT_NUM_BUCKETS - 1);
+}
+
+int64_t rtt_clock_offset(rtt_monitor_t* rtt) {
+    int fastest = -1;
+    for (int i = 0; i < rtt->num_samples; i++) {
+        if (fastest == -1 || rtt->rtts[i] < rtt->rtts[fastest]) {
+            fastest = i;
+        }
+    }
+    return (fastest == -1) ? 0 : rtt->offsets[fastest];
+}
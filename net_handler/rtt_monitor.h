@@ -0,0 +1,93 @@
+/**
+ * Round-trip time monitor of a client connection.
+ * Once a client asks for them, net handler periodically sends it a probe: a TimeStamps whose runtime_timestamp
+ * identifies the probe (the time it was sent, in microseconds on a monotonic clock) and whose dawn_timestamp is 0.
+ * The client answers by sending it back with dawn_timestamp set to its own time in milliseconds. Each answer gives
+ * a round trip, measured on the monotonic clock so that the wall clock being set doesn't skew it, which goes into
+ * a histogram of the latest RTT_WINDOW round trips. It also gives an estimate of the offset of the client's clock:
+ * the client's time minus our wall clock time halfway through the round trip. The offset reported is the one from
+ * the fastest round trip in the window, whose estimate is the most accurate.
+ *
+ * Histogram buckets are log-linear: exact below 4 us, then 4 buckets per power of two, so a percentile
+ * is within 25% of the actual round trip. Monitors are only used from net handler's event loop, so they are not locked.
+ */
+
+#ifndef RTT_MONITOR_H
+#define RTT_MONITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RTT_PROBE_INTERVAL 500  // ms between the probes sent to a client
+#define RTT_WINDOW 64           // number of latest round trips that the percentiles and the clock offset are computed from
+#define RTT_MAX_BITS 24         // round trips are measured up to 2^RTT_MAX_BITS us (about 16 s); longer ones are ignored
+#define RTT_NUM_BUCKETS (4 * (RTT_MAX_BITS - 1))
+
+typedef struct {
+    bool requested;                    // whether the client asked for probes; none are started until it does
+    uint64_t last_probe;               // id of the last probe sent (see rtt_start_probe())
+    uint64_t last_reply;               // id of the last probe answered, or when the monitor was reset
+    uint16_t counts[RTT_NUM_BUCKETS];  // number of round trips in the window that fall in each bucket
+    uint32_t rtts[RTT_WINDOW];         // round trips in the window (us), oldest at next once the window is full
+    int64_t offsets[RTT_WINDOW];       // clock offset (ms) estimated from each round trip
+    int num_samples;                   // number of round trips in the window
+    int next;                          // index in rtts of the next round trip
+    uint64_t probes_sent;              // probes sent since the monitor was reset
+    uint64_t replies;                  // probes answered since the monitor was reset
+} rtt_monitor_t;
+
+/**
+ * Empties a monitor for a new connection; answers to probes sent before are ignored, and no probes are started
+ * until the client asks for them again.
+ * Arguments:
+ *    rtt: the monitor
+ *    now: current time in us, from a monotonic clock
+ */
+void rtt_reset(rtt_monitor_t* rtt, uint64_t now);
+
+/**
+ * Starts sending probes to the client, which asked for them.
+ * Arguments:
+ *    rtt: the monitor
+ */
+void rtt_request_probes(rtt_monitor_t* rtt);
+
+/**
+ * Starts a probe if one is due, i.e. the client asked for probes and it has been RTT_PROBE_INTERVAL ms since the last one.
+ * Arguments:
+ *    rtt: the monitor
+ *    now: current time in us, from a monotonic clock
+ * Returns:
+ *    the id of the probe to send, as the runtime_timestamp of a TimeStamps, or
+ *    0 if no probe is due
+ */
+uint64_t rtt_start_probe(rtt_monitor_t* rtt, uint64_t now);
+
+/**
+ * Records the answer to a probe.
+ * Arguments:
+ *    rtt: the monitor
+ *    id: runtime_timestamp of the answer
+ *    client_time: dawn_timestamp of the answer; the client's time in ms when it answered
+ *    now: current time in us, from the same monotonic clock as the probe's id
+ *    wall_now: current time, from micros(); only used to estimate the client's clock offset
+ * Returns:
+ *    0 if the answer was recorded, or
+ *    -1 if it doesn't answer a probe sent since the last one answered (or took too long)
+ */
+int rtt_probe_reply(rtt_monitor_t* rtt, uint64_t id, uint64_t client_time, uint64_t now, uint64_t wall_now);
+
+/**
+ * Returns an upper bound of a percentile of the round trips in the window, in us, or -1 if there are none.
+ * Arguments:
+ *    rtt: the monitor
+ *    percent: the percentile, from 0 to 100
+ */
+int32_t rtt_percentile(rtt_monitor_t* rtt, int percent);
+
+/**
+ * Returns the estimated offset of the client's clock in ms (its time minus ours), or 0 if there are no round trips.
+ */
+int64_t rtt_clock_offset(rtt_monitor_t* rtt);
+
+#endif
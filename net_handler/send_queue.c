@@ -0,0 +1,264 @@
+#include <send_queue.h>
+
+// Shared messages that aren't in use, with their buffers kept for reuse
+static shared_msg_t* shared_pool = NULL;
+
+// Returns the bytes of a queued message, wherever they are
+static uint8_t* msg_bytes(queued_msg_t* queued) {
+    return (queued->shared != NULL) ? queued->shared->buf : queued->buf;
+}
+
+/*
+ * Stops a queued message from referencing a shared message, if it does.
+ * Arguments:
+ *    - queued_msg_t *queued: the queued message
+ */
+static void unref_msg(queued_msg_t* queued) {
+    if (queued->shared != NULL) {
+        shared_msg_release(queued->shared);
+        queued->shared = NULL;
+    }
+}
+
+/*
+ * Removes the message at index IDX from the waiting messages, keeping its buffer for reuse.
+ * Arguments:
+ *    - send_queue_t *queue: the queue
+ *    - int idx: index of the message in queue->msgs
+ */
+static void remove_msg(send_queue_t* queue, int idx) {
+    unref_msg(&queue->msgs[idx]);
+    queued_msg_t removed = queue->msgs[idx];
+    memmove(&queue->msgs[idx], &queue->msgs[idx + 1], (queue->num_msgs - idx - 1) * sizeof(queued_msg_t));
+    queue->num_msgs--;
+    queue->msgs[queue->num_msgs] = removed;  // the slot after the last waiting message is free again
+}
+
+/*
+ * Copies a message into a queued message that hasn't been written at all, growing its buffer if needed.
+ * A queued message that was shared gets its own copy first.
+ * Arguments:
+ *    - queued_msg_t *slot: the queued message to overwrite
+ *    - size_t offset: where in the queued message to copy to; the rest of the queued message is kept
+ *    - uint8_t *msg: bytes to copy
+ *    - size_t len: number of bytes to copy
+ */
+static void copy_msg(queued_msg_t* slot, size_t offset, uint8_t* msg, size_t len) {
+    if (slot->shared != NULL) {
+        shared_msg_t* shared = slot->shared;
+        slot->shared = NULL;
+        if (offset > 0) {
+            copy_msg(slot, 0, shared->buf, offset);
+        }
+        shared_msg_release(shared);
+    }
+    if (offset + len > slot->cap) {
+        slot->buf = realloc(slot->buf, offset + len);
+        if (slot->buf == NULL) {
+            log_printf(FATAL, "send_queue_push: Failed to realloc queued message of size %d", offset + len);
+            exit(1);
+        }
+        slot->cap = offset + len;
+    }
+    memcpy(slot->buf + offset, msg, len);
+    slot->len = offset + len;
+}
+
+/*
+ * Returns the index of the newest waiting message that hasn't been written at all, with the given policy and type,
+ * or -1 if there is none. A message like that may still be merged into, replaced, or dropped.
+ * Arguments:
+ *    - send_queue_t *queue: the queue
+ *    - send_policy_t policy: policy of the message to find
+ *    - int type: net_msg_t of the message to find, or -1 for any type
+ */
+static int find_unsent(send_queue_t* queue, send_policy_t policy, int type) {
+    for (int i = queue->num_msgs - 1; i >= 0; i--) {
+        queued_msg_t* queued = &queue->msgs[i];
+        if (queued->sent == 0 && queued->policy == policy && (type == -1 || msg_bytes(queued)[0] == type)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Drops the oldest SEND_COALESCE message that hasn't been written at all.
+ * Returns:
+ *    - true if a message was dropped, false if there was none to drop
+ */
+static bool drop_oldest(send_queue_t* queue) {
+    for (int i = 0; i < queue->num_msgs; i++) {
+        if (queue->msgs[i].sent == 0 && queue->msgs[i].policy == SEND_COALESCE) {
+            queue->stats.bytes -= queue->msgs[i].len;
+            remove_msg(queue, i);
+            queue->stats.msgs_dropped++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/************************ PUBLIC FUNCTIONS *************************/
+
+shared_msg_t* shared_msg_get(size_t len) {
+    // prefer a message whose buffer is already big enough, so that messages of different sizes don't keep growing each other's
+    shared_msg_t** prev = &shared_pool;
+    for (shared_msg_t** p = &shared_pool; *p != NULL; p = &(*p)->next) {
+        if ((*p)->cap >= len) {
+            prev = p;
+            break;
+        }
+    }
+    shared_msg_t* msg = *prev;
+    if (msg != NULL) {
+        *prev = msg->next;
+    } else if ((msg = calloc(1, sizeof(shared_msg_t))) == NULL) {
+        log_printf(FATAL, "shared_msg_get: Failed to malloc shared message");
+        exit(1);
+    }
+    if (len > msg->cap) {
+        msg->buf = realloc(msg->buf, len);
+        if (msg->buf == NULL) {
+            log_printf(FATAL, "shared_msg_get: Failed to realloc shared message of size %d", len);
+            exit(1);
+        }
+        msg->cap = len;
+    }
+    msg->len = len;
+    msg->refs = 1;
+    return msg;
+}
+
+void shared_msg_release(shared_msg_t* msg) {
+    if (--msg->refs == 0) {
+        msg->next = shared_pool;
+        shared_pool = msg;
+    }
+}
+
+void send_queue_clear(send_queue_t* queue) {
+    for (int i = 0; i < queue->num_msgs; i++) {
+        unref_msg(&queue->msgs[i]);
+    }
+    queue->num_msgs = 0;
+    queue->stats.bytes = 0;
+}
+
+void send_queue_reset(send_queue_t* queue, int fd) {
+    send_queue_clear(queue);
+    queue->fd = fd;
+    memset(&queue->stats, 0, sizeof(queue->stats));
+}
+
+/*
+ * Puts a message in a queued message that hasn't been written at all: references it if it is shared, and copies it otherwise.
+ * Arguments:
+ *    - queued_msg_t *slot: the queued message to overwrite
+ *    - uint8_t *msg: the message
+ *    - size_t len: length of MSG
+ *    - shared_msg_t *shared: the shared message that MSG is the buffer of, or NULL
+ */
+static void set_msg(queued_msg_t* slot, uint8_t* msg, size_t len, shared_msg_t* shared) {
+    unref_msg(slot);
+    if (shared != NULL) {
+        shared->refs++;
+        slot->shared = shared;
+        slot->len = len;
+    } else {
+        copy_msg(slot, 0, msg, len);
+    }
+}
+
+/*
+ * Queues a message as described by send_queue_push() and send_queue_push_shared().
+ * Arguments:
+ *    - send_queue_t *queue: the queue
+ *    - send_policy_t policy: what happens to the message if the client falls behind
+ *    - uint8_t *msg: the message, header included
+ *    - size_t len: length of MSG
+ *    - shared_msg_t *shared: the shared message that MSG is the buffer of, or NULL to copy MSG
+ */
+static int push_msg(send_queue_t* queue, send_policy_t policy, uint8_t* msg, size_t len, shared_msg_t* shared) {
+    int idx = (policy == SEND_RELIABLE) ? -1 : find_unsent(queue, policy, (policy == SEND_COALESCE) ? msg[0] : -1);
+    queued_msg_t* queued = (idx == -1) ? NULL : &queue->msgs[idx];
+
+    if (queued != NULL && policy == SEND_NEWEST_WINS) {
+        // the newer message takes the place of the waiting one
+        queue->stats.bytes -= queued->len;
+        set_msg(queued, msg, len, shared);
+        queue->stats.bytes += len;
+        queue->stats.msgs_replaced++;
+    } else if (queued != NULL && policy == SEND_COALESCE && queued->len + len - 2 * BUFFER_OFFSET <= SEND_QUEUE_COALESCE_MAX) {
+        // append the payload to the waiting message's, and fix the length in its header
+        copy_msg(queued, queued->len, msg + BUFFER_OFFSET, len - BUFFER_OFFSET);
+        set_buf_header(queued->buf, (net_msg_t) queued->buf[0], queued->len - BUFFER_OFFSET);
+        queue->stats.bytes += len - BUFFER_OFFSET;
+        queue->stats.msgs_coalesced++;
+    } else {
+        if (queue->num_msgs == SEND_QUEUE_MAX_MSGS && !drop_oldest(queue)) {
+            log_printf(ERROR, "send_queue_push: %d messages are already waiting to be sent on %d", SEND_QUEUE_MAX_MSGS, queue->fd);
+            return -1;
+        }
+        queued = &queue->msgs[queue->num_msgs++];
+        set_msg(queued, msg, len, shared);
+        queued->sent = 0;
+        queued->policy = policy;
+        queue->stats.bytes += len;
+    }
+
+    // over budget, older logs make way for newer ones
+    while (queue->stats.bytes > SEND_QUEUE_BUDGET) {
+        if (!drop_oldest(queue)) {
+            break;
+        }
+    }
+    if (queue->stats.bytes > queue->stats.max_bytes) {
+        queue->stats.max_bytes = queue->stats.bytes;
+    }
+    if (queue->stats.bytes > SEND_QUEUE_HARD_LIMIT) {
+        log_printf(ERROR, "send_queue_push: %d bytes are waiting to be sent on %d; client isn't reading", queue->stats.bytes, queue->fd);
+        return -1;
+    }
+    return send_queue_flush(queue);
+}
+
+int send_queue_push(send_queue_t* queue, send_policy_t policy, uint8_t* msg, size_t len) {
+    return push_msg(queue, policy, msg, len, NULL);
+}
+
+int send_queue_push_shared(send_queue_t* queue, send_policy_t policy, shared_msg_t* msg) {
+    return push_msg(queue, policy, msg->buf, msg->len, msg);
+}
+
+int send_queue_flush(send_queue_t* queue) {
+    while (queue->num_msgs > 0) {
+        queued_msg_t* head = &queue->msgs[0];
+        ssize_t n_sent = send(queue->fd, msg_bytes(head) + head->sent, head->len - head->sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n_sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;  // the rest is sent when the socket becomes writable
+            }
+            log_printf(ERROR, "send_queue_flush: sending on %d failed: %s", queue->fd, strerror(errno));
+            return -1;
+        }
+        head->sent += n_sent;
+        queue->stats.bytes -= n_sent;
+        if (head->sent == head->len) {
+            remove_msg(queue, 0);
+            queue->stats.msgs_sent++;
+        }
+    }
+    return 0;
+}
+
+bool send_queue_pending(send_queue_t* queue) {
+    return queue->num_msgs > 0;
+}
+
+int send_queue_replaceable_type(send_queue_t* queue) {
+    int idx = find_unsent(queue, SEND_NEWEST_WINS, -1);
+    return (idx == -1) ? -1 : msg_bytes(&queue->msgs[idx])[0];
+}
@@ -0,0 +1,148 @@
+/**
+ * Bounded, non-blocking output queue of a client connection.
+ * Messages are queued whole (header included) and written to the socket as it becomes writable,
+ * so a client that reads slowly never blocks net handler. Each message is queued with a policy
+ * that decides what happens to it when the client falls behind:
+ *
+ *    SEND_NEWEST_WINS: at most one of these is waiting at a time; a newer one replaces it (device data)
+ *    SEND_COALESCE:    merged into the previous one of the same type while it is waiting (up to SEND_QUEUE_COALESCE_MAX),
+ *                      and dropped oldest first once the queue holds more than SEND_QUEUE_BUDGET bytes (logs)
+ *    SEND_RELIABLE:    never dropped (timestamps and other replies)
+ *
+ * Coalescing appends one serialized protobuf to another, which protobuf parses as a single message with
+ * the repeated fields of both (see the Text of LOG_MSG). A message that has been partially written is
+ * never replaced, merged into, or dropped, so the stream always stays well-formed.
+ *
+ * A message sent to several clients (device data and logs for observers) is packed once into a shared_msg_t,
+ * which every queue it is pushed to references instead of copying; it goes back to a pool once the last queue
+ * has written it. Only coalescing into a shared message copies it first, which only happens while a client is behind.
+ * Queues are only used from net handler's event loop, so neither they nor the pool are locked.
+ */
+
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include <net_util.h>
+
+#define SEND_QUEUE_MAX_MSGS 64           // max number of messages waiting in a queue
+#define SEND_QUEUE_BUDGET (64 * 1024)    // bytes a queue may hold before it starts dropping coalesced messages
+#define SEND_QUEUE_COALESCE_MAX 4096     // max payload of a coalesced message, so that dropping one doesn't drop too much
+#define SEND_QUEUE_HARD_LIMIT (1 << 20)  // bytes a queue may hold at all; a client this far behind is dead
+
+// What happens to a waiting message when the client falls behind
+typedef enum {
+    SEND_NEWEST_WINS,
+    SEND_COALESCE,
+    SEND_RELIABLE
+} send_policy_t;
+
+// A message packed once for several queues, with a reference from each queue it is waiting in
+typedef struct shared_msg {
+    uint8_t* buf;             // the message, header included
+    size_t cap;               // size of buf; kept while the message is in the pool
+    size_t len;               // length of the message
+    int refs;                 // references held by the creator and the queues it is waiting in
+    struct shared_msg* next;  // next message in the pool, while not in use
+} shared_msg_t;
+
+// A message waiting to be written; buffers are kept across messages to avoid allocating
+typedef struct {
+    uint8_t* buf;          // the message, header included, unless it is shared
+    size_t cap;            // size of buf
+    size_t len;            // length of the message
+    size_t sent;           // bytes of the message already written
+    send_policy_t policy;  // what happens to it when the client falls behind
+    shared_msg_t* shared;  // the message if it is shared (instead of buf), or NULL
+} queued_msg_t;
+
+// Counters of a queue since it was last reset
+typedef struct {
+    size_t bytes;             // bytes currently waiting
+    size_t max_bytes;         // most bytes that were ever waiting
+    uint64_t msgs_sent;       // messages written completely
+    uint64_t msgs_replaced;   // SEND_NEWEST_WINS messages replaced by a newer one before being written
+    uint64_t msgs_coalesced;  // SEND_COALESCE messages merged into a waiting one
+    uint64_t msgs_dropped;    // SEND_COALESCE messages dropped because the queue was over budget
+} send_queue_stats_t;
+
+typedef struct {
+    int fd;                                  // socket the queue writes to
+    queued_msg_t msgs[SEND_QUEUE_MAX_MSGS];  // waiting messages, oldest first; the slots after them keep their buffers
+    int num_msgs;                            // number of waiting messages
+    send_queue_stats_t stats;                // counters
+} send_queue_t;
+
+/**
+ * Gets an unused shared message from the pool, with room for LEN bytes and a single reference, held by the caller.
+ * Once the message is filled in and pushed to every queue it is for, the caller releases its reference.
+ * Arguments:
+ *    len: length of the message, header included
+ * Returns:
+ *    the message, with its len set
+ */
+shared_msg_t* shared_msg_get(size_t len);
+
+/**
+ * Releases a reference to a shared message, returning it to the pool if it was the last.
+ * Arguments:
+ *    msg: the message
+ */
+void shared_msg_release(shared_msg_t* msg);
+
+/**
+ * Drops every waiting message of a queue, releasing the shared messages it references so that they go back
+ * to the pool. Buffers are kept. Should be called when the queue's connection is closed.
+ * Arguments:
+ *    queue: the queue
+ */
+void send_queue_clear(send_queue_t* queue);
+
+/**
+ * Empties a queue and starts using it for a new socket. Buffers from previous use are kept.
+ * Arguments:
+ *    queue: the queue
+ *    fd: the socket to write to
+ */
+void send_queue_reset(send_queue_t* queue, int fd);
+
+/**
+ * Queues a message (copying it) and writes as much of the queue as the socket takes without blocking.
+ * Arguments:
+ *    queue: the queue
+ *    policy: what happens to the message if the client falls behind
+ *    msg: the message, header included (see make_buf())
+ *    len: length of MSG
+ * Returns:
+ *    0 on success (whether or not the message was written yet), or
+ *    -1 if the client is too far behind or writing to the socket failed; the connection should be closed
+ */
+int send_queue_push(send_queue_t* queue, send_policy_t policy, uint8_t* msg, size_t len);
+
+/**
+ * Queues a shared message without copying it, and writes as much of the queue as the socket takes without blocking.
+ * The queue holds a reference to the message while it is waiting. Same policies and return values as send_queue_push().
+ */
+int send_queue_push_shared(send_queue_t* queue, send_policy_t policy, shared_msg_t* msg);
+
+/**
+ * Writes as much of the queue as the socket takes without blocking. Should be called when the socket becomes writable.
+ * Arguments:
+ *    queue: the queue
+ * Returns:
+ *    0 on success (whether or not everything was written), or
+ *    -1 if writing to the socket failed; the connection should be closed
+ */
+int send_queue_flush(send_queue_t* queue);
+
+/**
+ * Returns whether the queue has messages waiting to be written.
+ */
+bool send_queue_pending(send_queue_t* queue);
+
+/**
+ * Returns the type (net_msg_t) of the SEND_NEWEST_WINS message that is waiting and not partially written yet,
+ * i.e. the one that the next SEND_NEWEST_WINS message would replace, or -1 if there is none.
+ */
+int send_queue_replaceable_type(send_queue_t* queue);
+
+#endif
@@ -1,5 +1,10 @@
+#define _GNU_SOURCE  // for CPU_SET and pthread_setaffinity_np
 #include "runtime_util.h"
 
+#include <sched.h>      // for sched_param, SCHED_FIFO
+#include <sys/mman.h>   // for mlockall
+#include <sys/prctl.h>  // for prctl, PR_SET_TIMERSLACK
+
 // *************************** LOWCAR DEFINITIONS *************************** //
 
 device_t DummyDevice = {
@@ -412,6 +417,13 @@ uint64_t millis() {
     return s1 + s2;
 }
 
+/* Returns the number of microseconds since the Unix Epoch */
+uint64_t micros() {
+    struct timeval time;  // Holds the current time in seconds + microseconds
+    gettimeofday(&time, NULL);
+    return (uint64_t) (time.tv_sec) * 1000000 + time.tv_usec;
+}
+
 // ********************* READ/WRITE TO FILE DESCRIPTOR ********************** //
 
 int readn(int fd, void* buf, uint16_t n) {
@@ -455,3 +467,68 @@ int writen(int fd, void* buf, uint16_t n) {
     }
     return n;
 }
+
+// ************************* REAL-TIME SCHEDULING *************************** //
+
+bool rt_profile_enabled() {
+    char* profile = getenv(RT_PROFILE_ENV);
+    return profile != NULL && strcmp(profile, "1") == 0;
+}
+
+int rt_profile_process_init() {
+    int err = 0;
+    if (!rt_profile_enabled()) {
+        return 0;
+    }
+    // 1 ns of timer slack (default is 50 us); inherited by threads created from here on
+    if (prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0) != 0) {
+        err = errno;
+    }
+    // Small stacks for the threads to come, which are locked in RAM in full
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    int ret = pthread_attr_setstacksize(&attr, RT_STACK_SIZE);
+    if (ret == 0) {
+        ret = pthread_setattr_default_np(&attr);
+    }
+    pthread_attr_destroy(&attr);
+    if (ret != 0 && err == 0) {
+        err = ret;
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0 && err == 0) {
+        err = errno;
+    }
+    return err;
+}
+
+int rt_profile_thread_init(int priority) {
+    int err = 0;
+    if (!rt_profile_enabled()) {
+        return 0;
+    }
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+
+    // Pin to the real-time CPU if one was given, so that these threads don't get migrated around with everything else
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    char* cpu_str = getenv(RT_CPU_ENV);
+    int cpu = (cpu_str != NULL) ? atoi(cpu_str) : -1;
+    if (cpu >= 0 && cpu < num_cpus) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+    }
+
+    struct sched_param param = {.sched_priority = priority};
+    int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    return (err != 0) ? err : ret;
+}
+
+void rt_prefault(void* addr, size_t len) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    volatile uint8_t* bytes = addr;
+    // Read (don't write) each page; the data may be in use by other processes
+    for (size_t i = 0; i < len; i += page_size) {
+        (void) bytes[i];
+    }
+}
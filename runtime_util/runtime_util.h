@@ -274,6 +274,11 @@ char* field_to_string(robot_desc_field_t field);
  */
 uint64_t millis();
 
+/**
+ * Returns the number of microseconds since the Unix Epoch.
+ */
+uint64_t micros();
+
 // ********************* READ/WRITE TO FILE DESCRIPTOR ********************** //
 
 /**
@@ -301,4 +306,57 @@ int readn(int fd, void* buf, uint16_t n);
  */
 int writen(int fd, void* buf, uint16_t n);
 
+// ************************* REAL-TIME SCHEDULING *************************** //
+
+// Environment variable that turns on the real-time scheduling profile when set to "1" (see systemd/README.md)
+#define RT_PROFILE_ENV "RUNTIME_RT_PROFILE"
+// Environment variable holding the CPU to pin latency-critical threads to (not pinned if unset)
+#define RT_CPU_ENV "RUNTIME_RT_CPU"
+// Stack size (bytes) of the threads created once the real-time profile is applied, instead of the default 8 MB,
+// since mlockall() keeps every page of every thread's stack in RAM
+#define RT_STACK_SIZE (256 * 1024)
+
+// SCHED_FIFO priorities (1 - 99, higher preempts lower) of the latency-critical threads
+#define RT_PRIO_DEV_HANDLER 50  // dev_handler sender and receiver threads
+#define RT_PRIO_NET_HANDLER 40  // net_handler event loop
+
+/**
+ * Returns true iff the real-time scheduling profile is turned on for this process (RT_PROFILE_ENV is "1").
+ */
+bool rt_profile_enabled();
+
+/**
+ * Applies the process-wide part of the real-time scheduling profile, if it is turned on:
+ * locks all current and future memory of the process in RAM (so latency-critical threads never
+ * page fault), makes threads created from now on use stacks of RT_STACK_SIZE bytes (so locking
+ * them doesn't cost 8 MB of RAM each), and makes timers of this thread (and threads it creates
+ * from now on) fire as precisely as possible instead of being coalesced.
+ * Should be called at the start of main(), before any threads are created.
+ * Returns:
+ *    0 on success, or if the profile is turned off
+ *    otherwise the error number of the first step that failed (ex: EPERM without CAP_IPC_LOCK);
+ *      the remaining steps are still applied, so the caller can log a warning and carry on
+ */
+int rt_profile_process_init();
+
+/**
+ * Applies the per-thread part of the real-time scheduling profile to the calling thread, if it is turned on:
+ * switches it to SCHED_FIFO with the given priority and, if RT_CPU_ENV is set, pins it to that CPU.
+ * Arguments:
+ *    priority: SCHED_FIFO priority of the thread; one of the RT_PRIO_* constants
+ * Returns:
+ *    0 on success, or if the profile is turned off
+ *    otherwise the error number of the first step that failed (ex: EPERM without CAP_SYS_NICE);
+ *      the thread then keeps running under the default scheduler
+ */
+int rt_profile_thread_init(int priority);
+
+/**
+ * Touches every page of a memory region so that later accesses don't page fault
+ * Arguments:
+ *    addr: start of the memory region (ex: a memory-mapped shared memory block)
+ *    len: length of the memory region in bytes
+ */
+void rt_prefault(void* addr, size_t len);
+
 #endif
@@ -124,6 +124,9 @@ int main() {
     for (int i = 0; i < MAX_DEVICES + 1; i++) {
         dev_shm_ptr->cmd_map[i] = 0;
     }
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        dev_shm_ptr->data_gen[i] = 0;
+    }
     for (int j = 0; j < 2; j++) {
         input_shm_ptr->inputs[j].buttons = 0;
         for (int i = 0; i < 4; i++) {
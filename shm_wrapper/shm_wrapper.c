@@ -168,8 +168,9 @@ static void device_read_helper(int dev_ix, process_t process, stream_t stream, u
  *    params_to_read: bitmap representing which params to be written (nonexistent params should have corresponding bits set to 0)
  *    params: pointer to array of param_val_t's that is at least as long as highest requested param number
  *        device data will be written into the corresponding param_val_t's
+ *    update_cmd_map: whether to update the command map when writing commands (false if the caller does it for several devices)
  */
-static void device_write_helper(int dev_ix, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params) {
+static void device_write_helper(int dev_ix, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params, bool update_cmd_map) {
     // grab semaphore for the appropriate stream and device
     if (stream == DATA) {
         my_sem_wait(sems[dev_ix].data_sem, "data sem @device_write");
@@ -177,15 +178,21 @@ static void device_write_helper(int dev_ix, process_t process, stream_t stream,
         my_sem_wait(sems[dev_ix].command_sem, "command sem @device_write");
     }
 
-    // write all requested params
+    // write all requested params, noting whether any DATA value changed
+    bool changed = false;
     for (int i = 0; i < MAX_PARAMS; i++) {
         if (params_to_write & (1 << i)) {
+            changed = changed || memcmp(&dev_shm_ptr->params[stream][dev_ix][i], &params[i], sizeof(param_val_t)) != 0;
             dev_shm_ptr->params[stream][dev_ix][i] = params[i];
         }
     }
 
+    if (stream == DATA && changed) {
+        dev_shm_ptr->data_gen[dev_ix]++;
+    }
+
     // If writing a command, update the command map to indicate which param should be changed
-    if (stream == COMMAND) {
+    if (stream == COMMAND && update_cmd_map) {
         // wait on cmd_map_sem
         my_sem_wait(cmd_map_sem, "cmd_map_sem @device_write");
 
@@ -262,6 +269,13 @@ int get_dev_ix_from_uid(uint64_t dev_uid) {
     return dev_ix;
 }
 
+int get_dev_ix_from_uid_cached(uint64_t dev_uid, int dev_ix) {
+    if (dev_ix >= 0 && dev_ix < MAX_DEVICES && (dev_shm_ptr->catalog & (1 << dev_ix)) && dev_shm_ptr->dev_ids[dev_ix].uid == dev_uid) {
+        return dev_ix;
+    }
+    return get_dev_ix_from_uid(dev_uid);
+}
+
 void shm_init() {
     // Verify that shared memory exists
     if (!shm_exists()) {
@@ -341,6 +355,14 @@ void shm_init() {
         log_printf(ERROR, "close log_data_shm: %s", strerror(errno));
     }
 
+    // fault in every page now so that the real-time threads never take a page fault on shared memory
+    if (rt_profile_enabled()) {
+        rt_prefault(dev_shm_ptr, sizeof(dev_shm_t));
+        rt_prefault(input_shm_ptr, sizeof(input_shm_t));
+        rt_prefault(rd_shm_ptr, sizeof(robot_desc_shm_t));
+        rt_prefault(log_data_shm_ptr, sizeof(log_data_shm_t));
+    }
+
     atexit(shm_close);
 }
 
@@ -378,6 +400,8 @@ void device_connect(dev_id_t* dev_id, int* dev_ix) {
         dev_shm_ptr->params[DATA][*dev_ix][i] = (const param_val_t){0};
         dev_shm_ptr->params[COMMAND][*dev_ix][i] = (const param_val_t){0};
     }
+    dev_shm_ptr->timing[*dev_ix] = (const dev_timing_t){0};
+    dev_shm_ptr->data_gen[*dev_ix]++;
 
     // release associated data and command sems
     my_sem_post(sems[*dev_ix].data_sem, "data_sem");
@@ -402,6 +426,7 @@ void device_disconnect(int dev_ix) {
     // reset cmd bitmap values to 0
     dev_shm_ptr->cmd_map[0] &= (~(1 << dev_ix));  // reset the changed bit flag in cmd_map[0]
     dev_shm_ptr->cmd_map[dev_ix + 1] = 0;         // turn off all changed bits for the device
+    dev_shm_ptr->data_gen[dev_ix]++;
 
     my_sem_post(cmd_map_sem, "cmd_map_sem");
     // release associated upstream and downstream sems
@@ -438,6 +463,24 @@ int device_read_uid(uint64_t dev_uid, process_t process, stream_t stream, uint32
     return 0;
 }
 
+int device_read_gen(int dev_ix, uint32_t params_to_read, param_val_t* params, uint32_t* gen) {
+    // check catalog to see if dev_ix is valid, if not then return immediately
+    if (!(dev_shm_ptr->catalog & (1 << dev_ix))) {
+        log_printf(ERROR, "device_read_gen: no device at dev_ix = %d, read failed", dev_ix);
+        return -1;
+    }
+
+    my_sem_wait(sems[dev_ix].data_sem, "data sem @device_read_gen");
+    for (int i = 0; i < MAX_PARAMS; i++) {
+        if (params_to_read & (1 << i)) {
+            params[i] = dev_shm_ptr->params[DATA][dev_ix][i];
+        }
+    }
+    *gen = dev_shm_ptr->data_gen[dev_ix];
+    my_sem_post(sems[dev_ix].data_sem, "data sem @device_read_gen");
+    return 0;
+}
+
 int device_write(int dev_ix, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params) {
     // check catalog to see if dev_ix is valid, if not then return immediately
     if (!(dev_shm_ptr->catalog & (1 << dev_ix))) {
@@ -446,7 +489,7 @@ int device_write(int dev_ix, process_t process, stream_t stream, uint32_t params
     }
 
     // call the helper to do the actual reading
-    device_write_helper(dev_ix, process, stream, params_to_write, params);
+    device_write_helper(dev_ix, process, stream, params_to_write, params, true);
     return 0;
 }
 
@@ -460,7 +503,65 @@ int device_write_uid(uint64_t dev_uid, process_t process, stream_t stream, uint3
     }
 
     // call the helper to do the actual reading
-    device_write_helper(dev_ix, process, stream, params_to_write, params);
+    device_write_helper(dev_ix, process, stream, params_to_write, params, true);
+    return 0;
+}
+
+int device_write_batch(int num_devices, int* dev_ixs, process_t process, stream_t stream, uint32_t* params_to_write, param_val_t (*params)[MAX_PARAMS]) {
+    int ret = 0;
+    uint32_t written = 0;  // bitmap of the devices that were written
+
+    for (int i = 0; i < num_devices; i++) {
+        if (!(dev_shm_ptr->catalog & (1 << dev_ixs[i]))) {
+            log_printf(ERROR, "device_write_batch: no device at dev_ix = %d, write failed", dev_ixs[i]);
+            if (ret == 0) {
+                ret = -(i + 1);
+            }
+            continue;
+        }
+        device_write_helper(dev_ixs[i], process, stream, params_to_write[i], params[i], false);
+        written |= (1 << i);
+    }
+
+    // publish the params written to every device with a single update of the command map
+    if (stream == COMMAND && written) {
+        my_sem_wait(cmd_map_sem, "cmd_map_sem @device_write_batch");
+        for (int i = 0; i < num_devices; i++) {
+            if (written & (1 << i)) {
+                dev_shm_ptr->cmd_map[0] |= (1 << dev_ixs[i]);
+                dev_shm_ptr->cmd_map[dev_ixs[i] + 1] |= params_to_write[i];
+            }
+        }
+        my_sem_post(cmd_map_sem, "cmd_map_sem @device_write_batch");
+    }
+    return ret;
+}
+
+int device_timing_write(int dev_ix, dev_timing_t* timing) {
+    // check catalog to see if dev_ix is valid, if not then return immediately
+    if (!(dev_shm_ptr->catalog & (1 << dev_ix))) {
+        log_printf(ERROR, "device_timing_write: no device at dev_ix = %d, write failed", dev_ix);
+        return -1;
+    }
+
+    my_sem_wait(sems[dev_ix].data_sem, "data sem @device_timing_write");
+    dev_shm_ptr->timing[dev_ix] = *timing;
+    my_sem_post(sems[dev_ix].data_sem, "data sem @device_timing_write");
+    return 0;
+}
+
+int device_timing_read_uid(uint64_t dev_uid, dev_timing_t* timing) {
+    int dev_ix;
+
+    // if device doesn't exist, return immediately
+    if ((dev_ix = get_dev_ix_from_uid(dev_uid)) == -1) {
+        log_printf(ERROR, "device_timing_read_uid: no device at dev_uid = %llu, read failed", dev_uid);
+        return -1;
+    }
+
+    my_sem_wait(sems[dev_ix].data_sem, "data sem @device_timing_read");
+    *timing = dev_shm_ptr->timing[dev_ix];
+    my_sem_post(sems[dev_ix].data_sem, "data sem @device_timing_read");
     return 0;
 }
 
@@ -498,6 +599,19 @@ void get_catalog(uint32_t* catalog) {
     my_sem_post(catalog_sem, "catalog_sem");
 }
 
+void get_data_generation(uint32_t* gen) {
+    // the sum of the generations changes whenever any one of them does
+    *gen = 0;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        my_sem_wait(sems[i].data_sem, "data sem @get_data_generation");
+        *gen += dev_shm_ptr->data_gen[i];
+        my_sem_post(sems[i].data_sem, "data sem @get_data_generation");
+    }
+    my_sem_wait(log_data_sem, "log_data_mutex");
+    *gen += log_data_shm_ptr->gen;
+    my_sem_post(log_data_sem, "log_data_mutex");
+}
+
 robot_desc_val_t robot_desc_read(robot_desc_field_t field) {
     robot_desc_val_t ret;
 
@@ -640,7 +754,10 @@ int log_data_write(char* key, param_type_t type, param_val_t value) {
         return -2;
     }
 
-    // copy over the name, type, and parameter of the log data into the shared memory block
+    // note any change, then copy over the name, type, and parameter of the log data into the shared memory block
+    if (idx == log_data_shm_ptr->num_params || log_data_shm_ptr->types[idx] != type || memcmp(&log_data_shm_ptr->params[idx], &value, sizeof(param_val_t)) != 0) {
+        log_data_shm_ptr->gen++;
+    }
     strcpy(log_data_shm_ptr->names[idx], key);
     log_data_shm_ptr->types[idx] = type;
     log_data_shm_ptr->params[idx] = value;
@@ -33,12 +33,27 @@ typedef enum stream {
     COMMAND
 } stream_t;
 
+// timing information about a device measured by dev_handler (only available for devices that support clock synchronization or write acknowledgements)
+typedef struct {
+    bool synced;                    // true iff dev_handler has synchronized with the device's clock; the clock fields below are 0 otherwise
+    uint32_t clock_rtt_us;          // round trip time of the DEVICE_PING exchange the clock offset estimate is based on
+    float clock_drift_ppm;          // drift of the device's clock relative to the Raspberry Pi's clock, in parts per million
+    uint64_t last_sample_time;      // time (microseconds since the Unix Epoch) at which the device read its latest DATA values
+    uint32_t sample_to_shm_us;      // latency between the device reading its latest DATA values and them being written to shared memory
+    uint32_t cmd_to_actuation_us;   // latency between dev_handler sending the latest acknowledged DEVICE_WRITE and the device applying it (0 if none yet, or if the device doesn't acknowledge writes)
+    uint32_t write_rtt_us;          // smoothed round trip time between sending a DEVICE_WRITE and the device acknowledging it (0 if the device doesn't)
+    uint32_t writes_acked;          // number of DEVICE_WRITEs the device acknowledged
+    uint32_t writes_retransmitted;  // number of times lost DEVICE_WRITEs were resent to the device
+} dev_timing_t;
+
 // shared memory block that holds device information, data, and commands has this structure
 typedef struct {
     uint32_t catalog;                                // catalog of valid devices
     uint32_t cmd_map[MAX_DEVICES + 1];               // bitmap is 33 32-bit integers (changed devices and changed params of device commands from executor to dev_handler)
     param_val_t params[2][MAX_DEVICES][MAX_PARAMS];  // all the device parameter info, data and commands
     dev_id_t dev_ids[MAX_DEVICES];                   // all the device identification info
+    dev_timing_t timing[MAX_DEVICES];                // timing of each device's DATA stream; protected by the device's data semaphore
+    uint32_t data_gen[MAX_DEVICES];                  // incremented whenever a device's DATA values change or it (dis)connects; protected by the device's data semaphore
 } dev_shm_t;
 
 // two mutex semaphores for each device
@@ -72,6 +87,7 @@ typedef struct {
     char names[UCHAR_MAX][LOG_KEY_LENGTH];  // keys (names) of quantities that student wants to log
     param_val_t params[UCHAR_MAX];          // values of quantities that student wants to log
     param_type_t types[UCHAR_MAX];          // types of the values that student wants to log
+    uint32_t gen;                           // incremented whenever a key, type, or value changes
 } log_data_shm_t;
 
 // *********************************** SHM EXTERNAL VARIABLES  ******************************************** //
@@ -115,6 +131,16 @@ void generate_sem_name(stream_t stream, int dev_ix, char* name);
  */
 int get_dev_ix_from_uid(uint64_t dev_uid);
 
+/**
+ * Same as get_dev_ix_from_uid(), but first checks the index the device was last found at, which is where it
+ * stays for as long as it is connected. Lets a caller that uses the same device repeatedly skip the search.
+ * Arguments:
+ *    dev_uid: 64-bit unique ID of the device
+ *    dev_ix: index in the SHM block the device was last found at, or -1 if it hasn't been found yet
+ * Returns: device index in shared memory of the specified device, -1 if specified device is not in shared memory
+ */
+int get_dev_ix_from_uid_cached(uint64_t dev_uid, int dev_ix);
+
 /**
  * Call this function from every process that wants to use the shared memory wrapper
  * No return value (will exit on fatal errors).
@@ -163,6 +189,21 @@ int device_read(int dev_ix, process_t process, stream_t stream, uint32_t params_
  */
 int device_read_uid(uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_read, param_val_t* params);
 
+/**
+ * Reads DATA params of a device like device_read(), together with the generation of the device's DATA values,
+ * under the same wait on its data semaphore. The generation changes whenever the device's DATA values change,
+ * so a reader can tell whether the values it read are new since its last read.
+ * Arguments:
+ *    dev_ix: device index of the device whose data is being requested
+ *    params_to_read: bitmap representing which params to be read  (nonexistent params should have corresponding bits set to 0)
+ *    params: pointer to array of param_val_t's that is at least as long as highest requested param number
+ *    gen: pointer to 32-bit integer into which the generation of the device's DATA values will be read
+ * Returns:
+ *    0 on success
+ *    -1 on failure (specified device is not connected in shm)
+ */
+int device_read_gen(int dev_ix, uint32_t params_to_read, param_val_t* params, uint32_t* gen);
+
 /**
  * Should be called from every process wanting to write to the device data
  * Takes care of updating the param bitmap for fast transfer of commands from executor to device handler
@@ -186,6 +227,47 @@ int device_write(int dev_ix, process_t process, stream_t stream, uint32_t params
  */
 int device_write_uid(uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params);
 
+/**
+ * Writes params of several devices at once. The same as calling device_write() on each of them, except that
+ * when writing commands, the command map is updated once for all of them (with the devices' params already written),
+ * instead of once per device.
+ * Arguments:
+ *    num_devices: number of devices to write (at most MAX_DEVICES)
+ *    dev_ixs: device index of each device
+ *    process: the calling process, one of DEV_HANDLER, EXECUTOR, or NET_HANDLER
+ *    stream: the requested block to write to, one of DATA, COMMAND
+ *    params_to_write: bitmap for each device representing which of its params to write
+ *    params: array of MAX_PARAMS param_val_t's for each device holding the values to write
+ * Returns:
+ *    0 on success
+ *    -(i + 1) if dev_ixs[i] is the first device that is not connected in shm (the others are still written)
+ */
+int device_write_batch(int num_devices, int* dev_ixs, process_t process, stream_t stream, uint32_t* params_to_write, param_val_t (*params)[MAX_PARAMS]);
+
+/**
+ * Should only be called from device handler
+ * Writes the timing information of a device's DATA stream. Blocks on the device's data semaphore.
+ * Arguments:
+ *    dev_ix: device index of the device whose timing is being written
+ *    timing: the timing information to write
+ * Returns:
+ *    0 on success
+ *    -1 on failure (specified device is not connected in shm)
+ */
+int device_timing_write(int dev_ix, dev_timing_t* timing);
+
+/**
+ * Reads the timing information of a device's DATA stream, as measured by device handler.
+ * Blocks on the device's data semaphore.
+ * Arguments:
+ *    dev_uid: 64-bit unique ID of the device
+ *    timing: pointer to a dev_timing_t that the timing information will be read into
+ * Returns:
+ *    0 on success
+ *    -1 on failure (specified device is not connected in shm)
+ */
+int device_timing_read_uid(uint64_t dev_uid, dev_timing_t* timing);
+
 /**
  * Should be called from all processes that want to know current state of the command map (i.e. device handler)
  * Blocks on the command bitmap semaphore for obvious reasons
@@ -211,6 +293,16 @@ void get_device_identifiers(dev_id_t dev_ids[MAX_DEVICES]);
  */
 void get_catalog(uint32_t* catalog);
 
+/**
+ * Should be called from processes that want to know whether anything they could read from the DATA streams
+ * or the log data changed, without reading it all (e.g. net_handler, to only send device data when it changed)
+ * The generation changes whenever a DATA value or a log data key, type, or value changes, and whenever a device
+ * connects or disconnects; writing the same values again doesn't change it. Blocks on each data semaphore and the log data semaphore.
+ * Arguments:
+ *    gen: pointer to 32-bit integer into which the current generation will be read into
+ */
+void get_data_generation(uint32_t* gen);
+
 /**
  * Reads the specified robot description field. Blocks on the robot description semaphore.
  * Arguments:
@@ -0,0 +1,33 @@
+#include <sys/socket.h>
+
+#include "alloc_count.h"
+
+__thread bool counting = false;
+__thread uint64_t num_allocs = 0;
+
+// Count allocations by interposing the allocator
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) {
+    num_allocs += counting;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+    num_allocs += counting;
+    return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    num_allocs += counting;
+    return __libc_realloc(ptr, size);
+}
+
+void drain(int fd) {
+    static uint8_t buf[1 << 16];
+    while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+        continue;
+    }
+}
@@ -0,0 +1,24 @@
+/**
+ * Helpers for the performance tests that benchmark net handler's message functions in-process
+ * (tc_71_23 and tc_71_28) and check how many heap allocations they make.
+ * Linking this file interposes malloc(), calloc() and realloc() for the whole test, so it is
+ * linked only into those tests (see the Makefile).
+ */
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// While true, every heap allocation made by the calling thread increments its NUM_ALLOCS
+extern __thread bool counting;
+extern __thread uint64_t num_allocs;
+
+/**
+ * Reads and discards everything that was sent on a socket, as Dawn would
+ * Arguments:
+ *    fd: the receiving end of the socket; it isn't blocked on
+ */
+void drain(int fd);
+
+#endif
@@ -141,6 +141,10 @@ void stop_dev_handler() {
     }
 }
 
+pid_t get_dev_handler_pid() {
+    return dev_handler_pid;
+}
+
 int connect_virtual_device(char* dev_name, uint64_t uid) {
     // Connect a socket
     int socket_num = connect_socket();
@@ -20,6 +20,9 @@ void start_dev_handler();
 // Stops dev handler
 void stop_dev_handler();
 
+// Returns the process id of the dev handler started by start_dev_handler()
+pid_t get_dev_handler_pid();
+
 /**
  * Connects a virtual device to dev handler
  * Arguments:
@@ -0,0 +1,650 @@
+#define _GNU_SOURCE  // for ppoll(), posix_openpt()
+
+#include "device_fleet.h"
+
+#include <dev_handler_message.h>
+#include <fcntl.h>       // for O_* flags
+#include <poll.h>        // for ppoll()
+#include <sys/socket.h>  // for sockets
+#include <sys/un.h>      // for sockaddr_un
+
+#include "dev_handler_client.h"
+
+// Size of each device's receive and transmit buffers
+#define FLEET_BUF_SIZE 1024
+
+// Number of commands per device whose issue times are remembered to compute latencies
+#define WRITE_RING_SIZE 256
+
+// Maximum number of samples kept per latency measurement
+#define MAX_LAT_SAMPLES 65536
+
+// Milliseconds between two samples of dev handler's timing measurements in shared memory
+#define TIMING_SAMPLE_INTERVAL 50
+
+// Maximum number of milliseconds to wait for all devices to be acknowledged before measuring
+#define CONNECT_TIMEOUT 5000
+
+// The names of the files the fleet's devices appear at (followed by the port number)
+#define SOCKET_PREFIX "ttyACM"  // in the home directory
+#define PTY_PREFIX "/dev/ttyACM"
+
+// The state of a single device in the fleet
+typedef enum {
+    DEV_UNPLUGGED,  // No file for dev handler to find
+    DEV_LISTENING,  // Socket created; waiting for dev handler to connect
+    DEV_CONNECTED,  // Dev handler connected; waiting for its first DEVICE_PING
+    DEV_RUNNING     // Acknowledged by dev handler; sending DEVICE_DATA
+} fleet_dev_state_t;
+
+// A single device in the fleet
+typedef struct {
+    fleet_dev_state_t state;
+    uint64_t uid;
+    char port_name[64];                     // Path of the socket or pty symlink dev handler finds the device at
+    int listen_fd;                          // The listening socket (FLEET_SOCKET only); -1 if none
+    int fd;                                 // The file descriptor messages are exchanged over; -1 if none
+    int pty_slave_fd;                       // Held open (FLEET_PTY only) so the pty doesn't hang up before dev handler opens it; -1 if none
+    bool is_socket;                         // Whether FD is a socket (as opposed to a pty master)
+    uint8_t rx[FLEET_BUF_SIZE];             // Bytes received from dev handler that haven't been parsed yet
+    size_t rx_len;                          // Number of valid bytes in RX
+    uint8_t tx[FLEET_BUF_SIZE];             // Bytes waiting to be written to dev handler
+    size_t tx_len;                          // Number of valid bytes in TX
+    uint64_t plugged_time;                  // micros() at which the device was (re)plugged in
+    uint64_t unplugged_until;               // micros() at which a device unplugged by a storm is plugged back in
+    uint64_t next_data_time;                // micros() at which the next DEVICE_DATA is due
+    bool send_timestamps;                   // Whether dev handler asked for clock synchronization
+    uint32_t last_write_time;               // Lower 32 bits of micros() when the last DEVICE_WRITE was received
+    bool send_write_ack;                    // Whether to echo WRITE_ACK in DEVICE_DATA, which tells dev handler to number its DEVICE_WRITEs
+    uint16_t write_ack;                     // Sequence number of the last DEVICE_WRITE received in order
+    int32_t delivered_seq;                  // Value of the last command that arrived at the device (retransmissions carry it again)
+    int32_t counter;                        // Value sent for every readable int param; incremented every DEVICE_DATA
+    int32_t write_seq;                      // Value of the last command written to the device's latency param
+    uint64_t write_times[WRITE_RING_SIZE];  // micros() at which each of the last commands was written
+    uint64_t last_sample_time;              // The last dev_timing_t.last_sample_time sampled for this device
+} fleet_dev_t;
+
+// A set of latency samples
+typedef struct {
+    uint32_t samples[MAX_LAT_SAMPLES];
+    uint32_t num_samples;
+} lat_samples_t;
+
+// ****************************** GLOBAL VARS ******************************* //
+
+fleet_dev_t fleet_devs[MAX_DEVICES];
+lat_samples_t write_lat, ingest_lat, connect_lat;
+
+// ******************************** Private ********************************* //
+
+static void add_sample(lat_samples_t* lat, uint32_t sample) {
+    if (lat->num_samples < MAX_LAT_SAMPLES) {
+        lat->samples[lat->num_samples++] = sample;
+    }
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(uint32_t*) a, y = *(uint32_t*) b;
+    return (x > y) - (x < y);
+}
+
+static void compute_percentiles(lat_samples_t* lat, fleet_percentiles_t* pct) {
+    *pct = (fleet_percentiles_t){0};
+    if (lat->num_samples == 0) {
+        return;
+    }
+    qsort(lat->samples, lat->num_samples, sizeof(uint32_t), compare_u32);
+    pct->samples = lat->num_samples;
+    pct->p50 = lat->samples[lat->num_samples / 2];
+    pct->p99 = lat->samples[(uint64_t) lat->num_samples * 99 / 100];
+    pct->max = lat->samples[lat->num_samples - 1];
+}
+
+/**
+ * Returns the total CPU time (user + system) used by a process so far
+ * Arguments:
+ *    pid: the process to look up
+ * Returns:
+ *    CPU time in clock ticks, or 0 if it couldn't be read
+ */
+static uint64_t process_cpu_ticks(pid_t pid) {
+    char path[32];
+    char buf[512];
+    sprintf(path, "/proc/%d/stat", pid);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+    // The process name may contain spaces, so start after its closing parenthesis (field 2)
+    char* fields = strrchr(buf, ')');
+    unsigned long long utime, stime;
+    if (fields == NULL || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+        return 0;
+    }
+    return utime + stime;
+}
+
+/**
+ * Returns the index of the first writable int param of a device type; its value is
+ * used to identify the commands written to a device so their latency can be measured
+ * Returns:
+ *    the param index, or -1 if the device has no writable int param
+ */
+static int get_latency_param(device_t* dev) {
+    for (int i = 0; i < dev->num_params; i++) {
+        if (dev->params[i].write && dev->params[i].type == INT) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Removes a device from its port; dev handler notices the device is gone
+static void unplug(fleet_dev_t* dev) {
+    if (dev->fd != -1) {
+        close(dev->fd);
+        dev->fd = -1;
+    }
+    if (dev->listen_fd != -1) {
+        close(dev->listen_fd);
+        dev->listen_fd = -1;
+    }
+    if (dev->pty_slave_fd != -1) {
+        close(dev->pty_slave_fd);
+        dev->pty_slave_fd = -1;
+    }
+    remove(dev->port_name);
+    dev->state = DEV_UNPLUGGED;
+}
+
+/**
+ * Makes a device appear at its port so dev handler can find it
+ * Returns:
+ *    0 on success
+ *    -1 on failure
+ */
+static int plug_in(fleet_config_t* config, fleet_dev_t* dev) {
+    dev->rx_len = 0;
+    dev->tx_len = 0;
+    dev->send_timestamps = false;
+    dev->last_write_time = 0;
+    dev->send_write_ack = true;
+    dev->write_ack = 0;
+    dev->plugged_time = micros();
+    if (config->transport == FLEET_SOCKET) {
+        dev->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (dev->listen_fd < 0) {
+            log_printf(ERROR, "plug_in: Couldn't create socket -- %s", strerror(errno));
+            return -1;
+        }
+        struct sockaddr_un addr = {0};
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, dev->port_name);
+        if (bind(dev->listen_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(dev->listen_fd, 1) < 0) {
+            log_printf(ERROR, "plug_in: Couldn't bind socket %s -- %s", dev->port_name, strerror(errno));
+            close(dev->listen_fd);
+            dev->listen_fd = -1;
+            remove(dev->port_name);
+            return -1;
+        }
+        dev->is_socket = true;
+        dev->state = DEV_LISTENING;
+    } else {
+        dev->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (dev->fd < 0 || grantpt(dev->fd) != 0 || unlockpt(dev->fd) != 0) {
+            log_printf(ERROR, "plug_in: Couldn't create pseudoterminal -- %s", strerror(errno));
+            return -1;
+        }
+        dev->pty_slave_fd = open(ptsname(dev->fd), O_RDWR | O_NOCTTY);
+        if (dev->pty_slave_fd < 0 || symlink(ptsname(dev->fd), dev->port_name) != 0) {
+            log_printf(ERROR, "plug_in: Couldn't link %s -- %s", dev->port_name, strerror(errno));
+            unplug(dev);
+            return -1;
+        }
+        dev->is_socket = false;
+        dev->state = DEV_CONNECTED;
+    }
+    return 0;
+}
+
+/**
+ * Writes as many pending bytes of a device as dev handler accepts without blocking
+ * Returns:
+ *    0 on success (even if some bytes are still pending)
+ *    -1 if the connection was closed
+ */
+static int flush_tx(fleet_dev_t* dev) {
+    if (dev->tx_len == 0) {
+        return 0;
+    }
+    ssize_t written = dev->is_socket ? send(dev->fd, dev->tx, dev->tx_len, MSG_NOSIGNAL) : write(dev->fd, dev->tx, dev->tx_len);
+    if (written < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    memmove(dev->tx, &dev->tx[written], dev->tx_len - written);
+    dev->tx_len -= written;
+    return 0;
+}
+
+/**
+ * Queues a message to be written to dev handler
+ * Arguments:
+ *    dev: the device sending the message
+ *    msg: the message to send
+ *    corrupt: whether to corrupt the encoded frame
+ * Returns:
+ *    0 on success
+ *    -1 if there isn't enough room left in the device's transmit buffer
+ */
+static int queue_message(fleet_dev_t* dev, message_t* msg, bool corrupt) {
+    ssize_t len = message_to_bytes(msg, &dev->tx[dev->tx_len], FLEET_BUF_SIZE - dev->tx_len);
+    if (len < 0) {
+        return -1;
+    }
+    if (corrupt) {
+        // Flip bits of a byte after the COBS length without creating a delimiter, so the frame is still read whole
+        uint8_t* byte = &dev->tx[dev->tx_len + DELIMITER_SIZE + COBS_LENGTH_SIZE + rand() % (len - DELIMITER_SIZE - COBS_LENGTH_SIZE)];
+        uint8_t mask = 1 + rand() % 0xFF;
+        *byte = ((*byte ^ mask) == 0) ? (*byte ^ 0xFF) : (*byte ^ mask);
+    }
+    dev->tx_len += len;
+    return 0;
+}
+
+// Records the latency of the command carried by a DEVICE_WRITE, if any
+static void receive_device_write(fleet_dev_t* dev, device_t* type, int latency_param, message_t* msg, uint64_t now, fleet_stats_t* stats) {
+    uint32_t pmap;
+    memcpy(&pmap, msg->payload, BITMAP_SIZE);
+    uint8_t* payload_ptr = &msg->payload[BITMAP_SIZE];
+    for (int i = 0; ((pmap >> i) > 0) && (i < MAX_PARAMS); i++) {
+        if (!(pmap & (1 << i))) {
+            continue;
+        }
+        if (i == latency_param) {
+            int32_t seq;
+            memcpy(&seq, payload_ptr, sizeof(int32_t));
+            // Commands older than the ring (or from before the run) can't be matched to an issue time
+            if (seq > dev->delivered_seq && seq <= dev->write_seq && seq > dev->write_seq - WRITE_RING_SIZE) {
+                dev->delivered_seq = seq;
+                stats->writes_delivered++;
+                add_sample(&write_lat, (uint32_t) (now - dev->write_times[seq % WRITE_RING_SIZE]));
+            }
+            return;
+        }
+        payload_ptr += (type->params[i].type == BOOL) ? sizeof(uint8_t) : sizeof(int32_t);
+    }
+}
+
+/**
+ * Parses and responds to every complete message in a device's receive buffer
+ * Arguments:
+ *    config: the configuration of the run
+ *    dev: the device that received the bytes
+ *    msg: a message with a payload of MAX_PAYLOAD_SIZE to parse into
+ *    stats: the results of the run
+ */
+static void handle_rx(fleet_config_t* config, fleet_dev_t* dev, message_t* msg, fleet_stats_t* stats) {
+    device_t* type = get_device(device_name_to_type(config->dev_name));
+    int latency_param = get_latency_param(type);
+    size_t start = 0;
+    while (1) {
+        // Skip to the next delimiter
+        while (start < dev->rx_len && dev->rx[start] != 0x00) {
+            start++;
+        }
+        if (start + DELIMITER_SIZE + COBS_LENGTH_SIZE > dev->rx_len) {
+            break;
+        }
+        uint8_t cobs_len = dev->rx[start + DELIMITER_SIZE];
+        if (start + DELIMITER_SIZE + COBS_LENGTH_SIZE + cobs_len > dev->rx_len) {
+            break;  // Wait for the rest of the message
+        }
+        uint64_t now = micros();
+        if (parse_message(&dev->rx[start], msg) == 0) {
+            if (msg->message_id == DEVICE_PING) {
+                if (dev->state == DEV_CONNECTED || msg->payload_length == 0) {
+                    // Dev handler is verifying the device (pty devices aren't hung up on when dev handler times them out)
+                    if (dev->state == DEV_RUNNING) {
+                        stats->timeouts++;
+                    }
+                    message_t* ack = make_empty(DEVICE_ID_SIZE);
+                    uint8_t dev_type = device_name_to_type(config->dev_name);
+                    ack->message_id = ACKNOWLEDGEMENT;
+                    ack->payload[0] = dev_type;
+                    ack->payload[1] = dev_type;
+                    memcpy(&ack->payload[2], &dev->uid, sizeof(uint64_t));
+                    ack->payload_length = DEVICE_ID_SIZE;
+                    queue_message(dev, ack, false);
+                    destroy_message(ack);
+                    if (dev->unplugged_until != 0) {
+                        stats->reconnects++;
+                        dev->unplugged_until = 0;
+                    }
+                    add_sample(&connect_lat, (uint32_t) ((now - dev->plugged_time) / 1000));
+                    dev->next_data_time = now;
+                    dev->state = DEV_RUNNING;
+                } else if (msg->payload_length == PING_REQUEST_SIZE) {
+                    // Clock synchronization request: reply right away (dev handler's timestamp stays first in the payload)
+                    uint32_t device_time = (uint32_t) now;
+                    memcpy(&msg->payload[TIMESTAMP_SIZE], &device_time, TIMESTAMP_SIZE);
+                    device_time = (uint32_t) micros();
+                    memcpy(&msg->payload[2 * TIMESTAMP_SIZE], &device_time, TIMESTAMP_SIZE);
+                    msg->payload_length = PING_REPLY_SIZE;
+                    queue_message(dev, msg, false);
+                    dev->send_timestamps = true;
+                }
+            } else if (msg->message_id == DEVICE_WRITE) {
+                dev->last_write_time = (uint32_t) now;
+                // Acknowledge it like lowcar does (see write_acks.h)
+                uint16_t seq;
+                if (parse_write_seq(type->type, msg, &seq) == 0) {
+                    if ((seq & WRITE_SEQ_RESYNC) || (seq & WRITE_SEQ_MASK) == ((dev->write_ack + 1) & WRITE_SEQ_MASK)) {
+                        dev->write_ack = seq & WRITE_SEQ_MASK;
+                    }
+                }
+                if (latency_param != -1) {
+                    receive_device_write(dev, type, latency_param, msg, now, stats);
+                }
+            }
+        }
+        start += DELIMITER_SIZE + COBS_LENGTH_SIZE + cobs_len;
+        msg->max_payload_length = MAX_PAYLOAD_SIZE;
+    }
+    memmove(dev->rx, &dev->rx[start], dev->rx_len - start);
+    dev->rx_len -= start;
+}
+
+/**
+ * Sends a DEVICE_DATA with every readable param of a device
+ * Arguments:
+ *    config: the configuration of the run
+ *    dev: the device sending the data
+ *    msg: a message with a payload of MAX_PAYLOAD_SIZE to build the DEVICE_DATA in
+ *    stats: the results of the run
+ */
+static void send_device_data(fleet_config_t* config, fleet_dev_t* dev, message_t* msg, fleet_stats_t* stats) {
+    // If the previous messages are still waiting to be read, dev handler isn't keeping up
+    if (dev->tx_len != 0) {
+        stats->data_dropped++;
+        return;
+    }
+    uint8_t dev_type = device_name_to_type(config->dev_name);
+    device_t* type = get_device(dev_type);
+    uint32_t pmap = get_readable_param_bitmap(dev_type);
+    float counter_f = (float) dev->counter;
+    uint8_t counter_b = dev->counter & 1;
+    msg->message_id = DEVICE_DATA;
+    memcpy(msg->payload, &pmap, BITMAP_SIZE);
+    msg->payload_length = BITMAP_SIZE;
+    for (int i = 0; ((pmap >> i) > 0) && (i < MAX_PARAMS); i++) {
+        if (!(pmap & (1 << i))) {
+            continue;
+        }
+        switch (type->params[i].type) {
+            case INT:
+                memcpy(&msg->payload[msg->payload_length], &dev->counter, sizeof(int32_t));
+                msg->payload_length += sizeof(int32_t);
+                break;
+            case FLOAT:
+                memcpy(&msg->payload[msg->payload_length], &counter_f, sizeof(float));
+                msg->payload_length += sizeof(float);
+                break;
+            case BOOL:
+                msg->payload[msg->payload_length] = counter_b;
+                msg->payload_length += sizeof(uint8_t);
+                break;
+        }
+    }
+    if (dev->send_timestamps) {
+        uint32_t sample_time = (uint32_t) micros();
+        memcpy(&msg->payload[msg->payload_length], &sample_time, TIMESTAMP_SIZE);
+        memcpy(&msg->payload[msg->payload_length + TIMESTAMP_SIZE], &dev->last_write_time, TIMESTAMP_SIZE);
+        msg->payload_length += DEVICE_DATA_TIMESTAMPS_SIZE;
+    }
+    if (dev->send_write_ack) {
+        memcpy(&msg->payload[msg->payload_length], &dev->write_ack, WRITE_SEQ_SIZE);
+        msg->payload_length += WRITE_SEQ_SIZE;
+    }
+    msg->max_payload_length = MAX_PAYLOAD_SIZE;
+    bool corrupt = (uint32_t) (rand() % 1000) < config->malformed_per_mille;
+    if (queue_message(dev, msg, corrupt) != 0) {
+        stats->data_dropped++;
+        return;
+    }
+    if (corrupt) {
+        stats->malformed_sent++;
+    } else {
+        stats->data_sent++;
+    }
+    dev->counter++;
+}
+
+// Writes a burst of commands to the latency param of every running device through shared memory
+static void write_burst(fleet_config_t* config, fleet_stats_t* stats) {
+    int latency_param = get_latency_param(get_device(device_name_to_type(config->dev_name)));
+    if (latency_param == -1) {
+        return;
+    }
+    param_val_t params[MAX_PARAMS];
+    for (int i = 0; i < config->num_devices; i++) {
+        fleet_dev_t* dev = &fleet_devs[i];
+        if (dev->state != DEV_RUNNING) {
+            continue;
+        }
+        for (int j = 0; j < config->write_burst_size; j++) {
+            dev->write_seq++;
+            params[latency_param].p_i = dev->write_seq;
+            dev->write_times[dev->write_seq % WRITE_RING_SIZE] = micros();
+            if (device_write_uid(dev->uid, EXECUTOR, COMMAND, 1 << latency_param, params) == 0) {
+                stats->writes_issued++;
+            }
+        }
+    }
+}
+
+// Unplugs the next STORM_SIZE running devices, starting after the ones unplugged by the last storm
+static void disconnect_storm(fleet_config_t* config, fleet_stats_t* stats, int* next_victim, uint64_t now) {
+    for (int unplugged = 0, checked = 0; unplugged < config->storm_size && checked < config->num_devices; checked++) {
+        fleet_dev_t* dev = &fleet_devs[*next_victim];
+        *next_victim = (*next_victim + 1) % config->num_devices;
+        if (dev->state == DEV_RUNNING) {
+            unplug(dev);
+            dev->unplugged_until = now + config->storm_downtime_ms * 1000;
+            stats->disconnects++;
+            unplugged++;
+        }
+    }
+}
+
+// Samples dev handler's measurement of each running device's DATA latency
+static void sample_ingest_latency(fleet_config_t* config) {
+    dev_timing_t timing;
+    for (int i = 0; i < config->num_devices; i++) {
+        fleet_dev_t* dev = &fleet_devs[i];
+        // Dev handler only synchronizes clocks once the device is in shared memory
+        if (dev->state == DEV_RUNNING && dev->send_timestamps && device_timing_read_uid(dev->uid, &timing) == 0 && timing.synced && timing.last_sample_time != dev->last_sample_time) {
+            add_sample(&ingest_lat, timing.sample_to_shm_us);
+            dev->last_sample_time = timing.last_sample_time;
+        }
+    }
+}
+
+// ******************************** Public ********************************* //
+
+int fleet_run(fleet_config_t* config, fleet_stats_t* stats) {
+    if (config->num_devices < 1 || config->num_devices > MAX_DEVICES || config->data_interval_us == 0 || device_name_to_type(config->dev_name) == (uint8_t) -1) {
+        log_printf(ERROR, "fleet_run: Invalid configuration for run %s", config->name);
+        return -1;
+    }
+    const char* home_dir = getenv("HOME");
+    message_t* msg = make_empty(MAX_PAYLOAD_SIZE);
+    struct pollfd fds[MAX_DEVICES];
+
+    // Plug in every device
+    for (int i = 0; i < config->num_devices; i++) {
+        fleet_dev_t* dev = &fleet_devs[i];
+        *dev = (fleet_dev_t){.uid = config->first_uid + i, .fd = -1, .listen_fd = -1, .pty_slave_fd = -1};
+        if (config->transport == FLEET_SOCKET) {
+            sprintf(dev->port_name, "%s/%s%d", home_dir, SOCKET_PREFIX, i);
+        } else {
+            sprintf(dev->port_name, "%s%d", PTY_PREFIX, i);
+        }
+        if (plug_in(config, dev) != 0) {
+            for (int j = 0; j < i; j++) {
+                unplug(&fleet_devs[j]);
+            }
+            destroy_message(msg);
+            return -1;
+        }
+    }
+
+    write_lat.num_samples = ingest_lat.num_samples = connect_lat.num_samples = 0;
+    *stats = (fleet_stats_t){0};
+    bool measuring = false;
+    uint64_t start = micros();
+    uint64_t next_burst = 0, next_storm = 0, next_timing_sample = 0, end = 0;
+    uint64_t start_ticks = 0;
+    int next_victim = 0;
+
+    while (!measuring || micros() < end) {
+        uint64_t now = micros();
+
+        // Start measuring once every device is running (or waiting longer doesn't help)
+        if (!measuring) {
+            int running = 0;
+            for (int i = 0; i < config->num_devices; i++) {
+                running += (fleet_devs[i].state == DEV_RUNNING);
+            }
+            if (running == config->num_devices || now - start >= CONNECT_TIMEOUT * 1000) {
+                if (running != config->num_devices) {
+                    log_printf(WARN, "fleet_run: Only %d out of %d devices connected", running, config->num_devices);
+                }
+                uint32_t connect_samples = connect_lat.num_samples;
+                *stats = (fleet_stats_t){0};
+                write_lat.num_samples = ingest_lat.num_samples = 0;
+                connect_lat.num_samples = connect_samples;  // Initial connections are part of the results
+                measuring = true;
+                start = now;
+                end = now + config->duration_ms * 1000;
+                next_burst = now + config->write_burst_interval_ms * 1000;
+                next_storm = now + config->storm_interval_ms * 1000;
+                start_ticks = process_cpu_ticks(get_dev_handler_pid());
+            }
+        }
+
+        // Generate the load
+        if (measuring && config->write_burst_interval_ms != 0 && now >= next_burst) {
+            write_burst(config, stats);
+            next_burst += config->write_burst_interval_ms * 1000;
+        }
+        if (measuring && config->storm_interval_ms != 0 && now >= next_storm) {
+            disconnect_storm(config, stats, &next_victim, now);
+            next_storm += config->storm_interval_ms * 1000;
+        }
+        if (measuring && now >= next_timing_sample) {
+            sample_ingest_latency(config);
+            next_timing_sample = now + TIMING_SAMPLE_INTERVAL * 1000;
+        }
+
+        // Send data that is due and find out how long we can wait for dev handler
+        uint64_t wake_time = now + 1000;
+        for (int i = 0; i < config->num_devices; i++) {
+            fleet_dev_t* dev = &fleet_devs[i];
+            if (dev->state == DEV_UNPLUGGED && dev->unplugged_until != 0 && now >= dev->unplugged_until) {
+                plug_in(config, dev);
+            }
+            if (dev->state == DEV_RUNNING && now >= dev->next_data_time) {
+                send_device_data(config, dev, msg, stats);
+                dev->next_data_time += config->data_interval_us;
+                if (dev->next_data_time < now) {
+                    dev->next_data_time = now + config->data_interval_us;  // We fell behind; don't burst to catch up
+                }
+            }
+            if (dev->state == DEV_RUNNING && dev->next_data_time < wake_time) {
+                wake_time = dev->next_data_time;
+            }
+            if (dev->fd != -1 && flush_tx(dev) != 0) {
+                unplug(dev);
+                stats->timeouts++;
+                plug_in(config, dev);
+            }
+            fds[i].fd = (dev->state == DEV_LISTENING) ? dev->listen_fd : dev->fd;
+            fds[i].events = (fds[i].fd == -1) ? 0 : (POLLIN | ((dev->tx_len != 0) ? POLLOUT : 0));
+            fds[i].revents = 0;
+        }
+
+        // Wait for dev handler
+        now = micros();
+        struct timespec timeout = {0, (wake_time > now) ? (wake_time - now) * 1000 : 0};
+        if (ppoll(fds, config->num_devices, &timeout, NULL) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < config->num_devices; i++) {
+            fleet_dev_t* dev = &fleet_devs[i];
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            if (dev->state == DEV_LISTENING) {
+                dev->fd = accept4(dev->listen_fd, NULL, NULL, SOCK_NONBLOCK);
+                if (dev->fd != -1) {
+                    dev->state = DEV_CONNECTED;
+                }
+                continue;
+            }
+            ssize_t num_read = read(dev->fd, &dev->rx[dev->rx_len], FLEET_BUF_SIZE - dev->rx_len);
+            if (num_read > 0) {
+                dev->rx_len += num_read;
+                handle_rx(config, dev, msg, stats);
+                if (dev->rx_len == FLEET_BUF_SIZE) {
+                    dev->rx_len = 0;  // Garbage that doesn't parse; drop it
+                }
+            } else if (num_read == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                // Dev handler closed the connection (ex: timed out the device); plug back in to be found again
+                unplug(dev);
+                stats->timeouts++;
+                plug_in(config, dev);
+            }
+        }
+    }
+
+    // Collect the results
+    stats->duration_ms = (micros() - start) / 1000;
+    uint64_t cpu_ticks = process_cpu_ticks(get_dev_handler_pid()) - start_ticks;
+    stats->dev_handler_cpu_pct = (stats->duration_ms == 0) ? 0 : 100.0 * cpu_ticks / sysconf(_SC_CLK_TCK) / (stats->duration_ms / 1000.0);
+    for (int i = 0; i < config->num_devices; i++) {
+        unplug(&fleet_devs[i]);
+    }
+    compute_percentiles(&write_lat, &stats->write_lat_us);
+    compute_percentiles(&ingest_lat, &stats->ingest_lat_us);
+    compute_percentiles(&connect_lat, &stats->connect_ms);
+    destroy_message(msg);
+    return 0;
+}
+
+void fleet_print_csv_header(FILE* out) {
+    fprintf(out, "run,transport,device,num_devices,data_interval_us,write_burst_interval_ms,write_burst_size,malformed_per_mille,"
+                 "storm_interval_ms,storm_size,storm_downtime_ms,duration_ms,data_sent,data_per_sec,data_dropped,data_drop_pct,"
+                 "malformed_sent,writes_issued,writes_delivered,write_delivery_pct,disconnects,reconnects,timeouts,"
+                 "dev_handler_cpu_pct,cpu_pct_per_device,write_p50_us,write_p99_us,write_max_us,"
+                 "ingest_p50_us,ingest_p99_us,ingest_max_us,connect_p50_ms,connect_max_ms\n");
+}
+
+void fleet_print_csv_row(FILE* out, fleet_config_t* config, fleet_stats_t* stats) {
+    double seconds = stats->duration_ms / 1000.0;
+    uint64_t data_attempted = stats->data_sent + stats->data_dropped + stats->malformed_sent;
+    fprintf(out, "%s,%s,%s,%d,%u,%u,%d,%u,%u,%d,%u,", config->name, (config->transport == FLEET_SOCKET) ? "socket" : "pty",
+            config->dev_name, config->num_devices, config->data_interval_us, config->write_burst_interval_ms, config->write_burst_size,
+            config->malformed_per_mille, config->storm_interval_ms, config->storm_size, config->storm_downtime_ms);
+    fprintf(out, "%u,%llu,%.1f,%llu,%.2f,%llu,%llu,%llu,%.2f,%llu,%llu,%llu,", stats->duration_ms, stats->data_sent,
+            (seconds == 0) ? 0 : stats->data_sent / seconds, stats->data_dropped,
+            (data_attempted == 0) ? 0 : 100.0 * stats->data_dropped / data_attempted, stats->malformed_sent, stats->writes_issued,
+            stats->writes_delivered, (stats->writes_issued == 0) ? 0 : 100.0 * stats->writes_delivered / stats->writes_issued,
+            stats->disconnects, stats->reconnects, stats->timeouts);
+    fprintf(out, "%.2f,%.3f,%u,%u,%u,%u,%u,%u,%u,%u\n", stats->dev_handler_cpu_pct, stats->dev_handler_cpu_pct / config->num_devices,
+            stats->write_lat_us.p50, stats->write_lat_us.p99, stats->write_lat_us.max, stats->ingest_lat_us.p50,
+            stats->ingest_lat_us.p99, stats->ingest_lat_us.max, stats->connect_ms.p50, stats->connect_ms.max);
+    fflush(out);
+}
@@ -0,0 +1,103 @@
+/**
+ * A load generator that emulates a fleet of up to MAX_DEVICES lowcar devices from
+ * a single process to benchmark dev handler at full robot scale.
+ * Unlike the virtual devices in virtual_devices/, which fork one process per device
+ * and build every message on the heap, the fleet drives all devices from one
+ * poll() loop with preallocated buffers, so the load generator itself stays cheap
+ * and its measurements reflect dev handler.
+ *
+ * A fleet run can exercise:
+ *    - steady DEVICE_DATA at a configurable rate from every device
+ *    - bursts of DEVICE_WRITEs (commands written to shared memory for every device)
+ *    - malformed frame injection (corrupted DEVICE_DATA frames)
+ *    - disconnect storms (groups of devices unplugged and plugged back in)
+ * and reports throughput, drops, dev handler CPU usage, and latency percentiles.
+ *
+ * The fleet takes ports 0 to (num_devices - 1); don't connect virtual devices with
+ * connect_virtual_device() while a fleet is running.
+ */
+
+#ifndef DEV_FLEET_H
+#define DEV_FLEET_H
+
+#include <runtime_util.h>
+#include <shm_wrapper.h>
+
+// How the fleet's devices are presented to dev handler
+typedef enum {
+    FLEET_SOCKET,  // Unix sockets at $HOME/ttyACM*, picked up by dev handler as virtual devices
+    FLEET_PTY      // Pseudoterminals symlinked to /dev/ttyACM*, picked up as Arduinos (requires write access to /dev)
+} fleet_transport_t;
+
+// Describes the load of a single fleet run
+typedef struct {
+    char* name;                        // Name of the run; first column of its CSV row
+    fleet_transport_t transport;       // How devices are connected to dev handler
+    char* dev_name;                    // The type of every device in the fleet (ex: "GeneralTestDevice")
+    int num_devices;                   // Number of devices in the fleet (1 to MAX_DEVICES)
+    uint64_t first_uid;                // UID of the first device; the i-th device has UID first_uid + i
+    uint32_t data_interval_us;         // Microseconds between two DEVICE_DATA messages of a device
+    uint32_t write_burst_interval_ms;  // Milliseconds between two bursts of commands (0 to disable)
+    int write_burst_size;              // Number of commands written to each device per burst
+    uint32_t malformed_per_mille;      // Chance (out of 1000) that a DEVICE_DATA frame is corrupted
+    uint32_t storm_interval_ms;        // Milliseconds between two disconnect storms (0 to disable)
+    int storm_size;                    // Number of devices unplugged per storm
+    uint32_t storm_downtime_ms;        // Milliseconds a device stays unplugged during a storm
+    uint32_t duration_ms;              // Length of the measurement window
+} fleet_config_t;
+
+// Percentiles of a set of latency samples
+typedef struct {
+    uint32_t samples;  // Number of samples the percentiles were computed from
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+} fleet_percentiles_t;
+
+// Results of a single fleet run, all measured over the measurement window
+typedef struct {
+    uint32_t duration_ms;               // Actual length of the measurement window
+    uint64_t data_sent;                 // DEVICE_DATA messages written to dev handler
+    uint64_t data_dropped;              // DEVICE_DATA messages skipped because dev handler didn't read the previous ones in time
+    uint64_t malformed_sent;            // Corrupted DEVICE_DATA frames written to dev handler
+    uint64_t writes_issued;             // Commands written to shared memory
+    uint64_t writes_delivered;          // Commands that arrived at their device in a DEVICE_WRITE (commands of a burst may be coalesced)
+    uint64_t disconnects;               // Devices unplugged by disconnect storms
+    uint64_t reconnects;                // Devices acknowledged again by dev handler after being plugged back in
+    uint64_t timeouts;                  // Connections closed by dev handler
+    double dev_handler_cpu_pct;         // CPU usage of dev handler (100 is one core)
+    fleet_percentiles_t write_lat_us;   // Command written to shared memory -> DEVICE_WRITE received by the device
+    fleet_percentiles_t ingest_lat_us;  // Device sampled its params -> params in shared memory (as measured by dev handler)
+    fleet_percentiles_t connect_ms;     // Device plugged in -> device acknowledged by dev handler
+} fleet_stats_t;
+
+/**
+ * Runs a fleet of devices against a running dev handler
+ * Devices are connected and given up to a few seconds to be acknowledged before the
+ * measurement window starts. All devices are unplugged when the run is over.
+ * Arguments:
+ *    config: the load to generate
+ *    stats: populated with the results of the run
+ * Returns:
+ *    0 on success
+ *    -1 if the configuration is invalid or the devices couldn't be plugged in
+ */
+int fleet_run(fleet_config_t* config, fleet_stats_t* stats);
+
+/**
+ * Prints the header of the CSV produced by fleet_print_csv_row()
+ * Arguments:
+ *    out: stream to print to
+ */
+void fleet_print_csv_header(FILE* out);
+
+/**
+ * Prints the configuration and results of a fleet run as a CSV row
+ * Arguments:
+ *    out: stream to print to
+ *    config: the configuration of the run
+ *    stats: the results of the run
+ */
+void fleet_print_csv_row(FILE* out, fleet_config_t* config, fleet_stats_t* stats);
+
+#endif
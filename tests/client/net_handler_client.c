@@ -7,6 +7,7 @@ pthread_t dump_tid;  // holds the thread id of the output dumper threads
 // File pointers
 int nh_tcp_shep_fd = -1;     // holds file descriptor for TCP Shepherd socket
 int nh_tcp_dawn_fd = -1;     // holds file descriptor for TCP Dawn socket
+int nh_udp_fd = -1;          // holds file descriptor for the UDP socket on which Dawn's inputs are sent
 FILE* tcp_output_fp = NULL;  // holds current output location of incoming TCP messages
 FILE* null_fp = NULL;        // file pointer to /dev/null
 
@@ -17,8 +18,11 @@ FILE* null_fp = NULL;        // file pointer to /dev/null
  *   which has memory allocated to it. This prevents memory leak.
  * The mutex must be held whenever we want to access this global variable.
  */
-pthread_mutex_t most_recent_dev_data_mutex;  // lock over the following two variables
+pthread_mutex_t most_recent_dev_data_mutex;  // lock over the following variables
 DevData* most_recent_dev_data = NULL;        // Holds the most recent device_data received from Runtime
+uint64_t num_dev_data_full = 0;              // Number of full DevData messages (and schemas) received
+uint64_t num_dev_data_deltas = 0;            // Number of DevData deltas received and applied to most_recent_dev_data
+uint64_t num_dev_data_values = 0;            // Number of packed values received and applied to most_recent_dev_data
 
 // 2021 Game Specific
 bool hypothermia_enabled = false;  // 0 if hypothermia enabled, 1 if disabled
@@ -29,10 +33,10 @@ bool hypothermia_enabled = false;  // 0 if hypothermia enabled, 1 if disabled
  * Function to connect the net_handler_client to net_handler,
  * as the specified client.
  * Arguments:
- *    client: the client to connect as, one of DAWN or SHEPHERD
+ *    client_id: the client ID to connect with: 0 for Shepherd, 1 for Dawn, 2 for an observer
  * Returns: socket descriptor of new connection; kills net handler and exits on failure
  */
-static int connect_tcp(robot_desc_field_t client) {
+static int connect_tcp(uint8_t client_id) {
     int sockfd;
     if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
         log_printf(ERROR, "socket: failed to create listening socket: %s\n", strerror(errno));
@@ -60,8 +64,7 @@ static int connect_tcp(robot_desc_field_t client) {
     }
 
     // send the verification byte
-    uint8_t verif_byte = (client == SHEPHERD) ? 0 : 1;
-    if (writen(sockfd, &verif_byte, 1) == -1) {
+    if (writen(sockfd, &client_id, 1) == -1) {
         log_printf(ERROR, "writen: error sending verification byte\n");
         close(sockfd);
         stop_net_handler();
@@ -96,6 +99,93 @@ void print_dev_data(FILE* file, DevData* dev_data) {
     }
 }
 
+/**
+ * Applies a DevData delta to the device data it was computed against.
+ * The delta only holds the devices and params whose values changed, identified by UID and param name;
+ * net handler sends a full DevData instead whenever devices or params are added or removed.
+ * Arguments:
+ *    state: most recent device data, updated in place
+ *    delta: the delta to apply
+ * Returns:
+ *    0 on success, or
+ *    -1 if the delta refers to a device or param that isn't in STATE
+ */
+static int apply_dev_data_delta(DevData* state, DevData* delta) {
+    for (int i = 0; i < delta->n_devices; i++) {
+        Device* changed = delta->devices[i];
+        Device* device = NULL;
+        for (int j = 0; j < state->n_devices; j++) {
+            if (state->devices[j]->uid == changed->uid && state->devices[j]->type == changed->type) {
+                device = state->devices[j];
+                break;
+            }
+        }
+        if (device == NULL) {
+            return -1;
+        }
+        for (int j = 0; j < changed->n_params; j++) {
+            Param* param = NULL;
+            for (int k = 0; k < device->n_params; k++) {
+                if (strcmp(device->params[k]->name, changed->params[j]->name) == 0) {
+                    param = device->params[k];
+                    break;
+                }
+            }
+            if (param == NULL) {
+                return -1;
+            }
+            param->val_case = changed->params[j]->val_case;
+            param->ival = changed->params[j]->ival;
+            param->fval = changed->params[j]->fval;
+            param->bval = changed->params[j]->bval;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Applies a DEVICE_VALUES_MSG to the device data of the schema it follows.
+ * For each device, the message holds its index in the schema (1 byte), then the values of all of
+ * its params in schema order: 4 bytes for an int32 or a float, and 1 byte for a bool.
+ * Arguments:
+ *    state: most recent device data (the schema), updated in place
+ *    buf: payload of the DEVICE_VALUES_MSG
+ *    len: length of BUF
+ * Returns:
+ *    0 on success, or
+ *    -1 if the message doesn't match the schema
+ */
+static int apply_dev_data_values(DevData* state, uint8_t* buf, uint16_t len) {
+    uint8_t* end = buf + len;
+    while (buf < end) {
+        uint8_t idx = *buf++;
+        if (idx >= state->n_devices) {
+            return -1;
+        }
+        Device* device = state->devices[idx];
+        for (int i = 0; i < device->n_params; i++) {
+            Param* param = device->params[i];
+            size_t size = (param->val_case == PARAM__VAL_BVAL) ? 1 : 4;
+            if (buf + size > end) {
+                return -1;
+            }
+            switch (param->val_case) {
+                case PARAM__VAL_IVAL:
+                    memcpy(&param->ival, buf, sizeof(int32_t));
+                    break;
+                case PARAM__VAL_FVAL:
+                    memcpy(&param->fval, buf, sizeof(float));
+                    break;
+                default:
+                    param->bval = *buf;
+                    break;
+            }
+            buf += size;
+        }
+    }
+    return 0;
+}
+
 /**
  * Function to receive data as either Dawn or Shepherd on the connection.
  * Receives the next message on the TCP socket and prints out the contents.
@@ -128,13 +218,24 @@ static int recv_tcp_data(robot_desc_field_t client, int tcp_fd) {
         TimeStamps* time_stamp_msg = time_stamps__unpack(NULL, len, buf);
         if (time_stamp_msg == NULL) {
             fprintf(tcp_output_fp, "Cannot unpack time_stamp msg");
+        } else if (time_stamp_msg->dawn_timestamp == 0) {
+            // A round trip time probe from net handler, which is answered right away with our time, like Dawn does
+            time_stamp_msg->dawn_timestamp = millis();
+            uint16_t len_pb = time_stamps__get_packed_size(time_stamp_msg);
+            uint8_t* send_buf = make_buf(TIME_STAMP_MSG, len_pb);
+            time_stamps__pack(time_stamp_msg, send_buf + BUFFER_OFFSET);
+            if (writen(tcp_fd, send_buf, len_pb + BUFFER_OFFSET) == -1) {
+                log_printf(ERROR, "writen: issue answering round trip time probe\n");
+            }
+            free(send_buf);
+        } else {
+            uint64_t final_timestamp = millis();
+            printf("First Dawn Timestamp: %llu ms\n", time_stamp_msg->dawn_timestamp);
+            printf("Runtime Timestamp: %llu ms\n", time_stamp_msg->runtime_timestamp);
+            printf("Final Dawn Timestamp: %llu ms\n", final_timestamp);
+            printf("Round Dawn trip: %llu ms\n", final_timestamp - time_stamp_msg->dawn_timestamp);
+            fflush(stdout);
         }
-        uint64_t final_timestamp = millis();
-        printf("First Dawn Timestamp: %llu ms\n", time_stamp_msg->dawn_timestamp);
-        printf("Runtime Timestamp: %llu ms\n", time_stamp_msg->runtime_timestamp);
-        printf("Final Dawn Timestamp: %llu ms\n", final_timestamp);
-        printf("Round Dawn trip: %llu ms\n", final_timestamp - time_stamp_msg->dawn_timestamp);
-        fflush(stdout);
         time_stamps__free_unpacked(time_stamp_msg, NULL);
     } else if (msg_type == LOG_MSG) {
         if ((msg = text__unpack(NULL, len, buf)) == NULL) {
@@ -146,7 +247,7 @@ static int recv_tcp_data(robot_desc_field_t client, int tcp_fd) {
         }
         fflush(tcp_output_fp);
         text__free_unpacked(msg, NULL);
-    } else if (msg_type == DEVICE_DATA_MSG) {
+    } else if (msg_type == DEVICE_DATA_MSG || msg_type == DEVICE_SCHEMA_MSG) {
         // Update the global variable containing the most recent device data
         pthread_mutex_lock(&most_recent_dev_data_mutex);
         // Free the previous most recent device data
@@ -157,6 +258,31 @@ static int recv_tcp_data(robot_desc_field_t client, int tcp_fd) {
         if (most_recent_dev_data == NULL) {
             fprintf(tcp_output_fp, "Error unpacking incoming message from %s\n", client_str);
         }
+        num_dev_data_full++;
+        pthread_mutex_unlock(&most_recent_dev_data_mutex);
+    } else if (msg_type == DEVICE_DATA_DELTA_MSG) {
+        // Apply the changes to the most recent device data
+        DevData* delta = dev_data__unpack(NULL, len, buf);
+        if (delta == NULL) {
+            fprintf(tcp_output_fp, "Error unpacking incoming message from %s\n", client_str);
+        } else {
+            pthread_mutex_lock(&most_recent_dev_data_mutex);
+            if (most_recent_dev_data == NULL || apply_dev_data_delta(most_recent_dev_data, delta) != 0) {
+                fprintf(tcp_output_fp, "Received device data delta from %s that doesn't match the most recent device data\n", client_str);
+            } else {
+                num_dev_data_deltas++;
+            }
+            pthread_mutex_unlock(&most_recent_dev_data_mutex);
+            dev_data__free_unpacked(delta, NULL);
+        }
+    } else if (msg_type == DEVICE_VALUES_MSG) {
+        // Apply the values to the most recent schema
+        pthread_mutex_lock(&most_recent_dev_data_mutex);
+        if (most_recent_dev_data == NULL || apply_dev_data_values(most_recent_dev_data, buf, len) != 0) {
+            fprintf(tcp_output_fp, "Received device values from %s that don't match the most recent schema\n", client_str);
+        } else {
+            num_dev_data_values++;
+        }
         pthread_mutex_unlock(&most_recent_dev_data_mutex);
     } else {
         fprintf(tcp_output_fp, "Invalid message received over tcp from %s\n", client_str);
@@ -225,7 +351,7 @@ static void* output_dump(void* args) {
 
         // enable tcp output if more than enable_thresh has passed between last time and previous time
         // It's expected to be spammed with Device Data messages, so we do this logic for only other message types
-        if (msg_type != DEVICE_DATA_MSG) {
+        if (msg_type != DEVICE_DATA_MSG && msg_type != DEVICE_DATA_DELTA_MSG && msg_type != DEVICE_SCHEMA_MSG && msg_type != DEVICE_VALUES_MSG) {
             if (FD_ISSET(nh_tcp_shep_fd, &read_set) || FD_ISSET(nh_tcp_dawn_fd, &read_set)) {
                 curr_time = millis();
                 if (curr_time - last_received_time >= enable_threshold) {  // Start printing output again
@@ -251,8 +377,8 @@ static void* output_dump(void* args) {
 
 void connect_clients(bool dawn, bool shepherd) {
     // Connect Dawn and Shepherd to net handler over TCP
-    nh_tcp_dawn_fd = (dawn) ? connect_tcp(DAWN) : -1;
-    nh_tcp_shep_fd = (shepherd) ? connect_tcp(SHEPHERD) : -1;
+    nh_tcp_dawn_fd = (dawn) ? connect_tcp(1) : -1;
+    nh_tcp_shep_fd = (shepherd) ? connect_tcp(0) : -1;
 
     // open /dev/null, which will be used to disable log output if there are too many logs
     null_fp = fopen("/dev/null", "w");
@@ -268,6 +394,10 @@ void connect_clients(bool dawn, bool shepherd) {
     }
 }
 
+int connect_observer() {
+    return connect_tcp(2);
+}
+
 void start_net_handler() {
     // fork net_handler process
     if ((nh_pid = fork()) < 0) {
@@ -313,6 +443,10 @@ void close_output() {
     if (nh_tcp_dawn_fd != -1) {
         close(nh_tcp_dawn_fd);
     }
+    if (nh_udp_fd != -1) {
+        close(nh_udp_fd);
+        nh_udp_fd = -1;
+    }
 }
 
 void send_run_mode(robot_desc_field_t client, robot_desc_val_t mode) {
@@ -426,14 +560,22 @@ void send_start_pos(robot_desc_field_t client, robot_desc_val_t pos) {
     usleep(400000);  // allow time for net handler and runtime to react and generate output before returning to client
 }
 
-void send_user_input(uint64_t buttons, float joystick_vals[4], robot_desc_field_t source) {
+/**
+ * Builds an INPUTS_MSG with a single input with the specified buttons pushed and joystick values.
+ * Arguments:
+ *    - buttons, joystick_vals, source: as for send_user_input()
+ *    - prefix_len: number of bytes to leave between the header and the UserInputs (for the UDP sequence number)
+ *    - msg_len: set to the length of the returned message, including its header
+ * Returns: the message, which the caller must free
+ */
+static uint8_t* make_user_input_msg(uint64_t buttons, float joystick_vals[4], robot_desc_field_t source, uint16_t prefix_len, size_t* msg_len) {
     UserInputs inputs = USER_INPUTS__INIT;
 
     // build the message
     inputs.n_inputs = 1;
     inputs.inputs = malloc(sizeof(Input*) * inputs.n_inputs);
     if (inputs.inputs == NULL) {
-        log_printf(ERROR, "send_user_input: Failed to malloc inputs\n");
+        log_printf(ERROR, "make_user_input_msg: Failed to malloc inputs\n");
         exit(1);
     }
     Input input = INPUT__INIT;
@@ -445,7 +587,7 @@ void send_user_input(uint64_t buttons, float joystick_vals[4], robot_desc_field_
     input.n_axes = 4;
     input.axes = malloc(sizeof(double) * 4);
     if (input.axes == NULL) {
-        log_printf(ERROR, "send_user_input: Failed to malloc axes\n");
+        log_printf(ERROR, "make_user_input_msg: Failed to malloc axes\n");
         exit(1);
     }
     for (int i = 0; i < 4; i++) {
@@ -453,22 +595,49 @@ void send_user_input(uint64_t buttons, float joystick_vals[4], robot_desc_field_
     }
 
     uint16_t len = user_inputs__get_packed_size(&inputs);
-    uint8_t* send_buf = make_buf(INPUTS_MSG, len);
+    uint8_t* send_buf = make_buf(INPUTS_MSG, prefix_len + len);
     if (send_buf == NULL) {
-        log_printf(ERROR, "send_user_input: Failed to malloc buffer\n");
+        log_printf(ERROR, "make_user_input_msg: Failed to malloc buffer\n");
         exit(1);
     }
-    user_inputs__pack(&inputs, send_buf + BUFFER_OFFSET);
+    user_inputs__pack(&inputs, send_buf + BUFFER_OFFSET + prefix_len);
+    *msg_len = BUFFER_OFFSET + prefix_len + len;
+
+    // free everything but the message
+    free(input.axes);
+    free(inputs.inputs);
+    return send_buf;
+}
+
+void send_user_input(uint64_t buttons, float joystick_vals[4], robot_desc_field_t source) {
+    size_t len;
+    uint8_t* send_buf = make_user_input_msg(buttons, joystick_vals, source, 0, &len);
 
     // send the message
-    if (writen(nh_tcp_dawn_fd, send_buf, len + BUFFER_OFFSET) == -1) {
+    if (writen(nh_tcp_dawn_fd, send_buf, len) == -1) {
         log_printf(ERROR, "send_user_input: Error when sending UserInput message");
         exit(1);
     }
+    free(send_buf);
+}
+
+void send_user_input_udp(uint32_t seq, uint64_t buttons, float joystick_vals[4], robot_desc_field_t source) {
+    if (nh_udp_fd == -1 && (nh_udp_fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
+        log_printf(ERROR, "send_user_input_udp: failed to create UDP socket: %s\n", strerror(errno));
+        exit(1);
+    }
+    size_t len;
+    uint8_t* send_buf = make_user_input_msg(buttons, joystick_vals, source, UDP_SEQ_SIZE, &len);
+    memcpy(send_buf + BUFFER_OFFSET, &seq, UDP_SEQ_SIZE);
 
-    // free everything
-    free(input.axes);
-    free(inputs.inputs);
+    struct sockaddr_in serv_addr = {0};
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(RASPI_UDP_PORT);
+    serv_addr.sin_addr.s_addr = inet_addr(RASPI_ADDR);
+    if (sendto(nh_udp_fd, send_buf, len, 0, (struct sockaddr*) &serv_addr, sizeof(serv_addr)) != len) {
+        // a datagram can be lost anyway; the next one supersedes it
+        log_printf(ERROR, "send_user_input_udp: Error when sending UserInput datagram: %s", strerror(errno));
+    }
     free(send_buf);
 }
 
@@ -540,6 +709,52 @@ DevData* get_next_dev_data() {
     return device_copy;  // must be freed by caller with dev_data__free_unpacked
 }
 
+void request_dev_data_deltas() {
+    uint8_t* send_buf = make_buf(DEVICE_DATA_DELTA_MSG, 0);  // The request has no payload
+    if (writen(nh_tcp_dawn_fd, send_buf, BUFFER_OFFSET) == -1) {
+        log_printf(ERROR, "request_dev_data_deltas: Error when sending device data delta request");
+        exit(1);
+    }
+    free(send_buf);
+}
+
+void request_dev_data_values() {
+    uint8_t* send_buf = make_buf(DEVICE_SCHEMA_MSG, 0);  // The request has no payload
+    if (writen(nh_tcp_dawn_fd, send_buf, BUFFER_OFFSET) == -1) {
+        log_printf(ERROR, "request_dev_data_values: Error when sending device schema request");
+        exit(1);
+    }
+    free(send_buf);
+}
+
+void request_rtt_probes(robot_desc_field_t client) {
+    uint8_t* send_buf = make_buf(RTT_PROBE_MSG, 0);  // The request has no payload
+    if (writen((client == SHEPHERD) ? nh_tcp_shep_fd : nh_tcp_dawn_fd, send_buf, BUFFER_OFFSET) == -1) {
+        log_printf(ERROR, "request_rtt_probes: Error when sending round trip time probe request");
+        exit(1);
+    }
+    free(send_buf);
+}
+
+void set_dev_data_rate(uint16_t min_interval, uint16_t max_interval) {
+    uint16_t intervals[2] = {min_interval, max_interval};
+    uint8_t* send_buf = make_buf(DEVICE_DATA_RATE_MSG, sizeof(intervals));
+    memcpy(send_buf + BUFFER_OFFSET, intervals, sizeof(intervals));
+    if (writen(nh_tcp_dawn_fd, send_buf, BUFFER_OFFSET + sizeof(intervals)) == -1) {
+        log_printf(ERROR, "set_dev_data_rate: Error when sending device data rate request");
+        exit(1);
+    }
+    free(send_buf);
+}
+
+void get_dev_data_counts(uint64_t* num_full, uint64_t* num_deltas, uint64_t* num_values) {
+    pthread_mutex_lock(&most_recent_dev_data_mutex);
+    *num_full = num_dev_data_full;
+    *num_deltas = num_dev_data_deltas;
+    *num_values = num_dev_data_values;
+    pthread_mutex_unlock(&most_recent_dev_data_mutex);
+}
+
 void send_timestamp() {
     TimeStamps timestamp_msg = TIME_STAMPS__INIT;
     uint8_t* send_buf;
@@ -22,6 +22,13 @@ void print_dev_data(FILE* file, DevData* dev_data);
  */
 void connect_clients(bool dawn, bool shepherd);
 
+/**
+ * Connects a read-only observer to net handler, which is sent the same device data and logs as Dawn.
+ * Unlike Dawn and Shepherd, what the observer receives isn't read by the client; the caller reads it.
+ * Returns: socket descriptor of the observer's connection
+ */
+int connect_observer();
+
 /**
  * Starts a new instance of net handler and connects a fake Dawn and fake Shepherd.
  * Sets everything up for querying from the CLI or from a test.
@@ -74,6 +81,16 @@ void send_start_pos(robot_desc_field_t client, robot_desc_val_t pos);
  */
 void send_user_input(uint64_t buttons, float joystick_vals[4], robot_desc_field_t source);
 
+/**
+ * Sends the same UserInput message as send_user_input(), but as a UDP datagram with a sequence number.
+ * Net handler ignores datagrams whose sequence number isn't newer than the last one it applied.
+ * Arguments:
+ *    - seq: sequence number of the datagram, which should increase with each one sent
+ *    - buttons, joystick_vals, source: as for send_user_input()
+ * No return value.
+ */
+void send_user_input_udp(uint32_t seq, uint64_t buttons, float joystick_vals[4], robot_desc_field_t source);
+
 /**
  * Sends a UserInput message from (fake) Dawn specifying that both Keyboard and Gamepad are disconnected.
  */
@@ -85,6 +102,45 @@ void disconnect_user_input();
  */
 DevData* get_next_dev_data();
 
+/**
+ * Asks net_handler to send (fake) Dawn device data deltas instead of a full DevData every time.
+ * The client applies each delta to the most recent device data, so get_next_dev_data() keeps
+ * returning the full, current state of every device.
+ */
+void request_dev_data_deltas();
+
+/**
+ * Asks net_handler to send (fake) Dawn a schema (DEVICE_SCHEMA_MSG) followed by only the packed values of every
+ * device (DEVICE_VALUES_MSG). The client applies the values to the schema, so get_next_dev_data() keeps
+ * returning the full, current state of every device.
+ */
+void request_dev_data_values();
+
+/**
+ * Asks net_handler to send a client round trip time probes (see RTT_PROBE_MSG), which the client answers like Dawn does.
+ * Arguments:
+ *    client: the client that asks for them; one of DAWN or SHEPHERD
+ */
+void request_rtt_probes(robot_desc_field_t client);
+
+/**
+ * Asks net_handler to send (fake) Dawn device data no more often than every MIN_INTERVAL ms while values change,
+ * and at least every MAX_INTERVAL ms even if nothing changes.
+ * Arguments:
+ *    - min_interval: min ms between two device data messages
+ *    - max_interval: max ms between two device data messages, or 0 to only receive them when something changes
+ */
+void set_dev_data_rate(uint16_t min_interval, uint16_t max_interval);
+
+/**
+ * Gets the number of device data messages (fake) Dawn has received so far.
+ * Arguments:
+ *    - num_full: set to the number of full DevData messages (including schemas) received
+ *    - num_deltas: set to the number of DevData deltas received and applied
+ *    - num_values: set to the number of packed values received and applied
+ */
+void get_dev_data_counts(uint64_t* num_full, uint64_t* num_deltas, uint64_t* num_values);
+
 /**
  * Sends a Timestamp message with a "Dawn" timestamp attached to it. It is then received by the tcp_conn, where it
  * sends a new Timestamp message with the "Runtime" timestamp attached to it. Finally it comes back around to "net_handler_client"
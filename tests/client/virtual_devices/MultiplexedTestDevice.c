@@ -0,0 +1,75 @@
+/**
+ * MultiplexedTestDevice, A virtual multiplexed link (like a hub board)
+ * presenting several SimpleTestDevices over one connection
+ * The i-th device on the link has UID <uid> + i
+ */
+#include "virtual_device_util.h"
+
+// Number of logical devices on the link
+#define NUM_LINK_DEVICES 3
+
+// SimpleTestDevice params
+enum {
+    // Read-only
+    INCREASING,
+    DOUBLING,
+    FLIP_FLOP,
+    // Read and Write
+    MY_INT
+};
+
+/**
+ * Initialize the values for each param
+ * Arguments:
+ *    params: Array of params to be initialized
+ */
+void init_params(param_val_t params[]) {
+    params[INCREASING].p_i = 0;
+    params[DOUBLING].p_f = 1;
+    params[FLIP_FLOP].p_b = 1;
+    params[MY_INT].p_i = 0;
+}
+
+/**
+ * Changes device's read-only params
+ * Arguments:
+ *    params: Array of param values to be modified
+ */
+void device_actions(param_val_t params[]) {
+    params[INCREASING].p_i += 1;
+    params[DOUBLING].p_f *= 2;
+    params[FLIP_FLOP].p_b = 1 - params[FLIP_FLOP].p_b;
+}
+
+/**
+ * A multiplexed link that behaves like several lowcar devices, connected to dev handler via a socket
+ * Arguments:
+ *    int: file descriptor for the socket
+ *    uint64_t: uid of the first device on the link
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("Incorrect number of arguments: %d out of %d\n", argc, 3);
+        exit(1);
+    }
+
+    int fd = atoi(argv[1]);
+    uint64_t uid = strtoull(argv[2], NULL, 0);
+
+    uint8_t dev_type = device_name_to_type("SimpleTestDevice");
+    device_t* dev = get_device(dev_type);
+
+    dev_id_t dev_ids[NUM_LINK_DEVICES];
+    param_val_t dev_params[NUM_LINK_DEVICES][dev->num_params];
+    param_val_t* params[NUM_LINK_DEVICES];
+    for (int i = 0; i < NUM_LINK_DEVICES; i++) {
+        dev_ids[i].type = dev_type;
+        dev_ids[i].year = dev_type;
+        dev_ids[i].uid = uid + i;
+        init_params(dev_params[i]);
+        params[i] = dev_params[i];
+    }
+
+    lowcar_mux_protocol(fd, NUM_LINK_DEVICES, dev_ids, params, &device_actions, 1000);
+    return 0;
+}
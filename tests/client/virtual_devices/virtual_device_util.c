@@ -3,6 +3,9 @@
 // Number of milliseconds between sending each DEVICE_DATA message
 #define DATA_INTERVAL 1
 
+// Every how many DEVICE_WRITEs lowcar_protocol() drops one (0 to drop none); see set_device_write_loss()
+static int write_loss_every = 0;
+
 message_t* make_acknowledgement(uint8_t type, uint8_t year, uint64_t uid) {
     message_t* msg = malloc(sizeof(message_t));
     if (msg == NULL) {
@@ -23,7 +26,29 @@ message_t* make_acknowledgement(uint8_t type, uint8_t year, uint64_t uid) {
     return msg;
 }
 
-int receive_message(int fd, message_t* msg) {
+message_t* make_mux_acknowledgement(int num_devices, dev_id_t dev_ids[]) {
+    message_t* msg = make_empty(1 + num_devices * DEVICE_ID_SIZE);
+    msg->message_id = MUX_ACKNOWLEDGEMENT;
+    msg->payload[0] = num_devices;
+    for (int i = 0; i < num_devices; i++) {
+        uint8_t* id = &msg->payload[1 + i * DEVICE_ID_SIZE];
+        id[0] = dev_ids[i].type;
+        id[1] = dev_ids[i].year;
+        memcpy(&id[2], &dev_ids[i].uid, 8);
+    }
+    msg->payload_length = 1 + num_devices * DEVICE_ID_SIZE;
+    return msg;
+}
+
+/**
+ * Reads the next frame (delimiter, cobs length, then cobs-encoded message) from FD
+ * Arguments:
+ *    fd: File descriptor to read from
+ * Returns:
+ *    The frame, to be freed by the caller, or
+ *    NULL on bad read
+ */
+static uint8_t* read_frame(int fd) {
     uint8_t last_byte_read = 0;  // Variable to temporarily hold a read byte
     int num_bytes_read = 0;
 
@@ -32,7 +57,7 @@ int receive_message(int fd, message_t* msg) {
         num_bytes_read = read(fd, &last_byte_read, 1);  // Waiting for first byte can block
         if (num_bytes_read == -1) {
             printf("receive_message: Couldn't read first byte -- %s\n", strerror(errno));
-            return 1;
+            return NULL;
         } else if (last_byte_read == 0x00) {
             // Found start of a message
             break;
@@ -45,7 +70,7 @@ int receive_message(int fd, message_t* msg) {
     uint8_t cobs_len;
     num_bytes_read = read(fd, &cobs_len, 1);
     if (num_bytes_read != 1) {
-        return 1;
+        return NULL;
     }
 
     // Allocate buffer to read message into
@@ -62,6 +87,14 @@ int receive_message(int fd, message_t* msg) {
     if (num_bytes_read != cobs_len) {
         printf("receive_message: Couldn't read the full message. Read only %d out of %d bytes\n", num_bytes_read, cobs_len);
         free(data);
+        return NULL;
+    }
+    return data;
+}
+
+int receive_message(int fd, message_t* msg) {
+    uint8_t* data = read_frame(fd);
+    if (data == NULL) {
         return 1;
     }
 
@@ -90,6 +123,37 @@ void send_message(int fd, message_t* msg) {
     free(data);
 }
 
+int receive_addressed_message(int fd, message_t* msg, uint8_t* address) {
+    uint8_t* data = read_frame(fd);
+    if (data == NULL) {
+        return 1;
+    }
+
+    // Parse the message
+    int ret = parse_addressed_message(data, msg, address);
+    free(data);
+    if (ret != 0) {
+        printf("receive_addressed_message: Incorrect checksum\n");
+        return 2;
+    }
+    return 0;
+}
+
+void send_addressed_message(int fd, uint8_t address, message_t* msg) {
+    int len = calc_max_cobs_msg_length(msg);
+    uint8_t* data = malloc(len);
+    if (data == NULL) {
+        printf("send_addressed_message: Failed to malloc\n");
+        exit(1);
+    }
+    len = addressed_message_to_bytes(msg, address, data, len);
+    int transferred = write(fd, data, len);
+    if (transferred != len) {
+        printf("send_addressed_message: Sent only %d out of %d bytes\n", transferred, len);
+    }
+    free(data);
+}
+
 void device_write(uint8_t type, message_t* dev_write, param_val_t params[]) {
     device_t* dev = get_device(type);
     // Get bitmap from payload
@@ -153,6 +217,45 @@ message_t* make_device_data(uint8_t type, uint32_t pmap, param_val_t params[]) {
     return dev_data;
 }
 
+void append_device_data_timestamps(message_t* dev_data, uint32_t sample_time, uint32_t write_time) {
+    memcpy(&dev_data->payload[dev_data->payload_length], &sample_time, TIMESTAMP_SIZE);
+    memcpy(&dev_data->payload[dev_data->payload_length + TIMESTAMP_SIZE], &write_time, TIMESTAMP_SIZE);
+    dev_data->payload_length += DEVICE_DATA_TIMESTAMPS_SIZE;
+    dev_data->max_payload_length = dev_data->payload_length;
+}
+
+void acknowledge_device_write(uint8_t type, message_t* dev_write, uint16_t* ack) {
+    uint16_t seq;
+    if (parse_write_seq(type, dev_write, &seq) != 0) {
+        return;
+    }
+    // Only advance past sequence numbers received in order, unless told to resynchronize
+    if ((seq & WRITE_SEQ_RESYNC) || (seq & WRITE_SEQ_MASK) == ((*ack + 1) & WRITE_SEQ_MASK)) {
+        *ack = seq & WRITE_SEQ_MASK;
+    }
+}
+
+void append_device_data_write_ack(message_t* dev_data, uint16_t ack) {
+    memcpy(&dev_data->payload[dev_data->payload_length], &ack, WRITE_SEQ_SIZE);
+    dev_data->payload_length += WRITE_SEQ_SIZE;
+    dev_data->max_payload_length = dev_data->payload_length;
+}
+
+void set_device_write_loss(int every) {
+    write_loss_every = every;
+}
+
+message_t* make_ping_reply(uint32_t host_send_time, uint32_t device_recv_time) {
+    message_t* reply = make_empty(PING_REPLY_SIZE);
+    reply->message_id = DEVICE_PING;
+    uint32_t device_send_time = (uint32_t) micros();
+    memcpy(&reply->payload[0], &host_send_time, TIMESTAMP_SIZE);
+    memcpy(&reply->payload[TIMESTAMP_SIZE], &device_recv_time, TIMESTAMP_SIZE);
+    memcpy(&reply->payload[2 * TIMESTAMP_SIZE], &device_send_time, TIMESTAMP_SIZE);
+    reply->payload_length = PING_REPLY_SIZE;
+    return reply;
+}
+
 void lowcar_protocol(int fd, uint8_t type, uint8_t year, uint64_t uid,
                      param_val_t params[], void (*device_actions)(param_val_t[]), int32_t action_interval) {
     message_t* incoming_msg = make_empty(MAX_PAYLOAD_SIZE);
@@ -162,6 +265,12 @@ void lowcar_protocol(int fd, uint8_t type, uint8_t year, uint64_t uid,
     uint64_t last_sent_data_time = 0;
     uint64_t last_device_action = 0;
     uint8_t sent_ack = 0;
+    uint8_t send_timestamps = 0;  // Whether dev handler asked for clock synchronization
+    uint32_t last_write_time = 0;  // Lower 32 bits of micros() when the last DEVICE_WRITE was applied
+    uint8_t send_write_ack = 1;    // Whether to echo WRITE_ACK in DEVICE_DATA, which tells dev handler to number its DEVICE_WRITEs
+    uint16_t write_ack = 0;        // Sequence number of the last DEVICE_WRITE received in order
+    int num_writes = 0;            // Number of DEVICE_WRITEs received, for set_device_write_loss()
+    uint32_t host_send_time;
     uint64_t now;
     uint32_t readable_param_bitmap = get_readable_param_bitmap(type);  // Calculated once outside the loop for performance
 
@@ -179,11 +288,23 @@ void lowcar_protocol(int fd, uint8_t type, uint8_t year, uint64_t uid,
                         send_message(fd, outgoing_msg);
                         destroy_message(outgoing_msg);
                         sent_ack = 1;
+                    } else if (incoming_msg->payload_length == PING_REQUEST_SIZE) {
+                        // Reply to the clock synchronization request right away
+                        memcpy(&host_send_time, incoming_msg->payload, TIMESTAMP_SIZE);
+                        outgoing_msg = make_ping_reply(host_send_time, (uint32_t) micros());
+                        send_message(fd, outgoing_msg);
+                        destroy_message(outgoing_msg);
+                        send_timestamps = 1;
                     }
                     break;
 
                 case DEVICE_WRITE:
+                    if (write_loss_every != 0 && ++num_writes % write_loss_every == 0) {
+                        break;  // Pretend the message was corrupted
+                    }
                     device_write(type, incoming_msg, params);
+                    last_write_time = (uint32_t) micros();
+                    acknowledge_device_write(type, incoming_msg, &write_ack);
                     // If we're writing a pitch to the SoundDevice, play the pitch
                     if (type == device_name_to_type("SoundDevice")) {
                         (*device_actions)(params);
@@ -236,8 +357,123 @@ void lowcar_protocol(int fd, uint8_t type, uint8_t year, uint64_t uid,
         // Check if we should send another DEVICE_DATA
         if ((now - last_sent_data_time) >= DATA_INTERVAL) {
             outgoing_msg = make_device_data(type, readable_param_bitmap, params);
+            if (send_timestamps) {
+                append_device_data_timestamps(outgoing_msg, (uint32_t) micros(), last_write_time);
+            }
+            if (send_write_ack) {
+                append_device_data_write_ack(outgoing_msg, write_ack);
+            }
             send_message(fd, outgoing_msg);
             destroy_message(outgoing_msg);
         }
     }
 }
+
+void lowcar_mux_protocol(int fd, int num_devices, dev_id_t dev_ids[], param_val_t* params[],
+                         void (*device_actions)(param_val_t[]), int32_t action_interval) {
+    message_t* incoming_msg = make_empty(MAX_PAYLOAD_SIZE);
+    message_t* outgoing_msg;
+    uint8_t address;
+    uint64_t last_received_ping_time = millis();
+    uint64_t last_sent_data_time = 0;
+    uint64_t last_device_action = 0;
+    uint8_t sent_ack = 0;
+    uint8_t send_timestamps[num_devices];  // Whether dev handler asked each device for clock synchronization
+    uint32_t last_write_time[num_devices];  // Lower 32 bits of micros() when each device last applied a DEVICE_WRITE
+    uint8_t send_write_ack[num_devices];    // Whether each device echoes WRITE_ACK in DEVICE_DATA, which tells dev handler to number its DEVICE_WRITEs
+    uint16_t write_ack[num_devices];        // Sequence number of the last DEVICE_WRITE each device received in order
+    uint32_t host_send_time;
+    uint64_t now;
+    memset(send_timestamps, 0, sizeof(send_timestamps));
+    memset(last_write_time, 0, sizeof(last_write_time));
+    memset(send_write_ack, 1, sizeof(send_write_ack));
+    memset(write_ack, 0, sizeof(write_ack));
+
+    // Every cycle, read a message and respond accordingly, then send messages as needed
+    while (1) {
+        now = millis();
+        // The DEVICE_PING before the MUX_ACKNOWLEDGEMENT isn't addressed; every message after it is
+        int ret = sent_ack ? receive_addressed_message(fd, incoming_msg, &address) : receive_message(fd, incoming_msg);
+        if (ret == 0 && sent_ack && address >= num_devices) {
+            printf("lowcar_mux_protocol: Received message to invalid address %d\n", address);
+        } else if (ret == 0) {
+            // Got a message
+            switch (incoming_msg->message_id) {
+                case DEVICE_PING:
+                    last_received_ping_time = now;
+                    if (!sent_ack) {
+                        // Announce every device on the link
+                        outgoing_msg = make_mux_acknowledgement(num_devices, dev_ids);
+                        send_message(fd, outgoing_msg);
+                        destroy_message(outgoing_msg);
+                        sent_ack = 1;
+                    } else if (incoming_msg->payload_length == PING_REQUEST_SIZE) {
+                        // Reply to the clock synchronization request right away
+                        memcpy(&host_send_time, incoming_msg->payload, TIMESTAMP_SIZE);
+                        outgoing_msg = make_ping_reply(host_send_time, (uint32_t) micros());
+                        send_addressed_message(fd, address, outgoing_msg);
+                        destroy_message(outgoing_msg);
+                        send_timestamps[address] = 1;
+                    }
+                    break;
+
+                case DEVICE_WRITE:
+                    device_write(dev_ids[address].type, incoming_msg, params[address]);
+                    last_write_time[address] = (uint32_t) micros();
+                    acknowledge_device_write(dev_ids[address].type, incoming_msg, &write_ack[address]);
+                    break;
+
+                case RST:
+                    printf("lowcar_mux_protocol (%llX): Received a RST\n", dev_ids[address].uid);
+                    exit(1);
+
+                default:
+                    printf("lowcar_mux_protocol (%llX): Received message of invalid type\n", dev_ids[address].uid);
+                    break;
+            }
+        }
+        incoming_msg->message_id = NOP;
+        incoming_msg->payload_length = 0;
+        incoming_msg->max_payload_length = MAX_PAYLOAD_SIZE;
+        memset(incoming_msg->payload, 0, MAX_PAYLOAD_SIZE);
+
+        //  Don't send any other messages until we've sent an ACK
+        if (!sent_ack) {
+            continue;
+        }
+
+        // Make sure we're receiving DEVICE_PING messages still
+        if ((now - last_received_ping_time) >= TIMEOUT) {
+            printf("lowcar_mux_protocol: DEV_HANDLER timed out!\n");
+            outgoing_msg = make_rst();
+            for (int i = 0; i < num_devices; i++) {
+                send_addressed_message(fd, i, outgoing_msg);
+            }
+            destroy_message(outgoing_msg);
+            exit(1);
+        }
+
+        // Change read-only params periodically
+        if (action_interval != -1 && (now - last_device_action) >= action_interval) {
+            for (int i = 0; i < num_devices; i++) {
+                (*device_actions)(params[i]);
+            }
+            last_device_action = now;
+        }
+        // Check if we should send another DEVICE_DATA for each device
+        if ((now - last_sent_data_time) >= DATA_INTERVAL) {
+            for (int i = 0; i < num_devices; i++) {
+                outgoing_msg = make_device_data(dev_ids[i].type, get_readable_param_bitmap(dev_ids[i].type), params[i]);
+                if (send_timestamps[i]) {
+                    append_device_data_timestamps(outgoing_msg, (uint32_t) micros(), last_write_time[i]);
+                }
+                if (send_write_ack[i]) {
+                    append_device_data_write_ack(outgoing_msg, write_ack[i]);
+                }
+                send_addressed_message(fd, i, outgoing_msg);
+                destroy_message(outgoing_msg);
+            }
+            last_sent_data_time = now;
+        }
+    }
+}
@@ -22,6 +22,18 @@
  */
 message_t* make_acknowledgement(uint8_t type, uint8_t year, uint64_t uid);
 
+/**
+ * Builds a MUX_ACKNOWLEDGEMENT message, announcing the logical devices on a multiplexed link
+ * Arguments:
+ *    num_devices: The number of devices on the link (1 to MAX_LINK_DEVICES)
+ *    dev_ids: The identities of the devices; the i-th device has address i
+ * Returns:
+ *    A message of type MUX_ACKNOWLEDGEMENT
+ *      Payload: num_devices, then type, year, and uid of each device
+ *      payload_length: 1 + num_devices * DEVICE_ID_SIZE
+ */
+message_t* make_mux_acknowledgement(int num_devices, dev_id_t dev_ids[]);
+
 /**
  * Receives a message
  * Arguments:
@@ -42,6 +54,28 @@ int receive_message(int fd, message_t* msg);
  */
 void send_message(int fd, message_t* msg);
 
+/**
+ * Receives a message on a multiplexed link
+ * Arguments:
+ *    fd: File descriptor to read from
+ *    msg: message_t to be populated with parsed message
+ *    address: Populated with the address of the device the message is for
+ * Returns:
+ *    0 on success
+ *    1 on bad read
+ *    2 on incorrect checksum
+ */
+int receive_addressed_message(int fd, message_t* msg, uint8_t* address);
+
+/**
+ * Sends a message on a multiplexed link
+ * Arguments:
+ *    fd: File descriptor to write to
+ *    address: The address of the device sending the message
+ *    msg: message_t to be sent
+ */
+void send_addressed_message(int fd, uint8_t address, message_t* msg);
+
 /**
  * Processes a DEVICE_WRITE message, writing to params as appropriate
  * Arguments:
@@ -63,6 +97,52 @@ void device_write(uint8_t type, message_t* dev_write, param_val_t params[]);
  */
 message_t* make_device_data(uint8_t type, uint32_t pmap, param_val_t params[]);
 
+/**
+ * Appends the clock synchronization timestamps to a DEVICE_DATA message built by make_device_data()
+ * Arguments:
+ *    dev_data: The DEVICE_DATA message to append to
+ *    sample_time: Lower 32 bits of micros() when the params in DEV_DATA were read
+ *    write_time: Lower 32 bits of micros() when the last DEVICE_WRITE was applied (0 if none)
+ */
+void append_device_data_timestamps(message_t* dev_data, uint32_t sample_time, uint32_t write_time);
+
+/**
+ * Updates a device's write acknowledgement with the sequence number of a received DEVICE_WRITE, if any
+ * (see write_acks.h in dev handler)
+ * Arguments:
+ *    type: The type of the device that received DEV_WRITE
+ *    dev_write: The received DEVICE_WRITE
+ *    ack: The device's acknowledgement to update, which is left as is if DEV_WRITE carries no sequence number
+ */
+void acknowledge_device_write(uint8_t type, message_t* dev_write, uint16_t* ack);
+
+/**
+ * Appends a write acknowledgement to a DEVICE_DATA message, after the timestamps if any
+ * Arguments:
+ *    dev_data: The DEVICE_DATA message to append to
+ *    ack: The device's write acknowledgement
+ */
+void append_device_data_write_ack(message_t* dev_data, uint16_t ack);
+
+/**
+ * Makes lowcar_protocol() drop DEVICE_WRITEs, as if they were corrupted on the way
+ * Arguments:
+ *    every: Drop every EVERY-th DEVICE_WRITE received (0 to drop none)
+ */
+void set_device_write_loss(int every);
+
+/**
+ * Builds a DEVICE_PING in reply to a clock synchronization DEVICE_PING from dev handler
+ * Arguments:
+ *    host_send_time: The timestamp in the payload of dev handler's DEVICE_PING
+ *    device_recv_time: Lower 32 bits of micros() when dev handler's DEVICE_PING was received
+ * Returns:
+ *    A message of type DEVICE_PING
+ *      Payload: host_send_time, device_recv_time, then the current time
+ *      payload_length: PING_REPLY_SIZE
+ */
+message_t* make_ping_reply(uint32_t host_send_time, uint32_t device_recv_time);
+
 /**
  * Executes the lowcar protocol, receiving/responding to messages, and sending
  * messages as appropriate
@@ -79,4 +159,21 @@ message_t* make_device_data(uint8_t type, uint32_t pmap, param_val_t params[]);
 void lowcar_protocol(int fd, uint8_t type, uint8_t year, uint64_t uid,
                      param_val_t params[], void (*device_actions)(param_val_t[]), int32_t action_interval);
 
+/**
+ * Executes the lowcar protocol for a multiplexed link presenting several logical devices
+ * over one connection, like a hub board would.
+ * The link answers the first DEVICE_PING with a MUX_ACKNOWLEDGEMENT; after that, every
+ * message carries the address of the device it is from or for.
+ * Arguments:
+ *    fd: The file descriptor to read from and write to
+ *    num_devices: The number of devices on the link (1 to MAX_LINK_DEVICES)
+ *    dev_ids: The identities of the devices; the i-th device has address i
+ *    params: params[i] is the array of parameters of the i-th device
+ *    device_actions: Function pointer that accepts an array of params and
+ *      modifies the param values; called on each device's params
+ *    action_interval: Number of milliseconds between each call to device_actions(). Set to -1 to disable
+ */
+void lowcar_mux_protocol(int fd, int num_devices, dev_id_t dev_ids[], param_val_t* params[],
+                         void (*device_actions)(param_val_t[]), int32_t action_interval);
+
 #endif
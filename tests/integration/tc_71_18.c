@@ -0,0 +1,25 @@
+/**
+ * Verifies that dev handler synchronizes with a device's clock using
+ * timestamped DEVICE_PINGs and publishes the measured latency between the
+ * device reading its params and the values landing in shared memory
+ */
+
+#include "../test.h"
+
+#define UID 0x18
+// A virtual device is on the same machine, so this should be well under a millisecond
+#define UPPER_BOUND_LATENCY_US 5000
+
+int main() {
+    // Setup
+    start_test("Device Clock Sync", "", NO_REGEX);
+
+    // Connect GeneralTestDevice
+    connect_virtual_device("GeneralTestDevice", UID);
+    sleep(2);  // Wait for ACK exchange and a few DEVICE_PING exchanges
+
+    // Check that the clock was synchronized and the latency is reasonable
+    check_device_timing(UID, UPPER_BOUND_LATENCY_US);
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * Verifies that dev handler supports multiplexed links: several logical
+ * devices presented over one port, each connected to shared memory on its own.
+ * A command written to one device on the link must reach only that device.
+ */
+
+#include "../test.h"
+
+#define UID 0x21  // UID of the first device on the link; the others follow
+#define NUM_LINK_DEVICES 3
+#define DEVICE_NAME "SimpleTestDevice"
+#define PARAM_NAME "MY_INT"
+#define MY_INT 3  // Index of PARAM_NAME
+
+int main() {
+    // Setup
+    start_test("Multiplexed Link", "", NO_REGEX);
+
+    // Connect a link with three SimpleTestDevices
+    int socket_num = connect_virtual_device("MultiplexedTestDevice", UID);
+    sleep(1);
+    for (int i = 0; i < NUM_LINK_DEVICES; i++) {
+        check_device_connected(UID + i);
+    }
+
+    // Write to the second device on the link only
+    param_val_t params[MAX_PARAMS];
+    params[MY_INT].p_i = 71;
+    device_write_uid(UID + 1, EXECUTOR, COMMAND, 1 << MY_INT, params);
+    sleep(1);
+
+    // Check that the write reached the second device and no other
+    param_val_t zero = {0};
+    param_val_t written = {.p_i = 71};
+    same_param_value(DEVICE_NAME, UID, PARAM_NAME, INT, zero);
+    same_param_value(DEVICE_NAME, UID + 1, PARAM_NAME, INT, written);
+    same_param_value(DEVICE_NAME, UID + 2, PARAM_NAME, INT, zero);
+
+    // Unplugging the link disconnects every device on it
+    disconnect_virtual_device(socket_num);
+    sleep(1);
+    for (int i = 0; i < NUM_LINK_DEVICES; i++) {
+        check_device_not_connected(UID + i);
+    }
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * Verifies that dev handler retransmits DEVICE_WRITEs that a device didn't acknowledge.
+ * LossyTestDevice drops every other DEVICE_WRITE; without retransmissions, every
+ * other command would never take effect (including the last one).
+ */
+
+#include "../test.h"
+
+#define UID 0x22
+#define DEVICE_NAME "SimpleTestDevice"  // LossyTestDevice identifies as a SimpleTestDevice
+#define PARAM_NAME "MY_INT"
+#define MY_INT 3  // Index of PARAM_NAME
+#define NUM_WRITES 6
+
+int main() {
+    // Setup
+    start_test("DEVICE_WRITE Retransmission", "", NO_REGEX);
+
+    // Connect LossyTestDevice
+    connect_virtual_device("LossyTestDevice", UID);
+    sleep(1);
+
+    // Send commands one at a time so that each goes out in its own DEVICE_WRITE
+    param_val_t params[MAX_PARAMS];
+    for (int i = 1; i <= NUM_WRITES; i++) {
+        params[MY_INT].p_i = i;
+        device_write_uid(UID, EXECUTOR, COMMAND, 1 << MY_INT, params);
+        usleep(200000);
+    }
+    sleep(1);
+
+    // Check that the last command took effect, and that it took retransmissions
+    param_val_t expected = {.p_i = NUM_WRITES};
+    same_param_value(DEVICE_NAME, UID, PARAM_NAME, INT, expected);
+    check_write_acks(UID, NUM_WRITES / 2);
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+/**
+ * Verifies that a Dawn that asked for device data deltas can reconstruct the full
+ * state of every device from them.
+ * SimpleTestDevice's INCREASING param changes every second, and MY_INT changes only
+ * when written, so after the first full DevData both only reach Dawn in deltas.
+ */
+
+#include "../test.h"
+
+#define UID 0x24
+#define INCREASING 0  // Index of "INCREASING"
+#define MY_INT 3      // Index of "MY_INT"
+#define WRITTEN_VAL 71
+
+int main() {
+    // Setup
+    start_test("DevData Deltas", "", NO_REGEX);
+    request_dev_data_deltas();
+    set_dev_data_rate(DEVICE_DATA_INTERVAL, 40);  // Also send when nothing changed, so that unchanged params are left out of deltas
+
+    // Connect SimpleTestDevice
+    connect_virtual_device("SimpleTestDevice", UID);
+    sleep(1);
+
+    // Write MY_INT between two keyframes, and let INCREASING increase
+    param_val_t params[MAX_PARAMS];
+    params[MY_INT].p_i = WRITTEN_VAL;
+    device_write_uid(UID, EXECUTOR, COMMAND, 1 << MY_INT, params);
+    sleep(2);
+
+    // Right after INCREASING changes, give the change time to reach Dawn before the next one
+    param_val_t vals[MAX_PARAMS];
+    device_read_uid(UID, EXECUTOR, DATA, 1 << INCREASING, vals);
+    int32_t last = vals[INCREASING].p_i;
+    while (vals[INCREASING].p_i == last) {
+        usleep(10000);
+        device_read_uid(UID, EXECUTOR, DATA, 1 << INCREASING, vals);
+    }
+    usleep(200000);
+
+    // The reconstructed state must match shared memory
+    DevData* dev_data = get_next_dev_data();
+    check_device_sent(dev_data, 0, device_name_to_type("SimpleTestDevice"), UID);
+    check_device_param_sent(dev_data, 0, "MY_INT", INT, &params[MY_INT], 0);
+    check_device_param_sent(dev_data, 0, "INCREASING", INT, &vals[INCREASING], 1);
+    check_device_sent(dev_data, 1, MAX_DEVICES, 2020);  // CustomData device
+    dev_data__free_unpacked(dev_data, NULL);
+
+    // Most of that state must have come in deltas
+    uint64_t num_full, num_deltas, num_values;
+    get_dev_data_counts(&num_full, &num_deltas, &num_values);
+    if (num_deltas == 0 || num_full > num_deltas) {
+        fprintf(stderr, "Received %llu full DevData messages and %llu deltas\n", num_full, num_deltas);
+        exit(1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+/**
+ * Verifies the drop policy of net handler's send queues when a client stops reading.
+ * The test queues messages itself on a socket pair with small buffers whose other end it
+ * doesn't read until the end, as Dawn would if it froze:
+ *    - device data must be newest-wins: only the latest one is still waiting
+ *    - logs must be coalesced, and dropped oldest first once the queue is over budget,
+ *      so the ones that arrive are in order and include the latest
+ *    - timestamps must never be dropped
+ *    - a client that stays behind long enough must be disconnected
+ * Then it reads everything that was queued and checks what arrived.
+ */
+#include <send_queue.h>
+#include "../test.h"
+
+#define SOCKET_BUF_SIZE 4096
+#define NUM_ROUNDS 2000
+#define TIMESTAMP_ROUNDS 100  // a timestamp is queued every this many rounds
+#define LOG_LEN 64
+
+// Everything the reading end received
+static uint8_t received[SEND_QUEUE_HARD_LIMIT];
+static size_t received_len = 0;
+
+// Queues a message whose payload is just a counter, which is all the queue needs
+static void push_counter(send_queue_t* queue, send_policy_t policy, net_msg_t type, uint32_t counter) {
+    uint8_t msg[BUFFER_OFFSET + sizeof(counter)];
+    set_buf_header(msg, type, sizeof(counter));
+    memcpy(msg + BUFFER_OFFSET, &counter, sizeof(counter));
+    if (send_queue_push(queue, policy, msg, sizeof(msg)) != 0) {
+        fprintf(stderr, "Failed to queue message %d of type %d\n", counter, type);
+        exit(1);
+    }
+}
+
+// Queues a log message with a single line holding the counter
+static void push_log(send_queue_t* queue, uint32_t counter) {
+    char line[LOG_LEN];
+    char* lines[] = {line};
+    snprintf(line, sizeof(line), "log line %u of the frozen client test\n", counter);
+    Text log_msg = TEXT__INIT;
+    log_msg.n_payload = 1;
+    log_msg.payload = lines;
+    uint16_t len_pb = text__get_packed_size(&log_msg);
+    uint8_t* msg = make_buf(LOG_MSG, len_pb);
+    text__pack(&log_msg, msg + BUFFER_OFFSET);
+    if (send_queue_push(queue, SEND_COALESCE, msg, len_pb + BUFFER_OFFSET) != 0) {
+        fprintf(stderr, "Failed to queue log %d\n", counter);
+        exit(1);
+    }
+    free(msg);
+}
+
+// Reads whatever has arrived at the other end
+static void receive(int fd) {
+    ssize_t n_read;
+    while ((n_read = recv(fd, received + received_len, sizeof(received) - received_len, MSG_DONTWAIT)) > 0) {
+        received_len += n_read;
+    }
+}
+
+int main() {
+    // Setup
+    start_test("Send Queue Drop Policy", "", NO_REGEX);
+    int fds[2];
+    int buf_size = SOCKET_BUF_SIZE;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0 || setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size)) != 0 || setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size)) != 0) {
+        fprintf(stderr, "Couldn't set up socket pair: %s\n", strerror(errno));
+        exit(1);
+    }
+    static send_queue_t queue;
+    send_queue_reset(&queue, fds[0]);
+
+    // Queue far more than the client could take while it isn't reading
+    for (uint32_t i = 0; i < NUM_ROUNDS; i++) {
+        push_counter(&queue, SEND_NEWEST_WINS, DEVICE_DATA_MSG, i);
+        push_log(&queue, i);
+        if (i % TIMESTAMP_ROUNDS == 0) {
+            push_counter(&queue, SEND_RELIABLE, TIME_STAMP_MSG, i / TIMESTAMP_ROUNDS);
+        }
+    }
+    send_queue_stats_t stats = queue.stats;
+    printf("Waiting: %zu bytes in %d messages (at most %zu)\n", stats.bytes, queue.num_msgs, stats.max_bytes);
+    printf("Sent %llu, replaced %llu, coalesced %llu, dropped %llu\n", stats.msgs_sent, stats.msgs_replaced, stats.msgs_coalesced, stats.msgs_dropped);
+    if (stats.max_bytes > SEND_QUEUE_BUDGET || stats.msgs_replaced == 0 || stats.msgs_coalesced == 0 || stats.msgs_dropped == 0) {
+        fprintf(stderr, "Queue didn't stay within its budget by replacing, coalescing, and dropping\n");
+        exit(1);
+    }
+
+    // Let the client catch up
+    while (send_queue_pending(&queue)) {
+        receive(fds[1]);
+        if (send_queue_flush(&queue) != 0) {
+            fprintf(stderr, "Failed to flush the queue\n");
+            exit(1);
+        }
+    }
+    receive(fds[1]);
+
+    // Every message must have arrived whole; check each type's policy
+    uint32_t num_timestamps = 0;
+    int64_t last_dev_data = -1;
+    int64_t last_log = -1;
+    size_t offset = 0;
+    while (offset + BUFFER_OFFSET <= received_len) {
+        uint8_t* msg = received + offset;
+        uint16_t len_pb;
+        memcpy(&len_pb, msg + 1, sizeof(len_pb));
+        if (offset + BUFFER_OFFSET + len_pb > received_len) {
+            break;
+        }
+        uint32_t counter;
+        memcpy(&counter, msg + BUFFER_OFFSET, sizeof(counter));
+        if (msg[0] == TIME_STAMP_MSG) {
+            if (counter != num_timestamps++) {
+                fprintf(stderr, "Timestamp %u arrived as number %u\n", counter, num_timestamps - 1);
+                exit(1);
+            }
+        } else if (msg[0] == DEVICE_DATA_MSG) {
+            if ((int64_t) counter <= last_dev_data) {
+                fprintf(stderr, "Device data %u arrived after %lld\n", counter, last_dev_data);
+                exit(1);
+            }
+            last_dev_data = counter;
+        } else if (msg[0] == LOG_MSG) {
+            Text* log_msg = text__unpack(NULL, len_pb, msg + BUFFER_OFFSET);
+            if (log_msg == NULL) {
+                fprintf(stderr, "Coalesced log message can't be unpacked\n");
+                exit(1);
+            }
+            for (size_t i = 0; i < log_msg->n_payload; i++) {
+                uint32_t line;
+                sscanf(log_msg->payload[i], "log line %u", &line);
+                if ((int64_t) line <= last_log) {
+                    fprintf(stderr, "Log line %u arrived after %lld\n", line, last_log);
+                    exit(1);
+                }
+                last_log = line;
+            }
+            text__free_unpacked(log_msg, NULL);
+        } else {
+            fprintf(stderr, "Received message of unknown type %d\n", msg[0]);
+            exit(1);
+        }
+        offset += BUFFER_OFFSET + len_pb;
+    }
+    if (offset != received_len || num_timestamps != NUM_ROUNDS / TIMESTAMP_ROUNDS || last_dev_data != NUM_ROUNDS - 1 || last_log != NUM_ROUNDS - 1) {
+        fprintf(stderr, "Received %u timestamps, device data up to %lld, and logs up to %lld\n", num_timestamps, last_dev_data, last_log);
+        exit(1);
+    }
+
+    // A client that never catches up is given up on
+    int ret = 0;
+    for (uint32_t i = 0; ret == 0 && i < SEND_QUEUE_HARD_LIMIT; i++) {
+        uint8_t msg[BUFFER_OFFSET + sizeof(i)];
+        set_buf_header(msg, TIME_STAMP_MSG, sizeof(i));
+        memcpy(msg + BUFFER_OFFSET, &i, sizeof(i));
+        ret = send_queue_push(&queue, SEND_RELIABLE, msg, sizeof(msg));
+    }
+    if (ret != -1) {
+        fprintf(stderr, "Queue kept growing for a client that wasn't reading\n");
+        exit(1);
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * Verifies that device data is only sent to Dawn when something changed, at the rate Dawn asked for.
+ * With no devices connected, nothing changes, so nothing should be sent. SimpleTestDevice's
+ * params change once a second, so it should only cause about one message a second, but a
+ * written param should still reach Dawn right away.
+ */
+
+#include "../test.h"
+
+#define UID 0x27
+#define MY_INT 3  // Index of "MY_INT"
+#define WRITTEN_VAL 71
+#define MIN_INTERVAL 20  // Min ms between two messages that Dawn asks for
+
+// Returns how many device data messages (of any kind) Dawn has received
+static uint64_t num_dev_data() {
+    uint64_t num_full, num_deltas, num_values;
+    get_dev_data_counts(&num_full, &num_deltas, &num_values);
+    return num_full + num_deltas + num_values;
+}
+
+int main() {
+    // Setup
+    start_test("Event-Driven Device Data", "", NO_REGEX);
+    set_dev_data_rate(MIN_INTERVAL, 0);
+    sleep(1);
+
+    // Nothing changes, so nothing is sent
+    uint64_t before = num_dev_data();
+    sleep(2);
+    uint64_t idle = num_dev_data() - before;
+    if (idle != 0) {
+        fprintf(stderr, "Received %llu device data messages while nothing changed\n", idle);
+        exit(1);
+    }
+
+    // A connecting device is sent right away, then only its changes
+    connect_virtual_device("SimpleTestDevice", UID);
+    sleep(1);
+    before = num_dev_data();
+    sleep(3);
+    uint64_t changing = num_dev_data() - before;
+    if (changing == 0 || changing > 3 * 3) {
+        fprintf(stderr, "Received %llu device data messages in 3 seconds for values changing once a second\n", changing);
+        exit(1);
+    }
+
+    // A written value doesn't wait for the next change of the others
+    param_val_t params[MAX_PARAMS];
+    params[MY_INT].p_i = WRITTEN_VAL;
+    device_write_uid(UID, EXECUTOR, COMMAND, 1 << MY_INT, params);
+    usleep(200000);
+    DevData* dev_data = get_next_dev_data();
+    check_device_sent(dev_data, 0, device_name_to_type("SimpleTestDevice"), UID);
+    check_device_param_sent(dev_data, 0, "MY_INT", INT, &params[MY_INT], 0);
+    dev_data__free_unpacked(dev_data, NULL);
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * Verifies that read-only observers are sent the same telemetry as Dawn, but can't command the robot.
+ * Several observers connect alongside Dawn and Shepherd. Each of them must receive the device data
+ * of a connected device and the logs that Dawn receives, while a run mode they send is ignored,
+ * and one of them disconnecting must not disconnect or stop anyone else.
+ */
+#include "../test.h"
+
+#define UID 0x29
+#define NUM_OBSERVERS 3
+#define RECV_TIMEOUT 3000  // ms to wait for an observer to receive what it should
+
+// What an observer has received
+typedef struct {
+    bool dev_data;  // a DevData with the device
+    bool log;       // the log about Dawn not being allowed to start the robot
+} received_t;
+
+// Reads what has arrived for an observer until it has received everything, and exits if it doesn't in time
+static void check_received(int fd) {
+    received_t received = {false, false};
+    uint64_t start = millis();
+    while (!received.dev_data || !received.log) {
+        if (millis() - start > RECV_TIMEOUT) {
+            fprintf(stderr, "Observer received device data: %d, logs: %d\n", received.dev_data, received.log);
+            exit(1);
+        }
+        fd_set read_set;
+        FD_ZERO(&read_set);
+        FD_SET(fd, &read_set);
+        struct timeval timeout = {0, 100000};
+        if (select(fd + 1, &read_set, NULL, NULL, &timeout) <= 0) {
+            continue;
+        }
+        net_msg_t msg_type;
+        uint16_t len;
+        uint8_t* buf;
+        if (parse_msg(fd, &msg_type, &len, &buf) != 0) {
+            fprintf(stderr, "Observer was disconnected\n");
+            exit(1);
+        }
+        if (msg_type == DEVICE_DATA_MSG) {
+            DevData* dev_data = dev_data__unpack(NULL, len, buf);
+            for (size_t i = 0; dev_data != NULL && i < dev_data->n_devices; i++) {
+                received.dev_data |= dev_data->devices[i]->uid == UID;
+            }
+            dev_data__free_unpacked(dev_data, NULL);
+        } else if (msg_type == LOG_MSG) {
+            Text* logs = text__unpack(NULL, len, buf);
+            for (size_t i = 0; logs != NULL && i < logs->n_payload; i++) {
+                received.log |= strstr(logs->payload[i], "You cannot send Robot to Auto or Teleop from Dawn") != NULL;
+            }
+            text__free_unpacked(logs, NULL);
+        } else {
+            fprintf(stderr, "Observer received message of type %d\n", msg_type);
+            exit(1);
+        }
+        free(buf);
+    }
+}
+
+int main() {
+    // Setup
+    start_test("Read-Only Observers", "", NO_REGEX);
+    int observers[NUM_OBSERVERS];
+    for (int i = 0; i < NUM_OBSERVERS; i++) {
+        observers[i] = connect_observer();
+    }
+    connect_virtual_device("SimpleTestDevice", UID);
+    sleep(1);
+
+    // An observer can't start the robot, and Dawn can't either while Shepherd is connected, which is logged
+    RunMode run_mode = RUN_MODE__INIT;
+    run_mode.mode = MODE__TELEOP;
+    uint16_t len = run_mode__get_packed_size(&run_mode);
+    uint8_t* send_buf = make_buf(RUN_MODE_MSG, len);
+    run_mode__pack(&run_mode, send_buf + BUFFER_OFFSET);
+    writen(observers[0], send_buf, len + BUFFER_OFFSET);
+    free(send_buf);
+    send_run_mode(DAWN, TELEOP);
+    check_run_mode(IDLE);
+
+    // Every observer received the device and the log
+    for (int i = 0; i < NUM_OBSERVERS; i++) {
+        check_received(observers[i]);
+    }
+
+    // An observer leaving doesn't affect anyone else
+    close(observers[0]);
+    send_run_mode(SHEPHERD, AUTO);
+    check_run_mode(AUTO);
+    if (robot_desc_read(DAWN) != CONNECTED || robot_desc_read(SHEPHERD) != CONNECTED) {
+        fprintf(stderr, "Dawn or Shepherd was disconnected when an observer left\n");
+        exit(1);
+    }
+    send_run_mode(SHEPHERD, IDLE);
+    for (int i = 1; i < NUM_OBSERVERS; i++) {
+        close(observers[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * Verifies that net handler measures the round trip time to Dawn and Shepherd with its own probes,
+ * which the test client answers like Dawn does, and publishes the percentiles and Dawn's clock offset
+ * in CustomData. Dawn and Shepherd run on this machine, so the round trips must be short and the
+ * clock offset about 0. Probes are only sent to a client that asked for them, so nothing is measured before.
+ */
+#include "../test.h"
+
+#define MAX_LOCAL_RTT 100000  // us; far longer than any round trip to this machine should take
+#define MAX_LOCAL_OFFSET 2    // ms; the same clock, up to rounding on both ends
+
+// Returns the value of an int param of CustomData, exiting if it wasn't sent
+static int32_t get_custom_param(DevData* dev_data, char* name) {
+    for (size_t i = 0; i < dev_data->n_devices; i++) {
+        Device* device = dev_data->devices[i];
+        if (device->uid != 2020) {
+            continue;
+        }
+        for (size_t j = 0; j < device->n_params; j++) {
+            if (strcmp(device->params[j]->name, name) == 0) {
+                return device->params[j]->ival;
+            }
+        }
+    }
+    fprintf(stderr, "CustomData doesn't have %s\n", name);
+    exit(1);
+}
+
+int main() {
+    // Setup
+    start_test("Round Trip Time Monitor", "", NO_REGEX);
+
+    // Clients that don't ask for probes aren't sent any
+    sleep(2);
+    DevData* dev_data = get_next_dev_data();
+    if (get_custom_param(dev_data, "rtt_p50_us") != -1 || get_custom_param(dev_data, "shepherd_rtt_p50_us") != -1) {
+        fprintf(stderr, "Round trips were measured before the clients asked for probes\n");
+        exit(1);
+    }
+    dev_data__free_unpacked(dev_data, NULL);
+
+    // Several probes are answered
+    request_rtt_probes(DAWN);
+    request_rtt_probes(SHEPHERD);
+    sleep(3);
+    dev_data = get_next_dev_data();
+    int32_t p50 = get_custom_param(dev_data, "rtt_p50_us");
+    int32_t p99 = get_custom_param(dev_data, "rtt_p99_us");
+    int32_t offset = get_custom_param(dev_data, "clock_offset_ms");
+    int32_t shepherd_p50 = get_custom_param(dev_data, "shepherd_rtt_p50_us");
+    int32_t shepherd_p99 = get_custom_param(dev_data, "shepherd_rtt_p99_us");
+    dev_data__free_unpacked(dev_data, NULL);
+    printf("Dawn: p50 %d us, p99 %d us, clock offset %d ms\n", p50, p99, offset);
+    printf("Shepherd: p50 %d us, p99 %d us\n", shepherd_p50, shepherd_p99);
+
+    if (p50 < 0 || p50 > p99 || p99 > MAX_LOCAL_RTT) {
+        fprintf(stderr, "Round trips to Dawn weren't measured correctly\n");
+        exit(1);
+    }
+    if (shepherd_p50 < 0 || shepherd_p50 > shepherd_p99 || shepherd_p99 > MAX_LOCAL_RTT) {
+        fprintf(stderr, "Round trips to Shepherd weren't measured correctly\n");
+        exit(1);
+    }
+    if (offset < -MAX_LOCAL_OFFSET || offset > MAX_LOCAL_OFFSET) {
+        fprintf(stderr, "Dawn's clock offset should be about 0\n");
+        exit(1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * Verifies that device and parameter handles (Robot.device(...).param(...)) read and write the same values
+ * as Robot.get_value() and Robot.set_value(), which are backed by them, and that a handle keeps working after
+ * its device reconnects at a different index in shared memory.
+ */
+#include "../test.h"
+
+// The UID of GeneralTestDevice to connect and reference in device_handles.py
+#define UID 0x0123456789ABCDEF
+
+int main() {
+    // Setup
+    start_test("Device Handles", "device_handles", NO_REGEX);
+    int socket_num = connect_virtual_device("GeneralTestDevice", UID);
+    sleep(1);
+
+    // Both ways of writing copy ALWAYS_LEET (1337) plus an offset
+    param_val_t red_int = {.p_i = 1338};
+    param_val_t orange_int = {.p_i = 1339};
+    send_run_mode(SHEPHERD, AUTO);
+    sleep(1);
+    same_param_value("GeneralTestDevice", UID, "RED_INT", INT, red_int);
+    same_param_value("GeneralTestDevice", UID, "ORANGE_INT", INT, orange_int);
+
+    // Reconnect the device behind another one, so that it is no longer where the handles found it
+    disconnect_virtual_device(socket_num);
+    sleep(1);
+    connect_virtual_device("SimpleTestDevice", 0x32);
+    connect_virtual_device("GeneralTestDevice", UID);
+    sleep(2);
+    same_param_value("GeneralTestDevice", UID, "RED_INT", INT, red_int);
+    same_param_value("GeneralTestDevice", UID, "ORANGE_INT", INT, orange_int);
+    send_run_mode(SHEPHERD, IDLE);
+
+    add_ordered_string_output("Invalid device parameter NOT_A_PARAM for device type GeneralTestDevice(63)");
+    add_ordered_string_output("Device with type GeneralTestDevice(63) and uid 81985529216486895 isn't connected to the robot");
+    return 0;
+}
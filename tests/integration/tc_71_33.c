@@ -0,0 +1,30 @@
+/**
+ * Verifies that Robot.get_values() reads several params of a device at once, and that
+ * Robot.set_values() writes params of several devices at once, all of which reach the devices.
+ */
+#include "../test.h"
+
+// The UIDs of the devices referenced in batch_values.py
+#define GENERAL_UID 0x0123456789ABCDEF
+#define SIMPLE_UID 51
+
+int main() {
+    // Setup
+    start_test("Batched Get and Set", "batch_values", NO_REGEX);
+    connect_virtual_device("GeneralTestDevice", GENERAL_UID);
+    connect_virtual_device("SimpleTestDevice", SIMPLE_UID);
+    sleep(1);
+
+    // The values that were read together are written to both devices
+    send_run_mode(SHEPHERD, AUTO);
+    sleep(1);
+    param_val_t red_int = {.p_i = 1337};
+    param_val_t orange_float = {.p_f = 3.14159265359};
+    param_val_t my_int = {.p_i = 1338};
+    same_param_value("GeneralTestDevice", GENERAL_UID, "RED_INT", INT, red_int);
+    same_param_value("GeneralTestDevice", GENERAL_UID, "ORANGE_FLOAT", FLOAT, orange_float);
+    same_param_value("SimpleTestDevice", SIMPLE_UID, "MY_INT", INT, my_int);
+    send_run_mode(SHEPHERD, IDLE);
+
+    return 0;
+}
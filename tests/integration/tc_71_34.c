@@ -0,0 +1,40 @@
+/**
+ * Verifies that a student action blocked in shared memory doesn't stop the rest of the student code.
+ * One action writes a device's param in a loop while the main thread counts up a logged value.
+ * The test holds the device's command semaphore, so the writing action blocks waiting for it;
+ * since the student API releases the GIL around shared memory calls, the main thread must keep counting.
+ */
+#include "../test.h"
+
+#define UID 52
+#define BLOCKED_TIME 2000  // ms to hold the device's command semaphore for
+#define MIN_PROGRESS 50    // how much the main thread, counting every 10 ms, must count up while the action is blocked
+
+int main() {
+    // Setup
+    start_test("Actions Progress While One Is Blocked", "gil_release", NO_REGEX);
+    connect_virtual_device("SimpleTestDevice", UID);
+    sleep(1);
+    send_run_mode(SHEPHERD, AUTO);
+    sleep(1);
+
+    // Block the writing action for a while
+    int dev_ix = get_dev_ix_from_uid(UID);
+    if (dev_ix == -1) {
+        fprintf(stderr, "SimpleTestDevice isn't connected\n");
+        exit(1);
+    }
+    sem_wait(sems[dev_ix].command_sem);
+    int32_t start = check_log_key("progress").p_i;
+    usleep(BLOCKED_TIME * 1000);
+    int32_t end = check_log_key("progress").p_i;
+    sem_post(sems[dev_ix].command_sem);
+    send_run_mode(SHEPHERD, IDLE);
+
+    printf("Main thread counted from %d to %d while the action was blocked\n", start, end);
+    if (start == 0 || end - start < MIN_PROGRESS) {
+        fprintf(stderr, "Main thread didn't make progress while an action was blocked in shared memory\n");
+        exit(1);
+    }
+    return 0;
+}
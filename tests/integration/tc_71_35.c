@@ -0,0 +1,33 @@
+/**
+ * Verifies that Gamepad.snapshot() and Keyboard.snapshot() capture the buttons, joysticks and keys
+ * that are pressed, which the student code reads from them and logs.
+ */
+#include "../test.h"
+
+int main() {
+    // Setup
+    start_test("Input Snapshots", "input_snapshot", NO_REGEX);
+    float joystick_vals[4] = {-0.5, 0.25, 0.0, 1.0};
+    float no_joysticks[4] = {0.0, 0.0, 0.0, 0.0};
+    send_user_input(get_button_bit("button_a") | get_button_bit("dpad_down"), joystick_vals, GAMEPAD);
+    send_user_input(get_key_bit("w") | get_key_bit("z"), no_joysticks, KEYBOARD);
+    sleep(1);
+
+    send_run_mode(SHEPHERD, TELEOP);
+    sleep(1);
+    if (!check_log_key("combo").p_b) {
+        fprintf(stderr, "Gamepad snapshot doesn't have the buttons that are pressed\n");
+        exit(1);
+    }
+    if (check_log_key("left_x").p_f != -0.5) {
+        fprintf(stderr, "Gamepad snapshot doesn't have the joystick position\n");
+        exit(1);
+    }
+    if (!check_log_key("keys").p_b) {
+        fprintf(stderr, "Keyboard snapshot doesn't have the keys that are pressed\n");
+        exit(1);
+    }
+    send_run_mode(SHEPHERD, IDLE);
+
+    return 0;
+}
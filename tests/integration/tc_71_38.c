@@ -0,0 +1,50 @@
+/**
+ * Verifies that the bindings from Robot.bind_axis() and Robot.bind_arcade_drive() write the params of a device
+ * from the gamepad's joysticks, with their scale and deadband, while the student code is busy in a loop that
+ * never returns to the executor, and that the params are held at 0 once the gamepad disconnects.
+ */
+#include "../test.h"
+
+// The UID of the device referenced in input_bindings.py
+#define GENERAL_UID 0x0123456789ABCDEF
+
+int main() {
+    // Setup
+    start_test("Native Input Bindings", "input_bindings", NO_REGEX);
+    connect_virtual_device("GeneralTestDevice", GENERAL_UID);
+    float joystick_vals[4] = {0.0, 0.5, 0.25, 0.0};  // left x, left y, right x, right y
+    send_user_input(0, joystick_vals, GAMEPAD);
+    sleep(1);
+    send_run_mode(SHEPHERD, TELEOP);
+    sleep(1);
+
+    // RED_FLOAT = -left y; ORANGE_FLOAT = left y + right x; GREEN_FLOAT = left y - right x
+    param_val_t red_float = {.p_f = -0.5};
+    param_val_t orange_float = {.p_f = 0.75};
+    param_val_t green_float = {.p_f = 0.25};
+    same_param_value("GeneralTestDevice", GENERAL_UID, "RED_FLOAT", FLOAT, red_float);
+    same_param_value("GeneralTestDevice", GENERAL_UID, "ORANGE_FLOAT", FLOAT, orange_float);
+    same_param_value("GeneralTestDevice", GENERAL_UID, "GREEN_FLOAT", FLOAT, green_float);
+
+    // Left y is within the deadband of RED_FLOAT's binding, but not of the arcade drive's
+    joystick_vals[1] = 0.03125;
+    send_user_input(0, joystick_vals, GAMEPAD);
+    sleep(1);
+    red_float.p_f = 0.0;
+    orange_float.p_f = 0.28125;
+    green_float.p_f = -0.21875;
+    same_param_value("GeneralTestDevice", GENERAL_UID, "RED_FLOAT", FLOAT, red_float);
+    same_param_value("GeneralTestDevice", GENERAL_UID, "ORANGE_FLOAT", FLOAT, orange_float);
+    same_param_value("GeneralTestDevice", GENERAL_UID, "GREEN_FLOAT", FLOAT, green_float);
+
+    // Every bound param is held at 0 without a gamepad
+    disconnect_user_input();
+    sleep(1);
+    orange_float.p_f = 0.0;
+    green_float.p_f = 0.0;
+    same_param_value("GeneralTestDevice", GENERAL_UID, "ORANGE_FLOAT", FLOAT, orange_float);
+    same_param_value("GeneralTestDevice", GENERAL_UID, "GREEN_FLOAT", FLOAT, green_float);
+    send_run_mode(SHEPHERD, IDLE);
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+/**
+ * Verifies that Robot.device_view() gives the params of a device through the buffer protocol, with the types of
+ * the params converted to doubles, and that the history of the view keeps the values of its last refreshes in order.
+ */
+#include "../test.h"
+
+// The UID of the device referenced in device_view.py
+#define GENERAL_UID 0x0123456789ABCDEF
+#define HISTORY 4  // samples kept in the history of the view
+
+int main() {
+    // Setup
+    start_test("Device Views", "device_view", NO_REGEX);
+    connect_virtual_device("GeneralTestDevice", GENERAL_UID);
+    sleep(1);
+    send_run_mode(SHEPHERD, AUTO);
+    sleep(2);
+
+    int32_t leet = check_log_key("leet").p_i;
+    float pi = check_log_key("pi").p_f;
+    int32_t samples = check_log_key("samples").p_i;
+    bool history_ok = check_log_key("history_ok").p_b;
+    send_run_mode(SHEPHERD, IDLE);
+
+    if (leet != 1337 || pi < 3.1415 || pi > 3.1416) {
+        fprintf(stderr, "Read ALWAYS_LEET = %d and ALWAYS_PI = %f through the view\n", leet, pi);
+        exit(1);
+    }
+    if (samples != HISTORY || !history_ok) {
+        fprintf(stderr, "History of the view has %d samples and %s in order\n", samples, history_ok ? "is" : "isn't");
+        exit(1);
+    }
+    return 0;
+}
@@ -6,12 +6,118 @@
  * When TimeTestDevice's "GET_TIME" is set to 1, it populates its "TIMESTAMP"
  * param, which can be read from shared memory.
  * The latency should be no more than a couple milliseconds.
+ *
+ * Then it compares sending inputs from Dawn over TCP and over UDP, with packets on loopback
+ * dropped by `tc netem` (if the test is allowed to add a qdisc; otherwise without loss).
+ * The qdisc is removed when the test exits or is killed by a signal, even if it fails midway.
+ * The latency of an input is the time until it, or a newer one, is in shared memory.
+ * A lost TCP segment holds up every input after it until it is retransmitted, while
+ * a lost datagram is just superseded by the next one.
+ * Last, it checks that a stale datagram is ignored, that restarting the UDP sequence is followed,
+ * and that TCP inputs are only applied while UDP inputs are silent.
  */
 #include "../test.h"
 
 #define TIME_DEV_UID 123
 #define UPPER_BOUND_LATENCY 5
 
+#define NUM_INPUTS 300
+#define INPUT_INTERVAL 10000  // microseconds between inputs, like a controller polled at 100 Hz
+#define INPUT_TIMEOUT 5000    // ms to wait for the last input to arrive
+#define ADD_LOSS "tc qdisc add dev lo root netem loss 10%"
+#define REMOVE_LOSS "tc qdisc del dev lo root netem"
+
+static bool lossy = false;  // whether this test added the loss to loopback, and hasn't removed it yet
+static pid_t test_pid;      // the test's process; processes forked from it don't own the loss
+
+// Removes the loss from loopback, if this test added it. Runs at exit, whatever makes the test exit.
+static void remove_loss() {
+    if (!lossy || getpid() != test_pid) {
+        return;
+    }
+    lossy = false;
+    if (system(REMOVE_LOSS) != 0) {
+        fprintf(stderr, "Couldn't remove loss with `%s`\n", REMOVE_LOSS);
+    }
+}
+
+// Removes the loss when the test is interrupted or killed, then dies of the signal as it would have
+static void remove_loss_on_signal(int sig) {
+    remove_loss();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Adds the loss to loopback, making sure it is removed however the test ends. Returns whether it could be added.
+static bool add_loss() {
+    test_pid = getpid();
+    atexit(remove_loss);
+    int signals[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGSEGV, SIGABRT};
+    for (int i = 0; i < sizeof(signals) / sizeof(int); i++) {
+        signal(signals[i], remove_loss_on_signal);
+    }
+    lossy = (system(ADD_LOSS) == 0);
+    return lossy;
+}
+
+// Returns the buttons currently in shared memory for the gamepad
+static uint64_t read_buttons() {
+    uint64_t buttons = 0;
+    float joystick_vals[4];
+    input_read(&buttons, joystick_vals, GAMEPAD);
+    return buttons;
+}
+
+/**
+ * Sends NUM_INPUTS inputs whose buttons count up from FIRST, and measures the latency of each.
+ * Over UDP, the last one is resent until it arrives, as Dawn keeps sending its current inputs.
+ * Arguments:
+ *    - udp: whether to send the inputs over UDP instead of TCP
+ *    - first: buttons of the first input; must be greater than the buttons currently in shared memory
+ *    - seq: sequence number of the last datagram sent, which is updated
+ *    - p99: set to the 99th percentile of the latencies (in microseconds)
+ * Returns: the max latency (in microseconds); exits if the last input doesn't arrive
+ */
+static uint64_t measure_inputs(bool udp, uint64_t first, uint32_t* seq, uint64_t* p99) {
+    static uint64_t sent_at[NUM_INPUTS];
+    static uint64_t latencies[NUM_INPUTS];
+    float joystick_vals[4] = {0};
+    int num_seen = 0;  // inputs up to this one have been measured
+
+    for (int i = 0; num_seen < NUM_INPUTS; i++) {
+        if (i >= NUM_INPUTS && micros() - sent_at[NUM_INPUTS - 1] > INPUT_TIMEOUT * 1000) {
+            fprintf(stderr, "Last input over %s didn't arrive within %d ms\n", udp ? "UDP" : "TCP", INPUT_TIMEOUT);
+            exit(1);
+        }
+        uint64_t buttons = first + ((i < NUM_INPUTS) ? i : NUM_INPUTS - 1);
+        if (i < NUM_INPUTS) {
+            sent_at[i] = micros();
+        }
+        if (udp) {
+            send_user_input_udp(++(*seq), buttons, joystick_vals, GAMEPAD);
+        } else if (i < NUM_INPUTS) {
+            send_user_input(buttons, joystick_vals, GAMEPAD);
+        }
+
+        // Until the next input is due, record every input that has been applied or superseded
+        uint64_t next = micros() + INPUT_INTERVAL;
+        do {
+            uint64_t now = micros();
+            uint64_t newest = read_buttons();
+            while (num_seen < NUM_INPUTS && num_seen <= i && newest >= first + num_seen) {
+                latencies[num_seen] = now - sent_at[num_seen];
+                num_seen++;
+            }
+            usleep(100);
+        } while (micros() < next && num_seen < NUM_INPUTS);
+    }
+
+    qsort(latencies, NUM_INPUTS, sizeof(uint64_t), compare_u64);
+    *p99 = latencies[NUM_INPUTS * 99 / 100];
+    printf("%s inputs: p50 %llu us, p99 %llu us, max %llu us\n", udp ? "UDP" : "TCP", latencies[NUM_INPUTS / 2], *p99, latencies[NUM_INPUTS - 1]);
+    return latencies[NUM_INPUTS - 1];
+}
+
 int main() {
     // Setup
     start_test("Latency Test", "runtime_latency", NO_REGEX);
@@ -43,5 +149,54 @@ int main() {
     // Check the latency between the button pressed and its change to TIMESTAMP
     check_latency(TIME_DEV_UID, UPPER_BOUND_LATENCY, start);
 
+    // Compare the input paths while packets are being lost
+    bool with_loss = add_loss();
+    if (!with_loss) {
+        printf("Couldn't inject loss with `%s`; comparing inputs without loss\n", ADD_LOSS);
+    }
+    uint32_t seq = 0;
+    uint64_t tcp_p99, udp_p99;
+    measure_inputs(false, 1, &seq, &tcp_p99);
+    measure_inputs(true, NUM_INPUTS + 1, &seq, &udp_p99);
+    remove_loss();
+    if (with_loss && udp_p99 > tcp_p99) {
+        fprintf(stderr, "UDP inputs were held up more than TCP inputs under loss\n");
+        exit(1);
+    }
+
+    // A datagram that arrives after a newer one is ignored
+    float joystick_vals_udp[4] = {0};
+    send_user_input_udp(seq - 1, 0, joystick_vals_udp, GAMEPAD);
+    usleep(20000);
+    if (read_buttons() != 2 * NUM_INPUTS) {
+        fprintf(stderr, "A stale UDP input replaced a newer one\n");
+        exit(1);
+    }
+
+    // Dawn reopening its UDP socket starts the sequence over, which is applied right away
+    seq = 1;
+    send_user_input_udp(seq, 2 * NUM_INPUTS + 1, joystick_vals_udp, GAMEPAD);
+    usleep(20000);
+    if (read_buttons() != 2 * NUM_INPUTS + 1) {
+        fprintf(stderr, "UDP inputs weren't applied after the sequence restarted\n");
+        exit(1);
+    }
+
+    // While UDP inputs arrive, TCP inputs are dropped; once UDP is silent, TCP inputs are applied again
+    send_user_input_udp(++seq, 2 * NUM_INPUTS + 2, joystick_vals_udp, GAMEPAD);
+    send_user_input(2 * NUM_INPUTS + 3, joystick_vals, GAMEPAD);
+    usleep(20000);
+    if (read_buttons() != 2 * NUM_INPUTS + 2) {
+        fprintf(stderr, "A TCP input replaced a UDP input while UDP inputs were arriving\n");
+        exit(1);
+    }
+    usleep((UDP_SILENCE_TIMEOUT + 50) * 1000);
+    send_user_input(2 * NUM_INPUTS + 4, joystick_vals, GAMEPAD);
+    usleep(20000);
+    if (read_buttons() != 2 * NUM_INPUTS + 4) {
+        fprintf(stderr, "TCP inputs weren't applied after UDP inputs went silent\n");
+        exit(1);
+    }
+
     return 0;
 }
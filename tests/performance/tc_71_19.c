@@ -0,0 +1,95 @@
+/**
+ * Performance test.
+ * Cyclictest-style benchmark of the real-time scheduling profile.
+ * Runs the same loop as dev handler's sender thread (sleep 1 ms, do work, repeat)
+ * while every CPU is kept busy by CPU hogs (standing in for a busy executor or ngrok),
+ * and measures how late each wake up is. The loop is run once under the default
+ * scheduler and once with the real-time profile applied; p50/p99/max wake up
+ * latencies of both runs are reported. Nothing is asserted about them, since
+ * they depend on the machine and whatever else is running on it.
+ * If the real-time profile can't be applied (missing permissions), only the
+ * baseline is reported.
+ */
+#include <sys/wait.h>
+
+#include "../test.h"
+
+#define NUM_CYCLES 5000  // Number of 1 ms cycles to measure per run
+#define INTERVAL 1000    // Sleep time (microseconds) of one cycle; same as dev handler's sender
+
+// Holds the results of one run of the loop
+typedef struct {
+    bool rt;                   // Whether to apply the real-time profile to the measuring thread
+    int rt_err;                // Error number returned when applying the real-time profile
+    uint64_t lat[NUM_CYCLES];  // Wake up latency (microseconds past the requested time) of each cycle
+} run_t;
+
+// Keeps a CPU busy until killed
+static void cpu_hog() {
+    volatile uint64_t x = 0;
+    while (1) {
+        x++;
+    }
+}
+
+// The measuring thread: the dev handler sender loop with a timer around the sleep
+static void* cyclic_loop(void* args) {
+    run_t* run = (run_t*) args;
+    if (run->rt) {
+        run->rt_err = rt_profile_thread_init(RT_PRIO_DEV_HANDLER);
+    }
+    for (int i = 0; i < NUM_CYCLES; i++) {
+        uint64_t start = micros();
+        usleep(INTERVAL);
+        uint64_t elapsed = micros() - start;
+        run->lat[i] = (elapsed > INTERVAL) ? elapsed - INTERVAL : 0;
+    }
+    qsort(run->lat, NUM_CYCLES, sizeof(uint64_t), compare_u64);
+    return NULL;
+}
+
+// Runs the loop in a new thread and prints its latency percentiles
+static void measure(run_t* run, char* name) {
+    pthread_t tid;
+    pthread_create(&tid, NULL, cyclic_loop, run);
+    pthread_join(tid, NULL);
+    printf("%s: p50 = %llu us, p99 = %llu us, max = %llu us\n", name, run->lat[NUM_CYCLES / 2],
+           run->lat[NUM_CYCLES * 99 / 100], run->lat[NUM_CYCLES - 1]);
+}
+
+int main() {
+    // Setup
+    start_test("Real-Time Scheduling Jitter", "", NO_REGEX);
+
+    // Load every CPU
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    pid_t hogs[num_cpus];
+    for (int i = 0; i < num_cpus; i++) {
+        if ((hogs[i] = fork()) == 0) {
+            cpu_hog();
+        }
+    }
+
+    // Baseline under the default scheduler
+    static run_t baseline = {.rt = false};
+    measure(&baseline, "SCHED_OTHER");
+
+    // Same loop with the real-time profile
+    static run_t rt = {.rt = true};
+    setenv(RT_PROFILE_ENV, "1", 1);
+    int err = rt_profile_process_init();
+    measure(&rt, "RT profile");
+
+    for (int i = 0; i < num_cpus; i++) {
+        kill(hogs[i], SIGKILL);
+        waitpid(hogs[i], NULL, 0);
+    }
+
+    if (err != 0 || rt.rt_err != 0) {
+        fprintf(stderr, "Real-time profile not applied (%s); only the baseline is meaningful\n", strerror(err != 0 ? err : rt.rt_err));
+        return 0;
+    }
+    printf("RT profile p99 - SCHED_OTHER p99 = %lld us\n",
+           (long long) rt.lat[NUM_CYCLES * 99 / 100] - (long long) baseline.lat[NUM_CYCLES * 99 / 100]);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * Performance test.
+ * Benchmarks dev handler at full robot scale with a fleet of MAX_DEVICES emulated
+ * devices (see client/device_fleet.h), under four loads:
+ *    steady:    every device sends DEVICE_DATA every millisecond
+ *    bursts:    steady, plus a burst of commands to every device every 20 ms
+ *    malformed: steady, with 5% of DEVICE_DATA frames corrupted
+ *    storm:     steady, with a quarter of the devices unplugged for 300 ms every second
+ * Results are printed as CSV (throughput, drops, dev handler CPU, latency percentiles)
+ * so runs before and after a dev handler change can be compared.
+ * Usage: tc_71_20 [csv file] [socket|pty]
+ *    csv file: also append the results to this file
+ *    pty: connect the fleet as Arduinos over pseudoterminals (requires write access to /dev)
+ */
+#include "../test.h"
+
+#define FIRST_UID 0x7100
+#define DURATION 5000  // Length of each run, in milliseconds
+
+int main(int argc, char* argv[]) {
+    fleet_transport_t transport = (argc > 2 && strcmp(argv[2], "pty") == 0) ? FLEET_PTY : FLEET_SOCKET;
+    FILE* csv = NULL;
+    if (argc > 1) {
+        csv = fopen(argv[1], "a");
+        if (csv == NULL) {
+            fprintf(stderr, "Couldn't open %s: %s\n", argv[1], strerror(errno));
+            exit(1);
+        }
+    }
+
+    // Setup
+    start_test("Device Fleet Throughput", "", NO_REGEX);
+
+    fleet_config_t runs[] = {
+        {.name = "steady", .data_interval_us = 1000},
+        {.name = "bursts", .data_interval_us = 1000, .write_burst_interval_ms = 20, .write_burst_size = 5},
+        {.name = "malformed", .data_interval_us = 1000, .malformed_per_mille = 50},
+        {.name = "storm", .data_interval_us = 1000, .storm_interval_ms = 1000, .storm_size = MAX_DEVICES / 4, .storm_downtime_ms = 300},
+    };
+    int num_runs = sizeof(runs) / sizeof(runs[0]);
+
+    fleet_print_csv_header(stdout);
+    if (csv != NULL) {
+        fleet_print_csv_header(csv);
+    }
+    for (int i = 0; i < num_runs; i++) {
+        runs[i].transport = transport;
+        runs[i].dev_name = "GeneralTestDevice";
+        runs[i].num_devices = MAX_DEVICES;
+        runs[i].first_uid = FIRST_UID;
+        runs[i].duration_ms = DURATION;
+        fleet_stats_t stats;
+        if (fleet_run(&runs[i], &stats) != 0) {
+            fprintf(stderr, "Couldn't start fleet for run %s\n", runs[i].name);
+            exit(1);
+        }
+        fleet_print_csv_row(stdout, &runs[i], &stats);
+        if (csv != NULL) {
+            fleet_print_csv_row(csv, &runs[i], &stats);
+        }
+        if (stats.data_sent == 0) {
+            fprintf(stderr, "Run %s couldn't send any data to dev handler\n", runs[i].name);
+            exit(1);
+        }
+        sleep(2);  // Let dev handler clean up the fleet before the next run
+    }
+
+    if (csv != NULL) {
+        fclose(csv);
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * Performance test.
+ * Benchmarks how fast net handler builds and sends a DevData to Dawn with many
+ * devices connected, and how many heap allocations each send makes.
+ * The test calls send_device_data() itself on a send queue over a socket pair that it
+ * drains after every send, against the shared memory of the running Runtime, so only
+ * building, packing, and queueing the message is measured.
+ * While no device connects or disconnects, a send should not allocate at all.
+ * Then it does the same with MAX_OBSERVERS observers, to which the same DevData is packed once
+ * and queued without copying, so each of them should only cost a socket write and still not allocate.
+ */
+#include <net_handler_message.h>
+#include "../alloc_count.h"
+#include "../test.h"
+
+#define NUM_DEVICES 16
+#define FIRST_UID 0x2300
+#define NUM_SENDS 20000
+
+// Packs a DevData for observers only (Dawn isn't connected), and queues it for each of them
+static void send_to_observers(send_queue_t* observers, int observer_fds[][2], uint64_t start_time) {
+    shared_msg_t* dawn_msg;
+    shared_msg_t* observer_msg;
+    pack_device_data(NULL, true, start_time, &dawn_msg, &observer_msg);
+    for (int i = 0; i < MAX_OBSERVERS; i++) {
+        if (send_queue_push_shared(&observers[i], SEND_NEWEST_WINS, observer_msg) != 0) {
+            fprintf(stderr, "Queueing device data for observer %d failed\n", i);
+            exit(1);
+        }
+        drain(observer_fds[i][1]);
+    }
+    shared_msg_release(observer_msg);
+}
+
+int main() {
+    // Setup
+    start_test("DevData Send Benchmark", "", NO_REGEX);
+
+    for (int i = 0; i < NUM_DEVICES; i++) {
+        connect_virtual_device("GeneralTestDevice", FIRST_UID + i);
+    }
+    sleep(2);  // Let them connect
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        fprintf(stderr, "Couldn't create socket pair: %s\n", strerror(errno));
+        exit(1);
+    }
+    static send_queue_t queue;
+    send_queue_reset(&queue, fds[0]);
+    uint64_t start_time = millis();
+
+    // The first send sets up whatever is reused afterwards
+    counting = true;
+    send_device_data(&queue, start_time);
+    drain(fds[1]);
+    uint64_t first_allocs = num_allocs;
+
+    num_allocs = 0;
+    uint64_t start = micros();
+    for (int i = 0; i < NUM_SENDS; i++) {
+        if (send_device_data(&queue, start_time) != 0) {
+            fprintf(stderr, "send_device_data() failed\n");
+            exit(1);
+        }
+        drain(fds[1]);
+    }
+    uint64_t elapsed = micros() - start;
+    counting = false;
+    close(fds[0]);
+    close(fds[1]);
+
+    printf("Devices: %d\n", NUM_DEVICES);
+    printf("First send: %llu allocations\n", first_allocs);
+    printf("Sends per second: %llu\n", (uint64_t) NUM_SENDS * 1000000 / (elapsed ? elapsed : 1));
+    printf("Average send: %.2f us\n", (double) elapsed / NUM_SENDS);
+    printf("Allocations per send: %.2f\n", (double) num_allocs / NUM_SENDS);
+
+    if (num_allocs != 0) {
+        fprintf(stderr, "send_device_data() made %llu allocations over %d steady-state sends\n", num_allocs, NUM_SENDS);
+        exit(1);
+    }
+
+    // Fan the same DevData out to observers as well, as net handler's event loop does
+    static send_queue_t observers[MAX_OBSERVERS];
+    int observer_fds[MAX_OBSERVERS][2];
+    for (int i = 0; i < MAX_OBSERVERS; i++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, observer_fds[i]) != 0) {
+            fprintf(stderr, "Couldn't create socket pair: %s\n", strerror(errno));
+            exit(1);
+        }
+        send_queue_reset(&observers[i], observer_fds[i][0]);
+    }
+    send_to_observers(observers, observer_fds, start_time);  // Sets up the observers' queues
+    counting = true;
+    num_allocs = 0;
+    start = micros();
+    for (int i = 0; i < NUM_SENDS; i++) {
+        send_to_observers(observers, observer_fds, start_time);
+    }
+    elapsed = micros() - start;
+    counting = false;
+    for (int i = 0; i < MAX_OBSERVERS; i++) {
+        close(observer_fds[i][0]);
+        close(observer_fds[i][1]);
+    }
+
+    printf("Observers: %d\n", MAX_OBSERVERS);
+    printf("Sends per second to all observers: %llu\n", (uint64_t) NUM_SENDS * 1000000 / (elapsed ? elapsed : 1));
+    printf("Average send to all observers: %.2f us\n", (double) elapsed / NUM_SENDS);
+    printf("Allocations per send to all observers: %.2f\n", (double) num_allocs / NUM_SENDS);
+
+    if (num_allocs != 0) {
+        fprintf(stderr, "Sending to observers made %llu allocations over %d steady-state sends\n", num_allocs, NUM_SENDS);
+        exit(1);
+    }
+    return 0;
+}
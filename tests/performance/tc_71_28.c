@@ -0,0 +1,111 @@
+/**
+ * Performance test.
+ * Benchmarks how fast net handler processes the messages Dawn sends most often
+ * (UserInputs, and TimeStamps, which are replied to), and how many heap allocations
+ * processing each one makes. The test calls process_new_msg() itself with packed
+ * messages, against the shared memory of the running Runtime, and replies on a
+ * send queue over a socket pair that it drains after every message.
+ * Once the receive arena has grown to fit the messages, processing should not allocate at all,
+ * even after a much bigger message than usual.
+ */
+#include <net_handler_message.h>
+#include "../alloc_count.h"
+#include "../test.h"
+
+#define NUM_MSGS 20000
+#define NUM_BIG_INPUTS 256  // inputs in the big message, far more than the arena starts out fitting
+
+// Packs a UserInputs with NUM_INPUTS gamepads that all press BUTTONS into BUF, returning its length
+static uint16_t pack_inputs(uint8_t* buf, int num_inputs, uint64_t buttons) {
+    static Input inputs[NUM_BIG_INPUTS];
+    static Input* input_ptrs[NUM_BIG_INPUTS];
+    static float axes[4] = {0.25, -0.5, 0.75, -1.0};
+    for (int i = 0; i < num_inputs; i++) {
+        input__init(&inputs[i]);
+        inputs[i].connected = 1;
+        inputs[i].source = SOURCE__GAMEPAD;
+        inputs[i].buttons = buttons;
+        inputs[i].n_axes = 4;
+        inputs[i].axes = axes;
+        input_ptrs[i] = &inputs[i];
+    }
+    UserInputs user_inputs = USER_INPUTS__INIT;
+    user_inputs.n_inputs = num_inputs;
+    user_inputs.inputs = input_ptrs;
+    return user_inputs__pack(&user_inputs, buf);
+}
+
+// Processes a message as if Dawn sent it, exiting if it fails
+static void process(send_queue_t* queue, net_msg_t msg_type, uint8_t* buf, uint16_t len_pb) {
+    if (process_new_msg(queue, DAWN, msg_type, buf, len_pb) != 0) {
+        fprintf(stderr, "process_new_msg() failed for message of type %d\n", msg_type);
+        exit(1);
+    }
+}
+
+int main() {
+    // Setup
+    start_test("Receive Path Allocations", "", NO_REGEX);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        fprintf(stderr, "Couldn't create socket pair: %s\n", strerror(errno));
+        exit(1);
+    }
+    static send_queue_t queue;
+    send_queue_reset(&queue, fds[0]);
+
+    static uint8_t inputs_buf[UINT16_MAX];
+    static uint8_t big_inputs_buf[UINT16_MAX];
+    static uint8_t timestamp_buf[UINT16_MAX];
+    uint16_t big_inputs_len = pack_inputs(big_inputs_buf, NUM_BIG_INPUTS, 0);
+    TimeStamps timestamp = TIME_STAMPS__INIT;
+    timestamp.dawn_timestamp = millis();
+    uint16_t timestamp_len = time_stamps__pack(&timestamp, timestamp_buf);
+
+    // The first messages set up whatever is reused afterwards
+    counting = true;
+    process(&queue, INPUTS_MSG, inputs_buf, pack_inputs(inputs_buf, 1, 0));
+    process(&queue, TIME_STAMP_MSG, timestamp_buf, timestamp_len);
+    drain(fds[1]);
+    uint64_t first_allocs = num_allocs;
+
+    // A much bigger message allocates once, then the arena fits it
+    num_allocs = 0;
+    process(&queue, INPUTS_MSG, big_inputs_buf, big_inputs_len);
+    uint64_t big_allocs = num_allocs;
+    num_allocs = 0;
+    process(&queue, INPUTS_MSG, big_inputs_buf, big_inputs_len);
+    uint64_t big_again_allocs = num_allocs;
+
+    num_allocs = 0;
+    uint64_t start = micros();
+    for (int i = 0; i < NUM_MSGS; i++) {
+        process(&queue, INPUTS_MSG, inputs_buf, pack_inputs(inputs_buf, 1, i));
+        process(&queue, TIME_STAMP_MSG, timestamp_buf, timestamp_len);
+        drain(fds[1]);
+    }
+    uint64_t elapsed = micros() - start;
+    counting = false;
+    close(fds[0]);
+    close(fds[1]);
+
+    printf("First messages: %llu allocations\n", first_allocs);
+    printf("Message of %d inputs: %llu allocations, then %llu\n", NUM_BIG_INPUTS, big_allocs, big_again_allocs);
+    printf("Messages per second: %llu\n", (uint64_t) 2 * NUM_MSGS * 1000000 / (elapsed ? elapsed : 1));
+    printf("Allocations per message: %.2f\n", (double) num_allocs / (2 * NUM_MSGS));
+
+    // The inputs must have actually been applied
+    uint64_t buttons;
+    float joystick_vals[4];
+    input_read(&buttons, joystick_vals, GAMEPAD);
+    if (buttons != NUM_MSGS - 1 || joystick_vals[1] != -0.5) {
+        fprintf(stderr, "Gamepad has buttons %llu and joystick %f after the last input\n", buttons, joystick_vals[1]);
+        exit(1);
+    }
+    if (num_allocs != 0 || big_again_allocs != 0) {
+        fprintf(stderr, "process_new_msg() made %llu allocations over %d steady-state messages\n", num_allocs + big_again_allocs, 2 * NUM_MSGS);
+        exit(1);
+    }
+    return 0;
+}
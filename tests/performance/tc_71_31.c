@@ -0,0 +1,78 @@
+/**
+ * Performance test.
+ * Measures how long it takes from a run mode change until the first instruction of the student code runs.
+ * The student code sleeps for half a second when it is imported, standing in for heavy imports like numpy.
+ * Starting a mode from IDLE hands the mode to the executor's zygote, which has already imported the student code,
+ * so only autonomous() or teleop() runs on the transition. So does switching from AUTO straight to TELEOP, since
+ * another zygote is forked as soon as AUTO starts. Switching from TELEOP straight to AUTO has no zygote to hand it to,
+ * so it waits for the import, which is reported for comparison.
+ */
+#include "../test.h"
+
+#define NUM_RUNS 10
+#define ZYGOTE_READY 1500     // ms to wait for the zygote to be forked again and import the student code
+#define START_TIMEOUT 5000    // ms to wait for the student code to run
+#define WARM_MAX_LATENCY 50   // ms that a mode may take to start from IDLE
+#define COLD_MIN_LATENCY 500  // ms that a mode without a zygote takes at least, importing the student code
+
+/**
+ * Changes the run mode, and measures how long it takes until the student code sets "mode_started" for it.
+ * Arguments:
+ *    - mode: AUTO, which sets it to 1, or TELEOP, which sets it to 2
+ * Returns: the latency in microseconds; exits if the student code doesn't run
+ */
+static uint64_t measure_start(robot_desc_val_t mode) {
+    int32_t expected = (mode == AUTO) ? 1 : 2;
+    param_val_t started;
+    uint64_t start = micros();
+    send_run_mode(SHEPHERD, mode);
+    while (!read_log_key("mode_started", &started) || started.p_i != expected) {
+        if (micros() - start > START_TIMEOUT * 1000) {
+            fprintf(stderr, "Student code didn't run within %d ms of starting mode %d\n", START_TIMEOUT, mode);
+            exit(1);
+        }
+        usleep(100);
+    }
+    return micros() - start;
+}
+
+int main() {
+    // Setup
+    start_test("Mode Start Latency", "mode_start", NO_REGEX);
+
+    // Start each mode from IDLE, alternating between them so that every run changes "mode_started"
+    uint64_t warm[NUM_RUNS];
+    for (int i = 0; i < NUM_RUNS; i++) {
+        usleep(ZYGOTE_READY * 1000);
+        warm[i] = measure_start((i % 2 == 0) ? AUTO : TELEOP);
+        send_run_mode(SHEPHERD, IDLE);
+    }
+    qsort(warm, NUM_RUNS, sizeof(uint64_t), compare_u64);
+
+    // Switch from AUTO straight to TELEOP, which starts from the zygote forked when AUTO started
+    usleep(ZYGOTE_READY * 1000);
+    measure_start(AUTO);
+    usleep(ZYGOTE_READY * 1000);
+    uint64_t auto_to_teleop = measure_start(TELEOP);
+
+    // Switch from TELEOP straight to AUTO, which starts without a zygote
+    uint64_t cold = measure_start(AUTO);
+    send_run_mode(SHEPHERD, IDLE);
+
+    printf("From IDLE (zygote): p50 %llu us, max %llu us\n", warm[NUM_RUNS / 2], warm[NUM_RUNS - 1]);
+    printf("From AUTO to TELEOP (zygote): %llu us\n", auto_to_teleop);
+    printf("Without a zygote: %llu us\n", cold);
+    if (warm[NUM_RUNS - 1] > WARM_MAX_LATENCY * 1000) {
+        fprintf(stderr, "Starting a mode from IDLE took up to %llu us\n", warm[NUM_RUNS - 1]);
+        exit(1);
+    }
+    if (auto_to_teleop > WARM_MAX_LATENCY * 1000) {
+        fprintf(stderr, "Switching from AUTO to TELEOP took %llu us\n", auto_to_teleop);
+        exit(1);
+    }
+    if (cold < COLD_MIN_LATENCY * 1000) {
+        fprintf(stderr, "Starting a mode without a zygote didn't wait for the import\n");
+        exit(1);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+/**
+ * Performance test.
+ * Measures how precisely Robot.run_periodic() keeps the rate of a student loop, which is asked to run at 200 Hz.
+ * The rate is measured from how fast the loop counts up a logged value, and the loop's own timing statistics
+ * (overruns, start jitter and execution time) are read from what it logs about itself.
+ */
+#include "../test.h"
+
+#define RATE 200             // calls per second the student code asks for
+#define MEASURE_TIME 3000    // ms to measure the rate over
+#define MAX_RATE_ERROR 1.0   // percent that the measured rate may be off by
+#define MAX_JITTER_P99 2000  // us that a call may start after its deadline (p99)
+#define MAX_OVERRUNS 1.0     // percent of the calls that may overrun, for the odd preemption by the rest of the machine
+
+int main() {
+    // Setup
+    start_test("Periodic Loop Timing", "periodic", NO_REGEX);
+    send_run_mode(SHEPHERD, AUTO);
+    sleep(2);  // the loop logs its timing after a second
+
+    // Count the calls made over the measurement
+    uint64_t start = micros();
+    int32_t start_ticks = check_log_key("ticks").p_i;
+    usleep(MEASURE_TIME * 1000);
+    int32_t end_ticks = check_log_key("ticks").p_i;
+    double rate = (end_ticks - start_ticks) * 1e6 / (micros() - start);
+
+    int32_t overruns = check_log_key("tick_overruns").p_i;
+    int32_t jitter_p99 = check_log_key("tick_jitter_p99_us").p_i;
+    int32_t exec_p50 = check_log_key("tick_exec_p50_us").p_i;
+    int32_t exec_p99 = check_log_key("tick_exec_p99_us").p_i;
+    send_run_mode(SHEPHERD, IDLE);
+
+    printf("Rate: %.2f Hz (asked for %d Hz)\n", rate, RATE);
+    printf("Overruns: %d of %d calls, start jitter p99: %d us, execution time p50: %d us, p99: %d us\n", overruns, end_ticks, jitter_p99, exec_p50, exec_p99);
+    if (rate < RATE * (1 - MAX_RATE_ERROR / 100) || rate > RATE * (1 + MAX_RATE_ERROR / 100)) {
+        fprintf(stderr, "Rate is off by more than %.1f%%\n", MAX_RATE_ERROR);
+        exit(1);
+    }
+    if (overruns * 100.0 > end_ticks * MAX_OVERRUNS || jitter_p99 > MAX_JITTER_P99) {
+        fprintf(stderr, "Calls didn't start on time\n");
+        exit(1);
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * Performance test.
+ * Compares the two ways that student actions are run: plain functions on the reusable action threads, and
+ * `async def` functions as tasks on the executor's event loop. The student code measures how long an action takes to
+ * start after Robot.run() (median), and how long it takes to switch between two actions that hand control back
+ * and forth, for each kind of action, and logs the results. Which kind is faster depends on the machine, so the
+ * results are printed for comparison, and only have to be within bounds that catch a regression.
+ */
+#include "../test.h"
+
+#define MEASURE_TIMEOUT 20000    // ms to wait for the student code to log all of its measurements
+#define MAX_START_LATENCY 500  // us that either kind of action may take to start (p50)
+#define MAX_SWITCH_TIME 100    // us that switching between either kind of actions may take
+
+int main() {
+    // Setup
+    start_test("Action Start and Switch Overhead", "action_benchmark", NO_REGEX);
+    send_run_mode(SHEPHERD, AUTO);
+
+    // The switch time of async actions is logged last
+    param_val_t logged;
+    uint64_t start = millis();
+    while (!read_log_key("async_switch_us", &logged)) {
+        if (millis() - start > MEASURE_TIMEOUT) {
+            fprintf(stderr, "Student code didn't log its measurements within %d ms\n", MEASURE_TIMEOUT);
+            exit(1);
+        }
+        usleep(100000);
+    }
+    float async_switch = logged.p_f;
+    float thread_start = check_log_key("thread_start_us").p_f;
+    float async_start = check_log_key("async_start_us").p_f;
+    float thread_switch = check_log_key("thread_switch_us").p_f;
+    send_run_mode(SHEPHERD, IDLE);
+
+    printf("Action start latency (p50): thread %.1f us, async %.1f us\n", thread_start, async_start);
+    printf("Switch between actions: thread %.1f us, async %.1f us\n", thread_switch, async_switch);
+    if (thread_start > MAX_START_LATENCY || async_start > MAX_START_LATENCY) {
+        fprintf(stderr, "Actions took more than %d us to start\n", MAX_START_LATENCY);
+        exit(1);
+    }
+    if (thread_switch > MAX_SWITCH_TIME || async_switch > MAX_SWITCH_TIME) {
+        fprintf(stderr, "Switching between actions took more than %d us\n", MAX_SWITCH_TIME);
+        exit(1);
+    }
+    return 0;
+}
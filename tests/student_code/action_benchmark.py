@@ -0,0 +1,90 @@
+import threading
+import time
+import asyncio
+
+ROUNDS = 1000  # actions started, and switches back and forth, for each measurement
+
+started = threading.Event()
+start_time = 0
+start_latencies = []
+
+def thread_started():
+    start_latencies.append(time.perf_counter_ns() - start_time)
+    started.set()
+
+async def async_started():
+    start_latencies.append(time.perf_counter_ns() - start_time)
+    started.set()
+
+def measure_start(action):
+    """
+    Returns the median time in microseconds from Robot.run() to the first line of `action`
+    """
+    global start_time
+    start_latencies.clear()
+    for _ in range(ROUNDS):
+        start_time = time.perf_counter_ns()
+        Robot.run(action)
+        started.wait()
+        started.clear()
+        while Robot.is_running(action):
+            time.sleep(0)
+    start_latencies.sort()
+    return start_latencies[ROUNDS // 2] / 1000
+
+ping_event = threading.Event()
+pong_event = threading.Event()
+async_ping_event = asyncio.Event()
+async_pong_event = asyncio.Event()
+switch_times = {}
+
+def thread_ping():
+    start = time.perf_counter_ns()
+    for _ in range(ROUNDS):
+        pong_event.set()
+        ping_event.wait()
+        ping_event.clear()
+    switch_times["thread"] = (time.perf_counter_ns() - start) / (2 * ROUNDS) / 1000
+
+def thread_pong():
+    for _ in range(ROUNDS):
+        pong_event.wait()
+        pong_event.clear()
+        ping_event.set()
+
+async def async_ping():
+    start = time.perf_counter_ns()
+    for _ in range(ROUNDS):
+        async_pong_event.set()
+        await async_ping_event.wait()
+        async_ping_event.clear()
+    switch_times["async"] = (time.perf_counter_ns() - start) / (2 * ROUNDS) / 1000
+
+async def async_pong():
+    for _ in range(ROUNDS):
+        await async_pong_event.wait()
+        async_pong_event.clear()
+        async_ping_event.set()
+
+def measure_switch(ping, pong):
+    """
+    Returns the time in microseconds that it takes to switch from one action to another, as two actions hand
+    control back and forth
+    """
+    Robot.run(pong)
+    Robot.run(ping)
+    while Robot.is_running(ping) or Robot.is_running(pong):
+        Robot.sleep(0.01)
+
+def autonomous():
+    Robot.log("thread_start_us", measure_start(thread_started))
+    Robot.log("async_start_us", measure_start(async_started))
+    measure_switch(thread_ping, thread_pong)
+    Robot.log("thread_switch_us", switch_times["thread"])
+    measure_switch(async_ping, async_pong)
+    Robot.log("async_switch_us", switch_times["async"])
+    while True:
+        Robot.sleep(1)
+
+def teleop():
+    pass
@@ -0,0 +1,18 @@
+# 0x0123456789ABCDEF == 0d81985529216486895
+GeneralTestDevice = '63_81985529216486895'
+SimpleTestDevice = '62_51'
+
+def autonomous():
+    """
+    Copies ALWAYS_LEET and ALWAYS_PI into params of both devices, reading and writing them in batches
+    """
+    while True:
+        leet, pi = Robot.get_values(GeneralTestDevice, ["ALWAYS_LEET", "ALWAYS_PI"])
+        Robot.set_values({
+            GeneralTestDevice: {"RED_INT": leet, "ORANGE_FLOAT": pi},
+            SimpleTestDevice: {"MY_INT": leet + 1},
+        })
+        Robot.sleep(0.1)
+
+def teleop():
+    pass
@@ -0,0 +1,25 @@
+# 0x0123456789ABCDEF == 0d81985529216486895
+GeneralTestDevice = '63_81985529216486895'
+
+def autonomous():
+    """
+    Copies ALWAYS_LEET + 1 into RED_INT through handles, and ALWAYS_LEET + 2 into ORANGE_INT through the string API
+    """
+    device = Robot.device(GeneralTestDevice)
+    leet = device.param("ALWAYS_LEET")
+    red = device.param("RED_INT")
+    try:
+        device.param("NOT_A_PARAM")
+    except Exception as e:
+        print(e)
+    while True:
+        try:
+            red.set(leet.get() + 1)
+            Robot.set_value(GeneralTestDevice, "ORANGE_INT", Robot.get_value(GeneralTestDevice, "ALWAYS_LEET") + 2)
+        except Exception as e:  # the device is disconnected for a moment during the test
+            print(e)
+            Robot.sleep(1)
+        Robot.sleep(0.1)
+
+def teleop():
+    pass
@@ -0,0 +1,28 @@
+# 0x0123456789ABCDEF == 0d81985529216486895
+GeneralTestDevice = '63_81985529216486895'
+
+def autonomous():
+    """
+    Reads the device through a view, made into a memoryview once like numpy.frombuffer() would, and checks
+    that its history, which is copied each time it is requested, holds the values of the last refreshes that changed them
+    """
+    view = Robot.device_view(GeneralTestDevice, history=4)
+    values = memoryview(view)
+    leet = view.names.index("ALWAYS_LEET")
+    pi = view.names.index("ALWAYS_PI")
+    increasing = view.names.index("INCREASING_ODD")
+    history_ok = True
+    while True:
+        if view.refresh():
+            rows = memoryview(view.history)
+            history_ok = history_ok and rows[3, increasing] == values[increasing]
+            if view.history.samples == 4:
+                history_ok = history_ok and rows[0, increasing] < rows[1, increasing] < rows[2, increasing] < rows[3, increasing]
+        Robot.log("leet", int(values[leet]))
+        Robot.log("pi", values[pi])
+        Robot.log("samples", view.history.samples)
+        Robot.log("history_ok", history_ok)
+        Robot.sleep(0.05)
+
+def teleop():
+    pass
@@ -0,0 +1,19 @@
+SimpleTestDevice = '62_52'
+
+def write_forever():
+    """
+    Writes MY_INT as fast as it can, so that it waits on the device's command semaphore whenever the test holds it
+    """
+    while True:
+        Robot.set_value(SimpleTestDevice, "MY_INT", 1)
+
+def autonomous():
+    Robot.run(write_forever)
+    progress = 0
+    while True:
+        progress += 1
+        Robot.log("progress", progress)
+        Robot.sleep(0.01)
+
+def teleop():
+    pass
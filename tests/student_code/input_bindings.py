@@ -0,0 +1,14 @@
+# 0x0123456789ABCDEF == 0d81985529216486895
+GeneralTestDevice = '63_81985529216486895'
+
+def autonomous():
+    pass
+
+def teleop():
+    """
+    Binds the gamepad to float params of the device, then keeps Python busy forever
+    """
+    Robot.bind_axis("joystick_left_y", GeneralTestDevice, "RED_FLOAT", scale=-1, deadband=0.05)
+    Robot.bind_arcade_drive("joystick_left_y", "joystick_right_x", GeneralTestDevice, "ORANGE_FLOAT", GeneralTestDevice, "GREEN_FLOAT")
+    while True:
+        pass
@@ -0,0 +1,14 @@
+def autonomous():
+    pass
+
+def teleop():
+    """
+    Logs inputs read from one snapshot of the gamepad and one of the keyboard
+    """
+    while True:
+        gamepad = Gamepad.snapshot()
+        keyboard = Keyboard.snapshot()
+        Robot.log("combo", gamepad.get_value("button_a") and gamepad.get_value("dpad_down") and not gamepad.get_value("button_b"))
+        Robot.log("left_x", gamepad.get_value("joystick_left_x"))
+        Robot.log("keys", keyboard.get_value("w") and keyboard.get_value("z") and not keyboard.get_value("q"))
+        Robot.sleep(0.05)
@@ -0,0 +1,12 @@
+import time
+
+# Stands in for heavy imports (e.g. numpy), which a mode started without a zygote waits for
+time.sleep(0.5)
+
+
+def autonomous():
+    Robot.log("mode_started", 1)
+
+
+def teleop():
+    Robot.log("mode_started", 2)
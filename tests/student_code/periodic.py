@@ -0,0 +1,15 @@
+ticks = 0
+
+def tick():
+    """
+    Counts the calls, so that the test can measure how often they are made
+    """
+    global ticks
+    ticks += 1
+    Robot.log("ticks", ticks)
+
+def autonomous():
+    Robot.run_periodic(tick, 200)
+
+def teleop():
+    pass
@@ -840,3 +840,80 @@ void check_latency(uint64_t uid, int32_t upper_bound_latency, uint64_t start_tim
     }
     print_pass();
 }
+
+void check_device_timing(uint64_t uid, uint32_t upper_bound_latency_us) {
+    dev_timing_t timing;
+    if (device_timing_read_uid(uid, &timing) < 0) {
+        print_fail();
+        fprintf(stderr, "Error reading timing of device with UID: %llu\n", uid);
+        fail_test();
+    }
+    if (!timing.synced) {
+        print_fail();
+        fprintf_delimiter(stderr, "Expected:");
+        fprintf(stderr, "Device clock to be synchronized\n");
+        fprintf_delimiter(stderr, "Got:");
+        fprintf(stderr, "Device clock not synchronized\n");
+        fail_test();
+    } else if (timing.sample_to_shm_us >= upper_bound_latency_us) {
+        print_fail();
+        fprintf_delimiter(stderr, "Expected:");
+        fprintf(stderr, "0 <= sample_to_shm_us < %u\n", upper_bound_latency_us);
+        fprintf_delimiter(stderr, "Got:");
+        fprintf(stderr, "sample_to_shm_us == %u (clock rtt %u us, drift %f ppm)\n", timing.sample_to_shm_us, timing.clock_rtt_us, timing.clock_drift_ppm);
+        fail_test();
+    }
+    print_pass();
+}
+
+void check_write_acks(uint64_t uid, uint32_t min_retransmitted) {
+    dev_timing_t timing;
+    if (device_timing_read_uid(uid, &timing) < 0) {
+        print_fail();
+        fprintf(stderr, "Error reading timing of device with UID: %llu\n", uid);
+        fail_test();
+    }
+    if (timing.writes_acked == 0 || timing.writes_retransmitted < min_retransmitted) {
+        print_fail();
+        fprintf_delimiter(stderr, "Expected:");
+        fprintf(stderr, "writes_acked > 0, writes_retransmitted >= %u\n", min_retransmitted);
+        fprintf_delimiter(stderr, "Got:");
+        fprintf(stderr, "writes_acked == %u, writes_retransmitted == %u (write rtt %u us)\n", timing.writes_acked, timing.writes_retransmitted, timing.write_rtt_us);
+        fail_test();
+    }
+    print_pass();
+}
+
+// ***************************** LOG DATA CHECK ***************************** //
+
+bool read_log_key(char* key, param_val_t* value) {
+    static char names[UCHAR_MAX][LOG_KEY_LENGTH];
+    static param_type_t types[UCHAR_MAX];
+    static param_val_t values[UCHAR_MAX];
+    uint8_t num_params;
+    log_data_read(&num_params, names, types, values);
+    for (int i = 0; i < num_params; i++) {
+        if (strcmp(names[i], key) == 0) {
+            *value = values[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+param_val_t check_log_key(char* key) {
+    param_val_t value;
+    if (!read_log_key(key, &value)) {
+        print_fail();
+        fprintf(stderr, "Student code didn't log %s\n", key);
+        fail_test();
+    }
+    return value;
+}
+
+// ******************************** SORTING ********************************* //
+
+int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
@@ -14,6 +14,7 @@
 #include <stdbool.h>
 
 #include "client/dev_handler_client.h"
+#include "client/device_fleet.h"
 #include "client/executor_client.h"
 #include "client/net_handler_client.h"
 #include "client/shm_client.h"
@@ -199,4 +200,51 @@ void check_param_range(char* dev_name, uint64_t uid, char* param_name, param_typ
  *    start_time: The start of a timer provided by the test case(in ms), usually a call to the millis() function
  */
 void check_latency(uint64_t uid, int32_t upper_bound_latency, uint64_t start_time);
+
+/**
+ * Checks that dev handler synchronized with the device's clock and that the measured latency
+ * between the device reading its params and them landing in shared memory is within bounds
+ * Arguments:
+ *    uid: unique identifier of the device
+ *    upper_bound_latency_us: The expected upperbound latency, in microseconds
+ */
+void check_device_timing(uint64_t uid, uint32_t upper_bound_latency_us);
+
+/**
+ * Checks that the device acknowledged DEVICE_WRITEs and that dev handler retransmitted lost ones
+ * Arguments:
+ *    uid: unique identifier of the device
+ *    min_retransmitted: The minimum number of retransmissions expected
+ */
+void check_write_acks(uint64_t uid, uint32_t min_retransmitted);
+
+// ***************************** LOG DATA CHECK ***************************** //
+
+/**
+ * Looks up a key in the custom log data that the student code sets with Robot.log()
+ * Arguments:
+ *    key: the key to look up
+ *    value: set to the value of the key, if the student code logged it
+ * Returns: whether the student code logged the key
+ */
+bool read_log_key(char* key, param_val_t* value);
+
+/**
+ * Same as above, for a key that the student code must have logged
+ * Arguments:
+ *    key: the key to look up
+ * Returns: the value of the key
+ * Exits with status code 1 if the student code didn't log it
+ */
+param_val_t check_log_key(char* key);
+
+// ******************************** SORTING ********************************* //
+
+/**
+ * Compares two uint64_t's for qsort(), which then sorts them in ascending order
+ * Arguments:
+ *    a, b: pointers to the uint64_t's to compare
+ * Returns: a negative number if *a < *b, 0 if they are equal, and a positive number if *a > *b
+ */
+int compare_u64(const void* a, const void* b);
 #endif